@@ -16,7 +16,8 @@ struct backfill_traversal_helper_t : public btree_traversal_helper_t, public hom
                         const btree_key_t *left_exclusive_or_null,
                         const btree_key_t *right_inclusive_or_null,
                         signal_t *interruptor,
-                        int * /*population_change_out*/)
+                        int * /*population_change_out*/,
+                        int64_t * /*value_bytes_change_out*/)
         THROWS_ONLY(interrupted_exc_t) {
         assert_thread();
         buf_read_t read(leaf_node_buf);
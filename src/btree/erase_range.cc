@@ -28,7 +28,8 @@ public:
                         const btree_key_t *l_excl,
                         const btree_key_t *r_incl,
                         signal_t *,
-                        int *population_change_out) THROWS_ONLY(interrupted_exc_t) {
+                        int *population_change_out,
+                        int64_t *value_bytes_change_out) THROWS_ONLY(interrupted_exc_t) {
         buf_write_t write(leaf_node_buf);
         leaf_node_t *node = static_cast<leaf_node_t *>(write.get_data_write());
 
@@ -52,6 +53,7 @@ public:
         scoped_malloc_t<char> value(sizer_->max_possible_size());
 
         int population_change = 0;
+        int64_t value_bytes_change = 0;
 
         for (size_t i = 0; i < keys_to_delete.size(); ++i) {
             bool found = leaf::lookup(sizer_, node, keys_to_delete[i].btree_key(),
@@ -62,6 +64,7 @@ public:
                 on_erase_cb_(keys_to_delete[i], value.get(), buf_parent_t(leaf_node_buf));
             }
 
+            value_bytes_change -= sizer_->value_bytes(value.get());
             deleter_->delete_value(buf_parent_t(leaf_node_buf), value.get());
             leaf::erase_presence(sizer_, node, keys_to_delete[i].btree_key(),
                                  key_modification_proof_t::real_proof());
@@ -69,6 +72,7 @@ public:
         }
 
         *population_change_out = population_change;
+        *value_bytes_change_out = value_bytes_change;
     }
 
     void postprocess_internal_node(UNUSED buf_lock_t *internal_node_buf) {
@@ -140,6 +144,16 @@ void btree_erase_range_generic(value_sizer_t *sizer,
     erase_range_helper_t helper(sizer, tester, deleter,
                                 left_exclusive_or_null, right_inclusive_or_null,
                                 on_erase_cb);
+    // The traversal might release the superblock, so grab these first.
+    txn_t *txn = superblock->expose_buf().txn();
+    const block_id_t stat_block = superblock->get_stat_block_id();
     btree_parallel_traversal(superblock, &helper, interruptor,
                              release_superblock);
+    // The traversal only updates the population in the stat block.  We don't know
+    // which of the sampled keys the tester erased, so we just drop all of the ones
+    // in the range.
+    if (stat_block != NULL_BLOCK_ID) {
+        erase_stat_block_key_sample_range(txn, stat_block, left_exclusive_or_null,
+                                          right_inclusive_or_null);
+    }
 }
@@ -1,9 +1,11 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "btree/get_distribution.hpp"
 
+#include "btree/depth_first_traversal.hpp"
 #include "btree/internal_node.hpp"
 #include "btree/node.hpp"
 #include "btree/leaf_node.hpp"
+#include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "buffer_cache/alt.hpp"
 #include "utils.hpp"
@@ -16,12 +18,7 @@ public:
 
     void read_stat_block(buf_lock_t *stat_block) {
         guarantee (stat_block != NULL);
-        buf_read_t read(stat_block);
-        uint32_t sb_size;
-        const btree_statblock_t *sb_data =
-            static_cast<const btree_statblock_t *>(read.get_data_read(&sb_size));
-        guarantee(sb_size == BTREE_STATBLOCK_SIZE);
-        key_count = sb_data->population;
+        key_count = ::read_stat_block(stat_block).population;
     }
 
     // This is free to call mark_deleted.
@@ -29,7 +26,8 @@ public:
                         const btree_key_t *,
                         const btree_key_t *,
                         signal_t * /*interruptor*/,
-                        int * /*population_change_out*/) THROWS_ONLY(interrupted_exc_t) {
+                        int * /*population_change_out*/,
+                        int64_t * /*value_bytes_change_out*/) THROWS_ONLY(interrupted_exc_t) {
         buf_read_t read(leaf_node_buf);
         const leaf_node_t *node
             = static_cast<const leaf_node_t *>(read.get_data_read());
@@ -98,3 +96,114 @@ void get_btree_key_distribution(superblock_t *superblock, int depth_limit,
     btree_parallel_traversal(superblock, &helper, &non_interruptor);
     *key_count_out = helper.key_count;
 }
+
+class find_any_key_callback_t : public depth_first_traversal_callback_t {
+public:
+    done_traversing_t handle_pair(scoped_key_value_t &&) {
+        return done_traversing_t::YES;
+    }
+};
+
+bool get_btree_population_in_range(superblock_t *superblock,
+                                   const key_range_t &range,
+                                   int64_t *population_out) {
+    // Writes update the stat block through their transaction rather than through
+    // the superblock, so a snapshot of the superblock doesn't cover it.
+    if (superblock->expose_buf().is_snapshotted()) {
+        return false;
+    }
+    const block_id_t stat_block_id = superblock->get_stat_block_id();
+    if (stat_block_id == NULL_BLOCK_ID) {
+        return false;
+    }
+
+    // The population only counts the keys in `range` if there are no keys on
+    // either side of it.  Each of these traversals stops at the first key it sees,
+    // so they only touch the blocks along the boundaries of `range`.
+    find_any_key_callback_t callback;
+    key_range_t left_of_range(key_range_t::none, store_key_t(),
+                              key_range_t::open, range.left);
+    if (!left_of_range.is_empty()
+        && !btree_depth_first_traversal(superblock, left_of_range, &callback,
+                                        FORWARD, release_superblock_t::KEEP)) {
+        return false;
+    }
+    if (!range.right.unbounded) {
+        key_range_t right_of_range(key_range_t::closed, range.right.key,
+                                   key_range_t::none, store_key_t());
+        if (!btree_depth_first_traversal(superblock, right_of_range, &callback,
+                                         FORWARD, release_superblock_t::KEEP)) {
+            return false;
+        }
+    }
+
+    buf_lock_t stat_block(buf_parent_t(superblock->expose_buf().txn()),
+                          stat_block_id, access_t::read);
+    *population_out = read_stat_block(&stat_block).population;
+    return true;
+}
+
+key_sample_state_t get_btree_key_sample(superblock_t *superblock,
+                                        btree_statblock_t *stats_out,
+                                        std::vector<store_key_t> *sorted_keys_out) {
+    const block_id_t stat_block_id = superblock->get_stat_block_id();
+    if (stat_block_id == NULL_BLOCK_ID) {
+        return key_sample_state_t::MISSING;
+    }
+    buf_lock_t stat_block(buf_parent_t(superblock->expose_buf().txn()),
+                          stat_block_id, access_t::read);
+    key_sample_t key_sample;
+    *stats_out = read_stat_block(&stat_block, &key_sample);
+    if (stats_out->value_bytes == btree_statblock_t::UNKNOWN_VALUE_BYTES) {
+        // The keys that were in the btree before it was upgraded aren't sampled.
+        return key_sample_state_t::MISSING;
+    }
+    if (key_sample.is_depleted(stats_out->population,
+                               key_sample_max_bytes(stat_block.cache()))) {
+        return key_sample_state_t::DEPLETED;
+    }
+    *sorted_keys_out = key_sample.sorted_keys();
+    return key_sample_state_t::USABLE;
+}
+
+class reservoir_sample_callback_t : public depth_first_traversal_callback_t {
+public:
+    reservoir_sample_callback_t(size_t max_keys, signal_t *interruptor)
+        : max_keys_(max_keys), keys_seen_(0), interruptor_(interruptor) { }
+
+    done_traversing_t handle_pair(scoped_key_value_t &&keyvalue) {
+        if (interruptor_->is_pulsed()) {
+            return done_traversing_t::YES;
+        }
+        ++keys_seen_;
+        if (keys_.size() < max_keys_) {
+            keys_.push_back(store_key_t(keyvalue.key()));
+        } else {
+            const uint64_t n = randuint64(keys_seen_);
+            if (n < max_keys_) {
+                keys_[n] = store_key_t(keyvalue.key());
+            }
+        }
+        return done_traversing_t::NO;
+    }
+
+    std::vector<store_key_t> *keys() { return &keys_; }
+
+private:
+    const size_t max_keys_;
+    uint64_t keys_seen_;
+    signal_t *interruptor_;
+    std::vector<store_key_t> keys_;
+};
+
+bool sample_btree_keys(superblock_t *superblock, size_t max_keys,
+                       signal_t *interruptor, std::vector<store_key_t> *keys_out) {
+    reservoir_sample_callback_t callback(max_keys, interruptor);
+    btree_depth_first_traversal(superblock, key_range_t::universe(), &callback,
+                                FORWARD, release_superblock_t::RELEASE);
+    if (interruptor->is_pulsed()) {
+        return false;
+    }
+    keys_out->swap(*callback.keys());
+    return true;
+}
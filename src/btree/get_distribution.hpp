@@ -7,10 +7,43 @@
 #include "btree/keys.hpp"
 #include "buffer_cache/types.hpp"
 
+class signal_t;
 class superblock_t;
+struct btree_statblock_t;
 
 void get_btree_key_distribution(superblock_t *superblock, int depth_limit,
                                 int64_t *key_count_out,
                                 std::vector<store_key_t> *keys_out);
 
+enum class key_sample_state_t {
+    // The sample can be used.
+    USABLE,
+    // Deletions have left the sample too small to be used, and it should be rebuilt
+    // with `sample_btree_keys` and `replace_stat_block_key_sample`.
+    DEPLETED,
+    // The btree was created by an older version, or doesn't have a stat block.
+    MISSING
+};
+
+/* Reads the stat block into `*stats_out` and, if the key sample is usable, sets
+`*sorted_keys_out` to the sorted sample.  `*stats_out` is only set if the result
+isn't `MISSING`.  Doesn't release the superblock. */
+key_sample_state_t get_btree_key_sample(superblock_t *superblock,
+                                        btree_statblock_t *stats_out,
+                                        std::vector<store_key_t> *sorted_keys_out);
+
+/* Reads every key in the btree and sets `*keys_out` to a uniform random sample of
+`max_keys` of them.  Releases the superblock.  Returns `false` if it was
+interrupted. */
+bool sample_btree_keys(superblock_t *superblock, size_t max_keys,
+                       signal_t *interruptor, std::vector<store_key_t> *keys_out);
+
+/* If every key in the btree lies in `range`, sets `*population_out` to the
+population recorded in the stat block (which is then the exact number of keys in
+`range`) and returns `true`.  Otherwise returns `false`, which it always does if
+the superblock is snapshotted.  Doesn't release the superblock. */
+bool get_btree_population_in_range(superblock_t *superblock,
+                                   const key_range_t &range,
+                                   int64_t *population_out);
+
 #endif /* BTREE_GET_DISTRIBUTION_HPP_ */
@@ -0,0 +1,105 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/key_sample.hpp"
+
+#include <algorithm>
+
+#include "utils.hpp"
+
+size_t key_sample_t::num_keys() const {
+    size_t n = 0;
+    for (size_t offset = 0; offset < data_.size();
+         offset += key_at(offset)->full_size()) {
+        ++n;
+    }
+    return n;
+}
+
+bool key_sample_t::should_sample(int64_t population) {
+    rassert(population > 0);
+    return population <= MAX_KEYS
+        || randuint64(population) < static_cast<uint64_t>(MAX_KEYS);
+}
+
+void key_sample_t::add(const btree_key_t *key, size_t max_bytes) {
+    size_t n = num_keys();
+    if (n >= static_cast<size_t>(MAX_KEYS)) {
+        erase_nth(randuint64(n));
+        --n;
+    }
+    const char *key_data = reinterpret_cast<const char *>(key);
+    data_.insert(data_.end(), key_data, key_data + key->full_size());
+    ++n;
+
+    while (data_.size() > max_bytes) {
+        erase_nth(randuint64(n));
+        --n;
+    }
+}
+
+bool key_sample_t::on_erase(const btree_key_t *key) {
+    for (size_t offset = 0; offset < data_.size();
+         offset += key_at(offset)->full_size()) {
+        if (btree_key_cmp(key_at(offset), key) == 0) {
+            erase_at(offset);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool key_sample_t::contains(const char *data, size_t size, const btree_key_t *key) {
+    for (size_t offset = 0; offset < size;) {
+        const btree_key_t *k = reinterpret_cast<const btree_key_t *>(data + offset);
+        if (btree_key_cmp(k, key) == 0) {
+            return true;
+        }
+        offset += k->full_size();
+    }
+    return false;
+}
+
+void key_sample_t::erase_range(const btree_key_t *left_excl_or_null,
+                               const btree_key_t *right_incl_or_null) {
+    size_t offset = 0;
+    while (offset < data_.size()) {
+        const btree_key_t *k = key_at(offset);
+        if ((left_excl_or_null == NULL || btree_key_cmp(left_excl_or_null, k) < 0)
+            && (right_incl_or_null == NULL || btree_key_cmp(k, right_incl_or_null) <= 0)) {
+            erase_at(offset);
+        } else {
+            offset += k->full_size();
+        }
+    }
+}
+
+std::vector<store_key_t> key_sample_t::sorted_keys() const {
+    std::vector<store_key_t> keys;
+    for (size_t offset = 0; offset < data_.size();
+         offset += key_at(offset)->full_size()) {
+        keys.push_back(store_key_t(key_at(offset)));
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+bool key_sample_t::is_depleted(int64_t population, size_t max_bytes) const {
+    // A sample that only ever saw inserts has `min(population, MAX_KEYS)` keys, or
+    // fewer if they didn't fit in `max_bytes`.
+    const int64_t expected = std::min<int64_t>(population, MAX_KEYS);
+    return static_cast<int64_t>(num_keys()) * 2 < expected
+        && data_.size() * 2 < max_bytes;
+}
+
+void key_sample_t::erase_at(size_t offset) {
+    auto begin = data_.begin() + offset;
+    data_.erase(begin, begin + key_at(offset)->full_size());
+}
+
+void key_sample_t::erase_nth(size_t n) {
+    size_t offset = 0;
+    for (size_t i = 0; i < n; ++i) {
+        offset += key_at(offset)->full_size();
+    }
+    guarantee(offset < data_.size());
+    erase_at(offset);
+}
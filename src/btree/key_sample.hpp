@@ -0,0 +1,83 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BTREE_KEY_SAMPLE_HPP_
+#define BTREE_KEY_SAMPLE_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "btree/keys.hpp"
+
+/* `key_sample_t` is a random sample of the keys in a btree.  It's stored in the
+stat block, right after the `btree_statblock_t` header, and it's updated in the same
+write that updates the population.  Keys are sampled with reservoir sampling as
+they're inserted, so every key in the btree is in the sample with about the same
+probability.  The sorted sample is an equi-depth histogram of the btree: about the
+same number of keys lies between any two consecutive sampled keys.
+
+When a sampled key is deleted, it's replaced by a random key from the same leaf,
+which keeps the histogram about right without rereading the btree.  Keys erased
+with `erase_range` can't be replaced that way, so after a big erase the sample is
+left too small to be useful (see `is_depleted`), and it has to be rebuilt from the
+btree.
+
+The serialized form is just the sampled `btree_key_t`s packed back to back, in no
+particular order. */
+class key_sample_t {
+public:
+    // The sample never holds more than this many keys.
+    static const int64_t MAX_KEYS = 128;
+
+    key_sample_t() { }
+    key_sample_t(const char *data, size_t size) : data_(data, data + size) { }
+
+    const char *data() const { return data_.data(); }
+    size_t size_in_bytes() const { return data_.size(); }
+    size_t num_keys() const;
+
+    /* Whether a key that was just inserted into a btree that now has `population`
+    keys should be added to the sample.  This is true with probability
+    `MAX_KEYS / population`. */
+    static bool should_sample(int64_t population);
+
+    /* Adds `key` to the sample, evicting random keys to keep the sample under
+    `MAX_KEYS` keys and `max_bytes` bytes. */
+    void add(const btree_key_t *key, size_t max_bytes);
+
+    /* Called after `key` was inserted into a btree that now has `population`
+    keys. */
+    void on_insert(const btree_key_t *key, int64_t population, size_t max_bytes) {
+        if (should_sample(population)) {
+            add(key, max_bytes);
+        }
+    }
+
+    /* Called after `key` was deleted from the btree.  Returns whether it was in the
+    sample. */
+    bool on_erase(const btree_key_t *key);
+
+    /* Whether `key` is in the serialized sample `data`, without copying it. */
+    static bool contains(const char *data, size_t size, const btree_key_t *key);
+
+    /* Drops every sampled key in (`left_excl_or_null`, `right_incl_or_null`]. */
+    void erase_range(const btree_key_t *left_excl_or_null,
+                     const btree_key_t *right_incl_or_null);
+
+    std::vector<store_key_t> sorted_keys() const;
+
+    /* Whether the sample has lost too many keys to deletions to describe a btree with
+    `population` keys.  `max_bytes` is the limit the keys were added with. */
+    bool is_depleted(int64_t population, size_t max_bytes) const;
+
+private:
+    const btree_key_t *key_at(size_t offset) const {
+        return reinterpret_cast<const btree_key_t *>(data_.data() + offset);
+    }
+    void erase_at(size_t offset);
+    void erase_nth(size_t n);
+
+    std::vector<char> data_;
+};
+
+#endif  // BTREE_KEY_SAMPLE_HPP_
@@ -23,6 +23,9 @@ public:
     virtual int size(const void *value) const = 0;
     virtual bool fits(const void *value, int length_available) const = 0;
     virtual int max_possible_size() const = 0;
+    // The number of bytes the value accounts for in the stat block.  This
+    // includes out-of-line data (such as blob contents) that `size` doesn't.
+    virtual int64_t value_bytes(const void *value) const = 0;
     virtual block_magic_t btree_leaf_magic() const = 0;
     virtual max_block_size_t block_size() const = 0;
 
@@ -53,11 +56,20 @@ struct btree_statblock_t {
     //The total number of keys in the btree
     int64_t population;
 
+    //The total size of the values in the btree, in bytes, as reported by
+    //`value_sizer_t::value_bytes`.  Stat blocks created by older versions don't
+    //have this field, in which case it is `UNKNOWN_VALUE_BYTES`.
+    int64_t value_bytes;
+
+    static const int64_t UNKNOWN_VALUE_BYTES = -1;
+
     btree_statblock_t()
-        : population(0)
+        : population(0), value_bytes(0)
     { }
 } __attribute__((__packed__));
 static const uint32_t BTREE_STATBLOCK_SIZE = sizeof(btree_statblock_t);
+// The size of stat blocks written before `value_bytes` was added.
+static const uint32_t BTREE_STATBLOCK_POPULATION_ONLY_SIZE = sizeof(int64_t);
 
 
 //Note: This struct is stored directly on disk.  Changing it invalidates old data.
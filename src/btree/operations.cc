@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+#include <deque>
+
 #include "btree/erase_range.hpp"
 #include "btree/internal_node.hpp"
 #include "btree/slice.hpp"
@@ -392,6 +394,242 @@ void create_stat_block(superblock_t *sb) {
     sb->set_stat_block_id(stats_block.block_id());
 }
 
+btree_statblock_t read_stat_block(buf_lock_t *stat_block,
+                                  key_sample_t *key_sample_out) {
+    buf_read_t read(stat_block);
+    uint32_t sb_size;
+    const char *sb_data = static_cast<const char *>(read.get_data_read(&sb_size));
+    btree_statblock_t ret;
+    if (sb_size == BTREE_STATBLOCK_POPULATION_ONLY_SIZE) {
+        memcpy(&ret.population, sb_data, sizeof(ret.population));
+        ret.value_bytes = btree_statblock_t::UNKNOWN_VALUE_BYTES;
+        if (key_sample_out != NULL) {
+            *key_sample_out = key_sample_t();
+        }
+    } else {
+        guarantee(sb_size >= BTREE_STATBLOCK_SIZE);
+        memcpy(&ret, sb_data, BTREE_STATBLOCK_SIZE);
+        if (key_sample_out != NULL) {
+            *key_sample_out = key_sample_t(sb_data + BTREE_STATBLOCK_SIZE,
+                                           sb_size - BTREE_STATBLOCK_SIZE);
+        }
+    }
+    return ret;
+}
+
+btree_statblock_t read_stat_block(buf_lock_t *stat_block) {
+    return read_stat_block(stat_block, NULL);
+}
+
+void write_stat_block(buf_lock_t *stat_block, const btree_statblock_t &stats,
+                      const key_sample_t &key_sample) {
+    buf_write_t write(stat_block);
+    char *data = static_cast<char *>(write.get_data_write(
+        BTREE_STATBLOCK_SIZE + key_sample.size_in_bytes()));
+    memcpy(data, &stats, BTREE_STATBLOCK_SIZE);
+    memcpy(data + BTREE_STATBLOCK_SIZE, key_sample.data(),
+           key_sample.size_in_bytes());
+}
+
+size_t key_sample_max_bytes(cache_t *cache) {
+    return cache->max_block_size().value() - BTREE_STATBLOCK_SIZE;
+}
+
+// Overwrites the stat block's header, leaving its key sample as it is.
+void write_stat_block_header(buf_lock_t *stat_block, const btree_statblock_t &stats) {
+    uint32_t sb_size;
+    {
+        buf_read_t read(stat_block);
+        read.get_data_read(&sb_size);
+    }
+    guarantee(sb_size >= BTREE_STATBLOCK_SIZE);
+    buf_write_t write(stat_block);
+    memcpy(write.get_data_write(sb_size), &stats, BTREE_STATBLOCK_SIZE);
+}
+
+bool stat_block_samples_key(buf_lock_t *stat_block, const btree_key_t *key) {
+    buf_read_t read(stat_block);
+    uint32_t sb_size;
+    const char *sb_data = static_cast<const char *>(read.get_data_read(&sb_size));
+    guarantee(sb_size >= BTREE_STATBLOCK_SIZE);
+    return key_sample_t::contains(sb_data + BTREE_STATBLOCK_SIZE,
+                                  sb_size - BTREE_STATBLOCK_SIZE, key);
+}
+
+// Picks a random key from the leaf, if it's not empty.
+bool random_leaf_key(buf_lock_t *leaf_buf, store_key_t *key_out) {
+    buf_read_t read(leaf_buf);
+    const leaf_node_t *node = static_cast<const leaf_node_t *>(read.get_data_read());
+    size_t num_keys = 0;
+    for (auto it = leaf::begin(*node); it != leaf::end(*node); ++it) {
+        ++num_keys;
+    }
+    if (num_keys == 0) {
+        return false;
+    }
+    auto it = leaf::begin(*node);
+    for (size_t n = randsize(num_keys); n > 0; --n) {
+        ++it;
+    }
+    *key_out = store_key_t((*it).first);
+    return true;
+}
+
+void update_stat_block(txn_t *txn, block_id_t stat_block,
+                       int64_t population_change, int64_t value_bytes_change,
+                       const btree_key_t *key, buf_lock_t *leaf_or_null) {
+    buf_lock_t stat_block_lock(buf_parent_t(txn), stat_block, access_t::write);
+    btree_statblock_t stats = read_stat_block(&stat_block_lock);
+    stats.population += population_change;
+    // Stat blocks written by older versions don't know the size of the btree, and
+    // the keys that are already in the btree couldn't be sampled.  Writing them
+    // back upgrades them to the current size.
+    if (stats.value_bytes == btree_statblock_t::UNKNOWN_VALUE_BYTES) {
+        write_stat_block(&stat_block_lock, stats, key_sample_t());
+        return;
+    }
+    stats.value_bytes += value_bytes_change;
+
+    // Most writes don't change the sample: an insert is only sampled with
+    // probability `MAX_KEYS / population`, and a delete usually deletes a key that
+    // wasn't sampled.  Those only rewrite the header.
+    const size_t max_bytes = key_sample_max_bytes(stat_block_lock.cache());
+    if (key != NULL && population_change > 0
+        && key_sample_t::should_sample(stats.population)) {
+        key_sample_t key_sample;
+        read_stat_block(&stat_block_lock, &key_sample);
+        key_sample.add(key, max_bytes);
+        write_stat_block(&stat_block_lock, stats, key_sample);
+    } else if (key != NULL && population_change < 0
+               && stat_block_samples_key(&stat_block_lock, key)) {
+        key_sample_t key_sample;
+        read_stat_block(&stat_block_lock, &key_sample);
+        key_sample.on_erase(key);
+        // Replace it with a neighbor, so that this part of the key space stays
+        // represented.
+        store_key_t replacement;
+        if (leaf_or_null != NULL && !leaf_or_null->empty()
+            && random_leaf_key(leaf_or_null, &replacement)
+            && !key_sample_t::contains(key_sample.data(),
+                                       key_sample.size_in_bytes(),
+                                       replacement.btree_key())) {
+            key_sample.add(replacement.btree_key(), max_bytes);
+        }
+        write_stat_block(&stat_block_lock, stats, key_sample);
+    } else {
+        write_stat_block_header(&stat_block_lock, stats);
+    }
+}
+
+void erase_stat_block_key_sample_range(txn_t *txn, block_id_t stat_block,
+                                       const btree_key_t *left_exclusive_or_null,
+                                       const btree_key_t *right_inclusive_or_null) {
+    buf_lock_t stat_block_lock(buf_parent_t(txn), stat_block, access_t::write);
+    key_sample_t key_sample;
+    btree_statblock_t stats = read_stat_block(&stat_block_lock, &key_sample);
+    key_sample.erase_range(left_exclusive_or_null, right_inclusive_or_null);
+    write_stat_block(&stat_block_lock, stats, key_sample);
+}
+
+void replace_stat_block_key_sample(txn_t *txn, block_id_t stat_block,
+                                   const std::vector<store_key_t> &keys) {
+    buf_lock_t stat_block_lock(buf_parent_t(txn), stat_block, access_t::write);
+    btree_statblock_t stats = read_stat_block(&stat_block_lock);
+    if (stats.value_bytes == btree_statblock_t::UNKNOWN_VALUE_BYTES) {
+        // The sample still wouldn't be usable, since the size of the btree is
+        // unknown.
+        return;
+    }
+    const size_t max_bytes = key_sample_max_bytes(stat_block_lock.cache());
+    key_sample_t key_sample;
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        key_sample.add(it->btree_key(), max_bytes);
+    }
+    write_stat_block(&stat_block_lock, stats, key_sample);
+}
+
+bool pin_upper_levels(buf_lock_t *superblock, signal_t *interruptor) {
+    if (!superblock->pin_in_memory()) {
+        return false;
+    }
+
+    block_id_t root_id;
+    {
+        buf_read_t read(superblock);
+        uint32_t sb_size;
+        const btree_superblock_t *sb_data
+            = static_cast<const btree_superblock_t *>(read.get_data_read(&sb_size));
+        guarantee(sb_size == BTREE_SUPERBLOCK_SIZE);
+        root_id = sb_data->root_block;
+    }
+    if (root_id == NULL_BLOCK_ID) {
+        superblock->reset_buf_lock();
+        return true;
+    }
+    buf_lock_t root(superblock, root_id, access_t::read);
+    superblock->reset_buf_lock();
+
+    // The btree is balanced, so the leftmost path tells us how deep the leaves are,
+    // and we don't have to load any other leaf to find out.  Holding the root keeps
+    // the depth from changing under us.
+    int leaf_depth = 0;
+    {
+        buf_lock_t node;
+        for (;;) {
+            buf_lock_t *current = node.empty() ? &root : &node;
+            block_id_t child_id;
+            {
+                buf_read_t read(current);
+                const node_t *n = static_cast<const node_t *>(read.get_data_read());
+                if (!node::is_internal(n)) {
+                    break;
+                }
+                const internal_node_t *inode
+                    = reinterpret_cast<const internal_node_t *>(n);
+                rassert(inode->npairs > 0);
+                child_id = internal_node::get_pair_by_index(inode, 0)->lnode;
+            }
+            buf_lock_t child(current, child_id, access_t::read);
+            node = std::move(child);
+            ++leaf_depth;
+            if (interruptor->is_pulsed()) {
+                return false;
+            }
+        }
+    }
+
+    // Walk the internal nodes breadth-first.  Each node is released as soon as its
+    // children are in line, so writers are only held up by the nodes that are
+    // actually being loaded.
+    std::deque<std::pair<buf_lock_t, int> > queue;
+    if (leaf_depth > 0) {
+        queue.push_back(std::make_pair(std::move(root), 0));
+    }
+    while (!queue.empty()) {
+        if (interruptor->is_pulsed()) {
+            return false;
+        }
+        buf_lock_t node = std::move(queue.front().first);
+        const int depth = queue.front().second;
+        queue.pop_front();
+
+        if (!node.pin_in_memory()) {
+            return false;
+        }
+        if (depth + 1 < leaf_depth) {
+            buf_read_t read(&node);
+            const internal_node_t *inode
+                = static_cast<const internal_node_t *>(read.get_data_read());
+            for (int i = 0; i < inode->npairs; ++i) {
+                block_id_t child_id = internal_node::get_pair_by_index(inode, i)->lnode;
+                queue.push_back(std::make_pair(
+                    buf_lock_t(&node, child_id, access_t::read), depth + 1));
+            }
+        }
+    }
+    return true;
+}
+
 buf_lock_t get_root(value_sizer_t *sizer, superblock_t *sb) {
     const block_id_t node_id = sb->get_root_block_id();
 
@@ -472,6 +710,10 @@ void check_and_handle_split(value_sizer_t *sizer,
     // track of the median key in the split; then actually split.
     buf_lock_t rbuf(last_buf->empty() ? sb->expose_buf() : buf_parent_t(last_buf),
                     alt_create_t::create);
+    // Pinned upper levels of the tree stay pinned when they grow.
+    if (buf->is_pinned_in_memory()) {
+        rbuf.pin_in_memory();
+    }
     store_key_t median_buffer;
     btree_key_t *median = median_buffer.btree_key();
 
@@ -509,6 +751,9 @@ void check_and_handle_split(value_sizer_t *sizer,
         // We set the recency of the new root block to the max of the subtrees'
         // recency and the current transaction's recency.
         last_buf->manually_touch_recency(buf->get_recency());
+        if (sb->expose_buf().is_pinned_in_memory()) {
+            last_buf->pin_in_memory();
+        }
 
         insert_root(last_buf->block_id(), sb);
     }
@@ -873,6 +1118,7 @@ void find_keyvalue_location_for_write(
 
         if (key_found) {
             keyvalue_location_out->there_originally_was_value = true;
+            keyvalue_location_out->original_value_bytes = sizer->value_bytes(tmp.get());
             keyvalue_location_out->value = std::move(tmp);
         }
     }
@@ -885,7 +1131,8 @@ void find_keyvalue_location_for_read(
         value_sizer_t *sizer,
         superblock_t *superblock, const btree_key_t *key,
         keyvalue_location_t *keyvalue_location_out,
-        btree_stats_t *stats, profile::trace_t *trace) {
+        btree_stats_t *stats, profile::trace_t *trace,
+        promise_t<superblock_t *> *pass_back_superblock) {
     stats->pm_keys_read.record();
     stats->pm_total_keys_read += 1;
 
@@ -894,7 +1141,11 @@ void find_keyvalue_location_for_read(
 
     if (root_id == NULL_BLOCK_ID) {
         // There is no root, so the tree is empty.
-        superblock->release();
+        if (pass_back_superblock != NULL) {
+            pass_back_superblock->pulse(superblock);
+        } else {
+            superblock->release();
+        }
         return;
     }
 
@@ -902,7 +1153,11 @@ void find_keyvalue_location_for_read(
     {
         profile::starter_t starter("Acquire a block for read.", trace);
         buf_lock_t tmp(superblock->expose_buf(), root_id, access_t::read);
-        superblock->release();
+        if (pass_back_superblock != NULL) {
+            pass_back_superblock->pulse(superblock);
+        } else {
+            superblock->release();
+        }
         buf = std::move(tmp);
     }
 
@@ -958,6 +1213,45 @@ void find_keyvalue_location_for_read(
     }
 }
 
+bool find_value_optimistically(
+        cache_t *cache, block_id_t superblock_id,
+        value_sizer_t *sizer, const btree_key_t *key,
+        void *value_out, bool *found_out) {
+    const btree_superblock_t *sb_data = static_cast<const btree_superblock_t *>(
+        cache->peek_block_for_read(superblock_id));
+    if (sb_data == NULL) {
+        return false;
+    }
+
+    block_id_t node_id = sb_data->root_block;
+    rassert(node_id != SUPERBLOCK_ID);
+    if (node_id == NULL_BLOCK_ID) {
+        // There is no root, so the tree is empty.
+        *found_out = false;
+        return true;
+    }
+
+    for (;;) {
+        const void *data = cache->peek_block_for_read(node_id);
+        if (data == NULL) {
+            return false;
+        }
+#ifndef NDEBUG
+        node::validate(sizer, static_cast<const node_t *>(data));
+#endif  // NDEBUG
+
+        if (!node::is_internal(static_cast<const node_t *>(data))) {
+            *found_out = leaf::lookup(sizer, static_cast<const leaf_node_t *>(data),
+                                      key, value_out);
+            return true;
+        }
+
+        node_id = internal_node::lookup(static_cast<const internal_node_t *>(data),
+                                        key);
+        rassert(node_id != NULL_BLOCK_ID && node_id != SUPERBLOCK_ID);
+    }
+}
+
 void apply_keyvalue_change(
         value_sizer_t *sizer,
         keyvalue_location_t *kv_loc,
@@ -970,6 +1264,9 @@ void apply_keyvalue_change(
     /* how much this keyvalue change affects the total population of the btree
      * (should be -1, 0 or 1) */
     int population_change;
+    /* how much this keyvalue change affects the total size of the values in the
+     * btree */
+    int64_t value_bytes_change = -kv_loc->original_value_bytes;
 
     if (kv_loc->value.has()) {
         // We have a value to insert.
@@ -995,6 +1292,7 @@ void apply_keyvalue_change(
         } else {
             population_change = 1;
         }
+        value_bytes_change += sizer->value_bytes(kv_loc->value.get());
 
         {
             buf_write_t write(&kv_loc->buf);
@@ -1038,11 +1336,8 @@ void apply_keyvalue_change(
     // btree, we don't keep a consistent view of it, so we pass the txn as its
     // parent.
     if (kv_loc->stat_block != NULL_BLOCK_ID) {
-        buf_lock_t stat_block(buf_parent_t(kv_loc->buf.txn()),
-                              kv_loc->stat_block, access_t::write);
-        buf_write_t stat_block_write(&stat_block);
-        auto stat_block_buf = static_cast<btree_statblock_t *>(
-                stat_block_write.get_data_write(BTREE_STATBLOCK_SIZE));
-        stat_block_buf->population += population_change;
+        update_stat_block(kv_loc->buf.txn(), kv_loc->stat_block,
+                          population_change, value_bytes_change, key,
+                          &kv_loc->buf);
     }
 }
@@ -6,6 +6,7 @@
 #include <utility>
 #include <vector>
 
+#include "btree/key_sample.hpp"
 #include "btree/leaf_node.hpp"
 #include "btree/node.hpp"
 #include "buffer_cache/alt.hpp"
@@ -23,6 +24,7 @@ class trace_t;
 class btree_slice_t;
 class binary_blob_t;
 class value_deleter_t;
+class signal_t;
 
 template <class> class promise_t;
 
@@ -83,8 +85,8 @@ class keyvalue_location_t {
 public:
     keyvalue_location_t()
         : superblock(NULL), pass_back_superblock(NULL),
-          there_originally_was_value(false), stat_block(NULL_BLOCK_ID),
-          stats(NULL) { }
+          there_originally_was_value(false), original_value_bytes(0),
+          stat_block(NULL_BLOCK_ID), stats(NULL) { }
 
     ~keyvalue_location_t() {
         if (pass_back_superblock != NULL && superblock != NULL) {
@@ -110,6 +112,10 @@ public:
     template <class T>
     T *value_as() { return static_cast<T *>(value.get()); }
 
+    // The `value_sizer_t::value_bytes` of the value that was originally found,
+    // so that the stat block can be updated once the value has been replaced.
+    int64_t original_value_bytes;
+
     // Stat block when modifications are made using this class the statblock is
     // update.
     block_id_t stat_block;
@@ -234,12 +240,50 @@ void delete_superblock_metainfo(buf_lock_t *superblock,
                                 const std::vector<char> &key);
 void clear_superblock_metainfo(buf_lock_t *superblock);
 
+/* Pins the superblock and every internal node of its btree in memory (see
+`buf_lock_t::pin_in_memory`).  Leaves aren't pinned, so that a point read costs at
+most one disk read.  The tree is walked breadth-first with read locks, and
+`superblock` is only held until the root has been acquired.  Nodes that are created
+by later splits of pinned nodes are pinned as well.  Stops and returns false if
+`interruptor` is pulsed or the cache has no room left for pinned pages. */
+bool pin_upper_levels(buf_lock_t *superblock, signal_t *interruptor);
+
 /* Set sb to have root id as its root block and release sb */
 void insert_root(block_id_t root_id, superblock_t *sb);
 
 /* Create a stat block for the superblock. */
 void create_stat_block(superblock_t *sb);
 
+/* Reads the stat block.  Stat blocks written by older versions are missing some
+fields; these are filled in with their "unknown" values, and their key sample is
+empty. */
+btree_statblock_t read_stat_block(buf_lock_t *stat_block);
+btree_statblock_t read_stat_block(buf_lock_t *stat_block,
+                                  key_sample_t *key_sample_out);
+
+/* The most bytes the stat block's key sample can take up. */
+size_t key_sample_max_bytes(cache_t *cache);
+
+/* Adds the given changes to the stat block.  The stat block is detached from the
+rest of the btree, so it's acquired with `txn` as its parent.  If `key` isn't
+NULL, it's the key whose insertion or deletion caused the population change, and
+the key sample is updated accordingly.  A deleted key is replaced in the sample by
+a random key from `leaf_or_null`, the leaf it was deleted from. */
+void update_stat_block(txn_t *txn, block_id_t stat_block,
+                       int64_t population_change, int64_t value_bytes_change,
+                       const btree_key_t *key, buf_lock_t *leaf_or_null);
+
+/* Drops the sampled keys in the given range from the stat block, after the range
+has been erased. */
+void erase_stat_block_key_sample_range(txn_t *txn, block_id_t stat_block,
+                                       const btree_key_t *left_exclusive_or_null,
+                                       const btree_key_t *right_inclusive_or_null);
+
+/* Replaces the stat block's key sample with `keys`, which should be a uniform
+sample of the btree's keys. */
+void replace_stat_block_key_sample(txn_t *txn, block_id_t stat_block,
+                                   const std::vector<store_key_t> &keys);
+
 void get_btree_superblock(txn_t *txn, access_t access,
                           scoped_ptr_t<real_superblock_t> *got_superblock_out);
 
@@ -270,11 +314,31 @@ void find_keyvalue_location_for_write(
         profile::trace_t *trace,
         promise_t<superblock_t *> *pass_back_superblock = NULL) THROWS_NOTHING;
 
+/* Like `find_keyvalue_location_for_write`, passing in a pass_back_superblock
+parameter makes this function hand the superblock on once it has acquired the root,
+instead of releasing it. */
 void find_keyvalue_location_for_read(
         value_sizer_t *sizer,
         superblock_t *superblock, const btree_key_t *key,
         keyvalue_location_t *keyvalue_location_out,
-        btree_stats_t *stats, profile::trace_t *trace);
+        btree_stats_t *stats, profile::trace_t *trace,
+        promise_t<superblock_t *> *pass_back_superblock = NULL);
+
+/* Looks up `key` in the btree whose superblock is `superblock_id` without acquiring
+any blocks, by reading the current values of the superblock and the nodes on the
+way to the leaf, as long as they are in memory and no writer is in line for them
+(see `cache_t::peek_block_for_read`).  Since this never blocks, no writer can change
+the nodes while we look at them.  Returns false if some block on the way wasn't
+available like that, in which case the caller has to take the regular path
+(`find_keyvalue_location_for_read`).  Otherwise sets `*found_out` and, if the key
+was found, copies its value into `value_out`, which must have room for
+`sizer->max_possible_size()` bytes.  Unlike `find_keyvalue_location_for_read`, this
+doesn't record the read in the btree stats, since the caller might still fall back
+to the regular path. */
+bool find_value_optimistically(
+        cache_t *cache, block_id_t superblock_id,
+        value_sizer_t *sizer, const btree_key_t *key,
+        void *value_out, bool *found_out);
 
 void apply_keyvalue_change(
         value_sizer_t *sizer,
@@ -509,10 +509,12 @@ void process_a_leaf_node(traversal_state_t *state, buf_lock_t buf,
         const btree_key_t *right_inclusive_or_null) {
     rassert(coro_t::self());
     int population_change = 0;
+    int64_t value_bytes_change = 0;
 
     try {
         state->helper->process_a_leaf(&buf, left_exclusive_or_null,
-                right_inclusive_or_null, state->interruptor, &population_change);
+                right_inclusive_or_null, state->interruptor, &population_change,
+                &value_bytes_change);
     } catch (const interrupted_exc_t &) {
         rassert(state->interruptor->is_pulsed());
         /* ignore it; the backfill will come to a stop on its own now that
@@ -524,15 +526,13 @@ void process_a_leaf_node(traversal_state_t *state, buf_lock_t buf,
 
     if (state->helper->btree_node_mode() != access_t::write) {
         rassert(population_change == 0, "A read only operation claims it change the population of a leaf.\n");
-    } else if (population_change != 0 && state->stat_block != NULL_BLOCK_ID) {
+        rassert(value_bytes_change == 0, "A read only operation claims it changed the size of a leaf.\n");
+    } else if ((population_change != 0 || value_bytes_change != 0)
+               && state->stat_block != NULL_BLOCK_ID) {
         // The stat block has no parent, our changes to it are commutative and
         // readers expect out-of-date values.
-        buf_lock_t stat_block(buf_parent_t(txn), state->stat_block, access_t::write);
-        buf.reset_buf_lock();
-        buf_write_t stat_block_write(&stat_block);
-        auto stat_block_buf = static_cast<btree_statblock_t *>(
-                stat_block_write.get_data_write(BTREE_STATBLOCK_SIZE));
-        stat_block_buf->population += population_change;
+        update_stat_block(txn, state->stat_block,
+                          population_change, value_bytes_change, NULL, NULL);
     } else {
         // Don't acquire the block to not change the value.
     }
@@ -126,7 +126,8 @@ struct btree_traversal_helper_t {
                                 const btree_key_t *left_exclusive_or_null,
                                 const btree_key_t *right_inclusive_or_null,
                                 signal_t *interruptor,
-                                int *population_change_out) THROWS_ONLY(interrupted_exc_t) = 0;
+                                int *population_change_out,
+                                int64_t *value_bytes_change_out) THROWS_ONLY(interrupted_exc_t) = 0;
 
     virtual void postprocess_internal_node(buf_lock_t *internal_node_buf) = 0;
 
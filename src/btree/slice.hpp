@@ -80,15 +80,19 @@ public:
                                 const std::vector<char> &metainfo_key,
                                 const binary_blob_t &metainfo_value);
 
+    // If `pin_upper_levels` is true, whoever opens or creates the btree's superblock
+    // is expected to pin it with `pin_upper_levels()` (see btree/operations.hpp).
     btree_slice_t(cache_t *cache,
                   perfmon_collection_t *parent,
                   const std::string &identifier,
-                  index_type_t index_type);
+                  index_type_t index_type,
+                  bool pin_upper_levels);
 
     ~btree_slice_t();
 
     cache_t *cache() { return cache_; }
     cache_account_t *get_backfill_account() { return &backfill_account_; }
+    bool pins_upper_levels() const { return pin_upper_levels_; }
 
     btree_stats_t stats;
 
@@ -98,6 +102,8 @@ private:
     // Cache account to be used when backfilling.
     cache_account_t backfill_account_;
 
+    const bool pin_upper_levels_;
+
     DISABLE_COPYING(btree_slice_t);
 };
 
@@ -87,7 +87,9 @@ cache_t::cache_t(serializer_t *serializer,
                  perfmon_collection_t *perfmon_collection)
     : stats_(make_scoped<alt_cache_stats_t>(perfmon_collection)),
       throttler_(MINIMUM_SOFT_UNWRITTEN_CHANGES_LIMIT),
-      page_cache_(serializer, balancer, &throttler_) { }
+      page_cache_(serializer, balancer, &throttler_) {
+    page_cache_.evicter().set_pinned_bytes_perfmon(&stats_->pm_pinned_bytes);
+}
 
 cache_t::~cache_t() {
     guarantee(snapshot_nodes_by_block_id_.empty());
@@ -719,6 +721,18 @@ void buf_lock_t::manually_touch_recency(repli_timestamp_t recency) {
     current_page_acq_->manually_touch_recency(recency);
 }
 
+bool buf_lock_t::pin_in_memory() {
+    guarantee(!empty());
+    rassert(snapshot_node_ == NULL);
+    page_t *page = get_held_page_for_read();
+    return cache()->page_cache_.evicter().pin_page(page);
+}
+
+bool buf_lock_t::is_pinned_in_memory() {
+    guarantee(!empty());
+    return get_held_page_for_read()->is_pinned();
+}
+
 page_t *buf_lock_t::get_held_page_for_read() {
     guarantee(!empty());
     current_page_acq_t *cpa = current_page_acq();
@@ -54,6 +54,12 @@ public:
     // might consider supporting a mem_cap paremeter.
     cache_account_t create_cache_account(int priority);
 
+    // See `page_cache_t::peek_current_page_for_read`.  Returns NULL if the block
+    // can't be read without acquiring it.
+    const void *peek_block_for_read(block_id_t block_id) {
+        return page_cache_.peek_current_page_for_read(block_id);
+    }
+
 private:
     friend class txn_t;
     friend class buf_read_t;
@@ -223,6 +229,16 @@ public:
 
     void mark_deleted();
 
+    // Pins the block's page in memory, so that the evicter never drops it.  Pages
+    // created by later writes to the block inherit the pin.  The lock must not be
+    // snapshotted, since pinning a snapshot's page would pin an old version.  Returns
+    // false if the cache has no room left for pinned pages (see
+    // `evicter_t::pin_page`).
+    bool pin_in_memory();
+    bool is_pinned_in_memory();
+
+    bool is_snapshotted() const { return snapshot_node_ != NULL; }
+
     txn_t *txn() const { return txn_; }
     cache_t *cache() const { return txn_->cache(); }
 
@@ -291,6 +307,14 @@ public:
         }
     }
 
+    bool is_pinned_in_memory() {
+        return lock_or_null_ != NULL && lock_or_null_->is_pinned_in_memory();
+    }
+
+    bool is_snapshotted() const {
+        return lock_or_null_ != NULL && lock_or_null_->is_snapshotted();
+    }
+
     bool empty() const {
         return txn_ == NULL;
     }
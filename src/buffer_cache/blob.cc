@@ -214,6 +214,15 @@ int64_t value_size(const char *ref, int maxreflen) {
     }
 }
 
+bool inline_value(const char *ref, int maxreflen,
+                  const char **data_out, int64_t *size_out) {
+    if (!blob::is_small(ref, maxreflen)) {
+        return false;
+    }
+    *data_out = ref + big_size_offset(maxreflen);
+    *size_out = blob::small_size(ref, maxreflen);
+    return true;
+}
 
 int btree_maxreflen = 251;
 block_magic_t internal_node_magic = { { 'l', 'a', 'r', 'i' } };
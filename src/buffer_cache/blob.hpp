@@ -126,6 +126,11 @@ extern int btree_maxreflen;
 // The size of a blob, equivalent to blob_t(ref, maxreflen).valuesize().
 int64_t value_size(const char *ref, int maxreflen);
 
+// Returns true if the value is small enough to be stored in the blob ref itself, in
+// which case `*data_out` and `*size_out` describe it.
+bool inline_value(const char *ref, int maxreflen,
+                  const char **data_out, int64_t *size_out);
+
 struct ref_info_t {
     // The ref_size of a ref.
     int refsize;
@@ -4,6 +4,8 @@
 #include "buffer_cache/page.hpp"
 #include "buffer_cache/page_cache.hpp"
 #include "buffer_cache/cache_balancer.hpp"
+#include "config/args.hpp"
+#include "perfmon/perfmon.hpp"
 
 namespace alt {
 
@@ -16,7 +18,9 @@ evicter_t::evicter_t()
       bytes_loaded_counter_(0),
       access_count_counter_(0),
       access_time_counter_(INITIAL_ACCESS_TIME),
-      evict_if_necessary_active_(false) { }
+      evict_if_necessary_active_(false),
+      pinned_bytes_perfmon_(nullptr),
+      pinned_bytes_reported_(0) { }
 
 evicter_t::~evicter_t() {
     assert_thread();
@@ -165,7 +169,8 @@ void evicter_t::move_unevictable_to_evictable(page_t *page) {
     unevictable_.remove(page, page->hypothetical_memory_usage(page_cache_));
     eviction_bag_t *new_bag = correct_eviction_category(page);
     rassert(new_bag == &evictable_disk_backed_
-            || new_bag == &evictable_unbacked_);
+            || new_bag == &evictable_unbacked_
+            || new_bag == &pinned_);
     new_bag->add(page, page->hypothetical_memory_usage(page_cache_));
     evict_if_necessary();
 }
@@ -188,6 +193,8 @@ eviction_bag_t *evicter_t::correct_eviction_category(page_t *page) {
         return &unevictable_;
     } else if (!page->is_loaded()) {
         return &evicted_;
+    } else if (page->is_pinned()) {
+        return &pinned_;
     } else if (page->is_disk_backed()) {
         return &evictable_disk_backed_;
     } else {
@@ -204,12 +211,57 @@ void evicter_t::remove_page(page_t *page) {
     notify_bytes_loading(-static_cast<int64_t>(page->hypothetical_memory_usage(page_cache_)));
 }
 
+bool evicter_t::pin_page(page_t *page) {
+    assert_thread();
+    guarantee(initialized_);
+    if (page->pinned_) {
+        return true;
+    }
+    if (pinned_.size() + page->hypothetical_memory_usage(page_cache_)
+        > pinned_memory_limit()) {
+        return false;
+    }
+    eviction_bag_t *old_bag = correct_eviction_category(page);
+    old_bag->remove(page, page->hypothetical_memory_usage(page_cache_));
+    page->pinned_ = true;
+    eviction_bag_t *new_bag = correct_eviction_category(page);
+    new_bag->add(page, page->hypothetical_memory_usage(page_cache_));
+    evict_if_necessary();
+    return true;
+}
+
+uint64_t evicter_t::pinned_memory_limit() const {
+    return static_cast<uint64_t>(memory_limit_ * MAX_PINNED_CACHE_FRACTION);
+}
+
+void evicter_t::set_pinned_bytes_perfmon(perfmon_counter_t *pinned_bytes) {
+    assert_thread();
+    pinned_bytes_perfmon_ = pinned_bytes;
+    pinned_bytes_reported_ = 0;
+    update_pinned_bytes_perfmon();
+}
+
+void evicter_t::update_pinned_bytes_perfmon() {
+    if (pinned_bytes_perfmon_ != nullptr) {
+        int64_t pinned_bytes = pinned_.size();
+        *pinned_bytes_perfmon_ += pinned_bytes - pinned_bytes_reported_;
+        pinned_bytes_reported_ = pinned_bytes;
+    }
+}
+
 uint64_t evicter_t::in_memory_size() const {
     assert_thread();
     guarantee(initialized_);
     return unevictable_.size()
         + evictable_disk_backed_.size()
-        + evictable_unbacked_.size();
+        + evictable_unbacked_.size()
+        + pinned_.size();
+}
+
+uint64_t evicter_t::pinned_size() const {
+    assert_thread();
+    guarantee(initialized_);
+    return pinned_.size();
 }
 
 void evicter_t::evict_if_necessary() THROWS_NOTHING {
@@ -229,6 +281,18 @@ void evicter_t::evict_if_necessary() THROWS_NOTHING {
 
     evict_if_necessary_active_ = true;
     page_t *page;
+    // If the memory limit has shrunk, the oldest pinned pages go back to being
+    // evicted like any others.
+    while (pinned_.size() > pinned_memory_limit()
+           && pinned_.remove_oldish(&page, access_time_counter_, page_cache_)) {
+        page->pinned_ = false;
+        correct_eviction_category(page)->add(
+            page, page->hypothetical_memory_usage(page_cache_));
+    }
+    // Every change to the eviction bags ends up here, so this is where the pinned
+    // page perfmon is kept in sync.
+    update_pinned_bytes_perfmon();
+
     while (in_memory_size() > memory_limit_
            && evictable_disk_backed_.remove_oldish(&page, access_time_counter_,
                                                    page_cache_)) {
@@ -13,6 +13,7 @@
 
 class cache_balancer_t;
 class alt_txn_throttler_t;
+class perfmon_counter_t;
 
 namespace alt {
 
@@ -35,6 +36,17 @@ public:
     void remove_page(page_t *page);
     void reloading_page(page_t *page);
 
+    // Keeps `page` (and every copy of it made by later writes) out of eviction for
+    // as long as it exists.  Pinned pages still count against the memory limit, and
+    // they may only take up `pinned_memory_limit()` of it.  Returns false, leaving
+    // the page to be evicted normally, if pinning it would exceed that.  When the
+    // memory limit shrinks, the oldest pinned pages are unpinned again.
+    bool pin_page(page_t *page);
+    uint64_t pinned_memory_limit() const;
+
+    // `pinned_bytes` is kept equal to `pinned_size()`.
+    void set_pinned_bytes_perfmon(perfmon_counter_t *pinned_bytes);
+
     // Evicter will be unusable until initialize is called
     evicter_t();
     ~evicter_t();
@@ -57,6 +69,7 @@ public:
     uint64_t get_clamped_bytes_loaded() const;
 
     uint64_t in_memory_size() const;
+    uint64_t pinned_size() const;
 
     // This is decremented past UINT64_MAX to force code to be aware of access time
     // rollovers.
@@ -71,6 +84,8 @@ private:
     // Evicts any evictable pages until under the memory limit
     void evict_if_necessary() THROWS_NOTHING;
 
+    void update_pinned_bytes_perfmon();
+
     bool initialized_;
     page_cache_t *page_cache_;
     cache_balancer_t *balancer_;
@@ -98,6 +113,10 @@ private:
     eviction_bag_t evictable_disk_backed_;
     eviction_bag_t evictable_unbacked_;
     eviction_bag_t evicted_;
+    eviction_bag_t pinned_;
+
+    perfmon_counter_t *pinned_bytes_perfmon_;
+    int64_t pinned_bytes_reported_;
 
     auto_drainer_t drainer_;
 
@@ -56,7 +56,8 @@ page_t::page_t(block_id_t block_id, page_cache_t *page_cache)
     : block_id_(block_id),
       loader_(NULL),
       access_time_(page_cache->evicter().next_access_time()),
-      snapshot_refcount_(0) {
+      snapshot_refcount_(0),
+      pinned_(false) {
     page_cache->evicter().add_deferred_loaded(this);
 
     coro_t::spawn_now_dangerously(std::bind(&page_t::deferred_load_with_block_id,
@@ -70,7 +71,8 @@ page_t::page_t(block_id_t block_id, page_cache_t *page_cache,
     : block_id_(block_id),
       loader_(NULL),
       access_time_(page_cache->evicter().next_access_time()),
-      snapshot_refcount_(0) {
+      snapshot_refcount_(0),
+      pinned_(false) {
     page_cache->evicter().add_not_yet_loaded(this);
 
     coro_t::spawn_now_dangerously(std::bind(&page_t::load_with_block_id,
@@ -86,7 +88,8 @@ page_t::page_t(block_id_t block_id, buf_ptr_t buf,
       loader_(NULL),
       buf_(std::move(buf)),
       access_time_(page_cache->evicter().next_access_time()),
-      snapshot_refcount_(0) {
+      snapshot_refcount_(0),
+      pinned_(false) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_unbacked(this);
 }
@@ -100,7 +103,8 @@ page_t::page_t(block_id_t block_id,
       buf_(std::move(buf)),
       block_token_(block_token),
       access_time_(READ_AHEAD_ACCESS_TIME),
-      snapshot_refcount_(0) {
+      snapshot_refcount_(0),
+      pinned_(false) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_disk_backed(this);
 }
@@ -109,7 +113,8 @@ page_t::page_t(page_t *copyee, page_cache_t *page_cache, cache_account_t *accoun
     : block_id_(copyee->block_id_),
       loader_(NULL),
       access_time_(page_cache->evicter().next_access_time()),
-      snapshot_refcount_(0) {
+      snapshot_refcount_(0),
+      pinned_(copyee->pinned_) {
     page_cache->evicter().add_not_yet_loaded(this);
     coro_t::spawn_now_dangerously(std::bind(&page_t::load_from_copyee,
                                             this,
@@ -65,6 +65,8 @@ public:
     bool has_waiters() const { return !waiters_.empty(); }
     bool is_loaded() const { return buf_.has(); }
     bool is_disk_backed() const { return block_token_.has(); }
+    // Pinned pages are never evicted (see `evicter_t::pin_page`).
+    bool is_pinned() const { return pinned_; }
 
     void evict_self(page_cache_t *page_cache);
 
@@ -83,6 +85,7 @@ public:
 private:
     friend class page_ptr_t;
     friend class deferred_page_loader_t;
+    friend class evicter_t;
     static bool loader_is_loading(page_loader_t *loader);
     void add_snapshotter();
     void remove_snapshotter(page_cache_t *page_cache);
@@ -136,6 +139,10 @@ private:
     // other than themselves.
     size_t snapshot_refcount_;
 
+    // Set by `evicter_t::pin_page`, and inherited by copies of the page, so that a
+    // pinned block stays pinned when it's modified.
+    bool pinned_;
+
     // A list of waiters that expect the value to be loaded, and (as long as there
     // are waiters) expect the value to never be evicted.
     half_intrusive_list_t<page_acq_t> waiters_;
@@ -146,10 +153,11 @@ private:
     // if loader_ is non-null:  unevictable_pages_
     // else if waiters_ is non-empty: unevictable_pages_
     // else if buf_ is null: evicted_pages_ (and block_token_ is non-null)
+    // else if pinned_: pinned_pages_
     // else if block_token_ is non-null: evictable_disk_backed_pages_
     // else: evictable_unbacked_pages_ (buf_ is non-null, block_token_ is null)
     //
-    // So, when loader_, waiters_, buf_, or block_token_ is touched, we might
+    // So, when loader_, waiters_, buf_, block_token_, or pinned_ is touched, we might
     // need to change this page's eviction bag.
     //
     // The logic above is implemented in page_cache_t::correct_eviction_category.
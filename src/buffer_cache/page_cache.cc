@@ -343,6 +343,33 @@ current_page_t *page_cache_t::page_for_block_id(block_id_t block_id) {
     return current_pages_[block_id];
 }
 
+const void *page_cache_t::peek_current_page_for_read(block_id_t block_id) {
+    assert_thread();
+
+    if (current_pages_.size() <= block_id) {
+        return NULL;
+    }
+    current_page_t *current_page = current_pages_[block_id];
+    if (current_page == NULL
+        || current_page->is_deleted_
+        || !current_page->page_.has()) {
+        return NULL;
+    }
+    for (current_page_acq_t *acq = current_page->acquirers_.head();
+         acq != NULL;
+         acq = current_page->acquirers_.next(acq)) {
+        if (acq->access() == access_t::write) {
+            return NULL;
+        }
+    }
+
+    page_t *page = current_page->page_.get_page_for_read();
+    if (!page->is_loaded()) {
+        return NULL;
+    }
+    return page->get_page_buf(this);
+}
+
 current_page_t *page_cache_t::page_for_new_block_id(block_id_t *block_id_out) {
     assert_thread();
     block_id_t block_id = free_list_.acquire_block_id();
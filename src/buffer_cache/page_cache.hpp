@@ -324,6 +324,12 @@ public:
     current_page_t *page_for_new_block_id(block_id_t *block_id_out);
     current_page_t *page_for_new_chosen_block_id(block_id_t block_id);
 
+    // Returns the current value of the block, if it can be read right away without
+    // getting in line for the block: the block is in memory and no write-acquirer is
+    // in line for it (so nobody could be modifying it).  Returns NULL otherwise.  The
+    // pointer is only valid until the caller blocks.
+    const void *peek_current_page_for_read(block_id_t block_id);
+
     // Returns how much memory is being used by all the pages in the cache at this
     // moment in time.
     size_t total_page_memory() const;
@@ -6,5 +6,7 @@
 alt_cache_stats_t::alt_cache_stats_t(perfmon_collection_t *parent)
     : cache_collection(),
       cache_membership(parent, &cache_collection, "cache"),
-      cache_collection_membership(&cache_collection) { }
+      pm_pinned_bytes(),
+      cache_collection_membership(&cache_collection,
+                                  &pm_pinned_bytes, "pinned_bytes") { }
 
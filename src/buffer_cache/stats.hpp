@@ -11,9 +11,8 @@ public:
     perfmon_collection_t cache_collection;
     perfmon_membership_t cache_membership;
 
-    /*
-      LSI: insert perfmons here
-    */
+    // The size of the pages that are pinned in memory (see `evicter_t::pin_page`).
+    perfmon_counter_t pm_pinned_bytes;
 
     perfmon_multi_membership_t cache_collection_membership;
 };
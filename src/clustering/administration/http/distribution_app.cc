@@ -56,6 +56,20 @@ void distribution_app_t::handle(const http_req_t &req, http_res_t *result, signa
         }
     }
 
+    // The admin UI expects just the key counts, so the size of the values is only
+    // reported if it's asked for.
+    bool with_value_bytes = false;
+    boost::optional<std::string> maybe_value_bytes = req.find_query_param("value_bytes");
+
+    if (maybe_value_bytes) {
+        if (maybe_value_bytes.get() == "true") {
+            with_value_bytes = true;
+        } else if (maybe_value_bytes.get() != "false") {
+            *result = http_error_res("Invalid value_bytes value.");
+            return;
+        }
+    }
+
     auto it = rdb_ns_snapshot->namespaces.find(n_id);
     if (it != rdb_ns_snapshot->namespaces.end() &&
             !it->second.is_deleted()) {
@@ -69,8 +83,18 @@ void distribution_app_t::handle(const http_req_t &req, http_res_t *result, signa
             read_response_t db_res;
             ns_if_access.get()->read_outdated(read, &db_res, interruptor);
 
-            scoped_cJSON_t data(render_as_json(
-                &boost::get<distribution_read_response_t>(db_res.response).key_counts));
+            distribution_read_response_t *dist_res =
+                &boost::get<distribution_read_response_t>(db_res.response);
+            scoped_cJSON_t data(render_as_json(&dist_res->key_counts));
+            if (with_value_bytes) {
+                scoped_cJSON_t wrapper(cJSON_CreateObject());
+                wrapper.AddItemToObject("key_counts", data.release());
+                wrapper.AddItemToObject("value_bytes",
+                                        dist_res->value_bytes < 0
+                                        ? cJSON_CreateNull()
+                                        : cJSON_CreateNumber(dist_res->value_bytes));
+                data.reset(wrapper.release());
+            }
             http_json_res(data.get(), result);
         } catch (const cannot_perform_query_exc_t &exc) {
             *result = http_res_t(HTTP_INTERNAL_SERVER_ERROR, "text/plain", exc.what());
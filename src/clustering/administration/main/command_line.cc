@@ -979,6 +979,10 @@ options::help_section_t get_file_options(std::vector<options::option_t> *options
     options_out->push_back(options::option_t(options::names_t("--cache-size"),
                                              options::OPTIONAL));
     help.add("--cache-size mb", "total cache size (in megabytes) for the process");
+    options_out->push_back(options::option_t(options::names_t("--pin-btree-upper-levels"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--pin-btree-upper-levels",
+             "keep the internal btree nodes of every table in the cache, using up to half of it");
     return help;
 }
 
@@ -1484,7 +1488,8 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
                                 get_reql_http_proxy_option(opts),
                                 std::move(web_path),
                                 address_ports,
-                                get_optional_option(opts, "--config-file"));
+                                get_optional_option(opts, "--config-file"),
+                                exists_option(opts, "--pin-btree-upper-levels"));
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
 
@@ -1605,7 +1610,8 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
                                 get_reql_http_proxy_option(opts),
                                 std::move(web_path),
                                 address_ports,
-                                get_optional_option(opts, "--config-file"));
+                                get_optional_option(opts, "--config-file"),
+                                false);
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_proxy, &serve_info, &result),
@@ -1762,7 +1768,8 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
                                 get_reql_http_proxy_option(opts),
                                 std::move(web_path),
                                 address_ports,
-                                get_optional_option(opts, "--config-file"));
+                                get_optional_option(opts, "--config-file"),
+                                exists_option(opts, "--pin-btree-upper-levels"));
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
 
@@ -23,11 +23,13 @@ struct store_args_t {
                  perfmon_collection_t *_serializers_perfmon_collection,
                  rdb_context_t *_ctx,
                  outdated_index_issue_client_t *_outdated_index_client,
-                 namespace_id_t _ns_id)
+                 namespace_id_t _ns_id,
+                 bool _pin_btree_upper_levels)
         : io_backender(_io_backender), base_path(_base_path),
           namespace_id(_namespace_id), balancer(_balancer),
           serializers_perfmon_collection(_serializers_perfmon_collection),
-          ctx(_ctx), outdated_index_client(_outdated_index_client), ns_id(_ns_id)
+          ctx(_ctx), outdated_index_client(_outdated_index_client), ns_id(_ns_id),
+          pin_btree_upper_levels(_pin_btree_upper_levels)
     { }
 
     io_backender_t *io_backender;
@@ -38,6 +40,7 @@ struct store_args_t {
     rdb_context_t *ctx;
     outdated_index_issue_client_t *outdated_index_client;
     namespace_id_t ns_id;
+    bool pin_btree_upper_levels;
 };
 
 std::string hash_shard_perfmon_name(int hash_shard_number) {
@@ -68,7 +71,7 @@ void do_construct_existing_store(
         hash_shard_perfmon_name(thread_offset),
         false, store_args.serializers_perfmon_collection,
         store_args.ctx, store_args.io_backender, store_args.base_path,
-        index_report);
+        index_report, store_args.pin_btree_upper_levels);
     (*stores_out_stores)[thread_offset].init(store);
     store_views[thread_offset] = store;
 }
@@ -94,7 +97,7 @@ void do_create_new_store(
         hash_shard_perfmon_name(thread_offset),
         true, store_args.serializers_perfmon_collection,
         store_args.ctx, store_args.io_backender, store_args.base_path,
-        index_report);
+        index_report, store_args.pin_btree_upper_levels);
     (*stores_out_stores)[thread_offset].init(store);
     store_views[thread_offset] = store;
 }
@@ -141,7 +144,8 @@ file_based_svs_by_namespace_t::get_svs(
         store_args_t store_args(io_backender_, base_path_,
                                 namespace_id, balancer_,
                                 serializers_perfmon_collection, ctx,
-                                outdated_index_client, namespace_id);
+                                outdated_index_client, namespace_id,
+                                pin_btree_upper_levels_);
         filepath_file_opener_t file_opener(serializer_filepath, io_backender_);
         if (res == 0) {
             // TODO: Could we handle failure when loading the serializer?  Right
@@ -15,10 +15,11 @@ public:
     file_based_svs_by_namespace_t(io_backender_t *io_backender,
                                   cache_balancer_t *balancer,
                                   const base_path_t& base_path,
-                                  outdated_index_issue_client_t *_outdated_index_client)
+                                  outdated_index_issue_client_t *_outdated_index_client,
+                                  bool pin_btree_upper_levels)
         : io_backender_(io_backender), balancer_(balancer),
-          base_path_(base_path), thread_counter_(0),
-          outdated_index_client(_outdated_index_client) { }
+          base_path_(base_path), pin_btree_upper_levels_(pin_btree_upper_levels),
+          thread_counter_(0), outdated_index_client(_outdated_index_client) { }
 
     void get_svs(perfmon_collection_t *serializers_perfmon_collection,
                  namespace_id_t namespace_id,
@@ -34,6 +35,9 @@ private:
     io_backender_t *io_backender_;
     cache_balancer_t *balancer_;
     const base_path_t base_path_;
+    // Whether the tables' stores pin the upper levels of their btrees in the cache
+    // (see `store_t::pin_upper_levels_in_background`).
+    const bool pin_btree_upper_levels_;
 
     threadnum_t next_thread(int num_db_threads);
     int thread_counter_; // should only be used by `next_thread`
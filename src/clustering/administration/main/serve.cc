@@ -240,7 +240,9 @@ bool do_serve(io_backender_t *io_backender,
                               NULL,
                               auth_manager_cluster.get_root_view(),
                               &get_global_perfmon_collection(),
-                              serve_info.reql_http_proxy);
+                              serve_info.reql_http_proxy,
+                              io_backender,
+                              base_path);
 
         real_reql_cluster_interface_t reql_cluster_interface(
                 &mailbox_manager,
@@ -272,7 +274,8 @@ bool do_serve(io_backender_t *io_backender,
             if (i_am_a_server) {
                 rdb_svs_source.init(new file_based_svs_by_namespace_t(
                     io_backender, cache_balancer.get(), base_path,
-                    &admin_tracker.outdated_index_client));
+                    &admin_tracker.outdated_index_client,
+                    serve_info.pin_btree_upper_levels));
                 rdb_reactor_driver.init(new reactor_driver_t(
                         base_path,
                         io_backender,
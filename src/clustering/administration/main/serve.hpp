@@ -92,12 +92,14 @@ public:
                  std::string &&_reql_http_proxy,
                  std::string &&_web_assets,
                  service_address_ports_t _ports,
-                 boost::optional<std::string> _config_file) :
+                 boost::optional<std::string> _config_file,
+                 bool _pin_btree_upper_levels) :
         joins(std::move(_joins)),
         reql_http_proxy(std::move(_reql_http_proxy)),
         web_assets(std::move(_web_assets)),
         ports(_ports),
-        config_file(_config_file)
+        config_file(_config_file),
+        pin_btree_upper_levels(_pin_btree_upper_levels)
     { }
 
     void look_up_peers() {
@@ -110,6 +112,7 @@ public:
     std::string web_assets;
     service_address_ports_t ports;
     boost::optional<std::string> config_file;
+    bool pin_btree_upper_levels;
 };
 
 /* This has been factored out from `command_line.hpp` because it takes a very
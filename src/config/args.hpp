@@ -118,6 +118,10 @@
 // then the page replacement algorithm will on average be unable to evict pages from the cache.
 #define PAGE_REPL_NUM_TRIES                       10
 
+// How much of a table's cache may be taken up by pinned pages (see
+// `evicter_t::pin_page`).  Pages that don't fit are evicted like any others.
+#define MAX_PINNED_CACHE_FRACTION                 0.5
+
 // How large can the key be, in bytes?  This value needs to fit in a byte.
 #define MAX_KEY_SIZE                              250
 
@@ -0,0 +1,96 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "containers/arena.hpp"
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "thread_local.hpp"
+#include "utils.hpp"
+
+// Every allocation starts with a header that says which arena it came from (or
+// NULL for the heap).  It's as big as the alignment we promise.
+const size_t arena_alignment = 16;
+const size_t arena_header_size = arena_alignment;
+static_assert(sizeof(arena_t *) <= arena_header_size, "arena header too small");
+
+// Most queries compile to a handful of terms, so the first chunk is small.  Each
+// chunk after it is twice as big as the one before, up to a limit, so big queries
+// still only need a few.
+const size_t arena_first_chunk_size = 1 * KILOBYTE;
+const size_t arena_max_chunk_size = 64 * KILOBYTE;
+
+arena_t::arena_t()
+    : num_objects_(0), next_(NULL), remaining_(0), next_chunk_size_(arena_first_chunk_size),
+      size_in_bytes_(0) { }
+
+arena_t::~arena_t() {
+    for (auto it = chunks_.begin(); it != chunks_.end(); ++it) {
+        ::free(*it);
+    }
+}
+
+void *arena_t::allocate(size_t size) {
+    size = (size + arena_alignment - 1) & ~(arena_alignment - 1);
+    if (size > remaining_) {
+        const size_t chunk_size = std::max(size, next_chunk_size_);
+        next_chunk_size_ = std::min(next_chunk_size_ * 2, arena_max_chunk_size);
+        // We throw away what's left of the current chunk.
+        next_ = static_cast<char *>(::rmalloc(chunk_size));
+        remaining_ = chunk_size;
+        size_in_bytes_ += chunk_size;
+        chunks_.push_back(next_);
+    }
+    void *result = next_;
+    next_ += size;
+    remaining_ -= size;
+    counted_add_ref(this);
+    return result;
+}
+
+bool arena_t::use_heap_for_object(size_t size) {
+    if (num_objects_ == NUM_HEAP_OBJECTS) {
+        return false;
+    }
+    ++num_objects_;
+    size_in_bytes_ += size;
+    return true;
+}
+
+TLS_with_init(arena_t *, current_arena, NULL);
+
+arena_scope_t::arena_scope_t(arena_t *arena)
+    : arena_(arena), outer_arena_(TLS_get_current_arena()) {
+    TLS_set_current_arena(arena_);
+}
+
+arena_scope_t::~arena_scope_t() {
+    // Scopes only nest if nothing blocked inside them (see `arena_scope_t`).
+    rassert(TLS_get_current_arena() == arena_);
+    TLS_set_current_arena(outer_arena_);
+}
+
+void *arena_operator_new(size_t size) {
+    arena_t *arena = TLS_get_current_arena();
+    if (arena != NULL && arena->use_heap_for_object(arena_header_size + size)) {
+        arena = NULL;
+    }
+    char *p = static_cast<char *>(arena != NULL
+                                  ? arena->allocate(arena_header_size + size)
+                                  : ::rmalloc(arena_header_size + size));
+    *reinterpret_cast<arena_t **>(p) = arena;
+    return p + arena_header_size;
+}
+
+void arena_operator_delete(void *p) {
+    if (p == NULL) {
+        return;
+    }
+    char *start = static_cast<char *>(p) - arena_header_size;
+    arena_t *arena = *reinterpret_cast<arena_t **>(start);
+    if (arena != NULL) {
+        counted_release(arena);
+    } else {
+        ::free(start);
+    }
+}
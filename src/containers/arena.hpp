@@ -0,0 +1,72 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_ARENA_HPP_
+#define CONTAINERS_ARENA_HPP_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "containers/counted.hpp"
+#include "errors.hpp"
+
+/* An `arena_t` hands out memory from a few big chunks, for objects that tend to be
+made together and to die together (like the compiled terms of a query).  Every
+object holds a reference to its arena, and the chunks are freed once the arena and
+all of its objects are gone, so the objects may outlive whoever made the arena (and
+be destroyed on any thread).  Only one thread may allocate from an arena, though.
+
+Classes opt in by defining their `operator new` and `operator delete` with
+`arena_operator_new` and `arena_operator_delete`.  Their objects come from the
+arena of the innermost `arena_scope_t` on the current thread, or from the heap if
+there is none.  The first `NUM_HEAP_OBJECTS` objects of each arena come from the
+heap too, since for a handful of objects `malloc` beats getting a chunk and taking a
+reference per object. */
+class arena_t : public slow_atomic_countable_t<arena_t> {
+public:
+    static const size_t NUM_HEAP_OBJECTS = 16;
+
+    arena_t();
+    ~arena_t();
+
+    // Returns `size` bytes, aligned like `malloc`'s, and adds a reference to the
+    // arena, which `arena_operator_delete` removes.
+    void *allocate(size_t size);
+
+    // Counts an object of `size` bytes, and returns whether it should come from the
+    // heap instead of from `allocate`.
+    bool use_heap_for_object(size_t size);
+
+    // The total size of the chunks and of the objects that came from the heap.
+    size_t size_in_bytes() const { return size_in_bytes_; }
+
+private:
+    size_t num_objects_;
+    std::vector<char *> chunks_;
+    char *next_;
+    size_t remaining_;
+    size_t next_chunk_size_;
+    size_t size_in_bytes_;
+
+    DISABLE_COPYING(arena_t);
+};
+
+/* Makes `arena` the current arena on this thread for as long as the scope exists.
+The current arena belongs to the thread, not to the coroutine, so the code inside
+the scope must not block: another coroutine that ran in the meantime would allocate
+from this arena, and its own scopes wouldn't nest with this one. */
+class arena_scope_t {
+public:
+    explicit arena_scope_t(arena_t *arena);
+    ~arena_scope_t();
+
+private:
+    arena_t *const arena_;
+    arena_t *const outer_arena_;
+
+    DISABLE_COPYING(arena_scope_t);
+};
+
+void *arena_operator_new(size_t size);
+void arena_operator_delete(void *p);
+
+#endif  // CONTAINERS_ARENA_HPP_
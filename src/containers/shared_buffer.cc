@@ -12,9 +12,20 @@ counted_t<shared_buf_t> shared_buf_t::create(size_t size) {
     shared_buf_t *result = static_cast<shared_buf_t *>(raw_result);
     result->refcount_ = 0;
     result->size_ = size;
+    result->annexes_ = NULL;
+    result->lookups_ = 0;
     return counted_t<shared_buf_t>(result);
 }
 
+shared_buf_t::~shared_buf_t() {
+    shared_buf_annex_t *annex = annexes_;
+    while (annex != NULL) {
+        shared_buf_annex_t *next = annex->next_;
+        delete annex;
+        annex = next;
+    }
+}
+
 void shared_buf_t::operator delete(void *p) {
     ::free(p);
 }
@@ -30,3 +41,36 @@ const char *shared_buf_t::data(size_t offset) const {
 size_t shared_buf_t::size() const {
     return size_;
 }
+
+shared_buf_annex_t *shared_buf_t::get_annex(size_t offset) const {
+    for (shared_buf_annex_t *annex = __atomic_load_n(&annexes_, __ATOMIC_ACQUIRE);
+         annex != NULL;
+         annex = annex->next_) {
+        if (annex->offset_ == offset) {
+            return annex;
+        }
+    }
+    return NULL;
+}
+
+shared_buf_annex_t *shared_buf_t::add_annex(size_t offset,
+                                            shared_buf_annex_t *annex) const {
+    annex->offset_ = offset;
+    for (;;) {
+        shared_buf_annex_t *head = __atomic_load_n(&annexes_, __ATOMIC_ACQUIRE);
+        for (shared_buf_annex_t *a = head; a != NULL; a = a->next_) {
+            if (a->offset_ == offset) {
+                delete annex;
+                return a;
+            }
+        }
+        annex->next_ = head;
+        if (__sync_bool_compare_and_swap(&annexes_, head, annex)) {
+            return annex;
+        }
+    }
+}
+
+intptr_t shared_buf_t::note_lookup() const {
+    return __sync_add_and_fetch(&lookups_, 1);
+}
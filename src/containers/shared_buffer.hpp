@@ -5,12 +5,31 @@
 #include "containers/counted.hpp"
 #include "errors.hpp"
 
+/* A `shared_buf_annex_t` is something derived from the contents of a
+`shared_buf_t` at some offset, like an index over an object that's serialized
+there.  It's cached alongside the buffer and destroyed with it.  The buffer
+can be shared by several threads, so annexes must be safe to use from any of
+them. */
+class shared_buf_annex_t {
+public:
+    shared_buf_annex_t() : offset_(0), next_(NULL) { }
+    virtual ~shared_buf_annex_t() { }
+
+private:
+    friend class shared_buf_t;
+    size_t offset_;
+    shared_buf_annex_t *next_;
+
+    DISABLE_COPYING(shared_buf_annex_t);
+};
+
 /* A `shared_buffer_t` is a reference counted binary buffer.
 You can have multiple `shared_buf_ref_t`s pointing to different offsets in
 the same `shared_buffer_t`. */
 class shared_buf_t {
 public:
     shared_buf_t() = delete;
+    ~shared_buf_t();
 
     static counted_t<shared_buf_t> create(size_t _size);
     static void operator delete(void *p);
@@ -20,6 +39,15 @@ public:
 
     size_t size() const;
 
+    // Returns the annex for `offset`, or `NULL` if there's none yet.
+    shared_buf_annex_t *get_annex(size_t offset) const;
+    // Attaches `annex` to `offset`, unless another thread got there first.
+    // Returns the annex that ends up attached, which owns itself from now on.
+    shared_buf_annex_t *add_annex(size_t offset, shared_buf_annex_t *annex) const;
+    // Counts a lookup into the buffer and returns how many there have been, so
+    // that callers can wait for repeated lookups before they build an annex.
+    intptr_t note_lookup() const;
+
 private:
     // We duplicate the implementation of slow_atomic_countable_t here for the
     // sole purpose of having full control over the layout of fields. This
@@ -35,6 +63,11 @@ private:
     // The size of data_, for boundary checking.
     size_t size_;
 
+    // A list of annexes that's only ever pushed to, so that it can be read
+    // without locking.
+    mutable shared_buf_annex_t *annexes_;
+    mutable intptr_t lookups_;
+
     // We actually allocate more memory than this.
     // It's crucial that this field is the last one in this class.
     char data_[1];
@@ -85,6 +118,17 @@ public:
         return (buf->size() - offset) / sizeof(T);
     }
 
+    // The annex for the data this points at; see `shared_buf_annex_t`.
+    shared_buf_annex_t *get_annex() const {
+        return buf->get_annex(offset);
+    }
+    shared_buf_annex_t *add_annex(shared_buf_annex_t *annex) const {
+        return buf->add_annex(offset, annex);
+    }
+    intptr_t note_lookup() const {
+        return buf->note_lookup();
+    }
+
 private:
     counted_t<const shared_buf_t> buf;
     size_t offset;
@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 
+#include <cmath>
 #include <set>
 #include <vector>
 
@@ -164,6 +165,67 @@ std::string cJSON_print_unformatted_std_string(cJSON *json) THROWS_NOTHING {
     return res;
 }
 
+void json_print_string(const char *str, size_t size, std::string *out) {
+    out->push_back('"');
+    const char *const end = str + size;
+    while (str < end) {
+        // Copy the longest run of characters that don't need escaping at once.
+        const char *run = str;
+        while (run < end && static_cast<unsigned char>(*run) > 31
+               && *run != '"' && *run != '\\') {
+            ++run;
+        }
+        out->append(str, run - str);
+        if (run == end) {
+            break;
+        }
+        switch (*run) {
+        case '\\': out->append("\\\\"); break;
+        case '"': out->append("\\\""); break;
+        case '\b': out->append("\\b"); break;
+        case '\f': out->append("\\f"); break;
+        case '\n': out->append("\\n"); break;
+        case '\r': out->append("\\r"); break;
+        case '\t': out->append("\\t"); break;
+        default: {
+            char buf[7];
+            snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned char>(*run));
+            out->append(buf);
+        } break;
+        }
+        str = run + 1;
+    }
+    out->push_back('"');
+}
+
+void json_print_number(double d, std::string *out) {
+    // Same format as cJSON's `print_number`.
+    guarantee(std::isfinite(d));
+    // Most numbers are integers, which `%.20g` prints as plain decimals (except for
+    // -0.0, which we leave to `snprintf`).  2^53 has fewer than 20 digits.
+    if (-9007199254740992.0 <= d && d <= 9007199254740992.0
+        && d == static_cast<double>(static_cast<int64_t>(d))
+        && !(d == 0 && std::signbit(d))) {
+        const int64_t i = static_cast<int64_t>(d);
+        uint64_t magnitude = i < 0 ? -static_cast<uint64_t>(i) : i;
+        char digits[24];
+        size_t pos = sizeof(digits);
+        do {
+            digits[--pos] = '0' + magnitude % 10;
+            magnitude /= 10;
+        } while (magnitude != 0);
+        if (i < 0) {
+            digits[--pos] = '-';
+        }
+        out->append(digits + pos, sizeof(digits) - pos);
+        return;
+    }
+    char buf[64];
+    int ret = snprintf(buf, sizeof(buf), "%.20g", d);
+    guarantee(ret > 0 && static_cast<size_t>(ret) < sizeof(buf));
+    out->append(buf, ret);
+}
+
 void project(cJSON *json, std::set<std::string> keys) {
     guarantee(json);
     guarantee(json->type == cJSON_Object);
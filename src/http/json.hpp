@@ -24,6 +24,11 @@ std::string cJSON_print_std_string(cJSON *json) THROWS_NOTHING;
 std::string cJSON_print_unformatted_std_string(cJSON *json) THROWS_NOTHING;
 const char *cJSON_type_to_string(int type);
 
+// These append JSON to `out` the way `cJSON_PrintUnformatted` would print a string
+// or number, without building a cJSON tree first.
+void json_print_string(const char *str, size_t size, std::string *out);
+void json_print_number(double d, std::string *out);
+
 class scoped_cJSON_t {
 private:
     cJSON *val;
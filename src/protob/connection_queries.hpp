@@ -0,0 +1,172 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef PROTOB_CONNECTION_QUERIES_HPP_
+#define PROTOB_CONNECTION_QUERIES_HPP_
+
+#include <functional>
+#include <map>
+
+#include "arch/io/network.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/interruptor.hpp"
+#include "concurrency/new_mutex.hpp"
+#include "concurrency/new_semaphore.hpp"
+#include "concurrency/wait_any.hpp"
+#include "containers/scoped.hpp"
+#include "protob/protob.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/ql2.pb.h"
+
+// The number of queries from one client connection that can be running at the same
+// time.  Once this many are running we stop reading from the connection until one
+// of them finishes.
+const int64_t MAX_CONCURRENT_QUERIES_PER_CONNECTION = 256;
+
+// Queries from one connection run concurrently, so whoever writes a response to the
+// connection must hold its send mutex, or the responses' bytes could interleave.
+template <class protocol_t>
+void send_response_exclusively(const Response &response,
+                               query_handler_t *handler,
+                               tcp_conn_t *conn,
+                               new_mutex_t *send_mutex,
+                               signal_t *interruptor) {
+    new_mutex_in_line_t send_in_line(send_mutex);
+    try {
+        wait_interruptible(send_in_line.acq_signal(), interruptor);
+    } catch (const interrupted_exc_t &) {
+        // That's what `tcp_conn_t::write` does when its closer is pulsed.
+        throw tcp_conn_write_closed_exc_t();
+    }
+    protocol_t::send_response(response, handler, conn, interruptor);
+}
+
+// Runs the queries of one client connection, each in its own coroutine, and writes
+// their responses as they finish.  Queries with the same token (a START and the
+// CONTINUEs and STOP that follow it) still run one after another, in the order they
+// were received, since they share a stream cache entry.  Noreply queries and
+// NOREPLY_WAITs run alone, after the queries before them and before the queries
+// after them, as if the connection ran one query at a time.
+class connection_queries_t {
+public:
+    connection_queries_t(tcp_conn_t *_conn,
+                         query_handler_t *_handler,
+                         client_context_t *_client_ctx)
+        : conn(_conn),
+          handler(_handler),
+          client_ctx(_client_ctx),
+          old_interruptor(client_ctx->interruptor),
+          interruptor(old_interruptor, &stop_queries),
+          in_flight(MAX_CONCURRENT_QUERIES_PER_CONNECTION) {
+        // The queries use `client_ctx->interruptor`, so that's how we stop them
+        // when the connection loop exits.
+        client_ctx->interruptor = &interruptor;
+    }
+
+    ~connection_queries_t() {
+        stop();
+    }
+
+    // Interrupts the running queries and waits for them to go away.
+    void stop() {
+        if (!stop_queries.is_pulsed()) {
+            stop_queries.pulse();
+            drainer.drain();
+            client_ctx->interruptor = old_interruptor;
+        }
+    }
+
+    new_mutex_t *get_send_mutex() { return &send_mutex; }
+
+    // Blocks until there's room for another query, then starts running `query`.
+    template <class protocol_t>
+    void start_query(const ql::protob_t<Query> &query) {
+        // A NOREPLY_WAIT must wait for every query before it to finish, and a
+        // noreply query must finish before the queries after it start, since the
+        // client can't tell when it's done (and expects to read its own writes).
+        // So they take all of the room.
+        const int64_t count = query->type() == Query::NOREPLY_WAIT || is_noreply(query)
+            ? MAX_CONCURRENT_QUERIES_PER_CONNECTION
+            : 1;
+        new_semaphore_acq_t slot(&in_flight, count);
+        try {
+            wait_interruptible(slot.acquisition_signal(), &interruptor);
+        } catch (const interrupted_exc_t &) {
+            // That's what `tcp_conn_t::read` does when its closer is pulsed.
+            throw tcp_conn_read_closed_exc_t();
+        }
+
+        // `spawn_now_dangerously` runs the coroutine up to its first block, so the
+        // queries get in line for their tokens in the order they were received.
+        coro_t::spawn_now_dangerously(
+            std::bind(&connection_queries_t::run_query<protocol_t>,
+                      this, query, &slot, drainer.lock()));
+    }
+
+private:
+    static bool is_noreply(const ql::protob_t<Query> &query) {
+        if (query->type() != Query::START) {
+            return false;
+        }
+        ql::datum_t noreply = ql::static_optarg("noreply", query);
+        return noreply.has()
+            && noreply.get_type() == ql::datum_t::type_t::R_BOOL
+            && noreply.as_bool();
+    }
+
+    struct token_queue_t {
+        token_queue_t() : num_queries(0) { }
+        new_mutex_t mutex;
+        size_t num_queries;
+    };
+
+    template <class protocol_t>
+    void run_query(const ql::protob_t<Query> &query,
+                   new_semaphore_acq_t *slot_to_take,
+                   UNUSED auto_drainer_t::lock_t keepalive) {
+        new_semaphore_acq_t slot(std::move(*slot_to_take));
+        const int64_t token = query->token();
+        scoped_ptr_t<token_queue_t> &queue = token_queues[token];
+        if (!queue.has()) {
+            queue.init(new token_queue_t());
+        }
+        token_queue_t *const token_queue = queue.get();
+        ++token_queue->num_queries;
+
+        try {
+            new_mutex_in_line_t token_in_line(&token_queue->mutex);
+            wait_interruptible(token_in_line.acq_signal(), &interruptor);
+
+            Response response;
+            if (handler->run_query(query, &response, client_ctx)) {
+                send_response_exclusively<protocol_t>(response, handler, conn,
+                                                      &send_mutex, &interruptor);
+            }
+        } catch (const interrupted_exc_t &) {
+            // The connection is going away.
+        } catch (const tcp_conn_write_closed_exc_t &) {
+            // The connection is going away.
+        }
+
+        if (--token_queue->num_queries == 0) {
+            token_queues.erase(token);
+        }
+    }
+
+    tcp_conn_t *const conn;
+    query_handler_t *const handler;
+    client_context_t *const client_ctx;
+
+    signal_t *const old_interruptor;
+    cond_t stop_queries;
+    wait_any_t interruptor;
+
+    new_semaphore_t in_flight;
+    new_mutex_t send_mutex;
+    std::map<int64_t, scoped_ptr_t<token_queue_t> > token_queues;
+
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(connection_queries_t);
+};
+
+#endif  // PROTOB_CONNECTION_QUERIES_HPP_
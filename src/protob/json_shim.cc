@@ -1,6 +1,8 @@
 #include "protob/json_shim.hpp"
 
 #include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "debug.hpp"
 #include "http/json.hpp"
@@ -174,15 +176,295 @@ void extract(cJSON *json, Query *q) {
     transfer_arr(cJSON_slow_GetArrayItem(json, 2), q, &Query::add_global_optargs);
 }
 
-bool parse_json_pb(Query *q, int64_t token, const char *str) THROWS_NOTHING {
+// `reader_t` parses a query straight into the protobuf, without building a cJSON
+// tree first.  It accepts exactly what `cJSON_Parse` accepts (including its quirks,
+// like ignoring trailing garbage), and fills in the protobuf the same way the
+// `extract` functions above would, so that `parse_json_pb` and
+// `parse_json_pb_via_cjson` always agree.
+class reader_t {
+public:
+    explicit reader_t(const char *str) : p(str) { }
+
+    void read(Query *q) {
+        q->set_accepts_r_json(true);
+        // Like `cJSON_slow_GetArrayItem`, this treats other values as having no
+        // children.
+        skip_whitespace();
+        if (*p != '[' && *p != '{') {
+            skip_value();
+            return;
+        }
+        read_children([&](size_t i, const std::string *) {
+            if (i == 0) {
+                read_enum(q, &Query::set_type);
+            } else if (i == 1) {
+                read(q->mutable_query());
+            } else if (i == 2) {
+                read_pairs(q, &Query::add_global_optargs);
+            } else {
+                skip_value();
+            }
+        });
+    }
+
+private:
+    void read(Term *t) {
+        skip_whitespace();
+        if (*p == '[') {
+            read_children([&](size_t i, const std::string *) {
+                if (i == 0) {
+                    read_enum(t, &Term::set_type);
+                } else if (i == 1) {
+                    read_children([&](size_t, const std::string *) {
+                        read(t->add_args());
+                    });
+                } else if (i == 2) {
+                    read_pairs(t, &Term::add_optargs);
+                } else {
+                    skip_value();
+                }
+            });
+        } else if (*p == '{') {
+            t->set_type(Term::MAKE_OBJ);
+            read_pairs(t, &Term::add_optargs);
+        } else {
+            t->set_type(Term::DATUM);
+            read(t->mutable_datum());
+        }
+    }
+
+    void read(Datum *d) {
+        skip_whitespace();
+        if (starts_with("null")) {
+            p += 4;
+            d->set_type(Datum::R_NULL);
+        } else if (starts_with("false")) {
+            p += 5;
+            d->set_type(Datum::R_BOOL);
+            d->set_r_bool(false);
+        } else if (starts_with("true")) {
+            p += 4;
+            d->set_type(Datum::R_BOOL);
+            d->set_r_bool(true);
+        } else if (*p == '"') {
+            d->set_type(Datum::R_STR);
+            read_string(d->mutable_r_str());
+        } else if (*p == '-' || (*p >= '0' && *p <= '9')) {
+            d->set_type(Datum::R_NUM);
+            d->set_r_num(read_number());
+        } else if (*p == '[') {
+            d->set_type(Datum::R_ARRAY);
+            read_children([&](size_t, const std::string *) {
+                read(d->add_r_array());
+            });
+        } else if (*p == '{') {
+            d->set_type(Datum::R_OBJECT);
+            read_pairs(d, &Datum::add_r_object);
+        } else {
+            throw exc_t();
+        }
+    }
+
+    // Like `transfer_arr` on pairs: the children of an array don't have keys, so
+    // only an empty array is acceptable.
+    template<class T, class U>
+    void read_pairs(T *dest, U *(T::*adder)()) {
+        read_children([&](size_t, const std::string *key) {
+            if (key == NULL) throw exc_t();
+            U *pair = (dest->*adder)();
+            pair->set_key(*key);
+            read(pair->mutable_val());
+        });
+    }
+
+    template<class T, class U>
+    void read_enum(T *dest, void (T::*setter)(U)) {
+        skip_whitespace();
+        if (!(*p == '-' || (*p >= '0' && *p <= '9'))) throw exc_t();
+        double d = read_number();
+        U u = static_cast<U>(d);
+        if (static_cast<double>(u) != d) throw exc_t();
+        (dest->*setter)(u);
+    }
+
+    // Calls `f(index, key_or_null)` with `p` at each child of an array or object.
+    // Like `transfer_arr`, it's an error if the value is neither.
+    template<class callable_t>
+    void read_children(callable_t &&f) {
+        skip_whitespace();
+        if (*p != '[' && *p != '{') throw exc_t();
+        const char close = *p == '[' ? ']' : '}';
+        ++p;
+        skip_whitespace();
+        if (*p == close) {
+            ++p;
+            return;
+        }
+        std::string key;
+        for (size_t i = 0; ; ++i) {
+            if (close == '}') {
+                skip_whitespace();
+                read_string(&key);
+                skip_whitespace();
+                if (*p != ':') throw exc_t();
+                ++p;
+            }
+            f(i, close == '}' ? &key : NULL);
+            skip_whitespace();
+            if (*p == ',') {
+                ++p;
+            } else if (*p == close) {
+                ++p;
+                return;
+            } else {
+                throw exc_t();
+            }
+        }
+    }
+
+    void skip_value() {
+        skip_whitespace();
+        if (starts_with("null") || starts_with("true")) {
+            p += 4;
+        } else if (starts_with("false")) {
+            p += 5;
+        } else if (*p == '"') {
+            std::string ignored;
+            read_string(&ignored);
+        } else if (*p == '-' || (*p >= '0' && *p <= '9')) {
+            read_number();
+        } else if (*p == '[' || *p == '{') {
+            read_children([&](size_t, const std::string *) { skip_value(); });
+        } else {
+            throw exc_t();
+        }
+    }
+
+    // Same as cJSON's `parse_number`.
+    double read_number() {
+        if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+            ++p;
+            return 0;
+        }
+        char *end;
+        double d = strtod(p, &end);
+        if (end == p) throw exc_t();
+        p = end;
+        return d;
+    }
+
+    // Same as cJSON's `parse_string`.
+    void read_string(std::string *out) {
+        if (*p != '"') throw exc_t();
+        ++p;
+        out->clear();
+        while (*p != '"' && *p != '\0') {
+            // Copy the longest run of unescaped characters at once.
+            const char *run = p;
+            while (*run != '"' && *run != '\\' && *run != '\0') {
+                ++run;
+            }
+            out->append(p, run - p);
+            p = run;
+            if (*p != '\\') {
+                break;
+            }
+            ++p;
+            switch (*p) {
+            case 'b': out->push_back('\b'); break;
+            case 'f': out->push_back('\f'); break;
+            case 'n': out->push_back('\n'); break;
+            case 'r': out->push_back('\r'); break;
+            case 't': out->push_back('\t'); break;
+            case 'u': {
+                unsigned uc = read_hex4(p + 1);
+                p += 4;
+                if ((uc >= 0xDC00 && uc <= 0xDFFF) || uc == 0) {
+                    throw exc_t();
+                }
+                if (uc >= 0xD800 && uc <= 0xDBFF) {
+                    // A UTF-16 surrogate pair.  cJSON drops the character if the
+                    // second half is missing or invalid.
+                    if (p[1] != '\\' || p[2] != 'u') {
+                        break;
+                    }
+                    unsigned uc2 = read_hex4(p + 3);
+                    p += 6;
+                    if (uc2 < 0xDC00 || uc2 > 0xDFFF) {
+                        break;
+                    }
+                    uc = 0x10000 + (((uc & 0x3FF) << 10) | (uc2 & 0x3FF));
+                }
+                append_utf8(uc, out);
+            } break;
+            case '\0':
+                // cJSON reads past the terminator here; we stop instead.
+                throw exc_t();
+            default: out->push_back(*p); break;
+            }
+            ++p;
+        }
+        if (*p == '"') {
+            ++p;
+        }
+    }
+
+    static unsigned read_hex4(const char *str) {
+        unsigned h = 0;
+        for (int i = 0; i < 4; ++i) {
+            h <<= 4;
+            if (str[i] >= '0' && str[i] <= '9') {
+                h += str[i] - '0';
+            } else if (str[i] >= 'A' && str[i] <= 'F') {
+                h += 10 + str[i] - 'A';
+            } else if (str[i] >= 'a' && str[i] <= 'f') {
+                h += 10 + str[i] - 'a';
+            } else {
+                return 0;
+            }
+        }
+        return h;
+    }
+
+    static void append_utf8(unsigned uc, std::string *out) {
+        if (uc < 0x80) {
+            out->push_back(uc);
+        } else if (uc < 0x800) {
+            out->push_back(0xC0 | (uc >> 6));
+            out->push_back(0x80 | (uc & 0x3F));
+        } else if (uc < 0x10000) {
+            out->push_back(0xE0 | (uc >> 12));
+            out->push_back(0x80 | ((uc >> 6) & 0x3F));
+            out->push_back(0x80 | (uc & 0x3F));
+        } else {
+            out->push_back(0xF0 | (uc >> 18));
+            out->push_back(0x80 | ((uc >> 12) & 0x3F));
+            out->push_back(0x80 | ((uc >> 6) & 0x3F));
+            out->push_back(0x80 | (uc & 0x3F));
+        }
+    }
+
+    bool starts_with(const char *literal) const {
+        return strncmp(p, literal, strlen(literal)) == 0;
+    }
+
+    void skip_whitespace() {
+        while (*p != '\0' && static_cast<unsigned char>(*p) <= 32) {
+            ++p;
+        }
+    }
+
+    const char *p;
+
+    DISABLE_COPYING(reader_t);
+};
+
+template<class callable_t>
+bool parse_query(Query *q, int64_t token, callable_t &&parse) THROWS_NOTHING {
     try {
         q->Clear();
         q->set_token(token);
-        scoped_cJSON_t json_holder(cJSON_Parse(str));
-        cJSON *json = json_holder.get();
-        if (json == NULL) return false;
-        extract(json, q);
-        return true;
+        return parse();
     } catch (const exc_t &) {
         // This happens if the user provides bad JSON.  TODO: Give the user a
         // more specific error than "malformed query".
@@ -202,61 +484,119 @@ bool parse_json_pb(Query *q, int64_t token, const char *str) THROWS_NOTHING {
     }
 }
 
-void write_json_pb(const Response &r, std::string *s) THROWS_NOTHING {
+bool parse_json_pb(Query *q, int64_t token, const char *str) THROWS_NOTHING {
+    return parse_query(q, token, [&]() {
+        reader_t reader(str);
+        reader.read(q);
+        return true;
+    });
+}
+
+bool parse_json_pb_via_cjson(Query *q, int64_t token, const char *str) THROWS_NOTHING {
+    return parse_query(q, token, [&]() {
+        scoped_cJSON_t json_holder(cJSON_Parse(str));
+        cJSON *json = json_holder.get();
+        if (json == NULL) return false;
+        extract(json, q);
+        return true;
+    });
+}
+
+void json_pb_pieces_t::append_to(std::string *out) const {
+    out->reserve(out->size() + size_);
+    for (auto it = pieces_.begin(); it != pieces_.end(); ++it) {
+        out->append(it->first, it->second);
+    }
+}
+
+void json_pb_pieces_t::clear() {
+    pieces_.clear();
+    owned_.clear();
+    size_ = 0;
+}
+
+void json_pb_pieces_t::add_ref(const std::string &str) {
+    pieces_.push_back(std::make_pair(str.data(), str.size()));
+    size_ += str.size();
+}
+
+void json_pb_pieces_t::add_owned(std::string *str) {
+    if (!str->empty()) {
+        // `std::deque::push_back` doesn't move the strings that are already there.
+        owned_.push_back(std::move(*str));
+        add_ref(owned_.back());
+        str->clear();
+    }
+}
+
+void write_json_pb(const Response &r, json_pb_pieces_t *out) THROWS_NOTHING {
+    // The datums and the profile are already JSON, so we point at them instead of
+    // copying them; everything else goes into `buf` in between.
+    std::string buf;
     try {
-        *s += strprintf("{\"t\":%d,\"r\":[", r.type());
+        buf += strprintf("{\"t\":%d,\"r\":[", r.type());
         for (int i = 0; i < r.response_size(); ++i) {
-            *s += (i == 0) ? "" : ",";
+            buf += (i == 0) ? "" : ",";
             const Datum *d = &r.response(i);
             if (d->type() == Datum::R_JSON) {
-                *s += d->r_str();
+                out->add_owned(&buf);
+                out->add_ref(d->r_str());
             } else if (d->type() == Datum::R_STR) {
-                scoped_cJSON_t tmp(cJSON_CreateString(d->r_str().c_str()));
-                *s += tmp.PrintUnformatted();
+                json_print_string(d->r_str().data(), d->r_str().size(), &buf);
             } else {
                 unreachable();
             }
         }
-        *s += "]";
+        buf += "]";
 
         if (r.has_backtrace()) {
-            *s += ",\"b\":";
+            buf += ",\"b\":[";
             const Backtrace *bt = &r.backtrace();
-            scoped_cJSON_t arr(cJSON_CreateArray());
             for (int i = 0; i < bt->frames_size(); ++i) {
+                buf += (i == 0) ? "" : ",";
                 const Frame *f = &bt->frames(i);
                 switch (f->type()) {
                 case Frame::POS:
-                    arr.AddItemToArray(cJSON_CreateNumber(f->pos()));
+                    json_print_number(f->pos(), &buf);
                     break;
                 case Frame::OPT:
-                    arr.AddItemToArray(cJSON_CreateString(f->opt().c_str()));
+                    json_print_string(f->opt().data(), f->opt().size(), &buf);
                     break;
                 default:
                     unreachable();
                 }
             }
-            *s += arr.PrintUnformatted();
+            buf += "]";
         }
 
         if (r.has_profile()) {
-            *s += ",\"p\":";
+            buf += ",\"p\":";
             const Datum *d = &r.profile();
             guarantee(d->type() == Datum::R_JSON);
-            *s += d->r_str();
+            out->add_owned(&buf);
+            out->add_ref(d->r_str());
         }
 
-        *s += "}";
+        buf += "}";
+        out->add_owned(&buf);
     } catch (...) {
 #ifndef NDEBUG
         throw;
 #else
-        *s = strprintf("{\"t\":%d,\"r\":[\"%s\"]}",
-                       Response::RUNTIME_ERROR,
-                       "Internal error in `write_json_pb`, please report this.");
+        out->clear();
+        buf = strprintf("{\"t\":%d,\"r\":[\"%s\"]}",
+                        Response::RUNTIME_ERROR,
+                        "Internal error in `write_json_pb`, please report this.");
+        out->add_owned(&buf);
 #endif // NDEBUG
     }
 }
 
+void write_json_pb(const Response &r, std::string *s) THROWS_NOTHING {
+    json_pb_pieces_t pieces;
+    write_json_pb(r, &pieces);
+    pieces.append_to(s);
+}
+
 
 } // namespace json_shim
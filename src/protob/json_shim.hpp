@@ -1,7 +1,10 @@
 #ifndef PROTOB_JSON_SHIM_HPP_
 #define PROTOB_JSON_SHIM_HPP_
 
+#include <deque>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "utils.hpp"
 
@@ -11,7 +14,43 @@ template<class T>
 class scoped_array_t;
 
 namespace json_shim {
+
+// The JSON form of a `Response`, as a list of pieces.  The pieces point into the
+// `Response` where they can, so that writing a response out doesn't copy the
+// (possibly large) JSON of its datums.  The `Response` must outlive this.
+class json_pb_pieces_t {
+public:
+    json_pb_pieces_t() : size_(0) { }
+
+    size_t size() const { return size_; }
+    const std::vector<std::pair<const char *, size_t> > &pieces() const {
+        return pieces_;
+    }
+    void append_to(std::string *out) const;
+
+private:
+    friend void write_json_pb(const Response &r, json_pb_pieces_t *out) THROWS_NOTHING;
+
+    void clear();
+    void add_ref(const std::string &str);
+    // Takes the contents of `str` and leaves it empty.
+    void add_owned(std::string *str);
+
+    std::vector<std::pair<const char *, size_t> > pieces_;
+    std::deque<std::string> owned_;
+    size_t size_;
+
+    DISABLE_COPYING(json_pb_pieces_t);
+};
+
+// Parses the query without going through cJSON.
 MUST_USE bool parse_json_pb(Query *q, int64_t token, const char *str) THROWS_NOTHING;
+// The old way of parsing queries, which `parse_json_pb` must agree with.  It's only
+// used by the tests.
+MUST_USE bool parse_json_pb_via_cjson(Query *q, int64_t token,
+                                      const char *str) THROWS_NOTHING;
+
+void write_json_pb(const Response &r, json_pb_pieces_t *out) THROWS_NOTHING;
 void write_json_pb(const Response &r, std::string *out) THROWS_NOTHING;
 }  // namespace json_shim
 
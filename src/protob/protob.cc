@@ -3,9 +3,12 @@
 
 #include <google/protobuf/stubs/common.h>
 
+#include <exception>
+#include <functional>
+#include <limits>
+#include <map>
 #include <set>
 #include <string>
-#include <limits>
 
 #include "errors.hpp"
 #include <boost/lexical_cast.hpp>
@@ -14,7 +17,11 @@
 #include "arch/io/network.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/interruptor.hpp"
+#include "concurrency/new_mutex.hpp"
+#include "concurrency/wait_any.hpp"
 #include "containers/auth_key.hpp"
+#include "protob/connection_queries.hpp"
 #include "protob/json_shim.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rpc/semilattice/joins/vclock.hpp"
@@ -41,6 +48,7 @@ public:
     static bool parse_query(tcp_conn_t *conn,
                             signal_t *interruptor,
                             query_handler_t *handler,
+                            new_mutex_t *send_mutex,
                             ql::protob_t<Query> *query_out) {
         int64_t token;
         uint32_t size;
@@ -52,7 +60,8 @@ public:
             handler->unparseable_query(token, &error_response,
                                        strprintf("Payload size (%" PRIu32 ") greater than maximum (%" PRIu32 ").",
                                                  size, MAX_QUERY_SIZE));
-            send_response(error_response, handler, conn, interruptor);
+            send_response_exclusively<json_protocol_t>(
+                error_response, handler, conn, send_mutex, interruptor);
             throw tcp_conn_read_closed_exc_t();
         } else {
             scoped_array_t<char> data(size + 1);
@@ -63,7 +72,8 @@ public:
                 Response error_response;
                 handler->unparseable_query(token, &error_response,
                                            "Client is buggy (failed to deserialize query).");
-                send_response(error_response, handler, conn, interruptor);
+                send_response_exclusively<json_protocol_t>(
+                    error_response, handler, conn, send_mutex, interruptor);
                 return false;
             }
         }
@@ -76,22 +86,26 @@ public:
                               signal_t *interruptor) {
         int64_t token = response.token();
         uint32_t size;
-        std::string str;
+        json_shim::json_pb_pieces_t pieces;
 
-        json_shim::write_json_pb(response, &str);
-        if (str.size() > MAX_RESPONSE_SIZE) {
+        json_shim::write_json_pb(response, &pieces);
+        if (pieces.size() > MAX_RESPONSE_SIZE) {
             Response error_response;
             handler->unparseable_query(token, &error_response,
                 strprintf("Response size (%zu) is greater than maximum (%zu).",
-                          str.size(), MAX_RESPONSE_SIZE));
+                          pieces.size(), MAX_RESPONSE_SIZE));
             send_response(error_response, handler, conn, interruptor);
             return;
         }
-        size = str.size();
+        size = pieces.size();
 
-        conn->write(&token, sizeof(token), interruptor);
-        conn->write(&size, sizeof(size), interruptor);
-        conn->write(str.data(), size, interruptor);
+        // The pieces go straight into the connection's write buffer.
+        conn->write_buffered(&token, sizeof(token), interruptor);
+        conn->write_buffered(&size, sizeof(size), interruptor);
+        for (auto it = pieces.pieces().begin(); it != pieces.pieces().end(); ++it) {
+            conn->write_buffered(it->first, it->second, interruptor);
+        }
+        conn->flush_buffer(interruptor);
     }
 };
 
@@ -100,6 +114,7 @@ public:
     static bool parse_query(tcp_conn_t *conn,
                             signal_t *interruptor,
                             query_handler_t *handler,
+                            new_mutex_t *send_mutex,
                             ql::protob_t<Query> *query_out) {
         uint32_t size;
         conn->read(&size, sizeof(size), interruptor);
@@ -109,7 +124,8 @@ public:
             handler->unparseable_query(0, &error_response,
                                        strprintf("Payload size (%" PRIu32 ") greater than maximum (%" PRIu32 ").",
                                                  size, MAX_QUERY_SIZE));
-            send_response(error_response, handler, conn, interruptor);
+            send_response_exclusively<protobuf_protocol_t>(
+                error_response, handler, conn, send_mutex, interruptor);
             return false;
         } else {
             scoped_array_t<char> data(size);
@@ -120,7 +136,8 @@ public:
                 int64_t token = query_out->get()->has_token() ? query_out->get()->token() : 0;
                 handler->unparseable_query(token, &error_response,
                                            "Client is buggy (failed to deserialize query).");
-                send_response(error_response, handler, conn, interruptor);
+                send_response_exclusively<protobuf_protocol_t>(
+                    error_response, handler, conn, send_mutex, interruptor);
                 return false;
             }
         }
@@ -309,16 +326,24 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
 template <class protocol_t>
 void query_server_t::connection_loop(tcp_conn_t *conn,
                                      client_context_t *client_ctx) {
-    for (;;) {
-        ql::protob_t<Query> query(ql::make_counted_query());
+    connection_queries_t queries(conn, handler, client_ctx);
+    std::exception_ptr exc;
+    try {
+        for (;;) {
+            ql::protob_t<Query> query(ql::make_counted_query());
 
-        if (protocol_t::parse_query(conn, client_ctx->interruptor, handler, &query)) {
-            Response response;
-            if (handler->run_query(query, &response, client_ctx)) {
-                protocol_t::send_response(response, handler, conn, client_ctx->interruptor);
+            if (protocol_t::parse_query(conn, client_ctx->interruptor, handler,
+                                        queries.get_send_mutex(), &query)) {
+                queries.start_query<protocol_t>(query);
             }
         }
+    } catch (const std::exception &) {
+        exc = std::current_exception();
     }
+    // Stopping the queries has to wait for them, and we can't switch coroutines
+    // inside the `catch` statement.
+    queries.stop();
+    std::rethrow_exception(exc);
 }
 
 // Used in protob_server_t::handle(...) below to combine the interruptor from the
@@ -0,0 +1,287 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/batch_program.hpp"
+
+#include <utility>
+
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "utils.hpp"
+
+namespace ql {
+
+scoped_ptr_t<batch_program_t> batch_program_t::compile(const Term &body, sym_t arg) {
+    scoped_ptr_t<batch_program_t> program(new batch_program_t());
+    size_t index;
+    if (!program->compile_term(body, arg, &index)) {
+        return scoped_ptr_t<batch_program_t>();
+    }
+    guarantee(index + 1 == program->instructions.size());
+    return program;
+}
+
+size_t batch_program_t::push(opcode_t op, std::vector<size_t> &&args) {
+    instruction_t instruction;
+    instruction.op = op;
+    instruction.args = std::move(args);
+    instructions.push_back(std::move(instruction));
+    return instructions.size() - 1;
+}
+
+bool batch_program_t::compile_term(const Term &term, sym_t arg, size_t *index_out) {
+    std::vector<size_t> args;
+    // No term we handle takes optional arguments.
+    if (term.optargs_size() != 0) {
+        return false;
+    }
+    for (int i = 0; i < term.args_size(); ++i) {
+        if (term.args(i).type() == Term::ARGS) {
+            return false;
+        }
+    }
+
+    opcode_t op;
+    switch (term.type()) {
+    case Term::IMPLICIT_VAR:
+        // We don't compile nested functions, so `r.row` is the argument.
+        *index_out = push(opcode_t::ROW, std::move(args));
+        return true;
+    case Term::VAR:
+        if (term.args_size() == 1
+            && term.args(0).type() == Term::DATUM
+            && term.args(0).datum().type() == Datum::R_NUM
+            && term.args(0).datum().r_num() == static_cast<double>(arg.value)) {
+            *index_out = push(opcode_t::ROW, std::move(args));
+            return true;
+        }
+        // Other variables come from an enclosing scope.
+        return false;
+    case Term::DATUM: {
+        const Datum &d = term.datum();
+        datum_t constant;
+        switch (d.type()) {
+        case Datum::R_NULL: constant = datum_t::null(); break;
+        case Datum::R_BOOL: constant = datum_t::boolean(d.r_bool()); break;
+        case Datum::R_NUM: constant = datum_t(d.r_num()); break;
+        case Datum::R_STR: constant = datum_t(datum_string_t(d.r_str())); break;
+        default: return false;
+        }
+        *index_out = push(opcode_t::CONSTANT, std::move(args));
+        instructions[*index_out].constant = std::move(constant);
+        return true;
+    }
+    case Term::GET_FIELD: // fallthru
+    case Term::BRACKET: {
+        if (term.args_size() != 2
+            || term.args(1).type() != Term::DATUM
+            || term.args(1).datum().type() != Datum::R_STR) {
+            return false;
+        }
+        size_t object;
+        if (!compile_term(term.args(0), arg, &object)) {
+            return false;
+        }
+        args.push_back(object);
+        *index_out = push(opcode_t::GET_FIELD, std::move(args));
+        instructions[*index_out].field = datum_string_t(term.args(1).datum().r_str());
+        return true;
+    }
+    case Term::EQ: op = opcode_t::EQ; break;
+    case Term::NE: op = opcode_t::NE; break;
+    case Term::LT: op = opcode_t::LT; break;
+    case Term::LE: op = opcode_t::LE; break;
+    case Term::GT: op = opcode_t::GT; break;
+    case Term::GE: op = opcode_t::GE; break;
+    case Term::ALL: op = opcode_t::ALL; break;
+    case Term::ANY: op = opcode_t::ANY; break;
+    case Term::NOT: op = opcode_t::NOT; break;
+    case Term::ADD: op = opcode_t::ADD; break;
+    case Term::SUB: op = opcode_t::SUB; break;
+    case Term::MUL: op = opcode_t::MUL; break;
+    case Term::DIV: op = opcode_t::DIV; break;
+    default: return false;
+    }
+
+    switch (op) {
+    case opcode_t::NOT:
+        if (term.args_size() != 1) {
+            return false;
+        }
+        break;
+    case opcode_t::ALL: // fallthru
+    case opcode_t::ANY:
+        if (term.args_size() < 1) {
+            return false;
+        }
+        break;
+    default:
+        // We handle chained comparisons and arithmetic with more than two arguments
+        // the slow way.
+        if (term.args_size() != 2) {
+            return false;
+        }
+        break;
+    }
+    for (int i = 0; i < term.args_size(); ++i) {
+        size_t index;
+        if (!compile_term(term.args(i), arg, &index)) {
+            return false;
+        }
+        args.push_back(index);
+    }
+    *index_out = push(op, std::move(args));
+    return true;
+}
+
+const datum_t &batch_program_t::value(size_t index,
+                                      size_t row,
+                                      const std::vector<datum_t> &rows,
+                                      const std::vector<std::vector<datum_t> > &values)
+    const {
+    switch (instructions[index].op) {
+    case opcode_t::ROW: return rows[row];
+    case opcode_t::CONSTANT: return instructions[index].constant;
+    default: return values[index][row];
+    }
+}
+
+void batch_program_t::eval(env_t *env,
+                           const std::vector<datum_t> &rows,
+                           std::vector<datum_t> *out) const {
+    // The values of each instruction for each row.  `ROW` and `CONSTANT` don't fill
+    // in theirs.
+    std::vector<std::vector<datum_t> > values(instructions.size());
+    for (size_t n = 0; n < instructions.size(); ++n) {
+        eval_instruction(env, n, rows, &values);
+    }
+    const size_t result = instructions.size() - 1;
+    switch (instructions[result].op) {
+    case opcode_t::ROW:
+        *out = rows;
+        break;
+    case opcode_t::CONSTANT:
+        out->assign(rows.size(), instructions[result].constant);
+        break;
+    default:
+        out->swap(values[result]);
+        break;
+    }
+}
+
+void batch_program_t::eval_instruction(
+        env_t *env,
+        size_t index,
+        const std::vector<datum_t> &rows,
+        std::vector<std::vector<datum_t> > *values) const {
+    const instruction_t &instruction = instructions[index];
+    std::vector<datum_t> *out = &(*values)[index];
+    const reql_version_t reql_version = env->reql_version();
+    switch (instruction.op) {
+    case opcode_t::ROW: // fallthru
+    case opcode_t::CONSTANT:
+        return;
+    default:
+        break;
+    }
+
+    out->resize(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        datum_t *res = &(*out)[i];
+        switch (instruction.op) {
+        case opcode_t::GET_FIELD: {
+            const datum_t &object = value(instruction.args[0], i, rows, *values);
+            // `get_field` rejects pseudotypes.
+            if (object.has()
+                && object.get_type() == datum_t::R_OBJECT
+                && !object.is_ptype()) {
+                *res = object.get_field(instruction.field, NOTHROW);
+            }
+        } break;
+        case opcode_t::EQ: // fallthru
+        case opcode_t::NE: // fallthru
+        case opcode_t::LT: // fallthru
+        case opcode_t::LE: // fallthru
+        case opcode_t::GT: // fallthru
+        case opcode_t::GE: {
+            const datum_t &lhs = value(instruction.args[0], i, rows, *values);
+            const datum_t &rhs = value(instruction.args[1], i, rows, *values);
+            if (!lhs.has() || !rhs.has()) {
+                break;
+            }
+            bool b;
+            try {
+                switch (instruction.op) {
+                case opcode_t::EQ: b = lhs == rhs; break;
+                case opcode_t::NE: b = !(lhs == rhs); break;
+                case opcode_t::LT: b = lhs.cmp(reql_version, rhs) < 0; break;
+                case opcode_t::LE: b = lhs.cmp(reql_version, rhs) <= 0; break;
+                case opcode_t::GT: b = lhs.cmp(reql_version, rhs) > 0; break;
+                case opcode_t::GE: b = lhs.cmp(reql_version, rhs) >= 0; break;
+                default: unreachable();
+                }
+            } catch (const base_exc_t &) {
+                break;
+            }
+            *res = datum_t::boolean(b);
+        } break;
+        case opcode_t::ALL: {
+            // Like `and`, returns the first false argument or the last one, and
+            // ignores the arguments after the first false one.
+            for (size_t a = 0; a < instruction.args.size(); ++a) {
+                const datum_t &arg = value(instruction.args[a], i, rows, *values);
+                if (!arg.has() || !arg.as_bool() || a + 1 == instruction.args.size()) {
+                    *res = arg;
+                    break;
+                }
+            }
+        } break;
+        case opcode_t::ANY: {
+            *res = datum_t::boolean(false);
+            for (size_t a = 0; a < instruction.args.size(); ++a) {
+                const datum_t &arg = value(instruction.args[a], i, rows, *values);
+                if (!arg.has() || arg.as_bool()) {
+                    *res = arg;
+                    break;
+                }
+            }
+        } break;
+        case opcode_t::NOT: {
+            const datum_t &arg = value(instruction.args[0], i, rows, *values);
+            if (arg.has()) {
+                *res = datum_t::boolean(!arg.as_bool());
+            }
+        } break;
+        case opcode_t::ADD: // fallthru
+        case opcode_t::SUB: // fallthru
+        case opcode_t::MUL: // fallthru
+        case opcode_t::DIV: {
+            const datum_t &lhs = value(instruction.args[0], i, rows, *values);
+            const datum_t &rhs = value(instruction.args[1], i, rows, *values);
+            // Strings, arrays and times go the slow way.
+            if (!lhs.has() || lhs.get_type() != datum_t::R_NUM
+                || !rhs.has() || rhs.get_type() != datum_t::R_NUM) {
+                break;
+            }
+            double d;
+            switch (instruction.op) {
+            case opcode_t::ADD: d = lhs.as_num() + rhs.as_num(); break;
+            case opcode_t::SUB: d = lhs.as_num() - rhs.as_num(); break;
+            case opcode_t::MUL: d = lhs.as_num() * rhs.as_num(); break;
+            case opcode_t::DIV: d = lhs.as_num() / rhs.as_num(); break;
+            default: unreachable();
+            }
+            // Leave dividing by zero and overflowing to the slow way's errors.
+            if (risfinite(d) && !(instruction.op == opcode_t::DIV
+                                  && rhs.as_num() == 0)) {
+                *res = datum_t(d);
+            }
+        } break;
+        case opcode_t::ROW: // fallthru
+        case opcode_t::CONSTANT: // fallthru
+        default:
+            unreachable();
+        }
+    }
+}
+
+}  // namespace ql
@@ -0,0 +1,81 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_BATCH_PROGRAM_HPP_
+#define RDB_PROTOCOL_BATCH_PROGRAM_HPP_
+
+#include <vector>
+
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/sym.hpp"
+
+class Term;
+
+namespace ql {
+
+class env_t;
+
+// The body of a one-argument function that only gets fields with literal names,
+// compares, does arithmetic on numbers and combines booleans (as in
+// `r.row('x').gt(5).and(r.row('y').eq('a'))`), compiled into a list of instructions
+// that each run over a whole batch of rows.  This skips the `val_t`s, scopes and
+// virtual calls that evaluating the function a row at a time goes through.
+//
+// Rows the program can't handle (because a field is missing, an operand has the
+// wrong type, and so on) come out as uninitialized datums.  The caller should call
+// the function normally on those rows, which gives the right value or error.
+class batch_program_t {
+public:
+    // Returns an empty pointer if `body` does anything else.
+    static scoped_ptr_t<batch_program_t> compile(const Term &body, sym_t arg);
+
+    // Sets `(*out)[i]` to the value of the function for `rows[i]`, or leaves it
+    // uninitialized.
+    void eval(env_t *env,
+              const std::vector<datum_t> &rows,
+              std::vector<datum_t> *out) const;
+
+private:
+    enum class opcode_t {
+        ROW,
+        CONSTANT,
+        GET_FIELD,
+        EQ, NE, LT, LE, GT, GE,
+        ALL, ANY, NOT,
+        ADD, SUB, MUL, DIV
+    };
+
+    struct instruction_t {
+        opcode_t op;
+        // The instructions whose values this one uses, which come before it.
+        std::vector<size_t> args;
+        // For `CONSTANT`.
+        datum_t constant;
+        // For `GET_FIELD`.
+        datum_string_t field;
+    };
+
+    batch_program_t() { }
+
+    // Appends the instructions for `term` and sets `*index_out` to the index of the
+    // last one, or returns false.
+    bool compile_term(const Term &term, sym_t arg, size_t *index_out);
+    size_t push(opcode_t op, std::vector<size_t> &&args);
+
+    // Fills in `(*values)[index]`, the value of instruction `index` for each row.
+    void eval_instruction(env_t *env,
+                          size_t index,
+                          const std::vector<datum_t> &rows,
+                          std::vector<std::vector<datum_t> > *values) const;
+    const datum_t &value(size_t index,
+                         size_t row,
+                         const std::vector<datum_t> &rows,
+                         const std::vector<std::vector<datum_t> > &values) const;
+
+    std::vector<instruction_t> instructions;
+
+    DISABLE_COPYING(batch_program_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_BATCH_PROGRAM_HPP_
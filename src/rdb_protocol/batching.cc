@@ -25,6 +25,9 @@ static const int64_t SCALE_CONSTANT = 0;
 #else
 static const int64_t SCALE_CONSTANT = 32;
 #endif // NDEBUG
+// How far `batch_tuner_t` scales the limits, as powers of two.
+static const int MIN_TUNER_SHIFT = -4;
+static const int MAX_TUNER_SHIFT = 4;
 
 RDB_IMPL_SERIALIZABLE_7_FOR_CLUSTER(batchspec_t,
                                     batch_type,
@@ -126,6 +129,22 @@ batchspec_t batchspec_t::user(batch_type_t batch_type, env_t *env) {
                        current_microtime());
 }
 
+batch_policy_t batchspec_t::user_policy(env_t *env) {
+    datum_t policy_d;
+    if (!set_if_present("batch_policy", env, &policy_d)) {
+        return batch_policy_t::STATIC;
+    }
+    const std::string policy = policy_d.as_str().to_std();
+    if (policy == "static") {
+        return batch_policy_t::STATIC;
+    } else if (policy == "adaptive") {
+        return batch_policy_t::ADAPTIVE;
+    }
+    rfail_toplevel(base_exc_t::GENERIC,
+                   "Unrecognized batch_policy `%s` (expected `static` or `adaptive`).",
+                   policy.c_str());
+}
+
 batchspec_t batchspec_t::with_new_batch_type(batch_type_t new_batch_type) const {
     return batchspec_t(new_batch_type, min_els, max_els, max_size,
                        first_scaledown_factor, max_dur, start_time);
@@ -183,6 +202,55 @@ batchspec_t batchspec_t::scale_down(int64_t divisor) const {
                        first_scaledown_factor, max_dur, start_time);
 }
 
+batchspec_t batchspec_t::with_scaled_limits(double factor) const {
+    auto scale = [factor](int64_t limit, int64_t min_limit) {
+        if (limit == std::numeric_limits<int64_t>::max()) {
+            return limit;
+        }
+        const double scaled = limit * factor;
+        return scaled >= static_cast<double>(std::numeric_limits<int64_t>::max())
+            ? std::numeric_limits<int64_t>::max()
+            : std::max<int64_t>(min_limit, static_cast<int64_t>(scaled));
+    };
+    return batchspec_t(batch_type,
+                       min_els,
+                       scale(max_els, min_els),
+                       scale(max_size, 1),
+                       first_scaledown_factor,
+                       scale(max_dur, 0),
+                       start_time);
+}
+
+batchspec_t batch_tuner_t::tune(const batchspec_t &batchspec) const {
+    return shift == 0 ? batchspec : batchspec.with_scaled_limits(scale_factor());
+}
+
+double batch_tuner_t::scale_factor() const {
+    return shift >= 0
+        ? static_cast<double>(1 << shift)
+        : 1.0 / static_cast<double>(1 << -shift);
+}
+
+void batch_tuner_t::note_batch(size_t batch_rows, size_t batch_bytes,
+                               microtime_t read_usecs,
+                               size_t prev_rows, microtime_t client_usecs) {
+    ++batches;
+    rows += batch_rows;
+    bytes += batch_bytes;
+    if (batch_rows == 0 || prev_rows == 0 || client_usecs == 0) {
+        return;
+    }
+    // Reads that take no measurable time count as one microsecond, so a client that
+    // keeps up still grows its batches.
+    const double read_usecs_per_row = std::max<double>(1, read_usecs) / batch_rows;
+    const double client_usecs_per_row = static_cast<double>(client_usecs) / prev_rows;
+    if (client_usecs_per_row > 2 * read_usecs_per_row) {
+        shift = std::max(MIN_TUNER_SHIFT, shift - 1);
+    } else if (client_usecs_per_row < read_usecs_per_row) {
+        shift = std::min(MAX_TUNER_SHIFT, shift + 1);
+    }
+}
+
 batcher_t batchspec_t::to_batcher() const {
     int64_t real_min_els =
         batch_type != batch_type_t::NORMAL_FIRST
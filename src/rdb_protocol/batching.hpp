@@ -36,6 +36,15 @@ enum class batch_type_t {
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
     batch_type_t, int8_t, batch_type_t::NORMAL, batch_type_t::SINDEX_CONSTANT);
 
+// How a cursor picks the limits of its batches, set with the `batch_policy` global
+// optarg.
+enum class batch_policy_t {
+    // Always use the limits `batchspec_t::user` reads from the global optargs.
+    STATIC,
+    // Scale those limits up or down for each cursor with a `batch_tuner_t`.
+    ADAPTIVE
+};
+
 class batcher_t {
 public:
     bool note_el(const datum_t &t) {
@@ -73,14 +82,19 @@ private:
 class batchspec_t {
 public:
     static batchspec_t user(batch_type_t batch_type, env_t *env);
+    static batch_policy_t user_policy(env_t *env);
     static batchspec_t all(); // Gimme everything.
     static batchspec_t empty() { return batchspec_t(); }
     static batchspec_t default_for(batch_type_t batch_type);
     batch_type_t get_batch_type() const { return batch_type; }
+    // A batch stops at the first row that takes it to this many bytes.
+    int64_t get_max_size() const { return max_size; }
     batchspec_t with_new_batch_type(batch_type_t new_batch_type) const;
     batchspec_t with_max_dur(int64_t new_max_dur) const;
     batchspec_t with_at_most(uint64_t max_els) const;
     batchspec_t scale_down(int64_t divisor) const;
+    // Multiplies the size, duration and (if set) row limits by `factor`.
+    batchspec_t with_scaled_limits(double factor) const;
     batcher_t to_batcher() const;
 
 private:
@@ -101,6 +115,34 @@ private:
 };
 RDB_DECLARE_SERIALIZABLE(batchspec_t);
 
+// Tunes the batches of one cursor to how fast its client reads them.  If the client
+// takes much longer per row to come back for the next batch than we take to read it,
+// big batches only pile up on the client, so we shrink them.  If the client keeps up,
+// round trips are what slows it down, so we grow them.
+class batch_tuner_t {
+public:
+    batch_tuner_t() : shift(0), batches(0), rows(0), bytes(0) { }
+
+    // Returns `batchspec` with its limits scaled for the next batch.
+    batchspec_t tune(const batchspec_t &batchspec) const;
+
+    // Records a batch of `batch_rows` rows and `batch_bytes` bytes that took
+    // `read_usecs` to read.  `client_usecs` is how long the client took to ask for it
+    // after getting the previous batch of `prev_rows` rows, or 0 for the first batch.
+    void note_batch(size_t batch_rows, size_t batch_bytes, microtime_t read_usecs,
+                    size_t prev_rows, microtime_t client_usecs);
+
+    double scale_factor() const;
+    size_t batches_seen() const { return batches; }
+    size_t rows_seen() const { return rows; }
+    size_t bytes_seen() const { return bytes; }
+
+private:
+    // The limits are scaled by `2^shift`.
+    int shift;
+    size_t batches, rows, bytes;
+};
+
 } // namespace ql
 
 #endif // RDB_PROTOCOL_BATCHING_HPP_
@@ -39,3 +39,13 @@ void rdb_blob_wrapper_t::expose_all(
         "Other blocks might be referencing this blob, it's invalid to modify it in place.");
     internal.expose_all(parent, mode, buffer_group_out, acq_group_out);
 }
+
+void rdb_blob_wrapper_t::expose_region(
+        buf_parent_t parent, access_t mode,
+        int64_t offset, int64_t size,
+        buffer_group_t *buffer_group_out,
+        blob_acq_t *acq_group_out) {
+    guarantee(mode == access_t::read,
+        "Other blocks might be referencing this blob, it's invalid to modify it in place.");
+    internal.expose_region(parent, mode, offset, size, buffer_group_out, acq_group_out);
+}
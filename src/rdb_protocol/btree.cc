@@ -19,6 +19,7 @@
 #include "btree/slice.hpp"
 #include "buffer_cache/serialize_onto_blob.hpp"
 #include "concurrency/coro_pool.hpp"
+#include "concurrency/pmap.hpp"
 #include "concurrency/queue/unlimited_fifo.hpp"
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/buffer_group_stream.hpp"
@@ -31,8 +32,10 @@
 #include "rdb_protocol/geo_traversal.hpp"
 #include "rdb_protocol/lazy_json.hpp"
 #include "rdb_protocol/pseudo_geometry.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
 #include "rdb_protocol/serialize_datum_onto_blob.hpp"
 #include "rdb_protocol/shards.hpp"
+#include "stl_utils.hpp"
 
 #include "debug.hpp"
 
@@ -54,6 +57,10 @@ int rdb_value_sizer_t::max_possible_size() const {
     return blob::btree_maxreflen;
 }
 
+int64_t rdb_value_sizer_t::value_bytes(const void *value) const {
+    return as_rdb(value)->value_size();
+}
+
 block_magic_t rdb_value_sizer_t::leaf_magic() {
     block_magic_t magic = { { 'r', 'd', 'b', 'l' } };
     return magic;
@@ -105,6 +112,96 @@ void rdb_get(const store_key_t &store_key, btree_slice_t *slice,
     }
 }
 
+void do_a_get_from_batched_get(
+    auto_drainer_t::lock_t,
+    const store_key_t *key,
+    btree_slice_t *slice,
+    superblock_t *superblock,
+    promise_t<superblock_t *> *superblock_promise,
+    ql::datum_t *data_out,
+    profile::trace_t *trace) {
+    keyvalue_location_t kv_location;
+    rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+    find_keyvalue_location_for_read(&sizer, superblock,
+                                    key->btree_key(), &kv_location,
+                                    &slice->stats, trace, superblock_promise);
+
+    if (!kv_location.value.has()) {
+        *data_out = ql::datum_t::null();
+    } else {
+        *data_out = get_data(static_cast<rdb_value_t *>(kv_location.value.get()),
+                             buf_parent_t(&kv_location.buf));
+    }
+}
+
+void rdb_get_batch(const std::vector<store_key_t> &keys, btree_slice_t *slice,
+                   superblock_t *superblock, batched_point_read_response_t *response,
+                   profile::trace_t *trace) {
+    std::vector<ql::datum_t> rows(keys.size());
+    {
+        unlimited_fifo_queue_t<std::function<void()> > coro_queue;
+        struct callback_t : public coro_pool_callback_t<std::function<void()> > {
+            virtual void coro_pool_callback(std::function<void()> f, signal_t *) {
+                f();
+            }
+        } callback;
+        const size_t MAX_CONCURRENT_GETS = 8;
+        coro_pool_t<std::function<void()> > coro_pool(
+            MAX_CONCURRENT_GETS, &coro_queue, &callback);
+        auto_drainer_t drainer;
+        superblock_t *current_superblock = superblock;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            promise_t<superblock_t *> superblock_promise;
+            coro_queue.push(
+                std::bind(
+                    &do_a_get_from_batched_get,
+                    auto_drainer_t::lock_t(&drainer),
+                    &keys[i],
+                    slice,
+                    current_superblock,
+                    &superblock_promise,
+                    &rows[i],
+                    trace));
+            current_superblock = superblock_promise.wait();
+        }
+        // Every lookup has acquired its root by now.
+        current_superblock->release();
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        response->rows[keys[i]] = std::move(rows[i]);
+    }
+}
+
+bool rdb_get_optimistically(const store_key_t &store_key, btree_slice_t *slice,
+                            cache_t *cache, point_read_response_t *response) {
+    rdb_value_sizer_t sizer(cache->max_block_size());
+    scoped_malloc_t<void> value(sizer.max_possible_size());
+    bool found;
+    if (!find_value_optimistically(cache, SUPERBLOCK_ID, &sizer,
+                                   store_key.btree_key(), value.get(), &found)) {
+        return false;
+    }
+
+    if (!found) {
+        response->data = ql::datum_t::null();
+    } else {
+        // Reading a larger document would mean acquiring its blob's blocks.
+        const char *data;
+        int64_t size;
+        if (!blob::inline_value(static_cast<rdb_value_t *>(value.get())->value_ref(),
+                                blob::btree_maxreflen, &data, &size)) {
+            return false;
+        }
+        buffer_read_stream_t read_stream(data, size);
+        archive_result_t res = datum_deserialize(&read_stream, &response->data);
+        guarantee_deserialization(res, "rdb value");
+    }
+
+    slice->stats.pm_keys_read.record();
+    slice->stats.pm_total_keys_read += 1;
+    return true;
+}
+
 void kv_location_delete(keyvalue_location_t *kv_location,
                         const store_key_t &key,
                         repli_timestamp_t timestamp,
@@ -827,11 +924,13 @@ public:
             transformers.push_back(ql::make_op(_transforms[i]));
         }
         guarantee(transformers.size() == _transforms.size());
+        projection = ql::fields_used_by_ops(_transforms, accumulator->uses_val());
     }
     job_data_t(job_data_t &&jd)
         : env(jd.env),
           batcher(std::move(jd.batcher)),
           transformers(std::move(jd.transformers)),
+          projection(std::move(jd.projection)),
           sorting(jd.sorting),
           accumulator(jd.accumulator.release()) {
     }
@@ -840,6 +939,9 @@ private:
     ql::env_t *const env;
     ql::batcher_t batcher;
     std::vector<scoped_ptr_t<ql::op_t> > transformers;
+    // The only fields of each row that `transformers` and `accumulator` look at,
+    // if we know them.
+    boost::optional<std::set<datum_string_t> > projection;
     sorting_t sorting;
     scoped_ptr_t<ql::accumulator_t> accumulator;
 };
@@ -888,6 +990,10 @@ rget_cb_t::rget_cb_t(rget_io_data_t &&_io,
     io.response->last_key = !reversed(job.sorting)
         ? range.left
         : (!range.right.unbounded ? range.right.key : store_key_t::max());
+    if (sindex) {
+        // The secondary index function needs the whole row.
+        job.projection = boost::none;
+    }
     disabler.init(new profile::disabler_t(job.env->trace));
     sampler.init(new profile::sampler_t("Range traversal doc evaluation.",
                                         job.env->trace));
@@ -917,12 +1023,27 @@ done_traversing_t rget_cb_t::handle_pair(
         return done_traversing_t::NO;
     }
 
+    // An untransformed `count` on a secondary index only needs the secondary value
+    // to check the range, which we can usually get from the key instead of the row.
+    ql::datum_t key_sindex_val;
+    if (sindex && !job.accumulator->uses_val() && job.transformers.size() == 0) {
+        key_sindex_val = ql::datum_t::extract_secondary_value(
+            sindex->func_reql_version, key);
+    }
+
     lazy_json_t row(static_cast<const rdb_value_t *>(keyvalue.value()),
                     keyvalue.expose_buf());
     ql::datum_t val;
     // We only load the value if we actually use it (`count` does not).
-    if (job.accumulator->uses_val() || job.transformers.size() != 0 || sindex) {
-        val = row.get();
+    if (job.accumulator->uses_val() || job.transformers.size() != 0
+        || (sindex && !key_sindex_val.has())) {
+        if (job.projection) {
+            val = get_data_projected(static_cast<const rdb_value_t *>(keyvalue.value()),
+                                     keyvalue.expose_buf(), *job.projection);
+            row.reset();
+        } else {
+            val = row.get();
+        }
         io.slice->stats.pm_keys_read.record();
         io.slice->stats.pm_total_keys_read += 1;
     } else {
@@ -941,7 +1062,9 @@ done_traversing_t rget_cb_t::handle_pair(
 
         // Check whether we're out of sindex range.
         ql::datum_t sindex_val; // NULL if no sindex.
-        if (sindex) {
+        if (key_sindex_val.has()) {
+            sindex_val = std::move(key_sindex_val);
+        } else if (sindex) {
             // Secondary index functions are deterministic (so no need for an
             // rdb_context_t) and evaluated in a pristine environment (without global
             // optargs).
@@ -954,9 +1077,10 @@ done_traversing_t rget_cb_t::handle_pair(
                 sindex_val = sindex_val.get(*tag, ql::NOTHROW);
                 guarantee(sindex_val.has());
             }
-            if (!sindex->range.contains(sindex->func_reql_version, sindex_val)) {
-                return done_traversing_t::NO;
-            }
+        }
+        if (sindex
+            && !sindex->range.contains(sindex->func_reql_version, sindex_val)) {
+            return done_traversing_t::NO;
         }
 
         ql::groups_t data(optional_datum_less_t(job.env->reql_version()));
@@ -999,6 +1123,31 @@ void rdb_rget_slice(
         release_superblock_t release_superblock) {
 
     r_sanity_check(boost::get<ql::exc_t>(&response->result) == NULL);
+
+    // An unfiltered `count` over a range containing every key in the btree can
+    // be answered from the stat block without traversing the leaves.  That needs
+    // an unsnapshotted superblock, which is why `read_t::use_snapshot` doesn't
+    // snapshot these reads.
+    if (transforms.empty() && terminal
+        && boost::get<ql::count_wire_func_t>(&*terminal) != NULL) {
+        profile::starter_t starter("Count keys using the stat block.", ql_env->trace);
+        int64_t population;
+        if (get_btree_population_in_range(superblock, range, &population)) {
+            if (release_superblock == release_superblock_t::RELEASE) {
+                superblock->release();
+            }
+            response->result = ql::grouped_t<uint64_t>();
+            if (population > 0) {
+                boost::get<ql::grouped_t<uint64_t> >(&response->result)->insert(
+                    std::make_pair(ql::datum_t(), static_cast<uint64_t>(population)));
+            }
+            response->last_key = !reversed(sorting)
+                ? range.last_key_in_range()
+                : range.left;
+            return;
+        }
+    }
+
     profile::starter_t starter("Do range scan on primary index.", ql_env->trace);
     rget_cb_t callback(
         rget_io_data_t(response, slice),
@@ -1140,9 +1289,35 @@ void rdb_get_nearest_slice(
 void rdb_distribution_get(int max_depth,
                           const store_key_t &left_key,
                           superblock_t *superblock,
-                          distribution_read_response_t *response) {
+                          distribution_read_response_t *response,
+                          bool *key_sample_depleted_out) {
     int64_t key_count_out;
     std::vector<store_key_t> key_splits;
+    btree_statblock_t stats;
+    const key_sample_state_t sample_state
+        = get_btree_key_sample(superblock, &stats, &key_splits);
+    *key_sample_depleted_out = sample_state == key_sample_state_t::DEPLETED;
+    response->value_bytes = sample_state == key_sample_state_t::MISSING
+        ? btree_statblock_t::UNKNOWN_VALUE_BYTES
+        : stats.value_bytes;
+    if (sample_state == key_sample_state_t::USABLE) {
+        superblock->release();
+        // The sampled keys split the btree into `key_splits.size() + 1` ranges
+        // with about the same number of keys each.
+        key_count_out = stats.population;
+        const int64_t keys_per_bucket = key_splits.empty()
+            ? key_count_out
+            : std::max<int64_t>(
+                key_count_out / static_cast<int64_t>(key_splits.size() + 1), 1);
+        response->key_counts[left_key] = keys_per_bucket;
+        for (auto it = key_splits.begin(); it != key_splits.end(); ++it) {
+            response->key_counts[*it] = keys_per_bucket;
+        }
+        return;
+    }
+
+    // A depleted sample would put most of the btree in a handful of buckets, so we
+    // read the upper levels of the btree instead until it's rebuilt.
     get_btree_key_distribution(superblock, max_depth,
                                &key_count_out, &key_splits);
 
@@ -1369,6 +1544,7 @@ std::vector<std::string> expand_geo_key(
 void compute_keys(const store_key_t &primary_key,
                   ql::datum_t doc,
                   const sindex_disk_info_t &index_info,
+                  const counted_t<const ql::func_t> &mapping,
                   std::vector<std::pair<store_key_t, ql::datum_t> > *keys_out) {
     guarantee(keys_out->empty());
 
@@ -1380,8 +1556,7 @@ void compute_keys(const store_key_t &primary_key,
     cond_t non_interruptor;
     ql::env_t sindex_env(&non_interruptor, reql_version);
 
-    ql::datum_t index =
-        index_info.mapping.compile_wire_func()->call(&sindex_env, doc)->as_datum();
+    ql::datum_t index = mapping->call(&sindex_env, doc)->as_datum();
 
     if (index_info.multi == sindex_multi_bool_t::MULTI
         && index.get_type() == ql::datum_t::R_ARRAY) {
@@ -1424,6 +1599,14 @@ void compute_keys(const store_key_t &primary_key,
     }
 }
 
+void compute_keys(const store_key_t &primary_key,
+                  ql::datum_t doc,
+                  const sindex_disk_info_t &index_info,
+                  std::vector<std::pair<store_key_t, ql::datum_t> > *keys_out) {
+    compute_keys(primary_key, doc, index_info,
+                 index_info.mapping.compile_wire_func(), keys_out);
+}
+
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
         reql_version_t, int8_t,
         reql_version_t::v1_13, reql_version_t::v1_16_is_latest);
@@ -1757,122 +1940,273 @@ void rdb_update_sindexes(
     }
 }
 
+/* A row of the primary btree, copied out of its leaf node so that its secondary
+index keys can be computed on another thread. */
+struct post_construction_row_t {
+    store_key_t primary_key;
+    std::vector<char> value_ref;
+    std::vector<char> serialized_doc;
+    std::map<uuid_u, std::vector<store_key_t> > sindex_keys;
+};
+
+void copy_serialized_doc(const rdb_value_t *value,
+                         buf_parent_t parent,
+                         std::vector<char> *doc_out) {
+    rdb_blob_wrapper_t blob(parent.cache()->max_block_size(),
+                            const_cast<rdb_value_t *>(value)->value_ref(),
+                            blob::btree_maxreflen);
+
+    blob_acq_t acq_group;
+    buffer_group_t buffer_group;
+    blob.expose_all(parent, access_t::read, &buffer_group, &acq_group);
+
+    doc_out->resize(buffer_group.get_size());
+    buffer_group_t dest;
+    dest.add_buffer(doc_out->size(), doc_out->data());
+    buffer_group_copy_data(&dest, const_view(&buffer_group));
+}
+
+/* Computes the secondary index keys of `rows` for every index in
+`sindex_definitions`.  This only touches the rows and the definitions, so it can
+run on any thread. */
+void compute_post_construction_keys(
+        const std::map<uuid_u, std::vector<char> > &sindex_definitions,
+        std::vector<post_construction_row_t> *rows) {
+    std::vector<ql::datum_t> docs;
+    docs.reserve(rows->size());
+    for (const post_construction_row_t &row : *rows) {
+        buffer_read_stream_t read_stream(row.serialized_doc.data(),
+                                         row.serialized_doc.size());
+        ql::datum_t doc;
+        archive_result_t res = datum_deserialize(&read_stream, &doc);
+        guarantee_deserialization(res, "rdb value");
+        docs.push_back(doc);
+    }
+
+    for (const auto &definition : sindex_definitions) {
+        sindex_disk_info_t sindex_info;
+        try {
+            deserialize_sindex_info(definition.second, &sindex_info);
+        } catch (const archive_exc_t &e) {
+            crash("%s", e.what());
+        }
+
+        counted_t<const ql::func_t> mapping;
+        try {
+            // We compile the function once for the whole batch rather than once
+            // per row.
+            mapping = sindex_info.mapping.compile_wire_func();
+        } catch (const ql::base_exc_t &) {
+            continue;
+        }
+
+        for (size_t i = 0; i < rows->size(); ++i) {
+            post_construction_row_t *row = &(*rows)[i];
+            std::vector<std::pair<store_key_t, ql::datum_t> > keys;
+            try {
+                compute_keys(row->primary_key, docs[i], sindex_info, mapping, &keys);
+            } catch (const ql::base_exc_t &) {
+                // Do nothing (we just drop the row from the index).
+                continue;
+            }
+            std::vector<store_key_t> *keys_out = &row->sindex_keys[definition.first];
+            for (const auto &pair : keys) {
+                keys_out->push_back(pair.first);
+            }
+        }
+    }
+}
+
+void add_post_construction_keys(const store_t::sindex_access_t *sindex,
+                                const std::vector<store_key_t> &keys,
+                                const std::vector<char> &value_ref,
+                                const deletion_context_t *deletion_context) {
+    superblock_t *superblock = sindex->superblock.get();
+    for (const store_key_t &key : keys) {
+        promise_t<superblock_t *> return_superblock_local;
+        {
+            keyvalue_location_t kv_location;
+
+            rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+            find_keyvalue_location_for_write(
+                &sizer,
+                superblock,
+                key.btree_key(),
+                deletion_context->balancing_detacher(),
+                &kv_location,
+                &sindex->btree->stats,
+                NULL,
+                &return_superblock_local);
+
+            ql::serialization_result_t res =
+                kv_location_set(&kv_location, key, value_ref,
+                                repli_timestamp_t::distant_past,
+                                deletion_context);
+            // this particular context cannot fail AT THE MOMENT.
+            guarantee(!bad(res));
+            // The keyvalue location gets destroyed here.
+        }
+        superblock = return_superblock_local.wait();
+    }
+}
+
+/* Post-constructs the secondary indexes from the rows of one subrange of the
+primary btree.  Several of these run at once, one per subrange.  The rows of each
+leaf are copied out of the leaf, their secondary index keys are computed on
+`compute_thread`, and the keys are then inserted back on the store's thread (the
+cache is single-threaded). */
 class post_construct_traversal_helper_t : public btree_traversal_helper_t {
 public:
     post_construct_traversal_helper_t(
             store_t *store,
             const std::set<uuid_u> &sindexes_to_post_construct,
+            const std::map<uuid_u, std::vector<char> > &sindex_definitions,
+            const key_range_t &range,
+            threadnum_t compute_thread,
             cond_t *interrupt_myself,
             signal_t *interruptor
             )
         : store_(store),
           sindexes_to_post_construct_(sindexes_to_post_construct),
+          sindex_definitions_(sindex_definitions),
+          range_(range),
+          compute_thread_(compute_thread),
           interrupt_myself_(interrupt_myself), interruptor_(interruptor)
     { }
 
     void process_a_leaf(buf_lock_t *leaf_node_buf,
                         const btree_key_t *, const btree_key_t *,
-                        signal_t *, int *) THROWS_ONLY(interrupted_exc_t) {
-
-        scoped_ptr_t<txn_t> wtxn;
-        store_t::sindex_access_vector_t sindexes;
-
-        buf_read_t leaf_read(leaf_node_buf);
-        const leaf_node_t *leaf_node
-            = static_cast<const leaf_node_t *>(leaf_read.get_data_read());
+                        signal_t *, int *, int64_t *) THROWS_ONLY(interrupted_exc_t) {
+        std::vector<post_construction_row_t> rows;
+        {
+            buf_read_t leaf_read(leaf_node_buf);
+            const leaf_node_t *leaf_node
+                = static_cast<const leaf_node_t *>(leaf_read.get_data_read());
+            const max_block_size_t block_size = leaf_node_buf->cache()->max_block_size();
 
-        // Number of key/value pairs we process before yielding
-        const int MAX_CHUNK_SIZE = 10;
-        int current_chunk_size = 0;
-        const rdb_post_construction_deletion_context_t deletion_context;
-        for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
-            if (current_chunk_size == 0) {
-                // Start a write transaction and acquire the secondary index
-                // at the beginning of each chunk. We reset the transaction
-                // after each chunk because large write transactions can cause
-                // the cache to go into throttling, and that would interfere
-                // with other transactions on this table.
-                try {
-                    write_token_t token;
-                    store_->new_write_token(&token);
-
-                    scoped_ptr_t<real_superblock_t> superblock;
-
-                    // We use HARD durability because we want post construction
-                    // to be throttled if we insert data faster than it can
-                    // be written to disk. Otherwise we might exhaust the cache's
-                    // dirty page limit and bring down the whole table.
-                    // Other than that, the hard durability guarantee is not actually
-                    // needed here.
-                    store_->acquire_superblock_for_write(
-                            repli_timestamp_t::distant_past,
-                            2 + MAX_CHUNK_SIZE,
-                            write_durability_t::HARD,
-                            &token,
-                            &wtxn,
-                            &superblock,
-                            interruptor_);
+            for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
+                const btree_key_t *key = (*it).first;
+                guarantee(key);
+                if (!range_.contains_key(key->contents, key->size)) {
+                    // The leaf is shared with a neighbouring subrange.
+                    continue;
+                }
 
-                    // Acquire the sindex block.
-                    const block_id_t sindex_block_id = superblock->get_sindex_block_id();
+                store_->btree->stats.pm_keys_read.record();
+                store_->btree->stats.pm_total_keys_read += 1;
+
+                const rdb_value_t *rdb_value
+                    = static_cast<const rdb_value_t *>((*it).second);
+                rows.push_back(post_construction_row_t());
+                post_construction_row_t *row = &rows.back();
+                row->primary_key = store_key_t(key);
+                row->value_ref.assign(
+                    rdb_value->value_ref(),
+                    rdb_value->value_ref() + rdb_value->inline_size(block_size));
+                copy_serialized_doc(rdb_value, buf_parent_t(leaf_node_buf),
+                                    &row->serialized_doc);
+            }
+        }
 
-                    buf_lock_t sindex_block(superblock->expose_buf(), sindex_block_id,
-                                            access_t::write);
+        if (rows.empty()) {
+            return;
+        }
 
-                    superblock.reset();
+        {
+            // Evaluating the index functions is what dominates post construction,
+            // so that's the part we spread over the other threads.
+            on_thread_t thread_switcher(compute_thread_);
+            compute_post_construction_keys(sindex_definitions_, &rows);
+        }
 
-                    store_->acquire_sindex_superblocks_for_write(
-                            sindexes_to_post_construct_,
-                            &sindex_block,
-                            &sindexes);
+        new_semaphore_acq_t insertion_acq(&store_->post_construction_semaphore, 1);
+        try {
+            wait_interruptible(insertion_acq.acquisition_signal(), interruptor_);
+        } catch (const interrupted_exc_t &) {
+            return;
+        }
 
-                    if (sindexes.empty()) {
-                        interrupt_myself_->pulse_if_not_already_pulsed();
-                        return;
-                    }
-                } catch (const interrupted_exc_t &e) {
+        // Number of key/value pairs we process before yielding
+        const size_t MAX_CHUNK_SIZE = 10;
+        const rdb_post_construction_deletion_context_t deletion_context;
+        for (size_t chunk_begin = 0;
+             chunk_begin < rows.size();
+             chunk_begin += MAX_CHUNK_SIZE) {
+            scoped_ptr_t<txn_t> wtxn;
+            store_t::sindex_access_vector_t sindexes;
+
+            // Start a write transaction and acquire the secondary index
+            // at the beginning of each chunk. We reset the transaction
+            // after each chunk because large write transactions can cause
+            // the cache to go into throttling, and that would interfere
+            // with other transactions on this table.
+            try {
+                write_token_t token;
+                store_->new_write_token(&token);
+
+                scoped_ptr_t<real_superblock_t> superblock;
+
+                // We use HARD durability because we want post construction
+                // to be throttled if we insert data faster than it can
+                // be written to disk. Otherwise we might exhaust the cache's
+                // dirty page limit and bring down the whole table.
+                // Other than that, the hard durability guarantee is not actually
+                // needed here.
+                store_->acquire_superblock_for_write(
+                        repli_timestamp_t::distant_past,
+                        2 + MAX_CHUNK_SIZE,
+                        write_durability_t::HARD,
+                        &token,
+                        &wtxn,
+                        &superblock,
+                        interruptor_);
+
+                // Acquire the sindex block.
+                const block_id_t sindex_block_id = superblock->get_sindex_block_id();
+
+                buf_lock_t sindex_block(superblock->expose_buf(), sindex_block_id,
+                                        access_t::write);
+
+                superblock.reset();
+
+                store_->acquire_sindex_superblocks_for_write(
+                        sindexes_to_post_construct_,
+                        &sindex_block,
+                        &sindexes);
+
+                if (sindexes.empty()) {
+                    interrupt_myself_->pulse_if_not_already_pulsed();
                     return;
                 }
+            } catch (const interrupted_exc_t &e) {
+                return;
             }
 
-            store_->btree->stats.pm_keys_read.record();
-            store_->btree->stats.pm_total_keys_read += 1;
-
-            /* Grab relevant values from the leaf node. */
-            const btree_key_t *key = (*it).first;
-            const void *value = (*it).second;
-            guarantee(key);
-
-            const store_key_t pk(key);
-            rdb_modification_report_t mod_report(pk);
-            const rdb_value_t *rdb_value = static_cast<const rdb_value_t *>(value);
-            const max_block_size_t block_size = leaf_node_buf->cache()->max_block_size();
-            mod_report.info.added
-                = std::make_pair(
-                    get_data(rdb_value, buf_parent_t(leaf_node_buf)),
-                    std::vector<char>(rdb_value->value_ref(),
-                        rdb_value->value_ref() + rdb_value->inline_size(block_size)));
-
-            rdb_update_sindexes(store_,
-                                sindexes,
-                                &mod_report,
-                                wtxn.get(),
-                                &deletion_context,
-                                NULL,
-                                NULL,
-                                NULL);
-            store_->btree->stats.pm_keys_set.record();
-            store_->btree->stats.pm_total_keys_set += 1;
-
-            ++current_chunk_size;
-            if (current_chunk_size >= MAX_CHUNK_SIZE) {
-                current_chunk_size = 0;
-                // Release the write transaction and yield.
-                // We continue later where we have left off.
-                sindexes.clear();
-                wtxn.reset();
-                coro_t::yield();
+            const size_t chunk_end = std::min(rows.size(), chunk_begin + MAX_CHUNK_SIZE);
+            for (size_t i = chunk_begin; i < chunk_end; ++i) {
+                for (const auto &sindex : sindexes) {
+                    // Like `rdb_update_single_sindex`, we don't add anything to
+                    // an index that is being deleted.
+                    if (sindex->sindex.being_deleted) {
+                        continue;
+                    }
+                    auto keys = rows[i].sindex_keys.find(sindex->sindex.id);
+                    if (keys != rows[i].sindex_keys.end()) {
+                        add_post_construction_keys(sindex.get(),
+                                                   keys->second,
+                                                   rows[i].value_ref,
+                                                   &deletion_context);
+                    }
+                }
+                store_->btree->stats.pm_keys_set.record();
+                store_->btree->stats.pm_total_keys_set += 1;
             }
+
+            // Release the write transaction and yield.
+            // We continue later where we have left off.
+            sindexes.clear();
+            wtxn.reset();
+            coro_t::yield();
         }
     }
 
@@ -1882,7 +2216,19 @@ public:
                                      ranged_block_ids_t *ids_source,
                                      interesting_children_callback_t *cb) {
         for (int i = 0, e = ids_source->num_block_ids(); i < e; ++i) {
-            cb->receive_interesting_child(i);
+            block_id_t block_id;
+            const btree_key_t *left, *right;
+            ids_source->get_block_id_and_bounding_interval(i, &block_id, &left, &right);
+
+            // The child covers the keys in (`left`, `right`].
+            key_range_t child_range(
+                left == NULL ? key_range_t::none : key_range_t::open,
+                left == NULL ? store_key_t() : store_key_t(left),
+                right == NULL ? key_range_t::none : key_range_t::closed,
+                right == NULL ? store_key_t() : store_key_t(right));
+            if (range_.overlaps(child_range)) {
+                cb->receive_interesting_child(i);
+            }
         }
         cb->no_more_interesting_children();
     }
@@ -1892,10 +2238,68 @@ public:
 
     store_t *store_;
     const std::set<uuid_u> &sindexes_to_post_construct_;
+    const std::map<uuid_u, std::vector<char> > &sindex_definitions_;
+    const key_range_t range_;
+    const threadnum_t compute_thread_;
     cond_t *interrupt_myself_;
     signal_t *interruptor_;
 };
 
+std::vector<key_range_t> split_for_post_construction(
+        const std::vector<store_key_t> &sorted_sample,
+        int max_subranges) {
+    const size_t num_subranges =
+        std::min(sorted_sample.size() + 1, static_cast<size_t>(max_subranges));
+
+    std::vector<key_range_t> subranges;
+    key_range_t::bound_t left_bound = key_range_t::none;
+    store_key_t left;
+    for (size_t i = 1; i < num_subranges; ++i) {
+        const store_key_t &split = sorted_sample[(i * sorted_sample.size()) / num_subranges];
+        if (left_bound != key_range_t::none && split <= left) {
+            continue;
+        }
+        subranges.push_back(key_range_t(left_bound, left, key_range_t::open, split));
+        left_bound = key_range_t::closed;
+        left = split;
+    }
+    subranges.push_back(key_range_t(left_bound, left, key_range_t::none, store_key_t()));
+    return subranges;
+}
+
+void post_construct_subrange(
+        store_t *store,
+        post_construct_traversal_helper_t *helper,
+        signal_t *interruptor) {
+    try {
+        read_token_t read_token;
+        store->new_read_token(&read_token);
+
+        // Mind the destructor ordering.
+        // The superblock must be released before txn (`btree_parallel_traversal`
+        // usually already takes care of that).
+        // The txn must be destructed before the cache_account.
+        cache_account_t cache_account;
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+
+        store->acquire_superblock_for_read(
+            &read_token,
+            &txn,
+            &superblock,
+            interruptor,
+            true /* USE_SNAPSHOT */);
+
+        cache_account
+            = txn->cache()->create_cache_account(SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY);
+        txn->set_account(&cache_account);
+
+        btree_parallel_traversal(superblock.get(), helper, interruptor);
+    } catch (const interrupted_exc_t &) {
+        // `post_construct_secondary_indexes` rethrows if it needs to.
+    }
+}
+
 void post_construct_secondary_indexes(
         store_t *store,
         const std::set<uuid_u> &sindexes_to_post_construct,
@@ -1905,46 +2309,84 @@ void post_construct_secondary_indexes(
 
     wait_any_t wait_any(&local_interruptor, interruptor);
 
-    post_construct_traversal_helper_t helper(store,
-            sindexes_to_post_construct, &local_interruptor, interruptor);
+    // Read the index definitions and the key sample that we split the work by.
+    std::map<uuid_u, std::vector<char> > sindex_definitions;
+    std::vector<key_range_t> subranges;
+    {
+        read_token_t read_token;
+        store->new_read_token(&read_token);
+
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        store->acquire_superblock_for_read(
+            &read_token,
+            &txn,
+            &superblock,
+            interruptor,
+            false /* USE_SNAPSHOT */);
+
+        btree_statblock_t stats;
+        std::vector<store_key_t> sorted_sample;
+        if (get_btree_key_sample(superblock.get(), &stats, &sorted_sample)
+            != key_sample_state_t::USABLE) {
+            // Without a sample we can't tell where to split, so we just traverse
+            // the whole btree at once.
+            sorted_sample.clear();
+        }
+        subranges = split_for_post_construction(sorted_sample, get_num_db_threads());
+
+        buf_lock_t sindex_block(superblock->expose_buf(),
+                                superblock->get_sindex_block_id(),
+                                access_t::read);
+        superblock->release();
+
+        std::map<sindex_name_t, secondary_index_t> sindexes;
+        get_secondary_indexes(&sindex_block, &sindexes);
+        for (const auto &pair : sindexes) {
+            if (std_contains(sindexes_to_post_construct, pair.second.id)) {
+                sindex_definitions[pair.second.id] = pair.second.opaque_definition;
+            }
+        }
+    }
+
     /* Notice the ordering of progress_tracker and insertion_sentries matters.
      * insertion_sentries puts pointers in the progress tracker map. Once
      * insertion_sentries is destructed nothing has a reference to
      * progress_tracker so we know it's safe to destruct it. */
-    parallel_traversal_progress_t progress_tracker;
-    helper.progress = &progress_tracker;
+    sindex_construction_progress_t progress_tracker;
+
+    std::vector<scoped_ptr_t<post_construct_traversal_helper_t> >
+        helpers(subranges.size());
+    for (size_t i = 0; i < subranges.size(); ++i) {
+        // Spread the subranges over the threads, starting with the one after ours.
+        threadnum_t compute_thread(
+            (get_thread_id().threadnum + 1 + i) % get_num_db_threads());
+        helpers[i].init(new post_construct_traversal_helper_t(
+            store, sindexes_to_post_construct, sindex_definitions, subranges[i],
+            compute_thread, &local_interruptor, interruptor));
+
+        parallel_traversal_progress_t *subrange_progress
+            = new parallel_traversal_progress_t;
+        scoped_ptr_t<traversal_progress_t> subrange_progress_owned(subrange_progress);
+        progress_tracker.add_constituent(&subrange_progress_owned);
+        helpers[i]->progress = subrange_progress;
+    }
 
-    std::vector<map_insertion_sentry_t<uuid_u, const parallel_traversal_progress_t *> >
+    std::vector<map_insertion_sentry_t<uuid_u, const sindex_construction_progress_t *> >
         insertion_sentries(sindexes_to_post_construct.size());
     auto sentry = insertion_sentries.begin();
     for (auto it = sindexes_to_post_construct.begin();
-         it != sindexes_to_post_construct.end(); ++it) {
+         it != sindexes_to_post_construct.end(); ++it, ++sentry) {
         store->add_progress_tracker(&*sentry, *it, &progress_tracker);
     }
 
-    read_token_t read_token;
-    store->new_read_token(&read_token);
+    pmap(helpers.size(), [&](int64_t i) {
+        post_construct_subrange(store, helpers[i].get(), &wait_any);
+    });
 
-    // Mind the destructor ordering.
-    // The superblock must be released before txn (`btree_parallel_traversal`
-    // usually already takes care of that).
-    // The txn must be destructed before the cache_account.
-    cache_account_t cache_account;
-    scoped_ptr_t<txn_t> txn;
-    scoped_ptr_t<real_superblock_t> superblock;
-
-    store->acquire_superblock_for_read(
-        &read_token,
-        &txn,
-        &superblock,
-        interruptor,
-        true /* USE_SNAPSHOT */);
-
-    cache_account
-        = txn->cache()->create_cache_account(SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY);
-    txn->set_account(&cache_account);
-
-    btree_parallel_traversal(superblock.get(), &helper, &wait_any);
+    if (interruptor->is_pulsed()) {
+        throw interrupted_exc_t();
+    }
 }
 
 void noop_value_deleter_t::delete_value(buf_parent_t, const void *) const { }
@@ -38,6 +38,8 @@ public:
 
     int max_possible_size() const;
 
+    int64_t value_bytes(const void *value) const;
+
     static block_magic_t leaf_magic();
 
     block_magic_t btree_leaf_magic() const;
@@ -63,6 +65,25 @@ void rdb_get(
     point_read_response_t *response,
     profile::trace_t *trace);
 
+/* Looks up every key of a batched point read.  The lookups run concurrently, each
+one handing the superblock on to the next once it has acquired the root. */
+void rdb_get_batch(
+    const std::vector<store_key_t> &keys,
+    btree_slice_t *slice,
+    superblock_t *superblock,
+    batched_point_read_response_t *response,
+    profile::trace_t *trace);
+
+/* Tries to answer a point read on the primary btree of `cache` without acquiring
+any blocks (see `find_value_optimistically`).  Only documents that are stored inline
+in their leaf node can be read this way.  Returns false if the caller has to use
+`rdb_get` instead. */
+bool rdb_get_optimistically(
+    const store_key_t &key,
+    btree_slice_t *slice,
+    cache_t *cache,
+    point_read_response_t *response);
+
 struct btree_info_t {
     btree_info_t(btree_slice_t *_slice,
                  repli_timestamp_t _timestamp,
@@ -226,7 +247,8 @@ void rdb_get_nearest_slice(
 void rdb_distribution_get(int max_depth,
                           const store_key_t &left_key,
                           superblock_t *superblock,
-                          distribution_read_response_t *response);
+                          distribution_read_response_t *response,
+                          bool *key_sample_depleted_out);
 
 /* Secondary Indexes */
 
@@ -352,6 +374,13 @@ void rdb_update_sindexes(
     std::map<std::string, std::vector<ql::datum_t> > *old_keys_out,
     std::map<std::string, std::vector<ql::datum_t> > *new_keys_out);
 
+/* Splits the primary key space into at most `max_subranges` contiguous subranges
+holding about the same number of keys each, going by `sorted_sample` (the key
+sample in the stat block).  Post construction traverses the subranges at once. */
+std::vector<key_range_t> split_for_post_construction(
+        const std::vector<store_key_t> &sorted_sample,
+        int max_subranges);
+
 void post_construct_secondary_indexes(
         store_t *store,
         const std::set<uuid_u> &sindexes_to_post_construct,
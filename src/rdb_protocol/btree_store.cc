@@ -5,6 +5,8 @@
 
 #include "arch/runtime/coroutines.hpp"
 #include "btree/depth_first_traversal.hpp"
+#include "btree/get_distribution.hpp"
+#include "btree/key_sample.hpp"
 #include "btree/node.hpp"
 #include "btree/operations.hpp"
 #include "btree/secondary_operations.hpp"
@@ -66,7 +68,8 @@ store_t::store_t(serializer_t *serializer,
                  rdb_context_t *_ctx,
                  io_backender_t *io_backender,
                  const base_path_t &base_path,
-                 outdated_index_report_t *_index_report)
+                 outdated_index_report_t *_index_report,
+                 bool pin_btree_upper_levels)
     : store_view_t(region_t::universe()),
       perfmon_collection(),
       io_backender_(io_backender), base_path_(base_path),
@@ -75,7 +78,9 @@ store_t::store_t(serializer_t *serializer,
       changefeed_server((ctx == NULL || ctx->manager == NULL)
                         ? NULL
                         : new ql::changefeed::server_t(ctx->manager)),
-      index_report(_index_report)
+      index_report(_index_report),
+      rebuilding_key_sample(false),
+      post_construction_semaphore(MAX_CONCURRENT_POST_CONSTRUCTION_LEAVES)
 {
     cache.init(new cache_t(serializer, balancer, &perfmon_collection));
     general_cache_conn.init(new cache_conn_t(cache.get()));
@@ -104,7 +109,8 @@ store_t::store_t(serializer_t *serializer,
     btree.init(new btree_slice_t(cache.get(),
                                  &perfmon_collection,
                                  "primary",
-                                 index_type_t::PRIMARY));
+                                 index_type_t::PRIMARY,
+                                 pin_btree_upper_levels));
 
     // Initialize sindex slices
     {
@@ -140,7 +146,8 @@ store_t::store_t(serializer_t *serializer,
             auto slice = make_scoped<btree_slice_t>(cache.get(),
                                                     pc,
                                                     it->first.name,
-                                                    index_type_t::SECONDARY);
+                                                    index_type_t::SECONDARY,
+                                                    pin_btree_upper_levels);
             secondary_index_slices.insert(std::make_pair(it->second.id,
                                                          std::move(slice)));
         }
@@ -149,6 +156,14 @@ store_t::store_t(serializer_t *serializer,
     }
 
     help_construct_bring_sindexes_up_to_date();
+
+    // Loading every internal node can take a while on a big table, so it's done in
+    // the background instead of holding up the table.
+    if (pin_btree_upper_levels) {
+        coro_t::spawn_sometime(std::bind(&store_t::pin_upper_levels_in_background,
+                                         this,
+                                         drainer.lock()));
+    }
 }
 
 store_t::~store_t() {
@@ -160,6 +175,128 @@ store_t::~store_t() {
     }
 }
 
+void store_t::pin_upper_levels_in_background(
+        auto_drainer_t::lock_t store_keepalive)
+        THROWS_NOTHING {
+    assert_thread();
+    signal_t *interruptor = store_keepalive.get_drain_signal();
+    try {
+        // Each btree is pinned in its own transaction, so that we never hold on to
+        // the superblock or the sindex block while walking a btree.
+        {
+            read_token_t token;
+            new_read_token(&token);
+            scoped_ptr_t<txn_t> txn;
+            scoped_ptr_t<real_superblock_t> superblock;
+            acquire_superblock_for_read(&token, &txn, &superblock, interruptor, false);
+            if (!pin_upper_levels(superblock->get(), interruptor)) {
+                return;
+            }
+        }
+
+        std::map<sindex_name_t, secondary_index_t> sindexes;
+        {
+            read_token_t token;
+            new_read_token(&token);
+            scoped_ptr_t<txn_t> txn;
+            scoped_ptr_t<real_superblock_t> superblock;
+            acquire_superblock_for_read(&token, &txn, &superblock, interruptor, false);
+            buf_lock_t sindex_block(superblock->expose_buf(),
+                                    superblock->get_sindex_block_id(),
+                                    access_t::read);
+            superblock.reset();
+            if (!sindex_block.pin_in_memory()) {
+                return;
+            }
+            get_secondary_indexes(&sindex_block, &sindexes);
+        }
+
+        for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
+            if (it->second.being_deleted) {
+                continue;
+            }
+            read_token_t token;
+            new_read_token(&token);
+            scoped_ptr_t<txn_t> txn;
+            scoped_ptr_t<real_superblock_t> superblock;
+            acquire_superblock_for_read(&token, &txn, &superblock, interruptor, false);
+            buf_lock_t sindex_block(superblock->expose_buf(),
+                                    superblock->get_sindex_block_id(),
+                                    access_t::read);
+            superblock.reset();
+
+            // The index might have been dropped in the meantime.
+            secondary_index_t sindex;
+            if (!get_secondary_index(&sindex_block, it->second.id, &sindex)
+                || sindex.being_deleted) {
+                continue;
+            }
+            buf_lock_t sindex_superblock(&sindex_block, sindex.superblock,
+                                         access_t::read);
+            sindex_block.reset_buf_lock();
+            if (!pin_upper_levels(&sindex_superblock, interruptor)) {
+                return;
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        // The store is shutting down.
+    }
+}
+
+void store_t::rebuild_key_sample_in_background() {
+    assert_thread();
+    if (!rebuilding_key_sample) {
+        rebuilding_key_sample = true;
+        coro_t::spawn_sometime(std::bind(&store_t::rebuild_key_sample,
+                                         this,
+                                         drainer.lock()));
+    }
+}
+
+void store_t::rebuild_key_sample(
+        auto_drainer_t::lock_t store_keepalive)
+        THROWS_NOTHING {
+    assert_thread();
+    signal_t *interruptor = store_keepalive.get_drain_signal();
+    try {
+        // The keys are read from a snapshot, so writes can go on in the meantime.
+        // The sample is a little out of date by the time it's written, which doesn't
+        // matter for an estimate.
+        std::vector<store_key_t> keys;
+        {
+            read_token_t token;
+            new_read_token(&token);
+            scoped_ptr_t<txn_t> txn;
+            scoped_ptr_t<real_superblock_t> superblock;
+            acquire_superblock_for_read(&token, &txn, &superblock, interruptor, true);
+            if (!sample_btree_keys(superblock.get(), key_sample_t::MAX_KEYS,
+                                   interruptor, &keys)) {
+                throw interrupted_exc_t();
+            }
+        }
+
+        write_token_t token;
+        new_write_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        acquire_superblock_for_write(repli_timestamp_t::distant_past,
+                                     1,
+                                     write_durability_t::SOFT,
+                                     &token,
+                                     &txn,
+                                     &superblock,
+                                     interruptor);
+        const block_id_t stat_block = superblock->get_stat_block_id();
+        superblock.reset();
+        if (stat_block != NULL_BLOCK_ID) {
+            replace_stat_block_key_sample(txn.get(), stat_block, keys);
+        }
+    } catch (const interrupted_exc_t &) {
+        // The store is shutting down.
+    }
+    rebuilding_key_sample = false;
+}
+
 void store_t::read(
         DEBUG_ONLY(const metainfo_checker_t& metainfo_checker, )
         const read_t &read,
@@ -169,6 +306,50 @@ void store_t::read(
         signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t) {
     assert_thread();
+
+    // Point reads first try to find their document without acquiring any blocks,
+    // so that they don't get in line behind writers on the upper levels of the
+    // btree.  Batched point reads do the same if all of their documents can be
+    // found that way.  Profiled reads take the regular path, which records the
+    // block acquisitions.
+    const point_read_t *point_read = boost::get<point_read_t>(&read.read);
+    if (point_read != NULL && read.profile == profile_bool_t::DONT_PROFILE) {
+        wait_interruptible(token->main_read_token.get(), interruptor);
+        point_read_response_t point_read_response;
+        if (rdb_get_optimistically(point_read->key, btree.get(), cache.get(),
+                                   &point_read_response)) {
+            // `rdb_get_optimistically` doesn't block, so no write that comes after
+            // us in the token order could have gotten ahead of us.
+            token->main_read_token.reset();
+            response->response = std::move(point_read_response);
+            response->n_shards = 1;
+            response->event_log.push_back(profile::stop_t());
+            return;
+        }
+    }
+    const batched_point_read_t *batched_read =
+        boost::get<batched_point_read_t>(&read.read);
+    if (batched_read != NULL && read.profile == profile_bool_t::DONT_PROFILE) {
+        wait_interruptible(token->main_read_token.get(), interruptor);
+        batched_point_read_response_t batched_read_response;
+        bool all_found = true;
+        for (auto it = batched_read->keys.begin();
+             all_found && it != batched_read->keys.end();
+             ++it) {
+            point_read_response_t point_read_response;
+            all_found = rdb_get_optimistically(*it, btree.get(), cache.get(),
+                                               &point_read_response);
+            batched_read_response.rows[*it] = std::move(point_read_response.data);
+        }
+        if (all_found) {
+            token->main_read_token.reset();
+            response->response = std::move(batched_read_response);
+            response->n_shards = 1;
+            response->event_log.push_back(profile::stop_t());
+            return;
+        }
+    }
+
     scoped_ptr_t<txn_t> txn;
     scoped_ptr_t<real_superblock_t> superblock;
 
@@ -571,17 +752,27 @@ void store_t::sindex_queue_push(
 }
 
 void store_t::add_progress_tracker(
-        map_insertion_sentry_t<uuid_u, const parallel_traversal_progress_t *> *sentry,
-        uuid_u id, const parallel_traversal_progress_t *p) {
+        map_insertion_sentry_t<uuid_u, const sindex_construction_progress_t *> *sentry,
+        uuid_u id, const sindex_construction_progress_t *p) {
     assert_thread();
     sentry->reset(&progress_trackers, id, p);
 }
 
-progress_completion_fraction_t store_t::get_progress(uuid_u id) {
+progress_completion_fraction_t store_t::get_progress(uuid_u id,
+                                                     double *blocks_per_second_out) {
+    *blocks_per_second_out = 0;
     if (!std_contains(progress_trackers, id)) {
         return progress_completion_fraction_t();
     } else {
-        return progress_trackers[id]->guess_completion();
+        const sindex_construction_progress_t *progress = progress_trackers[id];
+        const microtime_t start_time = progress->start_time();
+        progress_completion_fraction_t frac = progress->guess_completion();
+        const microtime_t elapsed = current_microtime() - start_time;
+        if (!frac.invalid() && elapsed > 0) {
+            *blocks_per_second_out =
+                frac.estimate_of_released_nodes / (elapsed / 1000000.0);
+        }
+        return frac;
     }
 }
 
@@ -606,6 +797,11 @@ bool store_t::add_sindex(
             btree_slice_t::init_superblock(&sindex_superblock,
                                            std::vector<char>(),
                                            binary_blob_t());
+            // The new btree is empty, so only its superblock needs pinning.  Its
+            // root gets pinned when it first splits.
+            if (btree->pins_upper_levels()) {
+                sindex_superblock.pin_in_memory();
+            }
         }
 
         secondary_index_slices.insert(
@@ -613,7 +809,8 @@ bool store_t::add_sindex(
                                make_scoped<btree_slice_t>(cache.get(),
                                                           &perfmon_collection,
                                                           name.name,
-                                                          index_type_t::SECONDARY)));
+                                                          index_type_t::SECONDARY,
+                                                          btree->pins_upper_levels())));
 
         sindex.post_construction_complete = false;
 
@@ -7,9 +7,17 @@ rdb_context_t::rdb_context_t()
     : extproc_pool(NULL),
       cluster_interface(NULL),
       manager(NULL),
+      io_backender(NULL),
+      base_path(""),
       ql_stats_membership(
           &get_global_perfmon_collection(), &ql_stats_collection, "query_language"),
       ql_ops_running_membership(&ql_stats_collection, &ql_ops_running, "ops_running"),
+      ql_adaptive_batches_membership(
+          &ql_stats_collection, &ql_adaptive_batches, "adaptive_batches"),
+      ql_adaptive_batches_grown_membership(
+          &ql_stats_collection, &ql_adaptive_batches_grown, "adaptive_batches_grown"),
+      ql_adaptive_batches_shrunk_membership(
+          &ql_stats_collection, &ql_adaptive_batches_shrunk, "adaptive_batches_shrunk"),
       reql_http_proxy()
 { }
 
@@ -19,9 +27,17 @@ rdb_context_t::rdb_context_t(
     : extproc_pool(_extproc_pool),
       cluster_interface(_cluster_interface),
       manager(NULL),
+      io_backender(NULL),
+      base_path(""),
       ql_stats_membership(
           &get_global_perfmon_collection(), &ql_stats_collection, "query_language"),
       ql_ops_running_membership(&ql_stats_collection, &ql_ops_running, "ops_running"),
+      ql_adaptive_batches_membership(
+          &ql_stats_collection, &ql_adaptive_batches, "adaptive_batches"),
+      ql_adaptive_batches_grown_membership(
+          &ql_stats_collection, &ql_adaptive_batches_grown, "adaptive_batches_grown"),
+      ql_adaptive_batches_shrunk_membership(
+          &ql_stats_collection, &ql_adaptive_batches_shrunk, "adaptive_batches_shrunk"),
       reql_http_proxy()
 { }
 
@@ -32,13 +48,23 @@ rdb_context_t::rdb_context_t(
         boost::shared_ptr< semilattice_readwrite_view_t<auth_semilattice_metadata_t> >
             _auth_metadata,
         perfmon_collection_t *_global_stats,
-        const std::string &_reql_http_proxy)
+        const std::string &_reql_http_proxy,
+        io_backender_t *_io_backender,
+        const base_path_t &_base_path)
     : extproc_pool(_extproc_pool),
       cluster_interface(_cluster_interface),
       auth_metadata(_auth_metadata),
       manager(_mailbox_manager),
+      io_backender(_io_backender),
+      base_path(_base_path),
       ql_stats_membership(_global_stats, &ql_stats_collection, "query_language"),
       ql_ops_running_membership(&ql_stats_collection, &ql_ops_running, "ops_running"),
+      ql_adaptive_batches_membership(
+          &ql_stats_collection, &ql_adaptive_batches, "adaptive_batches"),
+      ql_adaptive_batches_grown_membership(
+          &ql_stats_collection, &ql_adaptive_batches_grown, "adaptive_batches_grown"),
+      ql_adaptive_batches_shrunk_membership(
+          &ql_stats_collection, &ql_adaptive_batches_shrunk, "adaptive_batches_shrunk"),
       reql_http_proxy(_reql_http_proxy)
 { }
 
@@ -60,6 +60,9 @@ public:
 
     virtual ql::datum_t read_row(ql::env_t *env,
         ql::datum_t pval, bool use_outdated) = 0;
+    /* Returns the rows in the order of `pvals`, with `null` for missing rows. */
+    virtual std::vector<ql::datum_t> read_rows(ql::env_t *env,
+        const std::vector<ql::datum_t> &pvals, bool use_outdated) = 0;
     virtual counted_t<ql::datum_stream_t> read_all(
         ql::env_t *env,
         const std::string &sindex,
@@ -161,6 +164,7 @@ protected:
     virtual ~reql_cluster_interface_t() { }   // silence compiler warnings
 };
 
+class io_backender_t;
 class mailbox_manager_t;
 
 class rdb_context_t {
@@ -179,7 +183,9 @@ public:
                     semilattice_readwrite_view_t<
                         auth_semilattice_metadata_t> > _auth_metadata,
                   perfmon_collection_t *_global_stats,
-                  const std::string &_reql_http_proxy);
+                  const std::string &_reql_http_proxy,
+                  io_backender_t *_io_backender,
+                  const base_path_t &_base_path);
 
     ~rdb_context_t();
 
@@ -191,10 +197,23 @@ public:
 
     mailbox_manager_t *manager;
 
+    // Where queries put what doesn't fit in memory (like the rows of a big unindexed
+    // `order_by`).  `io_backender` is NULL if there's nowhere (like on proxies).
+    io_backender_t *io_backender;
+    const base_path_t base_path;
+
     perfmon_collection_t ql_stats_collection;
     perfmon_membership_t ql_stats_membership;
     perfmon_counter_t ql_ops_running;
     perfmon_membership_t ql_ops_running_membership;
+    // The batches of cursors with the `adaptive` batch policy, and how many of them
+    // made the cursor's next batches bigger or smaller.
+    perfmon_counter_t ql_adaptive_batches;
+    perfmon_membership_t ql_adaptive_batches_membership;
+    perfmon_counter_t ql_adaptive_batches_grown;
+    perfmon_membership_t ql_adaptive_batches_grown_membership;
+    perfmon_counter_t ql_adaptive_batches_shrunk;
+    perfmon_membership_t ql_adaptive_batches_shrunk_membership;
 
     const std::string reql_http_proxy;
 
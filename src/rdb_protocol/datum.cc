@@ -14,6 +14,7 @@
 
 #include "containers/archive/stl_types.hpp"
 #include "containers/scoped.hpp"
+#include "rdb_protocol/datum_json.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/pseudo_binary.hpp"
@@ -404,7 +405,9 @@ datum_t to_datum(cJSON *json, const configured_limits_t &limits) {
         datum_object_builder_t builder;
         json_object_iterator_t it(json);
         while (cJSON *item = it.next()) {
-            bool dup = builder.add(item->string, to_datum(item, limits));
+            bool dup = builder.add(
+                intern_datum_string(strlen(item->string), item->string),
+                to_datum(item, limits));
             rcheck_datum(!dup, base_exc_t::GENERIC,
                          strprintf("Duplicate key `%s` in JSON.", item->string));
         }
@@ -542,8 +545,16 @@ void datum_t::num_to_str_key(std::string *str_out) const {
         packed.u ^= (1ULL << 63);
     }
     // The formatting here is sensitive.  Talk to mlucy before changing it.
-    str_out->append(strprintf("%.*" PRIx64, static_cast<int>(sizeof(double)*2), packed.u));
-    str_out->append(strprintf("#%" PR_RECONSTRUCTABLE_DOUBLE, as_num()));
+    // It's the same as `"%.16" PRIx64 "#%" PR_RECONSTRUCTABLE_DOUBLE`, without the
+    // cost of `strprintf` (`json_print_number` formats integers by hand).
+    char hex[sizeof(double) * 2];
+    for (size_t i = sizeof(hex); i > 0; --i) {
+        hex[i - 1] = "0123456789abcdef"[packed.u & 0xf];
+        packed.u >>= 4;
+    }
+    str_out->append(hex, sizeof(hex));
+    str_out->push_back('#');
+    json_print_number(as_num(), str_out);
 }
 
 void datum_t::binary_to_str_key(std::string *str_out) const {
@@ -986,6 +997,76 @@ boost::optional<uint64_t> datum_t::extract_tag(const store_key_t &key) {
     return extract_tag(key_to_unescaped_str(key));
 }
 
+datum_t datum_t::extract_secondary_value(reql_version_t reql_version,
+                                         const store_key_t &secondary_key) {
+    // Keys from before 1.14 don't end with a null character, so we can't tell where
+    // a string ends.
+    if (reql_version == reql_version_t::v1_13 || key_is_truncated(secondary_key)) {
+        return datum_t();
+    }
+    std::string s = extract_secondary(key_to_unescaped_str(secondary_key));
+    if (s.empty() || s[s.size() - 1] != '\0') {
+        return datum_t();
+    }
+    s.erase(s.size() - 1);
+
+    const std::string time_prefix = std::string("P") + pseudo::time_string + ":";
+    const bool is_time = s.compare(0, time_prefix.size(), time_prefix) == 0;
+    if (is_time) {
+        s.erase(0, time_prefix.size());
+    }
+    if (s.empty()) {
+        return datum_t();
+    }
+    switch (s[0]) {
+    case 'N': {
+        // The inverse of `num_to_str_key`, which writes the mangled bits in hex
+        // before a '#' and the number.
+        const size_t hex_size = sizeof(double) * 2;
+        if (s.size() < 2 + hex_size || s[1 + hex_size] != '#') {
+            return datum_t();
+        }
+        union {
+            double d;
+            uint64_t u;
+        } packed;
+        packed.u = 0;
+        for (size_t i = 1; i <= hex_size; ++i) {
+            const char c = s[i];
+            uint64_t digit;
+            if (c >= '0' && c <= '9') {
+                digit = c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                digit = c - 'a' + 10;
+            } else {
+                return datum_t();
+            }
+            packed.u = (packed.u << 4) | digit;
+        }
+        if (packed.u & (1ULL << 63)) {
+            packed.u ^= (1ULL << 63);
+        } else {
+            packed.u = ~packed.u;
+        }
+        return is_time
+            ? pseudo::make_time(packed.d, "+00:00")
+            : datum_t(packed.d);
+    }
+    case 'S':
+        if (is_time) {
+            return datum_t();
+        }
+        return datum_t(datum_string_t(s.size() - 1, s.data() + 1));
+    case 'B':
+        if (is_time || s.size() != 2) {
+            return datum_t();
+        }
+        return datum_t::boolean(s[1] == 't');
+    default:
+        return datum_t();
+    }
+}
+
 // This function returns a store_key_t suitable for searching by a
 // secondary-index.  This is needed because secondary indexes may be truncated,
 // but the amount truncated depends on the length of the primary key.  Since we
@@ -1154,23 +1235,30 @@ std::pair<datum_string_t, datum_t> datum_t::unchecked_get_pair(size_t index) con
 }
 
 datum_t datum_t::get_field(const datum_string_t &key, throw_bool_t throw_bool) const {
-    // Use binary search on top of unchecked_get_pair()
-    size_t range_beg = 0;
-    // The obj_size() also makes sure that this has the right type (R_OBJECT)
-    size_t range_end = obj_size();
-    while (range_beg < range_end) {
-        const size_t center = range_beg + ((range_end - range_beg) / 2);
-        auto center_pair = unchecked_get_pair(center);
-        const int cmp = key.compare(center_pair.first);
-        if (cmp == 0) {
-            // Found it
-            return center_pair.second;
-        } else if (cmp < 0) {
-            range_end = center;
-        } else {
-            range_beg = center + 1;
+    if (data.get_internal_type() == internal_type_t::BUF_R_OBJECT) {
+        datum_t res = datum_get_field_from_buf(data.buf_ref, key.data(), key.size());
+        if (res.has()) {
+            return res;
+        }
+    } else {
+        // Use binary search on top of unchecked_get_pair()
+        size_t range_beg = 0;
+        // The obj_size() also makes sure that this has the right type (R_OBJECT)
+        size_t range_end = obj_size();
+        while (range_beg < range_end) {
+            const size_t center = range_beg + ((range_end - range_beg) / 2);
+            auto center_pair = unchecked_get_pair(center);
+            const int cmp = key.compare(center_pair.first);
+            if (cmp == 0) {
+                // Found it
+                return center_pair.second;
+            } else if (cmp < 0) {
+                range_end = center;
+            } else {
+                range_beg = center + 1;
+            }
+            rassert(range_beg <= range_end);
         }
-        rassert(range_beg <= range_end);
     }
 
     // Didn't find it
@@ -1220,6 +1308,46 @@ scoped_cJSON_t datum_t::as_json() const {
     return scoped_cJSON_t(as_json_raw());
 }
 
+void datum_t::write_json(std::string *out) const {
+    switch (get_type()) {
+    case R_NULL: out->append("null"); break;
+    case R_BINARY: {
+        // Binary data is rare enough in responses that this can go through cJSON.
+        out->append(pseudo::encode_base64_ptype(as_binary()).PrintUnformatted());
+    } break;
+    case R_BOOL: out->append(as_bool() ? "true" : "false"); break;
+    case R_NUM: json_print_number(as_num(), out); break;
+    case R_STR: json_print_string(as_str().data(), as_str().size(), out); break;
+    case R_ARRAY: {
+        out->push_back('[');
+        const size_t sz = arr_size();
+        for (size_t i = 0; i < sz; ++i) {
+            if (i != 0) {
+                out->push_back(',');
+            }
+            unchecked_get(i).write_json(out);
+        }
+        out->push_back(']');
+    } break;
+    case R_OBJECT: {
+        out->push_back('{');
+        const size_t sz = obj_size();
+        for (size_t i = 0; i < sz; ++i) {
+            if (i != 0) {
+                out->push_back(',');
+            }
+            auto pair = get_pair(i);
+            json_print_string(pair.first.data(), pair.first.size(), out);
+            out->push_back(':');
+            pair.second.write_json(out);
+        }
+        out->push_back('}');
+    } break;
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
 // TODO: make BINARY, STR, and OBJECT convertible to sequence?
 counted_t<datum_stream_t>
 datum_t::as_datum_stream(const protob_t<const Backtrace> &backtrace) const {
@@ -1488,8 +1616,10 @@ datum_t to_datum(const Datum *d, const configured_limits_t &limits) {
         return datum_t(datum_string_t(d->r_str()));
     } break;
     case Datum::R_JSON: {
-        scoped_cJSON_t cjson(cJSON_Parse(d->r_str().c_str()));
-        return to_datum(cjson.get(), limits);
+        datum_t res;
+        bool ok = parse_json(d->r_str().data(), d->r_str().size(), limits, &res);
+        r_sanity_check(ok);
+        return res;
     } break;
     case Datum::R_ARRAY: {
         datum_array_builder_t out(limits);
@@ -1586,7 +1716,7 @@ void datum_t::write_to_protobuf(Datum *d, use_json_t use_json) const {
     } break;
     case use_json_t::YES: {
         d->set_type(Datum::R_JSON);
-        d->set_r_str(as_json().PrintUnformatted());
+        write_json(d->mutable_r_str());
     } break;
     default: unreachable();
     }
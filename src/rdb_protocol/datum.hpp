@@ -210,6 +210,11 @@ public:
             const std::string &secondary_and_primary);
     static boost::optional<uint64_t> extract_tag(const store_key_t &key);
     static components_t extract_all(const std::string &secondary_and_primary);
+    /* Returns the value `print_secondary` printed into `secondary_key` if it's a
+    number, string, bool or time that wasn't truncated, and an uninitialized datum
+    otherwise.  Times come back in UTC. */
+    static datum_t extract_secondary_value(reql_version_t reql_version,
+                                           const store_key_t &secondary_key);
     store_key_t truncated_secondary() const;
     void check_type(type_t desired, const char *msg = NULL) const;
     void type_error(const std::string &msg) const NORETURN;
@@ -254,6 +259,9 @@ public:
 
     cJSON *as_json_raw() const;
     scoped_cJSON_t as_json() const;
+    // Appends the same thing `as_json().PrintUnformatted()` would return to `out`,
+    // without building a cJSON tree.
+    void write_json(std::string *out) const;
     counted_t<datum_stream_t> as_datum_stream(
             const protob_t<const Backtrace> &backtrace) const;
 
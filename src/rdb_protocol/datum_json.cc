@@ -0,0 +1,324 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/datum_json.hpp"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/pseudo_literal.hpp"
+
+namespace ql {
+
+namespace {
+
+// Thrown internally when the JSON is malformed.
+class malformed_json_exc_t { };
+
+// A single pass over the input that builds the datum as it goes.  The grammar (and
+// every quirk of it) is the one in `cJSON.cc`; the comments point out where that's
+// not obvious.  Unlike cJSON, we never read past `end`.
+class json_parser_t {
+public:
+    json_parser_t(const char *begin, const char *end,
+                  const configured_limits_t &limits)
+        : p(begin), end_(end), limits_(limits),
+          allowed_pts_({ pseudo::literal_string }) { }
+
+    datum_t parse_value() {
+        skip_whitespace();
+        if (p == end_) throw malformed_json_exc_t();
+        switch (*p) {
+        case 'n':
+            if (!skip_literal("null")) throw malformed_json_exc_t();
+            return datum_t::null();
+        case 'f':
+            if (!skip_literal("false")) throw malformed_json_exc_t();
+            return datum_t::boolean(false);
+        case 't':
+            if (!skip_literal("true")) throw malformed_json_exc_t();
+            return datum_t::boolean(true);
+        case '"':
+            return datum_t(parse_string(false));
+        case '[':
+            return parse_array();
+        case '{':
+            return parse_object();
+        default:
+            if (*p == '-' || (*p >= '0' && *p <= '9')) {
+                return datum_t(parse_number());
+            }
+            throw malformed_json_exc_t();
+        }
+    }
+
+private:
+    datum_t parse_array() {
+        ++p;
+        std::vector<datum_t> array;
+        skip_whitespace();
+        if (p != end_ && *p == ']') {
+            ++p;
+        } else {
+            for (;;) {
+                array.push_back(parse_value());
+                skip_whitespace();
+                if (p == end_) throw malformed_json_exc_t();
+                if (*p == ']') {
+                    ++p;
+                    break;
+                }
+                if (*p != ',') throw malformed_json_exc_t();
+                ++p;
+            }
+        }
+        return datum_t(std::move(array), limits_);
+    }
+
+    datum_t parse_object() {
+        ++p;
+        datum_object_builder_t builder;
+        skip_whitespace();
+        if (p != end_ && *p == '}') {
+            ++p;
+        } else {
+            for (;;) {
+                skip_whitespace();
+                datum_string_t key = parse_string(true);
+                skip_whitespace();
+                if (p == end_ || *p != ':') throw malformed_json_exc_t();
+                ++p;
+                datum_t value = parse_value();
+                bool dup = builder.add(key, std::move(value));
+                rcheck_datum(!dup, base_exc_t::GENERIC,
+                             strprintf("Duplicate key `%s` in JSON.",
+                                       key.to_std().c_str()));
+                skip_whitespace();
+                if (p == end_) throw malformed_json_exc_t();
+                if (*p == '}') {
+                    ++p;
+                    break;
+                }
+                if (*p != ',') throw malformed_json_exc_t();
+                ++p;
+            }
+        }
+        return std::move(builder).to_datum(allowed_pts_);
+    }
+
+    // Object keys repeat a lot, so we intern them.
+    datum_string_t parse_string(bool is_key) {
+        if (p == end_ || *p != '"') throw malformed_json_exc_t();
+        ++p;
+        // Most strings have no escapes, so we build them straight from the input.
+        const char *run = find_quote_or_backslash(p);
+        if (run == end_ || *run == '"') {
+            datum_string_t str = is_key
+                ? intern_datum_string(run - p, p)
+                : datum_string_t(run - p, p);
+            // An unterminated string is fine; cJSON just stops at the end.
+            p = run == end_ ? run : run + 1;
+            return str;
+        }
+
+        scratch_.assign(p, run - p);
+        p = run;
+        while (p != end_ && *p == '\\') {
+            ++p;
+            if (p == end_) {
+                // cJSON reads past the terminator here; we stop instead.
+                throw malformed_json_exc_t();
+            }
+            switch (*p) {
+            case 'b': scratch_.push_back('\b'); break;
+            case 'f': scratch_.push_back('\f'); break;
+            case 'n': scratch_.push_back('\n'); break;
+            case 'r': scratch_.push_back('\r'); break;
+            case 't': scratch_.push_back('\t'); break;
+            case 'u': parse_unicode_escape(); break;
+            default: scratch_.push_back(*p); break;
+            }
+            ++p;
+            run = find_quote_or_backslash(p);
+            scratch_.append(p, run - p);
+            p = run;
+        }
+        if (p != end_) {
+            ++p;
+        }
+        return is_key
+            ? intern_datum_string(scratch_.size(), scratch_.data())
+            : datum_string_t(scratch_.size(), scratch_.data());
+    }
+
+    // Called with `p` at the `u` of a `\u` escape, and leaves it at the escape's
+    // last character.
+    void parse_unicode_escape() {
+        unsigned uc = parse_hex4(p + 1);
+        p += 4;
+        if ((uc >= 0xDC00 && uc <= 0xDFFF) || uc == 0) {
+            throw malformed_json_exc_t();
+        }
+        if (uc >= 0xD800 && uc <= 0xDBFF) {
+            // A UTF-16 surrogate pair.  cJSON drops the character if the second
+            // half is missing or invalid.
+            if (end_ - p < 3 || p[1] != '\\' || p[2] != 'u') {
+                return;
+            }
+            if (end_ - p < 7) {
+                throw malformed_json_exc_t();
+            }
+            unsigned uc2 = parse_hex4(p + 3);
+            p += 6;
+            if (uc2 < 0xDC00 || uc2 > 0xDFFF) {
+                return;
+            }
+            uc = 0x10000 + (((uc & 0x3FF) << 10) | (uc2 & 0x3FF));
+        }
+        append_utf8(uc);
+    }
+
+    // Returns 0 (which is never a valid escape) if the digits are missing or
+    // invalid.
+    unsigned parse_hex4(const char *str) const {
+        if (end_ - str < 4) {
+            return 0;
+        }
+        unsigned h = 0;
+        for (int i = 0; i < 4; ++i) {
+            h <<= 4;
+            if (str[i] >= '0' && str[i] <= '9') {
+                h += str[i] - '0';
+            } else if (str[i] >= 'A' && str[i] <= 'F') {
+                h += 10 + str[i] - 'A';
+            } else if (str[i] >= 'a' && str[i] <= 'f') {
+                h += 10 + str[i] - 'a';
+            } else {
+                return 0;
+            }
+        }
+        return h;
+    }
+
+    void append_utf8(unsigned uc) {
+        if (uc < 0x80) {
+            scratch_.push_back(uc);
+        } else if (uc < 0x800) {
+            scratch_.push_back(0xC0 | (uc >> 6));
+            scratch_.push_back(0x80 | (uc & 0x3F));
+        } else if (uc < 0x10000) {
+            scratch_.push_back(0xE0 | (uc >> 12));
+            scratch_.push_back(0x80 | ((uc >> 6) & 0x3F));
+            scratch_.push_back(0x80 | (uc & 0x3F));
+        } else {
+            scratch_.push_back(0xF0 | (uc >> 18));
+            scratch_.push_back(0x80 | ((uc >> 12) & 0x3F));
+            scratch_.push_back(0x80 | ((uc >> 6) & 0x3F));
+            scratch_.push_back(0x80 | (uc & 0x3F));
+        }
+    }
+
+    // Returns the first `"` or `\` at or after `s`, or `end_`.  String contents are
+    // most of the bytes in a typical document, so this looks at 16 bytes at a time
+    // when it can.
+    const char *find_quote_or_backslash(const char *s) const {
+#ifdef __SSE2__
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        while (end_ - s >= 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+            int mask = _mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                             _mm_cmpeq_epi8(chunk, backslash)));
+            if (mask != 0) {
+                return s + __builtin_ctz(mask);
+            }
+            s += 16;
+        }
+#endif
+        while (s != end_ && *s != '"' && *s != '\\') {
+            ++s;
+        }
+        return s;
+    }
+
+    // Same as cJSON's `parse_number`, which is `strtod` except for hexadecimal
+    // numbers.  Our input isn't NUL-terminated, so we hand `strtod` a copy of the
+    // longest run of characters it could possibly consume.
+    double parse_number() {
+        if (end_ - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+            ++p;
+            return 0;
+        }
+        const char *run = p;
+        while (run != end_ && (isalnum(static_cast<unsigned char>(*run))
+                               || *run == '.' || *run == '+' || *run == '-')) {
+            ++run;
+        }
+        char buf[64];
+        const char *num;
+        if (static_cast<size_t>(run - p) < sizeof(buf)) {
+            memcpy(buf, p, run - p);
+            buf[run - p] = '\0';
+            num = buf;
+        } else {
+            scratch_.assign(p, run - p);
+            num = scratch_.c_str();
+        }
+        char *num_end;
+        double d = strtod(num, &num_end);
+        if (num_end == num) throw malformed_json_exc_t();
+        p += num_end - num;
+        return d;
+    }
+
+    bool skip_literal(const char *literal) {
+        size_t len = strlen(literal);
+        if (static_cast<size_t>(end_ - p) < len || memcmp(p, literal, len) != 0) {
+            return false;
+        }
+        p += len;
+        return true;
+    }
+
+    // cJSON treats every byte up to 32 as whitespace.
+    void skip_whitespace() {
+        while (p != end_ && static_cast<unsigned char>(*p) <= 32) {
+            ++p;
+        }
+    }
+
+    const char *p;
+    const char *const end_;
+    const configured_limits_t &limits_;
+    const std::set<std::string> allowed_pts_;
+    // Holds strings that need unescaping.
+    std::string scratch_;
+
+    DISABLE_COPYING(json_parser_t);
+};
+
+}  // namespace
+
+bool parse_json(const char *json, size_t size,
+                const configured_limits_t &limits, datum_t *out) {
+    const char *nul = static_cast<const char *>(memchr(json, '\0', size));
+    json_parser_t parser(json, nul != NULL ? nul : json + size, limits);
+    try {
+        *out = parser.parse_value();
+        return true;
+    } catch (const malformed_json_exc_t &) {
+        return false;
+    }
+}
+
+}  // namespace ql
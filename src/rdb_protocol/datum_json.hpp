@@ -0,0 +1,25 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_DATUM_JSON_HPP_
+#define RDB_PROTOCOL_DATUM_JSON_HPP_
+
+#include <stddef.h>
+
+#include "errors.hpp"
+
+namespace ql {
+
+class configured_limits_t;
+class datum_t;
+
+/* Parses `size` bytes of JSON straight into a datum, without building a cJSON tree
+first.  It accepts exactly the documents that `cJSON_Parse` accepts (so trailing
+garbage is ignored, and a NUL byte ends the input) and produces the same datum that
+`to_datum` would produce from the cJSON tree.  Returns false if the JSON is
+malformed.  Throws like `to_datum` if the JSON is well-formed but isn't a valid
+datum (e.g. it has duplicate keys or too big an array). */
+MUST_USE bool parse_json(const char *json, size_t size,
+                         const configured_limits_t &limits, datum_t *out);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_DATUM_JSON_HPP_
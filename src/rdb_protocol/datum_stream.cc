@@ -7,6 +7,7 @@
 #include "rdb_protocol/batching.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
+#include "rdb_protocol/pseudo_geometry.hpp"
 #include "rdb_protocol/term.hpp"
 #include "rdb_protocol/val.hpp"
 #include "utils.hpp"
@@ -914,6 +915,62 @@ ordered_distinct_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &b
     return ret;
 }
 
+// EQ_JOIN_DATUM_STREAM_T
+eq_join_datum_stream_t::eq_join_datum_stream_t(counted_t<datum_stream_t> _source,
+                                               counted_t<const func_t> _left_attr,
+                                               counted_t<table_t> _table)
+    : wrapper_datum_stream_t(_source), left_attr(_left_attr), table(_table) {
+    guarantee(left_attr.has() && table.has() && source.has());
+}
+
+std::vector<datum_t>
+eq_join_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &bs) {
+    std::vector<datum_t> ret;
+    profile::sampler_t sampler("Eq join.", env->trace);
+    while (ret.size() == 0) {
+        std::vector<datum_t> v = source->next_batch(env, bs);
+        if (v.size() == 0) break;
+        std::vector<datum_t> lefts;
+        std::vector<datum_t> keys;
+        lefts.reserve(v.size());
+        keys.reserve(v.size());
+        for (auto &&el : v) {
+            if (el.get_type() == datum_t::R_NULL) {
+                continue;
+            }
+            datum_t key;
+            try {
+                key = left_attr->call(env, el)->as_datum();
+            } catch (const base_exc_t &e) {
+                // Rows without the join field don't join with anything.
+                if (e.get_type() == base_exc_t::NON_EXISTENCE) {
+                    continue;
+                }
+                throw;
+            }
+            rcheck(!key.is_ptype(pseudo::geometry_string),
+                   base_exc_t::GENERIC,
+                   "Cannot use a geospatial index with `get_all`. "
+                   "Use `get_intersecting` instead.");
+            lefts.push_back(std::move(el));
+            keys.push_back(std::move(key));
+        }
+        std::vector<datum_t> rights = table->get_rows(env, keys);
+        r_sanity_check(rights.size() == lefts.size());
+        for (size_t i = 0; i < lefts.size(); ++i) {
+            if (rights[i].get_type() != datum_t::R_NULL) {
+                datum_object_builder_t pair;
+                bool conflict = pair.add("left", std::move(lefts[i]))
+                    || pair.add("right", std::move(rights[i]));
+                guarantee(!conflict);
+                ret.push_back(std::move(pair).to_datum());
+            }
+            sampler.new_sample();
+        }
+    }
+    return ret;
+}
+
 // INDEXES_OF_DATUM_STREAM_T
 indexes_of_datum_stream_t::indexes_of_datum_stream_t(counted_t<const func_t> _f,
                                                      counted_t<datum_stream_t> _source)
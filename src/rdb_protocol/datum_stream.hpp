@@ -27,6 +27,7 @@ namespace ql {
 class env_t;
 class scope_env_t;
 class func_t;
+class table_t;
 
 class datum_stream_t : public single_threaded_countable_t<datum_stream_t>,
                        public pb_rcheckable_t {
@@ -156,6 +157,22 @@ private:
     datum_t last_val;
 };
 
+// Joins each row of `source` with the row of `table` whose primary key is
+// `left_attr` of it.  Looks up a whole batch of left rows with one read, and
+// emits `{left: ..., right: ...}` objects in the order of the left rows.
+class eq_join_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    eq_join_datum_stream_t(counted_t<datum_stream_t> _source,
+                           counted_t<const func_t> _left_attr,
+                           counted_t<table_t> _table);
+private:
+    std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    counted_t<const func_t> left_attr;
+    counted_t<table_t> table;
+};
+
 class array_datum_stream_t : public eager_datum_stream_t {
 public:
     array_datum_stream_t(datum_t _arr,
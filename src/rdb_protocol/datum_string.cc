@@ -12,8 +12,12 @@
 #include "containers/archive/varint.hpp"
 #include "containers/scoped.hpp"
 #include "debug.hpp"
+#include "thread_local.hpp"
 #include "utils.hpp"
 
+static_assert(sizeof(shared_buf_ref_t<char>) >= datum_string_t::max_inline_size + 1,
+              "datum_string_t::max_inline_size doesn't fit in a shared_buf_ref_t.");
+
 datum_string_t::datum_string_t() {
     init(0, "");
 }
@@ -36,15 +40,76 @@ datum_string_t::datum_string_t(const std::string &str) {
     init(str.size(), str.data());
 }
 
+datum_string_t::datum_string_t(const datum_string_t &copyee) {
+    assign_copy(copyee);
+}
+
+datum_string_t::datum_string_t(datum_string_t &&movee) noexcept {
+    assign_move(std::move(movee));
+}
+
+datum_string_t &datum_string_t::operator=(const datum_string_t &copyee) {
+    if (this != &copyee) {
+        destruct();
+        assign_copy(copyee);
+    }
+    return *this;
+}
+
+datum_string_t &datum_string_t::operator=(datum_string_t &&movee) noexcept {
+    if (this != &movee) {
+        destruct();
+        assign_move(std::move(movee));
+    }
+    return *this;
+}
+
+datum_string_t::~datum_string_t() {
+    destruct();
+}
+
+void datum_string_t::assign_copy(const datum_string_t &copyee) {
+    if (copyee.is_inline()) {
+        memcpy(inline_, copyee.inline_, sizeof(inline_));
+    } else {
+        new (&data_) shared_buf_ref_t<char>(copyee.data_);
+    }
+}
+
+void datum_string_t::assign_move(datum_string_t &&movee) noexcept {
+    if (movee.is_inline()) {
+        memcpy(inline_, movee.inline_, sizeof(inline_));
+    } else {
+        new (&data_) shared_buf_ref_t<char>(std::move(movee.data_));
+        movee.data_.~shared_buf_ref_t<char>();
+    }
+    // Leave `movee` an empty string rather than a null buffer.
+    movee.inline_[0] = 1;
+}
+
+void datum_string_t::destruct() {
+    if (!is_inline()) {
+        data_.~shared_buf_ref_t<char>();
+    }
+}
+
 void datum_string_t::init(size_t _size, const char *_data) {
+    if (_size <= max_inline_size) {
+        inline_[0] = static_cast<char>((_size << 1) | 1);
+        memcpy(inline_ + 1, _data, _size);
+        return;
+    }
     const size_t str_offset = varint_uint64_serialized_size(_size);
     counted_t<shared_buf_t> data = shared_buf_t::create(str_offset + _size);
     serialize_varint_uint64_into_buf(_size, reinterpret_cast<uint8_t *>(data->data()));
     memcpy(data->data() + str_offset, _data, _size);
-    data_ = shared_buf_ref_t<char>(std::move(data), 0);
+    new (&data_) shared_buf_ref_t<char>(std::move(data), 0);
 }
 
 const char *datum_string_t::data() const {
+    if (is_inline()) {
+        return inline_ + 1;
+    }
     const size_t str_size = size();
     size_t data_offset = varint_uint64_serialized_size(str_size);
     data_.guarantee_in_boundary(data_offset + str_size);
@@ -52,6 +117,9 @@ const char *datum_string_t::data() const {
 }
 
 size_t datum_string_t::size() const {
+    if (is_inline()) {
+        return static_cast<uint8_t>(inline_[0]) >> 1;
+    }
     uint64_t res = 0;
     static_assert(sizeof(uint8_t) == sizeof(char), "sizeof(uint8_t) != sizeof(char)");
     buffer_read_stream_t data_stream(data_.get(), data_.get_safety_boundary());
@@ -125,6 +193,12 @@ std::string datum_string_t::to_std() const {
 datum_string_t concat(const datum_string_t &a, const datum_string_t &b) {
     const size_t a_size = a.size();
     const size_t b_size = b.size();
+    if (a_size + b_size <= datum_string_t::max_inline_size) {
+        char buf[datum_string_t::max_inline_size];
+        memcpy(buf, a.data(), a_size);
+        memcpy(buf + a_size, b.data(), b_size);
+        return datum_string_t(a_size + b_size, buf);
+    }
     const size_t str_offset = varint_uint64_serialized_size(a_size + b_size);
     counted_t<shared_buf_t> buf = shared_buf_t::create(str_offset + a_size + b_size);
     serialize_varint_uint64_into_buf(a_size + b_size,
@@ -134,6 +208,39 @@ datum_string_t concat(const datum_string_t &a, const datum_string_t &b) {
     return datum_string_t(shared_buf_ref_t<char>(std::move(buf), 0));
 }
 
+// Longer strings are rarely keys, and cost more to compare.
+const size_t max_interned_size = 64;
+const size_t intern_table_size = 1024;
+
+// A direct-mapped cache of recently interned strings, so that it doesn't grow.
+struct intern_table_t {
+    datum_string_t strings[intern_table_size];
+};
+
+// Each thread's table lives as long as the thread.
+TLS_with_init(intern_table_t *, intern_table, NULL);
+
+datum_string_t intern_datum_string(size_t size, const char *data) {
+    if (size <= datum_string_t::max_inline_size || size > max_interned_size) {
+        return datum_string_t(size, data);
+    }
+    intern_table_t *table = TLS_get_intern_table();
+    if (table == NULL) {
+        table = new intern_table_t();
+        TLS_set_intern_table(table);
+    }
+    // 64-bit FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= static_cast<uint8_t>(data[i]);
+        h *= 1099511628211ULL;
+    }
+    datum_string_t *slot = &table->strings[h % intern_table_size];
+    if (slot->size() != size || memcmp(slot->data(), data, size) != 0) {
+        *slot = datum_string_t(size, data);
+    }
+    return *slot;
+}
 
 void debug_print(printf_buffer_t *buf, const datum_string_t &s) {
     debug_print_quoted_string(buf, reinterpret_cast<const uint8_t *>(s.data()),
@@ -13,13 +13,23 @@
  * - it can contain any character, including '\0'
  *
  * Underneath `datum_string_t` uses a `shared_buf_ref_t`. This makes it
- * relatively cheap to copy.
+ * relatively cheap to copy.  Strings of up to `max_inline_size` characters that
+ * we copy in are instead stored inline, so that short strings (like most object
+ * keys) don't need an allocation, and copying them doesn't touch a refcount.
  */
 class datum_string_t {
 public:
+    static const size_t max_inline_size = 15;
+
     // Creates an empty datum_string_t
     datum_string_t();
 
+    datum_string_t(const datum_string_t &copyee);
+    datum_string_t(datum_string_t &&movee) noexcept;
+    datum_string_t &operator=(const datum_string_t &copyee);
+    datum_string_t &operator=(datum_string_t &&movee) noexcept;
+    ~datum_string_t();
+
     // Creates a datum_string_t with its content copied from _data
     datum_string_t(size_t _size, const char *_data);
 
@@ -59,13 +69,35 @@ private:
     void init(size_t _size, const char *_data);
     int compare(size_t other_size, const char *other_data) const;
 
-    // Contains the length of the string in varint encoding, followed by the actual
-    // string content.
-    shared_buf_ref_t<char> data_;
+    bool is_inline() const {
+        return (inline_[0] & 1) != 0;
+    }
+    void assign_copy(const datum_string_t &copyee);
+    void assign_move(datum_string_t &&movee) noexcept;
+    void destruct();
+
+    union {
+        // Contains the length of the string in varint encoding, followed by the
+        // actual string content.
+        shared_buf_ref_t<char> data_;
+        // A short string: its size times two plus one, followed by its content.
+        // The low bit tells it apart from `data_`, which starts with an aligned
+        // pointer.
+        char inline_[sizeof(shared_buf_ref_t<char>)];
+    };
 };
 
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "datum_string_t's inline strings assume a little-endian pointer layout."
+#endif
+
 datum_string_t concat(const datum_string_t &a, const datum_string_t &b);
 
+// Returns a string equal to the given one.  Object keys of 16 characters or so
+// repeat a lot, so the ones we've recently seen on this thread share a buffer
+// instead of allocating their own.
+datum_string_t intern_datum_string(size_t size, const char *data);
+
 void debug_print(printf_buffer_t *buf, const datum_string_t &s);
 
 #endif  // RDB_PROTOCOL_DATUM_STRING_HPP_
@@ -55,6 +55,10 @@ scoped_ptr_t<profile::trace_t> maybe_make_profile_trace(profile_bool_t profile);
 struct query_cache_t {
     explicit query_cache_t(size_t cache_size) : regex_cache(cache_size) {}
     lru_cache_t<std::string, std::shared_ptr<re2::RE2> > regex_cache;
+    // The indexes `filter` can read, by table, so a query that filters the same
+    // table many times only looks them up once.
+    std::map<std::pair<uuid_u, std::string>,
+             std::map<datum_string_t, std::string> > filter_indexes;
 };
 
 class env_t : public home_thread_mixin_t {
@@ -155,8 +159,14 @@ private:
 class compile_env_t {
 public:
     explicit compile_env_t(var_visibility_t &&_visibility)
-        : visibility(std::move(_visibility)) { }
+        : visibility(std::move(_visibility)),
+          limited_order_by(NULL),
+          order_by_limit(0) { }
     var_visibility_t visibility;
+    // While we compile `order_by(...).limit(n)` with a literal `n`, the `order_by`
+    // and `n`, so that the `order_by` knows it only has to keep `n` rows.
+    const Term *limited_order_by;
+    size_t order_by_limit;
 };
 
 // This is an environment for evaluating things that use variables in scope.  It
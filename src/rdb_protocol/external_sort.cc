@@ -0,0 +1,340 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/external_sort.hpp"
+
+#include <algorithm>
+
+#include "containers/uuid.hpp"
+#include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
+
+namespace ql {
+
+// Once this many runs on disk have been merged the same number of times, we merge
+// them into one, so that a sort doesn't hold too many files (each with its own
+// cache) open.
+const size_t sorted_run_fan_in = 16;
+// How many rows we push onto a run in one transaction.
+const size_t sorted_run_push_size = 1000;
+
+sort_order_t::sort_order_t(
+        std::vector<std::pair<sort_direction_t, counted_t<const func_t> > >
+            _comparisons)
+    : comparisons(std::move(_comparisons)) { }
+
+datum_t sort_order_t::eval_ordering(env_t *env, size_t i, const datum_t &row) const {
+    try {
+        return comparisons[i].second->call(env, row)->as_datum();
+    } catch (const base_exc_t &e) {
+        if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+            throw;
+        }
+    }
+    return datum_t();
+}
+
+int sort_order_t::cmp_ordering(env_t *env, size_t i,
+                               const datum_t &l, const datum_t &r) const {
+    int cmp;
+    if (!l.has() || !r.has()) {
+        // Rows without the field come first.
+        cmp = static_cast<int>(r.has()) - static_cast<int>(l.has());
+    } else {
+        cmp = l.cmp(env->reql_version(), r);
+    }
+    return comparisons[i].first == sort_direction_t::DESC ? -cmp : cmp;
+}
+
+std::vector<datum_t> sort_order_t::key(env_t *env, const datum_t &row) const {
+    std::vector<datum_t> res;
+    res.reserve(comparisons.size());
+    for (size_t i = 0; i < comparisons.size(); ++i) {
+        res.push_back(eval_ordering(env, i, row));
+    }
+    return res;
+}
+
+bool sort_order_t::key_lt(env_t *env,
+                          const std::vector<datum_t> &l,
+                          const std::vector<datum_t> &r) const {
+    for (size_t i = 0; i < comparisons.size(); ++i) {
+        const int cmp = cmp_ordering(env, i, l[i], r[i]);
+        if (cmp != 0) {
+            return cmp < 0;
+        }
+    }
+    return false;
+}
+
+bool sort_order_t::operator()(env_t *env,
+                              profile::sampler_t *sampler,
+                              const datum_t &l,
+                              const datum_t &r) const {
+    sampler->new_sample();
+    for (size_t i = 0; i < comparisons.size(); ++i) {
+        const int cmp = cmp_ordering(env, i,
+                                     eval_ordering(env, i, l),
+                                     eval_ordering(env, i, r));
+        if (cmp != 0) {
+            return cmp < 0;
+        }
+    }
+    return false;
+}
+
+sorted_runs_merger_t::sorted_runs_merger_t(
+        const sort_order_t *_order,
+        std::vector<scoped_ptr_t<sorted_run_t> > &&_runs,
+        std::vector<keyed_row_t> &&_last_run)
+    : order(_order),
+      runs(std::move(_runs)),
+      last_run(std::move(_last_run)),
+      last_run_index(0),
+      heads(runs.size() + 1),
+      started(false) { }
+
+void sorted_runs_merger_t::advance(env_t *env, size_t run) {
+    keyed_row_t *head = &heads[run];
+    if (run < runs.size()) {
+        if (runs[run]->empty()) {
+            head->row = datum_t();
+        } else {
+            runs[run]->pop(&head->row);
+            head->key = order->key(env, head->row);
+        }
+    } else if (last_run_index < last_run.size()) {
+        *head = std::move(last_run[last_run_index++]);
+    } else {
+        head->row = datum_t();
+    }
+}
+
+datum_t sorted_runs_merger_t::next(env_t *env, profile::sampler_t *sampler) {
+    if (!started) {
+        for (size_t i = 0; i < heads.size(); ++i) {
+            advance(env, i);
+        }
+        started = true;
+    }
+    // There are few enough runs that a heap wouldn't save much, and this way the
+    // earlier run wins ties without another comparison.
+    size_t min = heads.size();
+    for (size_t i = 0; i < heads.size(); ++i) {
+        if (heads[i].row.has()
+            && (min == heads.size()
+                || order->key_lt(env, heads[i].key, heads[min].key))) {
+            min = i;
+        }
+    }
+    if (min == heads.size()) {
+        return datum_t();
+    }
+    sampler->new_sample();
+    datum_t res = std::move(heads[min].row);
+    advance(env, min);
+    return res;
+}
+
+bool sorted_runs_merger_t::is_exhausted() const {
+    if (!started) {
+        for (auto it = runs.begin(); it != runs.end(); ++it) {
+            if (!(*it)->empty()) {
+                return false;
+            }
+        }
+        return last_run.empty();
+    }
+    for (auto it = heads.begin(); it != heads.end(); ++it) {
+        if (it->row.has()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+merge_sort_datum_stream_t::merge_sort_datum_stream_t(
+        scoped_ptr_t<sort_order_t> &&_order,
+        std::vector<scoped_ptr_t<sorted_run_t> > &&runs,
+        std::vector<keyed_row_t> &&last_run,
+        const protob_t<const Backtrace> &bt_src)
+    : eager_datum_stream_t(bt_src),
+      order(std::move(_order)),
+      merger(order.get(), std::move(runs), std::move(last_run)) { }
+
+bool merge_sort_datum_stream_t::is_exhausted() const {
+    return merger.is_exhausted() && batch_cache_exhausted();
+}
+
+std::vector<datum_t>
+merge_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+    std::vector<datum_t> ret;
+    batcher_t batcher = batchspec.to_batcher();
+
+    profile::sampler_t sampler("Merging sorted runs.", env->trace);
+    datum_t d;
+    while (!batcher.should_send_batch() && (d = merger.next(env, &sampler), d.has())) {
+        batcher.note_el(d);
+        ret.push_back(std::move(d));
+    }
+    return ret;
+}
+
+external_sorter_t::external_sorter_t(env_t *env,
+                                     sort_order_t _order,
+                                     boost::optional<size_t> _limit)
+    : order(make_scoped<sort_order_t>(std::move(_order))),
+      io_backender(env->get_rdb_ctx() != NULL
+                   ? env->get_rdb_ctx()->io_backender
+                   : NULL),
+      base_path(env->get_rdb_ctx() != NULL
+                ? env->get_rdb_ctx()->base_path
+                : base_path_t("")),
+      stats(env->get_rdb_ctx() != NULL
+            ? &env->get_rdb_ctx()->ql_stats_collection
+            : NULL),
+      run_size(env->limits().array_size_limit()),
+      // A limit past what fits in memory doesn't save us anything.
+      limit(_limit && *_limit <= run_size ? _limit : boost::none),
+      num_added(0) { }
+
+bool external_sorter_t::row_lt(env_t *env,
+                               const keyed_row_t &l,
+                               const keyed_row_t &r) const {
+    if (order->key_lt(env, l.key, r.key)) {
+        return true;
+    } else if (order->key_lt(env, r.key, l.key)) {
+        return false;
+    }
+    return l.position < r.position;
+}
+
+void external_sorter_t::add(env_t *env, std::vector<datum_t> &&rows) {
+    profile::sampler_t sampler("Computing sort keys.", env->trace);
+    for (auto it = rows.begin(); it != rows.end(); ++it) {
+        keyed_row_t row;
+        row.key = order->key(env, *it);
+        row.row = std::move(*it);
+        row.position = num_added++;
+        sampler.new_sample();
+        if (limit) {
+            add_to_heap(env, std::move(row));
+            continue;
+        }
+        // We spill only once we know there's more than one run's worth of rows, so
+        // that whatever fits in memory gets sorted there.
+        if (io_backender != NULL && unsorted.size() == run_size) {
+            spill(env);
+        }
+        unsorted.push_back(std::move(row));
+    }
+}
+
+void external_sorter_t::add_to_heap(env_t *env, keyed_row_t &&row) {
+    // `unsorted` is a heap with the greatest row we're keeping on top.
+    auto lt = std::bind(&external_sorter_t::row_lt, this, env,
+                        std::placeholders::_1, std::placeholders::_2);
+    if (unsorted.size() < *limit) {
+        unsorted.push_back(std::move(row));
+        std::push_heap(unsorted.begin(), unsorted.end(), lt);
+    } else if (!unsorted.empty() && lt(row, unsorted.front())) {
+        std::pop_heap(unsorted.begin(), unsorted.end(), lt);
+        unsorted.back() = std::move(row);
+        std::push_heap(unsorted.begin(), unsorted.end(), lt);
+    }
+}
+
+counted_t<datum_stream_t> external_sorter_t::finish(
+        env_t *env, const protob_t<const Backtrace> &bt) {
+    if (limit) {
+        std::sort_heap(unsorted.begin(), unsorted.end(),
+                       std::bind(&external_sorter_t::row_lt, this, env,
+                                 std::placeholders::_1, std::placeholders::_2));
+    } else {
+        sort_in_memory(env);
+    }
+    if (runs.empty()) {
+        std::vector<datum_t> rows;
+        rows.reserve(unsorted.size());
+        for (auto it = unsorted.begin(); it != unsorted.end(); ++it) {
+            rows.push_back(std::move(it->row));
+        }
+        return make_counted<array_datum_stream_t>(
+            datum_t(std::move(rows), env->limits()), bt);
+    }
+    return make_counted<merge_sort_datum_stream_t>(
+        std::move(order), std::move(runs), std::move(unsorted), bt);
+}
+
+void external_sorter_t::sort_in_memory(env_t *env) {
+    profile::sampler_t sampler("Sorting in-memory.", env->trace);
+    std::stable_sort(unsorted.begin(), unsorted.end(),
+                     [&](const keyed_row_t &l, const keyed_row_t &r) {
+                         sampler.new_sample();
+                         return order->key_lt(env, l.key, r.key);
+                     });
+}
+
+void external_sorter_t::spill(env_t *env) {
+    sort_in_memory(env);
+    sorted_runs_merger_t merger(order.get(),
+                                std::vector<scoped_ptr_t<sorted_run_t> >(),
+                                std::move(unsorted));
+    unsorted.clear();
+    profile::sampler_t sampler("Spilling sorted rows to disk.", env->trace);
+    runs.push_back(write_run(&merger, env, &sampler));
+    run_levels.push_back(0);
+    collapse_runs(env);
+}
+
+void external_sorter_t::collapse_runs(env_t *env) {
+    while (runs.size() >= sorted_run_fan_in) {
+        const size_t first = runs.size() - sorted_run_fan_in;
+        const size_t level = run_levels.back();
+        if (run_levels[first] != level) {
+            break;
+        }
+        // These are the last runs, so they take the rows that compare equal in the
+        // order they came in.
+        std::vector<scoped_ptr_t<sorted_run_t> > to_merge;
+        for (size_t i = first; i < runs.size(); ++i) {
+            to_merge.push_back(std::move(runs[i]));
+        }
+        runs.erase(runs.begin() + first, runs.end());
+        run_levels.erase(run_levels.begin() + first, run_levels.end());
+
+        sorted_runs_merger_t merger(order.get(), std::move(to_merge),
+                                    std::vector<keyed_row_t>());
+        profile::sampler_t sampler("Merging sorted runs on disk.", env->trace);
+        runs.push_back(write_run(&merger, env, &sampler));
+        run_levels.push_back(level + 1);
+    }
+}
+
+scoped_ptr_t<sorted_run_t> external_sorter_t::write_run(sorted_runs_merger_t *merger,
+                                                        env_t *env,
+                                                        profile::sampler_t *sampler) {
+    scoped_ptr_t<sorted_run_t> run = make_run();
+    std::vector<datum_t> chunk;
+    datum_t d;
+    while (d = merger->next(env, sampler), d.has()) {
+        chunk.push_back(std::move(d));
+        if (chunk.size() == sorted_run_push_size) {
+            run->push(chunk);
+            chunk.clear();
+        }
+    }
+    if (!chunk.empty()) {
+        run->push(chunk);
+    }
+    return run;
+}
+
+scoped_ptr_t<sorted_run_t> external_sorter_t::make_run() {
+    guarantee(io_backender != NULL);
+    return make_scoped<sorted_run_t>(
+        io_backender,
+        serializer_filepath_t(base_path, "sort_" + uuid_to_str(generate_uuid())),
+        stats);
+}
+
+}  // namespace ql
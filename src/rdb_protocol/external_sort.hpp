@@ -0,0 +1,170 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_EXTERNAL_SORT_HPP_
+#define RDB_PROTOCOL_EXTERNAL_SORT_HPP_
+
+#include <utility>
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/optional.hpp>
+
+#include "containers/disk_backed_queue.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+
+namespace ql {
+
+enum class sort_direction_t { ASC, DESC };
+
+// The orderings of an `order_by`.
+class sort_order_t {
+public:
+    explicit sort_order_t(
+        std::vector<std::pair<sort_direction_t, counted_t<const func_t> > >
+            _comparisons);
+
+    // The values of the orderings for `row` (uninitialized for missing fields), so
+    // that sorting calls the ordering functions once per row rather than on every
+    // comparison.
+    std::vector<datum_t> key(env_t *env, const datum_t &row) const;
+    bool key_lt(env_t *env,
+                const std::vector<datum_t> &l,
+                const std::vector<datum_t> &r) const;
+
+    // Compares rows directly, evaluating only as many orderings as it needs to.
+    bool operator()(env_t *env,
+                    profile::sampler_t *sampler,
+                    const datum_t &l,
+                    const datum_t &r) const;
+
+    bool empty() const { return comparisons.empty(); }
+
+private:
+    datum_t eval_ordering(env_t *env, size_t i, const datum_t &row) const;
+    // Returns how `l` compares to `r` in ordering `i`, taking its direction into
+    // account.
+    int cmp_ordering(env_t *env, size_t i, const datum_t &l, const datum_t &r) const;
+
+    std::vector<std::pair<sort_direction_t, counted_t<const func_t> > > comparisons;
+};
+
+struct keyed_row_t {
+    std::vector<datum_t> key;
+    datum_t row;
+    // Where the row came in, which breaks ties.
+    uint64_t position;
+};
+
+typedef disk_backed_queue_t<datum_t> sorted_run_t;
+
+// Merges sorted runs, the last of which is in memory.  Rows that compare equal
+// come out in the order of their runs, so merging the runs of a stable sort is
+// stable.
+class sorted_runs_merger_t {
+public:
+    sorted_runs_merger_t(const sort_order_t *_order,
+                         std::vector<scoped_ptr_t<sorted_run_t> > &&_runs,
+                         std::vector<keyed_row_t> &&_last_run);
+
+    // Returns an uninitialized datum once all the runs are exhausted.
+    datum_t next(env_t *env, profile::sampler_t *sampler);
+    bool is_exhausted() const;
+
+private:
+    void advance(env_t *env, size_t run);
+
+    const sort_order_t *const order;
+    std::vector<scoped_ptr_t<sorted_run_t> > runs;
+    std::vector<keyed_row_t> last_run;
+    size_t last_run_index;
+    // The next row of each run, with the last run's at the end.  They're read (and
+    // get their keys) on the first call to `next`.
+    std::vector<keyed_row_t> heads;
+    bool started;
+
+    DISABLE_COPYING(sorted_runs_merger_t);
+};
+
+class merge_sort_datum_stream_t : public eager_datum_stream_t {
+public:
+    merge_sort_datum_stream_t(scoped_ptr_t<sort_order_t> &&_order,
+                              std::vector<scoped_ptr_t<sorted_run_t> > &&runs,
+                              std::vector<keyed_row_t> &&last_run,
+                              const protob_t<const Backtrace> &bt_src);
+
+private:
+    virtual bool is_array() { return false; }
+    virtual datum_t as_array(env_t *) { return datum_t(); }
+    virtual bool is_exhausted() const;
+    virtual bool is_cfeed() const { return false; }
+    virtual std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    // The merger points into this.
+    const scoped_ptr_t<sort_order_t> order;
+    sorted_runs_merger_t merger;
+};
+
+// Stably sorts sequences that might not fit in memory.  Rows are sorted in memory
+// in runs of up to the array size limit; once there's more than one run, they
+// are spilled to disk and merged back in the end.  Runs on disk of the same size
+// get merged into one bigger run as they pile up, so every row is rewritten once
+// per size rather than on every merge.  Without anywhere to spill to, it sorts in
+// memory up to the array size limit, as it always has.
+//
+// If only the first `limit` rows are wanted (and they fit in memory), it keeps just
+// those in a heap instead.
+class external_sorter_t {
+public:
+    external_sorter_t(env_t *env,
+                      sort_order_t _order,
+                      boost::optional<size_t> _limit);
+
+    // Whether the rows `add`ed so far must fit in the array size limit.
+    bool keeps_all_rows_in_memory() const {
+        return io_backender == NULL && !limit;
+    }
+
+    size_t runs_on_disk() const { return runs.size(); }
+
+    // Adds rows in the order they come in, which is the order of the rows that
+    // compare equal in the end.
+    void add(env_t *env, std::vector<datum_t> &&rows);
+
+    // Returns the sorted rows (the first `limit` of them, if given), as an array if
+    // they fit in memory.
+    counted_t<datum_stream_t> finish(env_t *env, const protob_t<const Backtrace> &bt);
+
+private:
+    void add_to_heap(env_t *env, keyed_row_t &&row);
+    void sort_in_memory(env_t *env);
+    void spill(env_t *env);
+    // Merges the runs at the end of `runs` while there are enough of the same size.
+    void collapse_runs(env_t *env);
+    scoped_ptr_t<sorted_run_t> write_run(sorted_runs_merger_t *merger,
+                                         env_t *env,
+                                         profile::sampler_t *sampler);
+    scoped_ptr_t<sorted_run_t> make_run();
+
+    // Orders by key, then by position.
+    bool row_lt(env_t *env, const keyed_row_t &l, const keyed_row_t &r) const;
+
+    scoped_ptr_t<sort_order_t> order;
+    io_backender_t *const io_backender;
+    const base_path_t base_path;
+    perfmon_collection_t *const stats;
+    const size_t run_size;
+    const boost::optional<size_t> limit;
+
+    uint64_t num_added;
+    std::vector<keyed_row_t> unsorted;
+    std::vector<scoped_ptr_t<sorted_run_t> > runs;
+    // How many times the rows of each run have been merged on disk, which never
+    // goes up from one run to the next.
+    std::vector<size_t> run_levels;
+
+    DISABLE_COPYING(external_sorter_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_EXTERNAL_SORT_HPP_
@@ -1,5 +1,6 @@
 #include "rdb_protocol/func.hpp"
 
+#include "rdb_protocol/batch_program.hpp"
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/minidriver.hpp"
@@ -140,6 +141,141 @@ void js_func_t::visit(func_visitor_t *visitor) const {
     visitor->on_js_func(this);
 }
 
+// Whether `t` is a use of the variable `var`.  A function with one argument makes
+// that argument the implicit variable, so we count `r.row` too (if it's some other
+// variable's `r.row`, we're only being pessimistic).
+bool is_use_of_var(const Term &t, sym_t var) {
+    if (t.type() == Term::IMPLICIT_VAR) {
+        return true;
+    }
+    return t.type() == Term::VAR
+        && t.args_size() == 1
+        && t.args(0).type() == Term::DATUM
+        && t.args(0).datum().type() == Datum::R_NUM
+        && t.args(0).datum().r_num() == static_cast<double>(var.value);
+}
+
+bool is_literal_string(const Term &t) {
+    return t.type() == Term::DATUM && t.datum().type() == Datum::R_STR;
+}
+
+// Adds the fields of `var` that `t` gets to `fields_out`.  Returns false if `t` uses
+// `var` in any other way.
+bool fields_of_var_used_by(const Term &t, sym_t var,
+                           std::set<datum_string_t> *fields_out) {
+    switch (t.type()) {
+    case Term::VAR: // fallthru
+    case Term::IMPLICIT_VAR:
+        return !is_use_of_var(t, var);
+    case Term::GET_FIELD: // fallthru
+    case Term::BRACKET:
+        if (t.args_size() == 2 && t.optargs_size() == 0
+            && is_use_of_var(t.args(0), var) && is_literal_string(t.args(1))) {
+            fields_out->insert(datum_string_t(t.args(1).datum().r_str()));
+            return true;
+        }
+        break;
+    case Term::PLUCK: // fallthru
+    case Term::HAS_FIELDS:
+        if (t.args_size() >= 2 && is_use_of_var(t.args(0), var)) {
+            for (int i = 1; i < t.args_size(); ++i) {
+                if (!is_literal_string(t.args(i))) {
+                    return false;
+                }
+                fields_out->insert(datum_string_t(t.args(i).datum().r_str()));
+            }
+            // Skip the argument we just looked at, but not the optargs.
+            for (int i = 0; i < t.optargs_size(); ++i) {
+                if (!fields_of_var_used_by(t.optargs(i).val(), var, fields_out)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        break;
+    default:
+        break;
+    }
+
+    for (int i = 0; i < t.args_size(); ++i) {
+        if (!fields_of_var_used_by(t.args(i), var, fields_out)) {
+            return false;
+        }
+    }
+    for (int i = 0; i < t.optargs_size(); ++i) {
+        if (!fields_of_var_used_by(t.optargs(i).val(), var, fields_out)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool reql_func_t::fields_used_by_arg(bool for_filter_call,
+                                     std::set<datum_string_t> *fields_out) const {
+    if (arg_names.size() != 1) {
+        return false;
+    }
+    const Term &src = *body->get_src();
+    if (for_filter_call) {
+        // `filter_helper` matches the row against an object body, which looks at
+        // the object's keys.
+        if (src.type() == Term::MAKE_OBJ) {
+            for (int i = 0; i < src.optargs_size(); ++i) {
+                if (src.optargs(i).key() == datum_t::reql_type_string.to_std()) {
+                    return false;
+                }
+                fields_out->insert(datum_string_t(src.optargs(i).key()));
+            }
+        } else if (src.type() == Term::DATUM) {
+            const Datum &d = src.datum();
+            if (d.type() == Datum::R_OBJECT) {
+                for (int i = 0; i < d.r_object_size(); ++i) {
+                    if (d.r_object(i).key() == datum_t::reql_type_string.to_std()) {
+                        return false;
+                    }
+                    fields_out->insert(datum_string_t(d.r_object(i).key()));
+                }
+            } else if (d.type() == Datum::R_JSON) {
+                return false;
+            }
+        }
+    }
+    return fields_of_var_used_by(src, arg_names[0], fields_out);
+}
+
+scoped_ptr_t<batch_program_t> reql_func_t::compile_batch_program() const {
+    if (arg_names.size() != 1) {
+        return scoped_ptr_t<batch_program_t>();
+    }
+    return batch_program_t::compile(*body->get_src(), arg_names[0]);
+}
+
+bool reql_func_t::returns_field_of_arg(datum_string_t *field_out) const {
+    if (arg_names.size() != 1) {
+        return false;
+    }
+    const Term &src = *body->get_src();
+    if ((src.type() == Term::GET_FIELD || src.type() == Term::BRACKET)
+        && src.args_size() == 2 && src.optargs_size() == 0
+        && is_use_of_var(src.args(0), arg_names[0]) && is_literal_string(src.args(1))) {
+        *field_out = datum_string_t(src.args(1).datum().r_str());
+        return true;
+    }
+    return false;
+}
+
+bool js_func_t::fields_used_by_arg(bool, std::set<datum_string_t> *) const {
+    return false;
+}
+
+scoped_ptr_t<batch_program_t> js_func_t::compile_batch_program() const {
+    return scoped_ptr_t<batch_program_t>();
+}
+
+bool js_func_t::returns_field_of_arg(datum_string_t *) const {
+    return false;
+}
+
 func_term_t::func_term_t(compile_env_t *env, const protob_t<const Term> &t)
     : term_t(t) {
     r_sanity_check(t.has());
@@ -3,6 +3,7 @@
 #define RDB_PROTOCOL_FUNC_HPP_
 
 #include <map>
+#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -23,6 +24,7 @@ class js_runner_t;
 
 namespace ql {
 
+class batch_program_t;
 class func_visitor_t;
 
 class func_t : public slow_atomic_countable_t<func_t>, public pb_rcheckable_t {
@@ -43,6 +45,22 @@ public:
 
     virtual void visit(func_visitor_t *visitor) const = 0;
 
+    // If the function takes one argument and only ever uses it to get fields with
+    // literal names (as in `row('a')` or `row.pluck('a', 'b')`), adds those names to
+    // `fields_out` and returns true.  Pass `for_filter_call` if the function is
+    // called through `filter_call`, which can look at more of the argument.
+    virtual bool fields_used_by_arg(bool for_filter_call,
+                                    std::set<datum_string_t> *fields_out) const = 0;
+
+    // If the function takes one argument and is simple enough for `batch_program_t`,
+    // compiles it into one.  Otherwise returns an empty pointer.
+    virtual scoped_ptr_t<batch_program_t> compile_batch_program() const = 0;
+
+    // If the function takes one argument and returns one of its fields with a literal
+    // name (as in `row('a')`, or the function of an index created by name), sets
+    // `*field_out` to that name and returns true.
+    virtual bool returns_field_of_arg(datum_string_t *field_out) const = 0;
+
     void assert_deterministic(const char *extra_msg) const;
 
     bool filter_call(env_t *env,
@@ -89,6 +107,13 @@ public:
 
     void visit(func_visitor_t *visitor) const;
 
+    bool fields_used_by_arg(bool for_filter_call,
+                            std::set<datum_string_t> *fields_out) const;
+
+    scoped_ptr_t<batch_program_t> compile_batch_program() const;
+
+    bool returns_field_of_arg(datum_string_t *field_out) const;
+
 private:
     template <cluster_version_t> friend class wire_func_serialization_visitor_t;
     bool filter_helper(env_t *env, datum_t arg) const;
@@ -126,6 +151,13 @@ public:
 
     void visit(func_visitor_t *visitor) const;
 
+    bool fields_used_by_arg(bool for_filter_call,
+                            std::set<datum_string_t> *fields_out) const;
+
+    scoped_ptr_t<batch_program_t> compile_batch_program() const;
+
+    bool returns_field_of_arg(datum_string_t *field_out) const;
+
 private:
     template <cluster_version_t> friend class wire_func_serialization_visitor_t;
     bool filter_helper(env_t *env, datum_t arg) const;
@@ -0,0 +1,226 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/join.hpp"
+
+#include <iterator>
+
+#include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/external_sort.hpp"
+#include "rdb_protocol/func.hpp"
+
+namespace ql {
+
+equi_join_datum_stream_t::equi_join_datum_stream_t(
+        env_t *env,
+        join_kind_t _kind,
+        counted_t<datum_stream_t> _left,
+        counted_t<const func_t> _left_key,
+        counted_t<datum_stream_t> _right,
+        counted_t<const func_t> _right_key,
+        const protob_t<const Backtrace> &bt_src)
+    : eager_datum_stream_t(bt_src),
+      kind(_kind),
+      left(std::move(_left)),
+      left_is_array(left->is_array()),
+      left_key(std::move(_left_key)),
+      right(std::move(_right)),
+      right_key(std::move(_right_key)),
+      state(state_t::START),
+      right_rows(optional_datum_less_t(env->reql_version())),
+      right_batch_index(0) {
+    guarantee(left.has() && left_key.has() && right.has() && right_key.has());
+}
+
+bool equi_join_datum_stream_t::is_exhausted() const {
+    return (state == state_t::DONE
+            || (state != state_t::START && left->is_exhausted()))
+        && batch_cache_exhausted();
+}
+
+std::vector<datum_t>
+equi_join_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+    std::vector<datum_t> ret;
+    while (ret.size() == 0 && state != state_t::DONE) {
+        std::vector<datum_t> left_rows;
+        if (state == state_t::START) {
+            left_rows = left->next_batch(env, batchspec);
+            // Like the nested loop, we don't look at the right side (or evaluate any
+            // keys) unless there's something on the left.
+            if (left_rows.size() != 0) {
+                start(env, batchspec, &left_rows);
+                if (kind == join_kind_t::INNER
+                    && state == state_t::IN_MEMORY
+                    && right_rows.empty()) {
+                    // Nothing on the left can match.
+                    left_rows.clear();
+                }
+            }
+        } else {
+            left_rows = left->next_batch(env, batchspec);
+        }
+        if (left_rows.size() == 0) {
+            state = state_t::DONE;
+            break;
+        }
+        if (state == state_t::IN_MEMORY) {
+            join_in_memory(env, std::move(left_rows), &ret);
+        } else {
+            join_sorted(env, std::move(left_rows), batchspec, &ret);
+        }
+    }
+    return ret;
+}
+
+void equi_join_datum_stream_t::start(env_t *env,
+                                     const batchspec_t &batchspec,
+                                     std::vector<datum_t> *first_left_rows) {
+    const size_t max_in_memory = env->limits().array_size_limit();
+    batchspec_t right_batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    std::vector<datum_t> rows;
+    for (;;) {
+        std::vector<datum_t> batch = right->next_batch(env, right_batchspec);
+        if (batch.size() == 0) {
+            break;
+        }
+        rows.insert(rows.end(),
+                    std::make_move_iterator(batch.begin()),
+                    std::make_move_iterator(batch.end()));
+        if (rows.size() > max_in_memory) {
+            sort_sides(env, std::move(rows), std::move(*first_left_rows), batchspec);
+            state = state_t::SORTED;
+            *first_left_rows = left->next_batch(env, batchspec);
+            return;
+        }
+    }
+
+    profile::sampler_t sampler("Keying the right side of a join.", env->trace);
+    for (auto &&row : rows) {
+        datum_t key = right_key->call(env, row)->as_datum();
+        right_rows[key].push_back(std::move(row));
+        sampler.new_sample();
+    }
+    state = state_t::IN_MEMORY;
+}
+
+void equi_join_datum_stream_t::sort_sides(env_t *env,
+                                          std::vector<datum_t> &&right_rows_so_far,
+                                          std::vector<datum_t> &&first_left_rows,
+                                          const batchspec_t &batchspec) {
+    batchspec_t sort_batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+
+    external_sorter_t right_sorter(
+        env,
+        sort_order_t({std::make_pair(sort_direction_t::ASC, right_key)}),
+        boost::none);
+    // The join term only gets here with somewhere to spill to.
+    r_sanity_check(!right_sorter.keeps_all_rows_in_memory());
+    right_sorter.add(env, std::move(right_rows_so_far));
+    for (;;) {
+        std::vector<datum_t> batch = right->next_batch(env, sort_batchspec);
+        if (batch.size() == 0) {
+            break;
+        }
+        right_sorter.add(env, std::move(batch));
+    }
+    right = right_sorter.finish(env, backtrace());
+
+    external_sorter_t left_sorter(
+        env,
+        sort_order_t({std::make_pair(sort_direction_t::ASC, left_key)}),
+        boost::none);
+    left_sorter.add(env, std::move(first_left_rows));
+    for (;;) {
+        std::vector<datum_t> batch = left->next_batch(env, batchspec);
+        if (batch.size() == 0) {
+            break;
+        }
+        left_sorter.add(env, std::move(batch));
+    }
+    left = left_sorter.finish(env, backtrace());
+}
+
+void equi_join_datum_stream_t::join_row(datum_t &&left_row,
+                                        const std::vector<datum_t> &matches,
+                                        std::vector<datum_t> *out) const {
+    if (matches.empty()) {
+        if (kind == join_kind_t::OUTER) {
+            datum_object_builder_t pair;
+            bool conflict = pair.add("left", std::move(left_row));
+            guarantee(!conflict);
+            out->push_back(std::move(pair).to_datum());
+        }
+        return;
+    }
+    for (auto it = matches.begin(); it != matches.end(); ++it) {
+        datum_object_builder_t pair;
+        bool conflict = pair.add("left", left_row) || pair.add("right", *it);
+        guarantee(!conflict);
+        out->push_back(std::move(pair).to_datum());
+    }
+}
+
+void equi_join_datum_stream_t::join_in_memory(env_t *env,
+                                              std::vector<datum_t> &&left_rows,
+                                              std::vector<datum_t> *out) {
+    profile::sampler_t sampler("Joining in memory.", env->trace);
+    const std::vector<datum_t> no_matches;
+    for (auto &&row : left_rows) {
+        if (right_rows.empty()) {
+            // The nested loop never evaluates the predicate here.
+            join_row(std::move(row), no_matches, out);
+            continue;
+        }
+        datum_t key = left_key->call(env, row)->as_datum();
+        auto it = right_rows.find(key);
+        join_row(std::move(row), it == right_rows.end() ? no_matches : it->second, out);
+        sampler.new_sample();
+    }
+}
+
+void equi_join_datum_stream_t::join_sorted(env_t *env,
+                                           std::vector<datum_t> &&left_rows,
+                                           const batchspec_t &batchspec,
+                                           std::vector<datum_t> *out) {
+    profile::sampler_t sampler("Merging the sides of a join.", env->trace);
+    for (auto &&row : left_rows) {
+        datum_t key = left_key->call(env, row)->as_datum();
+        if (!group_key.has() || group_key.cmp(env->reql_version(), key) != 0) {
+            // The left keys only go up, so we can drop the right rows with smaller
+            // keys as we look for the ones with this key.
+            group_key = key;
+            group.clear();
+            for (;;) {
+                if (!next_right.has()) {
+                    next_right = next_sorted_right(env, batchspec);
+                    if (!next_right.has()) {
+                        break;
+                    }
+                    next_right_key = right_key->call(env, next_right)->as_datum();
+                }
+                const int cmp = next_right_key.cmp(env->reql_version(), key);
+                if (cmp > 0) {
+                    break;
+                } else if (cmp == 0) {
+                    group.push_back(std::move(next_right));
+                }
+                next_right = datum_t();
+            }
+        }
+        join_row(std::move(row), group, out);
+        sampler.new_sample();
+    }
+}
+
+datum_t equi_join_datum_stream_t::next_sorted_right(env_t *env,
+                                                    const batchspec_t &batchspec) {
+    if (right_batch_index == right_batch.size()) {
+        right_batch = right->next_batch(env, batchspec);
+        right_batch_index = 0;
+        if (right_batch.size() == 0) {
+            return datum_t();
+        }
+    }
+    return std::move(right_batch[right_batch_index++]);
+}
+
+}  // namespace ql
@@ -0,0 +1,106 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_JOIN_HPP_
+#define RDB_PROTOCOL_JOIN_HPP_
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "rdb_protocol/datum_stream.hpp"
+#include "rdb_protocol/rdb_protocol_json.hpp"
+
+namespace ql {
+
+enum class join_kind_t { INNER, OUTER };
+
+// Joins the rows `l` of `left` with the rows `r` of `right` for which
+// `left_key(l) == right_key(r)`, emitting `{left: l, right: r}` for every match
+// (and `{left: l}` for the left rows of an outer join that match nothing).
+//
+// The right side is read first.  If it fits in the array size limit, it's kept in
+// memory keyed by `right_key`, and the left side streams past it, so the rows come
+// out in the same order as with a nested loop.  Otherwise, both sides get sorted
+// by their keys with `external_sorter_t`, which spills to disk, and are merged, so
+// the rows come out in the order of their keys.
+class equi_join_datum_stream_t : public eager_datum_stream_t {
+public:
+    equi_join_datum_stream_t(env_t *env,
+                             join_kind_t _kind,
+                             counted_t<datum_stream_t> _left,
+                             counted_t<const func_t> _left_key,
+                             counted_t<datum_stream_t> _right,
+                             counted_t<const func_t> _right_key,
+                             const protob_t<const Backtrace> &bt_src);
+
+private:
+    virtual bool is_array() { return left_is_array; }
+    virtual datum_t as_array(env_t *env) {
+        return left_is_array
+            ? eager_datum_stream_t::as_array(env)
+            : datum_t();
+    }
+    virtual bool is_exhausted() const;
+    virtual bool is_cfeed() const { return false; }
+    virtual std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    // Reads the right side once we have the first batch of the left side, and
+    // decides whether to join in memory or by merging.  When merging, it replaces
+    // `first_left_rows` with the first batch of the sorted left side.
+    void start(env_t *env,
+               const batchspec_t &batchspec,
+               std::vector<datum_t> *first_left_rows);
+    void sort_sides(env_t *env,
+                    std::vector<datum_t> &&right_rows_so_far,
+                    std::vector<datum_t> &&first_left_rows,
+                    const batchspec_t &batchspec);
+
+    // Appends the rows `left_row` joins into to `out`.
+    void join_row(datum_t &&left_row,
+                  const std::vector<datum_t> &matches,
+                  std::vector<datum_t> *out) const;
+    void join_in_memory(env_t *env,
+                        std::vector<datum_t> &&left_rows,
+                        std::vector<datum_t> *out);
+    void join_sorted(env_t *env,
+                     std::vector<datum_t> &&left_rows,
+                     const batchspec_t &batchspec,
+                     std::vector<datum_t> *out);
+    // Returns the next row of the sorted right side, or an uninitialized datum.
+    datum_t next_sorted_right(env_t *env, const batchspec_t &batchspec);
+
+    enum class state_t { START, IN_MEMORY, SORTED, DONE };
+
+    const join_kind_t kind;
+    counted_t<datum_stream_t> left;
+    // Whether the left side was an array to begin with, since sorting it replaces
+    // `left` with a stream.
+    const bool left_is_array;
+    const counted_t<const func_t> left_key;
+    counted_t<datum_stream_t> right;
+    const counted_t<const func_t> right_key;
+    state_t state;
+
+    // The right side by key, for joining in memory.
+    std::map<datum_t, std::vector<datum_t>, optional_datum_less_t> right_rows;
+
+    // When joining sorted sides, the rows of the right side with the key of the
+    // last left row, and the next right row with its key.
+    datum_t group_key;
+    std::vector<datum_t> group;
+    std::vector<datum_t> right_batch;
+    size_t right_batch_index;
+    datum_t next_right;
+    datum_t next_right_key;
+};
+
+// Recognizes the predicate `function(l, r) { return f(l).eq(g(r)); }` (or
+// `g(r).eq(f(l))`) of the `inner_join` or `outer_join` term `join`, and returns `f`
+// and `g` as one-argument functions.  (It's in terms/rewrites.cc.)
+bool equality_join_keys(const Term &join,
+                        protob_t<Term> *left_key_out,
+                        protob_t<Term> *right_key_out);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_JOIN_HPP_
@@ -4,6 +4,7 @@
 #include "containers/archive/buffer_group_stream.hpp"
 #include "containers/archive/versioned.hpp"
 #include "rdb_protocol/blob_wrapper.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
 
 ql::datum_t get_data(const rdb_value_t *value, buf_parent_t parent) {
     // TODO: Just use deserialize_from_blob?
@@ -24,6 +25,53 @@ ql::datum_t get_data(const rdb_value_t *value, buf_parent_t parent) {
     return data;
 }
 
+// Values smaller than this are read all at once, which takes about as many block
+// acquisitions as reading a few pieces of them.
+const int64_t projection_min_value_size = 16 * KILOBYTE;
+
+class blob_region_reader_t : public ql::datum_region_reader_t {
+public:
+    blob_region_reader_t(rdb_blob_wrapper_t *_blob, buf_parent_t _parent)
+        : blob(_blob), parent(_parent) { }
+
+    void read(size_t offset, size_t size, char *out) {
+        if (size == 0) {
+            return;
+        }
+        blob_acq_t acq_group;
+        buffer_group_t buffer_group;
+        blob->expose_region(parent, access_t::read, offset, size,
+                            &buffer_group, &acq_group);
+        buffer_group_t out_group;
+        out_group.add_buffer(size, out);
+        buffer_group_copy_data(&out_group, const_view(&buffer_group));
+    }
+
+private:
+    rdb_blob_wrapper_t *const blob;
+    const buf_parent_t parent;
+};
+
+ql::datum_t get_data_projected(const rdb_value_t *value,
+                               buf_parent_t parent,
+                               const std::set<datum_string_t> &fields) {
+    const int64_t size = value->value_size();
+    if (size < projection_min_value_size) {
+        return get_data(value, parent);
+    }
+
+    rdb_blob_wrapper_t blob(parent.cache()->max_block_size(),
+                            const_cast<rdb_value_t *>(value)->value_ref(),
+                            blob::btree_maxreflen);
+    blob_region_reader_t reader(&blob, parent);
+    ql::datum_t data;
+    if (!ql::datum_deserialize_projection(&reader, static_cast<size_t>(size),
+                                          fields, &data)) {
+        return get_data(value, parent);
+    }
+    return data;
+}
+
 const ql::datum_t &lazy_json_t::get() const {
     guarantee(pointee.has());
     if (!pointee->ptr.has()) {
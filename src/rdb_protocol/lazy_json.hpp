@@ -2,6 +2,8 @@
 #ifndef RDB_PROTOCOL_LAZY_JSON_HPP_
 #define RDB_PROTOCOL_LAZY_JSON_HPP_
 
+#include <set>
+
 #include "buffer_cache/alt.hpp"
 #include "buffer_cache/blob.hpp"
 #include "rdb_protocol/datum.hpp"
@@ -30,6 +32,12 @@ public:
 ql::datum_t get_data(const rdb_value_t *value,
                                       buf_parent_t parent);
 
+// Like `get_data`, but if the value is a big enough object, only loads the fields
+// in `fields` (and leaves the others out of the result).
+ql::datum_t get_data_projected(const rdb_value_t *value,
+                               buf_parent_t parent,
+                               const std::set<datum_string_t> &fields);
+
 class lazy_json_pointee_t : public single_threaded_countable_t<lazy_json_pointee_t> {
     lazy_json_pointee_t(const rdb_value_t *_rdb_value, buf_parent_t _parent)
         : rdb_value(_rdb_value), parent(_parent) {
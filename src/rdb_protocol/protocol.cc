@@ -281,6 +281,7 @@ void add_status(const single_sindex_status_t &new_status,
                 single_sindex_status_t *status_out) {
     status_out->blocks_processed += new_status.blocks_processed;
     status_out->blocks_total += new_status.blocks_total;
+    status_out->blocks_per_second += new_status.blocks_per_second;
     status_out->ready &= new_status.ready;
     status_out->func = new_status.func; // All shards have the same function.
     status_out->geo = new_status.geo; // All shards have the same geoness.
@@ -340,12 +341,18 @@ store_key_t sindex_list_region_key() {
     return store_key_t();
 }
 
+region_t region_from_keys(const std::vector<store_key_t> &keys);
+
 /* read_t::get_region implementation */
 struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const point_read_t &pr) const {
         return rdb_protocol::monokey_region(pr.key);
     }
 
+    region_t operator()(const batched_point_read_t &br) const {
+        return region_from_keys(br.keys);
+    }
+
     region_t operator()(const rget_read_t &rg) const {
         return rg.region;
     }
@@ -411,6 +418,21 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         return keyed_read(pr, pr.key);
     }
 
+    bool operator()(const batched_point_read_t &br) const {
+        std::vector<store_key_t> shard_keys;
+        for (auto it = br.keys.begin(); it != br.keys.end(); ++it) {
+            if (region_contains_key(*region, *it)) {
+                shard_keys.push_back(*it);
+            }
+        }
+        if (!shard_keys.empty()) {
+            *payload_out = batched_point_read_t(std::move(shard_keys));
+            return true;
+        } else {
+            return false;
+        }
+    }
+
     template <class T>
     bool rangey_read(const T &arg) const {
         const hash_region_t<key_range_t> intersection
@@ -526,6 +548,7 @@ public:
           ctx(_ctx), interruptor(_interruptor) { }
 
     void operator()(const point_read_t &);
+    void operator()(const batched_point_read_t &);
 
     void operator()(const rget_read_t &rg);
     void operator()(const intersecting_geo_read_t &gr);
@@ -615,6 +638,17 @@ void rdb_r_unshard_visitor_t::operator()(const point_read_t &) {
     *response_out = responses[0];
 }
 
+void rdb_r_unshard_visitor_t::operator()(const batched_point_read_t &) {
+    response_out->response = batched_point_read_response_t();
+    auto out = boost::get<batched_point_read_response_t>(&response_out->response);
+    for (size_t i = 0; i < count; ++i) {
+        auto res = boost::get<batched_point_read_response_t>(&responses[i].response);
+        guarantee(res != NULL);
+        // The shards' keys are disjoint.
+        out->rows.insert(res->rows.begin(), res->rows.end());
+    }
+}
+
 void rdb_r_unshard_visitor_t::operator()(const intersecting_geo_read_t &query) {
     unshard_range_batch<rget_read_response_t>(query, sorting_t::UNORDERED);
 }
@@ -740,6 +774,16 @@ void rdb_r_unshard_visitor_t::operator()(const distribution_read_t &dg) {
     std::sort(results.begin(), results.end(), distribution_read_response_less_t());
 
     distribution_read_response_t res;
+    res.value_bytes = 0;
+    for (size_t j = 0; j < results.size(); ++j) {
+        // Every hash shard holds different values, so the sizes just add up.
+        if (results[j].value_bytes < 0) {
+            res.value_bytes = -1;
+            break;
+        }
+        res.value_bytes += results[j].value_bytes;
+    }
+
     size_t i = 0;
     while (i < results.size()) {
         // Find the largest hash shard for this key range
@@ -840,7 +884,13 @@ void read_t::unshard(read_response_t *responses, size_t count,
 
 struct use_snapshot_visitor_t : public boost::static_visitor<bool> {
     bool operator()(const point_read_t &) const {                 return false; }
-    bool operator()(const rget_read_t &) const {                  return true;  }
+    bool operator()(const batched_point_read_t &) const {         return false; }
+    bool operator()(const rget_read_t &rget) const {
+        // Unfiltered counts of the primary index may be answered from the stat
+        // block, which can't be read from a snapshot (see `rdb_rget_slice`).
+        return !(!rget.sindex && rget.transforms.empty() && rget.terminal
+                 && boost::get<ql::count_wire_func_t>(&*rget.terminal) != NULL);
+    }
     bool operator()(const intersecting_geo_read_t &) const {      return true;  }
     bool operator()(const nearest_geo_read_t &) const {           return true;  }
     bool operator()(const changefeed_subscribe_t &) const {       return false; }
@@ -1155,10 +1205,11 @@ void write_t::unshard(write_response_t *responses, size_t count,
 }
 
 
-RDB_IMPL_SERIALIZABLE_7_FOR_CLUSTER(
+RDB_IMPL_SERIALIZABLE_8_FOR_CLUSTER(
         rdb_protocol::single_sindex_status_t,
         blocks_total,
         blocks_processed,
+        blocks_per_second,
         ready,
         func,
         geo,
@@ -1166,9 +1217,11 @@ RDB_IMPL_SERIALIZABLE_7_FOR_CLUSTER(
         outdated);
 
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(point_read_response_t, data);
+RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(batched_point_read_response_t, rows);
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(rget_read_response_t, result, truncated, last_key);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(nearest_geo_read_response_t, results_or_error);
-RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(distribution_read_response_t, region, key_counts);
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(distribution_read_response_t,
+                                    region, key_counts, value_bytes);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(sindex_list_response_t, sindexes);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(sindex_status_response_t, statuses);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(
@@ -1181,6 +1234,7 @@ RDB_IMPL_ME_SERIALIZABLE_2_FOR_CLUSTER(
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(read_response_t, response, event_log, n_shards);
 
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(point_read_t, key);
+RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(batched_point_read_t, keys);
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(sindex_rangespec_t, id, region, original_range);
 
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
@@ -143,13 +143,15 @@ void bring_sindexes_up_to_date(
 struct single_sindex_status_t {
     single_sindex_status_t()
         : blocks_processed(0),
-          blocks_total(0), ready(true), outdated(false),
+          blocks_total(0), blocks_per_second(0), ready(true), outdated(false),
           geo(sindex_geo_bool_t::REGULAR), multi(sindex_multi_bool_t::SINGLE)
     { }
     single_sindex_status_t(size_t _blocks_processed, size_t _blocks_total, bool _ready)
         : blocks_processed(_blocks_processed),
-          blocks_total(_blocks_total), ready(_ready) { }
+          blocks_total(_blocks_total), blocks_per_second(0), ready(_ready) { }
     size_t blocks_processed, blocks_total;
+    // The rate at which the index is being built, summed over all shards.
+    double blocks_per_second;
     bool ready;
     bool outdated;
     sindex_geo_bool_t geo;
@@ -169,6 +171,13 @@ struct point_read_response_t {
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(point_read_response_t);
 
+struct batched_point_read_response_t {
+    // Every key the read asked for; missing rows map to `null`.
+    std::map<store_key_t, ql::datum_t> rows;
+    batched_point_read_response_t() { }
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(batched_point_read_response_t);
+
 struct rget_read_response_t {
     ql::result_t result;
     bool truncated;
@@ -217,8 +226,12 @@ struct distribution_read_response_t {
     // Then k1 == left_key
     // and key_counts[ki] = the number of keys in [ki, ki+1) if i < n
     // key_counts[kn] = the number of keys in [kn, right_key)
+    distribution_read_response_t() : value_bytes(-1) { }
     region_t region;
     std::map<store_key_t, int64_t> key_counts;
+    // The total size of the values in `region`, or -1 if some of the btrees were
+    // created by an older version that didn't keep track of it.
+    int64_t value_bytes;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(distribution_read_response_t);
 
@@ -283,7 +296,8 @@ struct read_response_t {
                            changefeed_point_stamp_response_t,
                            distribution_read_response_t,
                            sindex_list_response_t,
-                           sindex_status_response_t> variant_t;
+                           sindex_status_response_t,
+                           batched_point_read_response_t> variant_t;
     variant_t response;
     profile::event_log_t event_log;
     size_t n_shards;
@@ -303,6 +317,18 @@ public:
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(point_read_t);
 
+// Looks up several primary keys at once.  The read gets sharded like a batched
+// write, so each shard sees only its own keys.
+class batched_point_read_t {
+public:
+    batched_point_read_t() { }
+    explicit batched_point_read_t(std::vector<store_key_t> &&_keys)
+        : keys(std::move(_keys)) { }
+
+    std::vector<store_key_t> keys;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(batched_point_read_t);
+
 struct sindex_rangespec_t {
     sindex_rangespec_t() { }
     sindex_rangespec_t(const std::string &_id,
@@ -516,7 +542,8 @@ struct read_t {
                            changefeed_point_stamp_t,
                            distribution_read_t,
                            sindex_list_t,
-                           sindex_status_t> variant_t;
+                           sindex_status_t,
+                           batched_point_read_t> variant_t;
     variant_t read;
     profile_bool_t profile;
 
@@ -77,6 +77,32 @@ ql::datum_t real_table_t::read_row(ql::env_t *env,
     return p_res->data;
 }
 
+std::vector<ql::datum_t> real_table_t::read_rows(ql::env_t *env,
+        const std::vector<ql::datum_t> &pvals, bool use_outdated) {
+    if (pvals.empty()) {
+        return std::vector<ql::datum_t>();
+    }
+    std::vector<store_key_t> keys;
+    keys.reserve(pvals.size());
+    for (auto it = pvals.begin(); it != pvals.end(); ++it) {
+        keys.push_back(store_key_t(it->print_primary()));
+    }
+    read_t read(batched_point_read_t(std::vector<store_key_t>(keys)), env->profile());
+    read_response_t res;
+    read_with_profile(env, read, &res, use_outdated);
+    batched_point_read_response_t *b_res =
+        boost::get<batched_point_read_response_t>(&res.response);
+    r_sanity_check(b_res);
+    std::vector<ql::datum_t> rows;
+    rows.reserve(keys.size());
+    for (auto it = keys.begin(); it != keys.end(); ++it) {
+        auto row = b_res->rows.find(*it);
+        r_sanity_check(row != b_res->rows.end());
+        rows.push_back(row->second);
+    }
+    return rows;
+}
+
 counted_t<ql::datum_stream_t> real_table_t::read_all(
         ql::env_t *env,
         const std::string &sindex,
@@ -310,6 +336,17 @@ real_table_t::sindex_status(ql::env_t *env, const std::set<std::string> &sindexe
             status[datum_string_t("blocks_total")] =
                 ql::datum_t(
                     safe_to_double(pair.second.blocks_total));
+            if (!pair.second.ready && pair.second.blocks_per_second > 0) {
+                status[datum_string_t("blocks_per_second")] =
+                    ql::datum_t(pair.second.blocks_per_second);
+                const size_t blocks_left =
+                    pair.second.blocks_total > pair.second.blocks_processed
+                    ? pair.second.blocks_total - pair.second.blocks_processed
+                    : 0;
+                status[datum_string_t("eta_seconds")] =
+                    ql::datum_t(safe_to_double(blocks_left)
+                                / pair.second.blocks_per_second);
+            }
         }
         status[datum_string_t("ready")] = ql::datum_t::boolean(pair.second.ready);
         std::string s = sindex_blob_prefix + pair.second.func;
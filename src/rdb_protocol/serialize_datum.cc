@@ -1,8 +1,13 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/serialize_datum.hpp"
 
+#include <string.h>
+
+#include <algorithm>
 #include <cmath>
 #include <limits>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -10,6 +15,7 @@
 #include "containers/archive/stl_types.hpp"
 #include "containers/archive/versioned.hpp"
 #include "containers/counted.hpp"
+#include "containers/scoped.hpp"
 #include "containers/shared_buffer.hpp"
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/env.hpp"
@@ -65,6 +71,43 @@ MUST_USE archive_result_t datum_deserialize(read_stream_t *s,
     return deserialize<cluster_version_t::LATEST_OVERALL>(s, type);
 }
 
+// Arrays bigger than this can go over the network, but not onto disk.
+const size_t max_serialized_array_size = 100000;
+
+// Checks `datum` for the errors that serializing it would report, without
+// serializing it.
+serialization_result_t datum_check_serialization_errors(const datum_t &datum) {
+    switch (datum.get_type()) {
+    case datum_t::R_ARRAY: {
+        const size_t sz = datum.arr_size();
+        if (sz > max_serialized_array_size) {
+            return serialization_result_t::ARRAY_TOO_BIG;
+        }
+        for (size_t i = 0; i < sz; ++i) {
+            serialization_result_t res = datum_check_serialization_errors(datum.get(i));
+            if (bad(res)) return res;
+        }
+    } break;
+    case datum_t::R_OBJECT: {
+        const size_t sz = datum.obj_size();
+        for (size_t i = 0; i < sz; ++i) {
+            serialization_result_t res =
+                datum_check_serialization_errors(datum.get_pair(i).second);
+            if (bad(res)) return res;
+        }
+    } break;
+    case datum_t::R_BINARY: // fallthru
+    case datum_t::R_BOOL: // fallthru
+    case datum_t::R_NULL: // fallthru
+    case datum_t::R_NUM: // fallthru
+    case datum_t::R_STR: break;
+    case datum_t::UNINITIALIZED: // fallthru
+    default:
+        unreachable();
+    }
+    return serialization_result_t::SUCCESS;
+}
+
 /* Forward declarations */
 size_t datum_serialized_size(const datum_t &datum,
                              check_datum_serialization_errors_t check_errors,
@@ -229,8 +272,7 @@ size_t datum_array_serialized_size(const datum_t &datum,
 
     // Can we use an existing serialization?
     const shared_buf_ref_t<char> *existing_buf_ref = datum.get_buf_ref();
-    if (existing_buf_ref != NULL
-        && check_errors == check_datum_serialization_errors_t::NO) {
+    if (existing_buf_ref != NULL) {
 
         // We don't initialize element_sizes_out, but that's ok. We don't need it
         // if there already is a serialization.
@@ -271,12 +313,17 @@ serialization_result_t datum_array_serialize(
 
     // Can we use an existing serialization?
     const shared_buf_ref_t<char> *existing_buf_ref = datum.get_buf_ref();
-    if (existing_buf_ref != NULL
-        && check_errors == check_datum_serialization_errors_t::NO) {
+    if (existing_buf_ref != NULL) {
+        // The existing serialization can still have errors that we have to
+        // report, but we can check for them without reencoding anything.
+        serialization_result_t res = serialization_result_t::SUCCESS;
+        if (check_errors == check_datum_serialization_errors_t::YES) {
+            res = datum_check_serialization_errors(datum);
+        }
 
         // Subtract 1 for the type byte, which we don't have to rewrite
         wm->append(existing_buf_ref->get(), precomputed_sizes.size - 1);
-        return serialization_result_t::SUCCESS;
+        return res;
     }
 
     // The inner serialized size
@@ -330,8 +377,7 @@ size_t datum_object_serialized_size(const datum_t &datum,
 
     // Can we use an existing serialization?
     const shared_buf_ref_t<char> *existing_buf_ref = datum.get_buf_ref();
-    if (existing_buf_ref != NULL
-        && check_errors == check_datum_serialization_errors_t::NO) {
+    if (existing_buf_ref != NULL) {
 
         // We don't initialize element_sizes_out, but that's ok. We don't need it
         // if there already is a serialization.
@@ -375,12 +421,17 @@ serialization_result_t datum_object_serialize(
 
     // Can we use an existing serialization?
     const shared_buf_ref_t<char> *existing_buf_ref = datum.get_buf_ref();
-    if (existing_buf_ref != NULL
-        && check_errors == check_datum_serialization_errors_t::NO) {
+    if (existing_buf_ref != NULL) {
+        // The existing serialization can still have errors that we have to
+        // report, but we can check for them without reencoding anything.
+        serialization_result_t res = serialization_result_t::SUCCESS;
+        if (check_errors == check_datum_serialization_errors_t::YES) {
+            res = datum_check_serialization_errors(datum);
+        }
 
         // Subtract 1 for the type byte, which we don't have to rewrite
         wm->append(existing_buf_ref->get(), precomputed_sizes.size - 1);
-        return serialization_result_t::SUCCESS;
+        return res;
     }
 
     // The inner serialized size
@@ -494,7 +545,7 @@ serialization_result_t datum_serialize(
     switch (datum.get_type()) {
     case datum_t::R_ARRAY: {
         res = res | datum_serialize(wm, datum_serialized_type_t::BUF_R_ARRAY);
-        if (datum.arr_size() > 100000)
+        if (datum.arr_size() > max_serialized_array_size)
             res = res | serialization_result_t::ARRAY_TOO_BIG;
         res = res | datum_array_serialize(wm, datum, check_errors, precomputed_size);
     } break;
@@ -717,6 +768,75 @@ archive_result_t datum_deserialize(read_stream_t *s, datum_t *datum) {
     return archive_result_t::SUCCESS;
 }
 
+datum_t datum_serialize_to_buf(const datum_t &datum) {
+    const datum_t::type_t type = datum.get_type();
+    if ((type != datum_t::R_ARRAY && type != datum_t::R_OBJECT)
+        || datum.get_buf_ref() != NULL) {
+        return datum;
+    }
+
+    write_message_t wm;
+    datum_serialize(&wm, datum, check_datum_serialization_errors_t::NO);
+    counted_t<shared_buf_t> buf = shared_buf_t::create(wm.size());
+    size_t offset = 0;
+    intrusive_list_t<write_buffer_t> *buffers = wm.unsafe_expose_buffers();
+    for (write_buffer_t *b = buffers->head(); b != NULL; b = buffers->next(b)) {
+        memcpy(buf->data(offset), b->data, b->size);
+        offset += b->size;
+    }
+
+    // The buffer representation starts after the type byte, like in
+    // `datum_deserialize_from_buf`.
+    return datum_t(type, shared_buf_ref_t<char>(std::move(buf), 1));
+}
+
+// Short strings are cheaper to copy out of the buffer than to hold a reference to
+// it with.
+datum_string_t datum_string_from_buf(const shared_buf_ref_t<char> &buf,
+                                     size_t at_offset) {
+    buf.guarantee_in_boundary(at_offset);
+    const uint8_t first = static_cast<uint8_t>(buf.get()[at_offset]);
+    // A one-byte varint is the size itself.
+    if (first <= datum_string_t::max_inline_size) {
+        buf.guarantee_in_boundary(at_offset + 1 + first);
+        return datum_string_t(first, buf.get() + at_offset + 1);
+    }
+    return datum_string_t(buf.make_child(at_offset));
+}
+
+// Numbers are the most common values in documents, so we decode them straight
+// from the buffer instead of going through a read stream one byte at a time.  This
+// must agree with `datum_deserialize`.
+datum_t datum_number_from_buf(const shared_buf_ref_t<char> &buf,
+                              datum_serialized_type_t type,
+                              size_t at_offset) {
+    const size_t end = buf.get_safety_boundary();
+    const char *data = buf.get();
+    double value;
+    if (type == datum_serialized_type_t::DOUBLE) {
+        guarantee(at_offset <= end && end - at_offset >= sizeof(double),
+                  "Deserialization of datum number from buf failed");
+        memcpy(&value, data + at_offset, sizeof(double));
+    } else {
+        uint64_t unsigned_value = 0;
+        for (int shift = 0; ; shift += 7) {
+            guarantee(at_offset < end && shift <= 63,
+                      "Deserialization of datum number from buf failed");
+            const uint8_t byte = static_cast<uint8_t>(data[at_offset++]);
+            unsigned_value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        guarantee(unsigned_value <= max_dbl_int,
+                  "Deserialization of datum number from buf failed");
+        const double d = unsigned_value;
+        // This might give the signed-zero double, -0.0.
+        value = type == datum_serialized_type_t::INT_NEGATIVE ? -d : d;
+    }
+    return datum_t(value);
+}
+
 datum_t datum_deserialize_from_buf(const shared_buf_ref_t<char> &buf, size_t at_offset) {
     // Peek into the buffer to find out the type of the datum in there.
     // If it's a string, buf_object or buf_array, we just create a datum from a
@@ -732,7 +852,7 @@ datum_t datum_deserialize_from_buf(const shared_buf_ref_t<char> &buf, size_t at_
     switch (type) {
     case datum_serialized_type_t::R_STR: {
         const size_t data_offset = at_offset + static_cast<size_t>(read_stream.tell());
-        return datum_t(datum_string_t(buf.make_child(data_offset)));
+        return datum_t(datum_string_from_buf(buf, data_offset));
     }
     case datum_serialized_type_t::BUF_R_ARRAY: {
         const size_t data_offset = at_offset + static_cast<size_t>(read_stream.tell());
@@ -747,13 +867,16 @@ datum_t datum_deserialize_from_buf(const shared_buf_ref_t<char> &buf, size_t at_
         return datum_t(datum_t::construct_binary_t(),
                        datum_string_t(buf.make_child(data_offset)));
     }
-    case datum_serialized_type_t::R_ARRAY: // fallthru
-    case datum_serialized_type_t::R_BOOL: // fallthru
-    case datum_serialized_type_t::R_NULL: // fallthru
     case datum_serialized_type_t::DOUBLE: // fallthru
-    case datum_serialized_type_t::R_OBJECT: // fallthru
     case datum_serialized_type_t::INT_NEGATIVE: // fallthru
     case datum_serialized_type_t::INT_POSITIVE: {
+        const size_t data_offset = at_offset + static_cast<size_t>(read_stream.tell());
+        return datum_number_from_buf(buf, type, data_offset);
+    }
+    case datum_serialized_type_t::R_ARRAY: // fallthru
+    case datum_serialized_type_t::R_BOOL: // fallthru
+    case datum_serialized_type_t::R_NULL: // fallthru
+    case datum_serialized_type_t::R_OBJECT: {
         buffer_read_stream_t data_read_stream(buf.get() + at_offset,
                                               buf.get_safety_boundary() - at_offset);
         datum_t res;
@@ -768,7 +891,7 @@ datum_t datum_deserialize_from_buf(const shared_buf_ref_t<char> &buf, size_t at_
 
 std::pair<datum_string_t, datum_t> datum_deserialize_pair_from_buf(
         const shared_buf_ref_t<char> &buf, size_t at_offset) {
-    datum_string_t key(buf.make_child(at_offset));
+    datum_string_t key = datum_string_from_buf(buf, at_offset);
     // Relies on the fact that the datum_string_t serialization format hasn't
     // changed, specifically that we would still get the same size if we re-serialized
     // the datum_string_t now.
@@ -779,6 +902,283 @@ std::pair<datum_string_t, datum_t> datum_deserialize_pair_from_buf(
     return std::make_pair(std::move(key), std::move(value));
 }
 
+size_t datum_peek_pair_key_from_buf(const shared_buf_ref_t<char> &buf,
+                                    size_t at_offset,
+                                    const char **key_out,
+                                    size_t *key_size_out) {
+    buf.guarantee_in_boundary(at_offset);
+    buffer_read_stream_t read_stream(buf.get() + at_offset,
+                                     buf.get_safety_boundary() - at_offset);
+    uint64_t key_size;
+    guarantee_deserialization(deserialize_varint_uint64(&read_stream, &key_size),
+                              "datum object key");
+    const size_t key_offset = at_offset + static_cast<size_t>(read_stream.tell());
+    guarantee(key_size <= buf.get_safety_boundary() - key_offset);
+    *key_out = buf.get() + key_offset;
+    *key_size_out = static_cast<size_t>(key_size);
+    return key_offset + static_cast<size_t>(key_size);
+}
+
+// The same order as `datum_string_t::compare`.
+int compare_keys(const char *a, size_t a_size, const char *b, size_t b_size) {
+    int cmp = memcmp(a, b, std::min(a_size, b_size));
+    if (cmp != 0) {
+        return cmp;
+    }
+    return a_size < b_size ? -1 : (a_size > b_size ? 1 : 0);
+}
+
+uint64_t hash_key(const char *key, size_t key_size) {
+    // 64-bit FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < key_size; ++i) {
+        h ^= static_cast<uint8_t>(key[i]);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// Objects with at least this many fields get a hash index over their keys, once
+// their buffer has been looked up in `field_index_min_lookups` times.  Building
+// the index reads every key once, so it's not worth it for objects we only look
+// into once or twice (like most rows a `filter` sees).  Until then we don't
+// allocate anything for the object.  (The count is per buffer, so wide objects
+// nested in a busy buffer get their index sooner.)
+const size_t field_index_min_fields = 64;
+const intptr_t field_index_min_lookups = 8;
+
+// An open-addressing hash table from key hashes to the offsets of the pairs.
+class field_index_table_t {
+public:
+    field_index_table_t(const shared_buf_ref_t<char> &object, size_t num_fields) {
+        size_t num_slots = 1;
+        while (num_slots < num_fields * 2) {
+            num_slots *= 2;
+        }
+        slots_.resize(num_slots);
+        for (size_t i = 0; i < num_fields; ++i) {
+            const size_t offset = datum_get_element_offset(object, i);
+            const char *key;
+            size_t key_size;
+            UNUSED size_t value_offset =
+                datum_peek_pair_key_from_buf(object, offset, &key, &key_size);
+            const uint64_t h = hash_key(key, key_size);
+            size_t slot = h & (num_slots - 1);
+            while (slots_[slot].pair_offset != 0) {
+                slot = (slot + 1) & (num_slots - 1);
+            }
+            slots_[slot].hash = h;
+            slots_[slot].pair_offset = offset;
+        }
+    }
+
+    // Returns the offset of the pair's value, or 0 if there's no such key.
+    size_t find(const shared_buf_ref_t<char> &object,
+                const char *key, size_t key_size) const {
+        const uint64_t h = hash_key(key, key_size);
+        const size_t mask = slots_.size() - 1;
+        for (size_t slot = h & mask;
+             slots_[slot].pair_offset != 0;
+             slot = (slot + 1) & mask) {
+            if (slots_[slot].hash == h) {
+                const char *k;
+                size_t k_size;
+                size_t value_offset = datum_peek_pair_key_from_buf(
+                    object, slots_[slot].pair_offset, &k, &k_size);
+                if (compare_keys(key, key_size, k, k_size) == 0) {
+                    return value_offset;
+                }
+            }
+        }
+        return 0;
+    }
+
+private:
+    struct slot_t {
+        slot_t() : hash(0), pair_offset(0) { }
+        uint64_t hash;
+        // Pairs never start at offset 0 (the sizes come first), so 0 means
+        // that the slot is empty.
+        size_t pair_offset;
+    };
+    std::vector<slot_t> slots_;
+
+    DISABLE_COPYING(field_index_table_t);
+};
+
+// Attached to a wide object's buffer to hold its index.
+class field_index_annex_t : public shared_buf_annex_t {
+public:
+    field_index_annex_t(const shared_buf_ref_t<char> &object, size_t num_fields)
+        : table(object, num_fields) { }
+
+    const field_index_table_t table;
+};
+
+datum_t datum_get_field_from_buf(const shared_buf_ref_t<char> &object,
+                                 const char *key, size_t key_size) {
+    const size_t num_fields = datum_get_array_size(object);
+    if (num_fields >= field_index_min_fields) {
+        shared_buf_annex_t *annex = object.get_annex();
+        if (annex == NULL && object.note_lookup() >= field_index_min_lookups) {
+            annex = object.add_annex(new field_index_annex_t(object, num_fields));
+        }
+        if (annex != NULL) {
+            const size_t value_offset = static_cast<field_index_annex_t *>(annex)
+                ->table.find(object, key, key_size);
+            return value_offset == 0
+                ? datum_t()
+                : datum_deserialize_from_buf(object, value_offset);
+        }
+    }
+
+    // Binary search, comparing the keys in place.
+    size_t range_beg = 0;
+    size_t range_end = num_fields;
+    while (range_beg < range_end) {
+        const size_t center = range_beg + ((range_end - range_beg) / 2);
+        const char *center_key;
+        size_t center_key_size;
+        const size_t value_offset = datum_peek_pair_key_from_buf(
+            object, datum_get_element_offset(object, center),
+            &center_key, &center_key_size);
+        const int cmp = compare_keys(key, key_size, center_key, center_key_size);
+        if (cmp == 0) {
+            return datum_deserialize_from_buf(object, value_offset);
+        } else if (cmp < 0) {
+            range_end = center;
+        } else {
+            range_beg = center + 1;
+        }
+    }
+    return datum_t();
+}
+
+// A uint64_t takes at most this many bytes as a varint.
+const size_t max_varint_size = 10;
+
+// Reads the serialized datum's offset table entry `index`, which is
+// `offset_width` bytes wide, from `table`.
+uint64_t read_offset_table_entry(const std::vector<char> &table, size_t index,
+                                 size_t offset_width) {
+    buffer_read_stream_t s(table.data() + index * offset_width, offset_width);
+    archive_result_t res;
+    uint64_t offset;
+    switch (offset_width) {
+    case 1: { uint8_t o; res = deserialize_universal(&s, &o); offset = o; } break;
+    case 2: { uint16_t o; res = deserialize_universal(&s, &o); offset = o; } break;
+    case 4: { uint32_t o; res = deserialize_universal(&s, &o); offset = o; } break;
+    case 8: { uint64_t o; res = deserialize_universal(&s, &o); offset = o; } break;
+    default: unreachable();
+    }
+    guarantee_deserialization(res, "datum projection offset");
+    return offset;
+}
+
+bool datum_deserialize_projection(datum_region_reader_t *reader, size_t size,
+                                  const std::set<datum_string_t> &fields,
+                                  datum_t *out) {
+    // The type, the inner size and the number of pairs.
+    char header[1 + 2 * max_varint_size];
+    const size_t header_size = std::min(size, sizeof(header));
+    reader->read(0, header_size, header);
+    buffer_read_stream_t header_stream(header, header_size);
+    datum_serialized_type_t type;
+    if (bad(datum_deserialize(&header_stream, &type))
+        || type != datum_serialized_type_t::BUF_R_OBJECT) {
+        return false;
+    }
+    const size_t buf_offset = static_cast<size_t>(header_stream.tell());
+    uint64_t inner_size;
+    guarantee_deserialization(deserialize_varint_uint64(&header_stream, &inner_size),
+                              "datum projection size");
+    uint64_t num_pairs;
+    guarantee_deserialization(deserialize_varint_uint64(&header_stream, &num_pairs),
+                              "datum projection size");
+    guarantee(inner_size <= size && num_pairs <= inner_size);
+    const size_t end = buf_offset + varint_uint64_serialized_size(inner_size)
+        + static_cast<size_t>(inner_size);
+    guarantee(end <= size, "Corrupted value in storage (bad object size).");
+
+    size_t offset_width;
+    switch (get_offset_size_from_inner_size(inner_size)) {
+    case datum_offset_size_t::U8BIT: offset_width = 1; break;
+    case datum_offset_size_t::U16BIT: offset_width = 2; break;
+    case datum_offset_size_t::U32BIT: offset_width = 4; break;
+    case datum_offset_size_t::U64BIT: offset_width = 8; break;
+    default: unreachable();
+    }
+
+    // The offset table is small next to the pairs, so we read all of it.
+    const size_t table_offset = static_cast<size_t>(header_stream.tell());
+    std::vector<char> table(num_pairs > 1 ? (num_pairs - 1) * offset_width : 0);
+    const size_t data_offset = table_offset + table.size();
+    guarantee(data_offset <= end, "Corrupted value in storage (bad object size).");
+    reader->read(table_offset, table.size(), table.data());
+    auto pair_offset = [&](size_t i) -> size_t {
+        if (i == 0) {
+            return data_offset;
+        }
+        const uint64_t offset = read_offset_table_entry(table, i - 1, offset_width);
+        guarantee(offset <= end - data_offset,
+                  "Corrupted value in storage (bad object offset).");
+        return data_offset + static_cast<size_t>(offset);
+    };
+    auto pair_end = [&](size_t i) -> size_t {
+        return i + 1 < num_pairs ? pair_offset(i + 1) : end;
+    };
+
+    std::map<datum_string_t, datum_t> pairs;
+    std::vector<char> buf;
+    for (auto it = fields.begin(); it != fields.end(); ++it) {
+        // Binary search, reading just enough of each key to compare it to ours.
+        size_t range_beg = 0;
+        size_t range_end = static_cast<size_t>(num_pairs);
+        while (range_beg < range_end) {
+            const size_t center = range_beg + ((range_end - range_beg) / 2);
+            const size_t beg = pair_offset(center);
+            const size_t pair_size = pair_end(center) - beg;
+            guarantee(beg + pair_size <= end,
+                      "Corrupted value in storage (bad object offset).");
+            buf.resize(std::min(pair_size, max_varint_size + it->size()));
+            reader->read(beg, buf.size(), buf.data());
+            buffer_read_stream_t key_stream(buf.data(), buf.size());
+            uint64_t key_size;
+            guarantee_deserialization(deserialize_varint_uint64(&key_stream, &key_size),
+                                      "datum projection key");
+            const size_t key_offset = static_cast<size_t>(key_stream.tell());
+            guarantee(key_size <= pair_size - key_offset,
+                      "Corrupted value in storage (bad object key).");
+            // If the key is longer than ours we only have a prefix of it, which is
+            // enough to know that it's bigger.
+            const int cmp = compare_keys(
+                it->data(), it->size(), buf.data() + key_offset,
+                std::min(static_cast<size_t>(key_size), buf.size() - key_offset));
+            if (cmp == 0) {
+                const size_t value_offset =
+                    key_offset + static_cast<size_t>(key_size);
+                buf.resize(pair_size - value_offset);
+                reader->read(beg + value_offset, buf.size(), buf.data());
+                buffer_read_stream_t value_stream(buf.data(), buf.size());
+                datum_t value;
+                guarantee_deserialization(datum_deserialize(&value_stream, &value),
+                                          "datum projection value");
+                pairs.insert(std::make_pair(*it, std::move(value)));
+                break;
+            } else if (cmp < 0) {
+                range_end = center;
+            } else {
+                range_beg = center + 1;
+            }
+        }
+    }
+
+    // The row was a valid object when we stored it, and we don't want to complain
+    // about a pseudotype that's missing the fields we left out.
+    *out = datum_t(std::move(pairs), datum_t::no_sanitize_ptype_t());
+    return true;
+}
+
 /* The format of `array` is:
      varint ser_size
      varint num_elements
@@ -902,6 +1302,19 @@ MUST_USE archive_result_t datum_deserialize(
         return archive_result_t::RANGE_ERROR;
     }
 
+    if (sz <= datum_string_t::max_inline_size) {
+        char str[datum_string_t::max_inline_size];
+        int64_t num_read = force_read(s, str, sz);
+        if (num_read == -1) {
+            return archive_result_t::SOCK_ERROR;
+        }
+        if (static_cast<uint64_t>(num_read) < sz) {
+            return archive_result_t::SOCK_EOF;
+        }
+        *out = datum_string_t(static_cast<size_t>(sz), str);
+        return archive_result_t::SUCCESS;
+    }
+
     const size_t str_offset = varint_uint64_serialized_size(sz);
     counted_t<shared_buf_t> buf =
         shared_buf_t::create(str_offset + static_cast<size_t>(sz));
@@ -1,6 +1,7 @@
 #ifndef RDB_PROTOCOL_SERIALIZE_DATUM_HPP_
 #define RDB_PROTOCOL_SERIALIZE_DATUM_HPP_
 
+#include <set>
 #include <utility>
 
 #include "containers/archive/archive.hpp"
@@ -55,10 +56,43 @@ serialization_result_t datum_serialize(write_message_t *wm, const datum_t &datum
                                        check_datum_serialization_errors_t check_errors);
 archive_result_t datum_deserialize(read_stream_t *s, datum_t *datum);
 
+// Returns a datum equal to `datum` that's backed by its own serialization, if it's
+// an array or an object.  Serializing the result again, onto the network or onto
+// disk, copies that buffer instead of reencoding the datum.
+datum_t datum_serialize_to_buf(const datum_t &datum);
+
 datum_t datum_deserialize_from_buf(const shared_buf_ref_t<char> &buf, size_t at_offset);
 std::pair<datum_string_t, datum_t> datum_deserialize_pair_from_buf(
         const shared_buf_ref_t<char> &buf, size_t at_offset);
 
+// Reads the key of the pair at `at_offset` in a serialized object without copying
+// it.  Returns the offset of the pair's value.
+size_t datum_peek_pair_key_from_buf(const shared_buf_ref_t<char> &buf,
+                                    size_t at_offset,
+                                    const char **key_out,
+                                    size_t *key_size_out);
+// Looks up a field of a serialized object.  Returns an uninitialized datum if the
+// object has no such field.  Wide objects that are looked up in repeatedly get a
+// hash index, attached to their buffer.
+datum_t datum_get_field_from_buf(const shared_buf_ref_t<char> &object,
+                                 const char *key, size_t key_size);
+
+// Reads parts of a serialized datum that lives somewhere it's expensive to read all
+// of, like a large blob.
+class datum_region_reader_t {
+public:
+    virtual void read(size_t offset, size_t size, char *out) = 0;
+protected:
+    virtual ~datum_region_reader_t() { }
+};
+
+// If the `size` byte datum that `reader` reads (serialized like by `datum_serialize`)
+// is an object, deserializes the pairs of it whose keys are in `fields` and returns
+// true, reading little more than those pairs.  Returns false otherwise.
+MUST_USE bool datum_deserialize_projection(datum_region_reader_t *reader, size_t size,
+                                           const std::set<datum_string_t> &fields,
+                                           datum_t *out);
+
 // Finds the offset of the given array element in the buffer
 size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t index);
 // Reads the number of elements in the array stored in the buffer
@@ -13,7 +13,8 @@ datum_serialize_onto_blob(buf_parent_t parent, blob_t *blob,
     // abstract stream type already, so what's the big deal?)
     write_message_t wm;
     // Check for errors to enforce the static array size limit when writing
-    // to disk
+    // to disk.  Datums that are backed by their serialization (like the ones
+    // inserted by `batched_insert_t`) are checked in place and copied as they are.
     ql::serialization_result_t res =
         datum_serialize(&wm, value,
                         ql::check_datum_serialization_errors_t::YES);
@@ -1,12 +1,14 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/shards.hpp"
 
+#include <algorithm>
 #include <utility>
 
 #include "errors.hpp"
 #include <boost/variant.hpp>
 
 #include "debug.hpp"
+#include "rdb_protocol/batch_program.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/profile.hpp"
 #include "rdb_protocol/protocol.hpp"
@@ -97,16 +99,26 @@ private:
                          const store_key_t &last_key,
                          const std::vector<result_t *> &results) {
         guarantee(acc.size() == 0);
-        std::map<datum_t, std::vector<T *>, optional_datum_less_t>
-            vecs(optional_datum_less_t(env->reql_version()));
+        std::vector<grouped_t<T> *> gress;
+        gress.reserve(results.size());
         for (auto res = results.begin(); res != results.end(); ++res) {
             guarantee(*res);
             grouped_t<T> *gres = boost::get<grouped_t<T> >(*res);
             guarantee(gres);
+            gress.push_back(gres);
+        }
+        if (acc.get_underlying_map(grouped::order_doesnt_matter_t())
+                ->key_comp().reql_version() == env->reql_version()) {
+            merge_unshard(env, last_key, &gress);
+            return;
+        }
+        std::map<datum_t, std::vector<T *>, optional_datum_less_t>
+            vecs(optional_datum_less_t(env->reql_version()));
+        for (auto gres = gress.begin(); gres != gress.end(); ++gres) {
             // `gres`'s ordering doesn't affect things here because we're putting the
             // values into a parallel map.
-            for (auto kv = gres->begin(grouped::order_doesnt_matter_t());
-                 kv != gres->end(grouped::order_doesnt_matter_t());
+            for (auto kv = (*gres)->begin(grouped::order_doesnt_matter_t());
+                 kv != (*gres)->end(grouped::order_doesnt_matter_t());
                  ++kv) {
                 vecs[kv->first].push_back(&kv->second);
             }
@@ -116,6 +128,58 @@ private:
             unshard_impl(env, &t_it->second, last_key, kv->second);
         }
     }
+    // When the shards' groups are ordered the way `env` compares them, we can merge
+    // the shards' results group by group instead of collecting them in another map.
+    // Each group's partial results get combined (and freed) as soon as the smallest
+    // remaining group is known, and the groups land in `acc` in order, so inserting
+    // them is constant time.
+    void merge_unshard(env_t *env,
+                       const store_key_t &last_key,
+                       std::vector<grouped_t<T> *> *gress) {
+        typedef std::map<datum_t, T, optional_datum_less_t> map_t;
+        typedef std::pair<typename map_t::iterator, map_t *> cursor_t;
+        map_t *out = acc.get_underlying_map(grouped::order_doesnt_matter_t());
+        const optional_datum_less_t less = out->key_comp();
+        // `std::push_heap` and friends keep the greatest element in front, so this
+        // is backwards to keep the smallest group in front.
+        auto cursor_gt = [&less](const cursor_t &a, const cursor_t &b) {
+            return less(b.first->first, a.first->first);
+        };
+        std::vector<cursor_t> heap;
+        heap.reserve(gress->size());
+        for (auto gres = gress->begin(); gres != gress->end(); ++gres) {
+            map_t *m = (*gres)->get_underlying_map(grouped::order_doesnt_matter_t());
+            if (!m->empty()) {
+                heap.push_back(std::make_pair(m->begin(), m));
+            }
+        }
+        std::make_heap(heap.begin(), heap.end(), cursor_gt);
+
+        std::vector<T *> ts;
+        std::vector<cursor_t> used;
+        while (!heap.empty()) {
+            const datum_t group = heap.front().first->first;
+            ts.clear();
+            used.clear();
+            while (!heap.empty() && !less(group, heap.front().first->first)) {
+                std::pop_heap(heap.begin(), heap.end(), cursor_gt);
+                cursor_t *cursor = &heap.back();
+                ts.push_back(&cursor->first->second);
+                used.push_back(*cursor);
+                ++cursor->first;
+                if (cursor->first == cursor->second->end()) {
+                    heap.pop_back();
+                } else {
+                    std::push_heap(heap.begin(), heap.end(), cursor_gt);
+                }
+            }
+            auto t_it = out->insert(out->end(), std::make_pair(group, default_val));
+            unshard_impl(env, &t_it->second, last_key, ts);
+            for (auto it = used.begin(); it != used.end(); ++it) {
+                it->second->erase(it->first);
+            }
+        }
+    }
     virtual void unshard_impl(env_t *env,
                               T *acc,
                               const store_key_t &last_key,
@@ -885,19 +949,31 @@ private:
 class map_trans_t : public ungrouped_op_t {
 public:
     explicit map_trans_t(const map_wire_func_t &_f)
-        : f(_f.compile_wire_func()) { }
+        : f(_f.compile_wire_func()),
+          program(f->compile_batch_program()) { }
 private:
     virtual void lst_transform(
         env_t *env, datums_t *lst, const datum_t &) {
         try {
-            for (auto it = lst->begin(); it != lst->end(); ++it) {
-                *it = f->call(env, *it)->as_datum();
+            if (program.has()) {
+                datums_t values;
+                program->eval(env, *lst, &values);
+                for (size_t i = 0; i < lst->size(); ++i) {
+                    (*lst)[i] = values[i].has()
+                        ? std::move(values[i])
+                        : f->call(env, (*lst)[i])->as_datum();
+                }
+            } else {
+                for (auto it = lst->begin(); it != lst->end(); ++it) {
+                    *it = f->call(env, *it)->as_datum();
+                }
             }
         } catch (const datum_exc_t &e) {
             throw exc_t(e, f->backtrace().get(), 1);
         }
     }
     counted_t<const func_t> f;
+    scoped_ptr_t<batch_program_t> program;
 };
 
 // Note: this removes duplicates ONLY TO SAVE NETWORK TRAFFIC.  It's possible
@@ -937,25 +1013,38 @@ public:
         : f(_f.filter_func.compile_wire_func()),
           default_val(_f.default_filter_val
                       ? _f.default_filter_val->compile_wire_func()
-                      : counted_t<const func_t>()) { }
+                      : counted_t<const func_t>()),
+          program(f->compile_batch_program()) { }
 private:
     virtual void lst_transform(
         env_t *env, datums_t *lst, const datum_t &) {
-        auto it = lst->begin();
-        auto loc = it;
+        datums_t values;
+        if (program.has()) {
+            program->eval(env, *lst, &values);
+        }
+        size_t loc = 0;
         try {
-            for (it = lst->begin(); it != lst->end(); ++it) {
-                if (f->filter_call(env, *it, default_val)) {
-                    std::swap(*loc, *it);
+            for (size_t i = 0; i < lst->size(); ++i) {
+                // `filter_call` matches objects against the row, and handles errors
+                // with `default_val`, so those rows go the slow way.
+                const bool keep =
+                    program.has()
+                    && values[i].has()
+                    && values[i].get_type() != datum_t::R_OBJECT
+                    ? values[i].as_bool()
+                    : f->filter_call(env, (*lst)[i], default_val);
+                if (keep) {
+                    std::swap((*lst)[loc], (*lst)[i]);
                     ++loc;
                 }
             }
         } catch (const datum_exc_t &e) {
             throw exc_t(e, f->backtrace().get(), 1);
         }
-        lst->erase(loc, lst->end());
+        lst->erase(lst->begin() + loc, lst->end());
     }
     counted_t<const func_t> f, default_val;
+    scoped_ptr_t<batch_program_t> program;
 };
 
 class concatmap_trans_t : public ungrouped_op_t {
@@ -1030,6 +1119,41 @@ scoped_ptr_t<op_t> make_op(const transform_variant_t &tv) {
     return scoped_ptr_t<op_t>(boost::apply_visitor(transform_visitor_t(), tv));
 }
 
+boost::optional<std::set<datum_string_t> > fields_used_by_ops(
+        const std::vector<transform_variant_t> &transforms,
+        bool terminal_uses_val) {
+    std::set<datum_string_t> fields;
+    // A row whose type is in here gets treated differently by `pluck` and friends,
+    // so we keep that field when it's there.
+    fields.insert(datum_t::reql_type_string);
+    for (auto it = transforms.begin(); it != transforms.end(); ++it) {
+        if (const filter_wire_func_t *f = boost::get<filter_wire_func_t>(&*it)) {
+            if (!f->filter_func.compile_wire_func()->fields_used_by_arg(true, &fields)) {
+                return boost::none;
+            }
+            continue;
+        }
+        counted_t<const func_t> func;
+        if (const map_wire_func_t *m = boost::get<map_wire_func_t>(&*it)) {
+            func = m->compile_wire_func();
+        } else if (const concatmap_wire_func_t *c
+                   = boost::get<concatmap_wire_func_t>(&*it)) {
+            func = c->compile_wire_func();
+        } else {
+            return boost::none;
+        }
+        // Nothing after a `map` or `concat_map` sees the row itself.
+        if (!func->fields_used_by_arg(false, &fields)) {
+            return boost::none;
+        }
+        return fields;
+    }
+    if (terminal_uses_val) {
+        return boost::none;
+    }
+    return fields;
+}
+
 RDB_IMPL_ME_SERIALIZABLE_3_SINCE_v1_13(rget_item_t, key, empty_ok(sindex_key), data);
 
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
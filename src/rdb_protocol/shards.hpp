@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <limits>
 #include <map>
+#include <set>
 #include <utility>
 #include <vector>
 
@@ -406,6 +407,14 @@ scoped_ptr_t<eager_acc_t> make_to_array(reql_version_t reql_version);
 scoped_ptr_t<eager_acc_t> make_eager_terminal(const terminal_variant_t &t);
 scoped_ptr_t<op_t> make_op(const transform_variant_t &tv);
 
+// The top-level fields of a row that `transforms` (followed by a terminal or an
+// append, which looks at whatever comes out of them if `terminal_uses_val`) could
+// look at, or `boost::none` if they could look at any of them.  Reads use this to
+// skip loading the rest of big rows.
+boost::optional<std::set<datum_string_t> > fields_used_by_ops(
+        const std::vector<transform_variant_t> &transforms,
+        bool terminal_uses_val);
+
 } // namespace ql
 
 #endif  // RDB_PROTOCOL_SHARDS_HPP_
@@ -354,6 +354,13 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         rdb_get(get.key, btree, superblock, res, trace);
     }
 
+    void operator()(const batched_point_read_t &get) {
+        response->response = batched_point_read_response_t();
+        batched_point_read_response_t *res =
+            boost::get<batched_point_read_response_t>(&response->response);
+        rdb_get_batch(get.keys, btree, superblock, res, trace);
+    }
+
     void operator()(const intersecting_geo_read_t &geo_read) {
         ql::env_t ql_env(ctx, interruptor, geo_read.optargs, trace);
 
@@ -468,18 +475,33 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
     void operator()(const distribution_read_t &dg) {
         response->response = distribution_read_response_t();
         distribution_read_response_t *res = boost::get<distribution_read_response_t>(&response->response);
+        bool key_sample_depleted;
         rdb_distribution_get(dg.max_depth, dg.region.inner.left,
-                             superblock, res);
+                             superblock, res, &key_sample_depleted);
+        if (key_sample_depleted) {
+            store->rebuild_key_sample_in_background();
+        }
+        int64_t total_keys = 0;
+        int64_t keys_in_region = 0;
         for (std::map<store_key_t, int64_t>::iterator it = res->key_counts.begin(); it != res->key_counts.end(); ) {
+            total_keys += it->second;
             if (!dg.region.inner.contains_key(store_key_t(it->first))) {
                 std::map<store_key_t, int64_t>::iterator tmp = it;
                 ++it;
                 res->key_counts.erase(tmp);
             } else {
+                keys_in_region += it->second;
                 ++it;
             }
         }
 
+        // The stat block covers the whole btree, so we assume the values in the
+        // region are about as big as the rest.
+        if (res->value_bytes > 0 && total_keys > 0) {
+            res->value_bytes = static_cast<int64_t>(
+                static_cast<double>(res->value_bytes) * keys_in_region / total_keys);
+        }
+
         // If the result is larger than the requested limit, scale it down
         if (dg.result_limit > 0 && res->key_counts.size() > dg.result_limit) {
             scale_down_distribution(dg.result_limit, &res->key_counts);
@@ -535,7 +557,9 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
                 rdb_protocol::single_sindex_status_t *s = &res->statuses[it->first.name];
                 const std::vector<char> &vec = it->second.opaque_definition;
                 s->func = std::string(&*vec.begin(), vec.size());
-                progress_completion_fraction_t frac = store->get_progress(it->second.id);
+                double blocks_per_second;
+                progress_completion_fraction_t frac
+                    = store->get_progress(it->second.id, &blocks_per_second);
                 s->ready = it->second.is_ready();
                 if (!s->ready) {
                     if (frac.estimate_of_total_nodes == -1) {
@@ -544,6 +568,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
                     } else {
                         s->blocks_processed = frac.estimate_of_released_nodes;
                         s->blocks_total = frac.estimate_of_total_nodes;
+                        s->blocks_per_second = blocks_per_second;
                     }
                 }
 
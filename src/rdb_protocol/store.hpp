@@ -16,6 +16,7 @@
 #include "buffer_cache/types.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/new_mutex.hpp"
+#include "concurrency/new_semaphore.hpp"
 #include "concurrency/rwlock.hpp"
 #include "containers/map_sentries.hpp"
 #include "containers/scoped.hpp"
@@ -25,6 +26,7 @@
 #include "rdb_protocol/protocol.hpp"
 #include "rpc/mailbox/typed.hpp"
 #include "store_view.hpp"
+#include "time.hpp"
 #include "utils.hpp"
 
 class store_t;
@@ -39,6 +41,10 @@ class txn_t;
 class cache_balancer_t;
 struct rdb_modification_report_t;
 
+// The number of leaves secondary index post construction inserts rows from at once,
+// which is how many a single `btree_parallel_traversal` processes at once.
+const int64_t MAX_CONCURRENT_POST_CONSTRUCTION_LEAVES = 16;
+
 class sindex_not_ready_exc_t : public std::exception {
 public:
     explicit sindex_not_ready_exc_t(std::string sindex_name,
@@ -83,6 +89,18 @@ public:
     virtual void destroy() = 0;
 };
 
+/* Tracks the progress of a secondary index post construction, which traverses
+several subranges of the primary btree at once. */
+class sindex_construction_progress_t : public traversal_progress_combiner_t {
+public:
+    sindex_construction_progress_t() : start_time_(current_microtime()) { }
+
+    microtime_t start_time() const { return start_time_; }
+
+private:
+    const microtime_t start_time_;
+};
+
 class store_t final : public store_view_t {
 public:
     using home_thread_mixin_t::assert_thread;
@@ -95,7 +113,8 @@ public:
             rdb_context_t *_ctx,
             io_backender_t *io_backender,
             const base_path_t &base_path,
-            outdated_index_report_t *_index_report);
+            outdated_index_report_t *_index_report,
+            bool pin_btree_upper_levels);
     ~store_t();
 
     void note_reshard();
@@ -194,10 +213,13 @@ public:
             const new_mutex_in_line_t *acq);
 
     void add_progress_tracker(
-        map_insertion_sentry_t<uuid_u, const parallel_traversal_progress_t *> *sentry,
-        uuid_u id, const parallel_traversal_progress_t *p);
+        map_insertion_sentry_t<uuid_u, const sindex_construction_progress_t *> *sentry,
+        uuid_u id, const sindex_construction_progress_t *p);
 
-    progress_completion_fraction_t get_progress(uuid_u id);
+    // `blocks_per_second_out` is set to the average rate since the post
+    // construction started, or to 0 if there's no post construction going on.
+    progress_completion_fraction_t get_progress(uuid_u id,
+                                                double *blocks_per_second_out);
 
     MUST_USE bool add_sindex(
         const sindex_name_t &name,
@@ -349,6 +371,10 @@ public:
             signal_t *interruptor)
             THROWS_ONLY(interrupted_exc_t);
 
+    // Rebuilds the primary btree's key sample (see `key_sample_t`) from the btree in
+    // a coroutine, unless a rebuild is already running.
+    void rebuild_key_sample_in_background();
+
 private:
     // Drops all sindexes if this store is not responsible for any data
     void maybe_drop_all_sindexes(const binary_blob_t &zero_metainfo,
@@ -371,6 +397,18 @@ private:
 
     void help_construct_bring_sindexes_up_to_date();
 
+    // Pins the upper levels of the primary btree and of the secondary indexes (see
+    // `pin_upper_levels()`).  Stops early if the cache runs out of room for pinned
+    // pages.  To be run in a coroutine.
+    void pin_upper_levels_in_background(
+            auto_drainer_t::lock_t store_keepalive)
+            THROWS_NOTHING;
+
+    // Internally called by `rebuild_key_sample_in_background()`
+    void rebuild_key_sample(
+            auto_drainer_t::lock_t store_keepalive)
+            THROWS_NOTHING;
+
     MUST_USE bool mark_secondary_index_deleted(
             buf_lock_t *sindex_block,
             const sindex_name_t &name);
@@ -408,7 +446,7 @@ public:
 
     std::vector<internal_disk_backed_queue_t *> sindex_queues;
     new_mutex_t sindex_queue_mutex;
-    std::map<uuid_u, const parallel_traversal_progress_t *> progress_trackers;
+    std::map<uuid_u, const sindex_construction_progress_t *> progress_trackers;
 
     rdb_context_t *ctx;
     scoped_ptr_t<ql::changefeed::server_t> changefeed_server;
@@ -417,6 +455,9 @@ public:
     // any time the set of outdated indexes for this table changes
     outdated_index_report_t *index_report;
 
+    // Whether `rebuild_key_sample()` is running.
+    bool rebuilding_key_sample;
+
     // This lock is used to pause backfills while secondary indexes are being
     // post constructed. Secondary index post construction gets in line for a write
     // lock on this and stays there for as long as it's running. It does not
@@ -425,6 +466,12 @@ public:
     // A read lock is acquired before a backfill chunk is being processed.
     rwlock_t backfill_postcon_lock;
 
+    // Post construction traverses several key ranges at once, and each traversal
+    // processes several leaves at once.  Every leaf acquires this before inserting
+    // its rows, so splitting the work doesn't multiply the write transactions that
+    // post construction starts (see `MAX_CONCURRENT_POST_CONSTRUCTION_LEAVES`).
+    new_semaphore_t post_construction_semaphore;
+
     // Mind the constructor ordering. We must destruct drainer before destructing
     // many of the other structures.
     auto_drainer_t drainer;
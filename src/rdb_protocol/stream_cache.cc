@@ -1,6 +1,12 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/stream_cache.hpp"
 
+#include <functional>
+
+#include <boost/optional.hpp>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/interruptor.hpp"
 #include "rdb_protocol/env.hpp"
 
 #include "debug.hpp"
@@ -15,6 +21,7 @@ void stream_cache_t::insert(int64_t key,
                             use_json_t use_json,
                             std::map<std::string, wire_func_t> global_optargs,
                             profile_bool_t profile_requested,
+                            prefetch_batches_t prefetch_batches,
                             counted_t<datum_stream_t> val_stream) {
     maybe_evict();
     auto res = streams.insert(
@@ -23,13 +30,19 @@ void stream_cache_t::insert(int64_t key,
                                                 use_json,
                                                 std::move(global_optargs),
                                                 profile_requested,
+                                                prefetch_batches,
                                                 val_stream)));
     guarantee(res.second);
 }
 
 void stream_cache_t::erase(int64_t key) {
-    size_t num_erased = streams.erase(key);
-    guarantee(num_erased == 1);
+    auto it = streams.find(key);
+    guarantee(it != streams.end());
+    if (it->second->prefetch.has()) {
+        prefetched_bytes -= it->second->prefetch->reserved_bytes;
+    }
+    // This waits for any prefetch to notice it's interrupted.
+    streams.erase(it);
 }
 
 bool stream_cache_t::serve(int64_t key, Response *res, signal_t *interruptor) {
@@ -41,6 +54,7 @@ bool stream_cache_t::serve(int64_t key, Response *res, signal_t *interruptor) {
     entry->last_activity = time(0);
 
     std::exception_ptr exc;
+    boost::optional<batchspec_t> next_batchspec;
     try {
         scoped_ptr_t<profile::trace_t> trace = maybe_make_profile_trace(entry->profile);
 
@@ -49,14 +63,56 @@ bool stream_cache_t::serve(int64_t key, Response *res, signal_t *interruptor) {
         batch_type_t batch_type = entry->has_sent_batch
                                       ? batch_type_t::NORMAL
                                       : batch_type_t::NORMAL_FIRST;
+        batchspec_t batchspec = batchspec_t::user(batch_type, &env);
+        // Changefeed batches wait for changes, so their timing says nothing about
+        // the client.
+        if (!entry->has_sent_batch
+            && !entry->stream->is_cfeed()
+            && batchspec_t::user_policy(&env) == batch_policy_t::ADAPTIVE) {
+            entry->tuner.init(new batch_tuner_t());
+        }
+        if (entry->tuner.has()) {
+            batchspec = entry->tuner->tune(batchspec);
+        }
+        const microtime_t read_start = current_microtime();
+        microtime_t read_usecs;
         std::vector<datum_t> ds
-            = entry->stream->next_batch(
-                &env,
-                batchspec_t::user(batch_type, &env));
-        entry->has_sent_batch = true;
+            = next_batch(&env, entry, batchspec, interruptor, &read_usecs);
         for (auto d = ds.begin(); d != ds.end(); ++d) {
             d->write_to_protobuf(res->add_response(), entry->use_json);
         }
+        if (entry->tuner.has()) {
+            const double prev_scale = entry->tuner->scale_factor();
+            entry->tuner->note_batch(
+                ds.size(), res->ByteSize(), read_usecs, entry->last_batch_rows,
+                entry->has_sent_batch ? read_start - entry->last_batch_time : 0);
+            ++rdb_ctx->ql_adaptive_batches;
+            if (entry->tuner->scale_factor() > prev_scale) {
+                ++rdb_ctx->ql_adaptive_batches_grown;
+            } else if (entry->tuner->scale_factor() < prev_scale) {
+                ++rdb_ctx->ql_adaptive_batches_shrunk;
+            }
+            if (trace.has()) {
+                profile::starter_t starter(
+                    strprintf("Adaptive batching: %zu batches, %zu rows and %zu bytes "
+                              "so far, next batch limits scaled by %g.",
+                              entry->tuner->batches_seen(),
+                              entry->tuner->rows_seen(),
+                              entry->tuner->bytes_seen(),
+                              entry->tuner->scale_factor()),
+                    trace);
+            }
+        }
+        entry->has_sent_batch = true;
+        entry->last_batch_rows = ds.size();
+        entry->last_batch_time = current_microtime();
+        if (entry->prefetch_batches == prefetch_batches_t::YES) {
+            // The tuner has seen this batch, so these are the next one's limits.
+            next_batchspec = batchspec_t::user(batch_type_t::NORMAL, &env);
+            if (entry->tuner.has()) {
+                next_batchspec = entry->tuner->tune(*next_batchspec);
+            }
+        }
         if (trace.has()) {
             trace->as_datum().write_to_protobuf(
                 res->mutable_profile(), entry->use_json);
@@ -82,10 +138,77 @@ bool stream_cache_t::serve(int64_t key, Response *res, signal_t *interruptor) {
         res->set_type(Response::SUCCESS_SEQUENCE);
     } else {
         res->set_type(cfeed ? Response::SUCCESS_FEED : Response::SUCCESS_PARTIAL);
+        if (!cfeed && next_batchspec) {
+            maybe_prefetch(entry, *next_batchspec);
+        }
     }
     return true;
 }
 
+std::vector<datum_t> stream_cache_t::next_batch(env_t *env,
+                                                entry_t *entry,
+                                                const batchspec_t &batchspec,
+                                                signal_t *interruptor,
+                                                microtime_t *read_usecs_out) {
+    if (!entry->prefetch.has()) {
+        const microtime_t start = current_microtime();
+        std::vector<datum_t> ret = entry->stream->next_batch(env, batchspec);
+        *read_usecs_out = current_microtime() - start;
+        return ret;
+    }
+    wait_interruptible(&entry->prefetch->done, interruptor);
+    scoped_ptr_t<prefetch_t> prefetch(entry->prefetch.release());
+    prefetched_bytes -= prefetch->reserved_bytes;
+    if (prefetch->exc) {
+        std::rethrow_exception(prefetch->exc);
+    }
+    *read_usecs_out = prefetch->read_usecs;
+    return std::move(prefetch->batch);
+}
+
+void stream_cache_t::maybe_prefetch(entry_t *entry, const batchspec_t &batchspec) {
+    // A prefetched batch couldn't show up in the profile of the response it goes
+    // out in.
+    if (entry->profile == profile_bool_t::PROFILE || entry->prefetch.has()) {
+        return;
+    }
+    // The row that takes a batch over its limit still goes in it, which we don't
+    // count.
+    const int64_t max_size = batchspec.get_max_size();
+    if (max_size > static_cast<int64_t>(MAX_PREFETCHED_BYTES - prefetched_bytes)) {
+        return;
+    }
+    entry->prefetch.init(new prefetch_t(batchspec));
+    entry->prefetch->reserved_bytes = max_size;
+    prefetched_bytes += max_size;
+    coro_t::spawn_sometime(std::bind(&stream_cache_t::prefetch_batch,
+                                     rdb_ctx,
+                                     entry,
+                                     auto_drainer_t::lock_t(&entry->drainer)));
+}
+
+void stream_cache_t::prefetch_batch(rdb_context_t *rdb_ctx,
+                                    entry_t *entry,
+                                    auto_drainer_t::lock_t keepalive) {
+    if (keepalive.get_drain_signal()->is_pulsed()) {
+        return;
+    }
+    prefetch_t *prefetch = entry->prefetch.get();
+    try {
+        env_t env(rdb_ctx, keepalive.get_drain_signal(), entry->global_optargs, NULL);
+        const microtime_t start = current_microtime();
+        prefetch->batch = entry->stream->next_batch(&env, prefetch->batchspec);
+        prefetch->read_usecs = current_microtime() - start;
+    } catch (const interrupted_exc_t &) {
+        // The entry is going away, so nobody will wait for the batch.
+        return;
+    } catch (const std::exception &) {
+        // We report the error when the client asks for the batch.
+        prefetch->exc = std::current_exception();
+    }
+    prefetch->done.pulse();
+}
+
 void stream_cache_t::maybe_evict() {
     // We never evict right now.
 }
@@ -94,14 +217,18 @@ stream_cache_t::entry_t::entry_t(time_t _last_activity,
                                  use_json_t _use_json,
                                  std::map<std::string, wire_func_t> _global_optargs,
                                  profile_bool_t _profile,
+                                 prefetch_batches_t _prefetch_batches,
                                  counted_t<datum_stream_t> _stream)
     : last_activity(_last_activity),
       use_json(_use_json),
       global_optargs(std::move(_global_optargs)),
       profile(_profile),
+      prefetch_batches(_prefetch_batches),
       stream(_stream),
       max_age(DEFAULT_MAX_AGE),
-      has_sent_batch(false) { }
+      has_sent_batch(false),
+      last_batch_rows(0),
+      last_batch_time(0) { }
 
 stream_cache_t::entry_t::~entry_t() { }
 
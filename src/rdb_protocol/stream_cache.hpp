@@ -7,8 +7,11 @@
 #include <map>
 #include <string>
 
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
 #include "concurrency/signal.hpp"
 #include "containers/scoped.hpp"
+#include "rdb_protocol/batching.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/ql2.pb.h"
 
@@ -19,12 +22,16 @@ class env_t;
 namespace ql {
 
 enum class reject_cfeeds_t { NO, YES };
+// Whether a cursor may read its next batch before the client asks for it, which is
+// only safe when reading it has no side effects.
+enum class prefetch_batches_t { NO, YES };
 class stream_cache_t {
 public:
     stream_cache_t(rdb_context_t *_rdb_ctx,
                    reject_cfeeds_t _reject_cfeeds)
         : rdb_ctx(_rdb_ctx),
-          reject_cfeeds(_reject_cfeeds) {
+          reject_cfeeds(_reject_cfeeds),
+          prefetched_bytes(0) {
         rassert(rdb_ctx != NULL);
     }
     MUST_USE bool contains(int64_t key);
@@ -32,12 +39,33 @@ public:
                 use_json_t use_json,
                 std::map<std::string, wire_func_t> global_optargs,
                 profile_bool_t profile_requested,
+                prefetch_batches_t prefetch_batches,
                 counted_t<datum_stream_t> val_stream);
     void erase(int64_t key);
     MUST_USE bool serve(int64_t key, Response *res, signal_t *interruptor);
 private:
+    // Prefetched batches of a connection's cursors add up to at most about this much.
+    static const size_t MAX_PREFETCHED_BYTES = 16 * MEGABYTE;
+
     void maybe_evict();
 
+    // A batch read in the background right after the previous one was sent, so the
+    // storage round trip overlaps with the client's.
+    struct prefetch_t {
+        explicit prefetch_t(const batchspec_t &_batchspec)
+            : batchspec(_batchspec), read_usecs(0), reserved_bytes(0) { }
+        // The limits the batch would have had if the client had asked for it.
+        const batchspec_t batchspec;
+        // Pulsed when `batch` or `exc` is set.
+        cond_t done;
+        std::vector<datum_t> batch;
+        std::exception_ptr exc;
+        microtime_t read_usecs;
+        // The most `batchspec` lets it take up, which counts against
+        // `MAX_PREFETCHED_BYTES` until it's served.
+        size_t reserved_bytes;
+    };
+
     struct entry_t {
         ~entry_t();
         static const time_t DEFAULT_MAX_AGE = 0; // 0 = never evict
@@ -45,20 +73,41 @@ private:
                 use_json_t use_json,
                 std::map<std::string, wire_func_t> global_optargs,
                 profile_bool_t profile,
+                prefetch_batches_t prefetch_batches,
                 counted_t<datum_stream_t> _stream);
         time_t last_activity;
         use_json_t use_json;
         std::map<std::string, wire_func_t> global_optargs;
         profile_bool_t profile;
+        prefetch_batches_t prefetch_batches;
         counted_t<datum_stream_t> stream;
         time_t max_age;
         bool has_sent_batch;
+        // For the `adaptive` batch policy.
+        scoped_ptr_t<batch_tuner_t> tuner;
+        size_t last_batch_rows;
+        microtime_t last_batch_time;
+        scoped_ptr_t<prefetch_t> prefetch;
+        // Interrupts and waits for the prefetch when the entry goes away.
+        auto_drainer_t drainer;
     private:
         DISABLE_COPYING(entry_t);
     };
 
+    void maybe_prefetch(entry_t *entry, const batchspec_t &batchspec);
+    static void prefetch_batch(rdb_context_t *rdb_ctx,
+                               entry_t *entry,
+                               auto_drainer_t::lock_t keepalive);
+    // Reads the next batch of `entry`, or takes the prefetched one.
+    std::vector<datum_t> next_batch(env_t *env,
+                                    entry_t *entry,
+                                    const batchspec_t &batchspec,
+                                    signal_t *interruptor,
+                                    microtime_t *read_usecs_out);
+
     rdb_context_t *const rdb_ctx;
     const reject_cfeeds_t reject_cfeeds;
+    size_t prefetched_bytes;
     std::map<int64_t, scoped_ptr_t<entry_t> > streams;
     DISABLE_COPYING(stream_cache_t);
 };
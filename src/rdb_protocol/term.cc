@@ -1,6 +1,7 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/term.hpp"
 
+#include "containers/arena.hpp"
 #include "containers/cow_ptr.hpp"
 #include "concurrency/cross_thread_watchable.hpp"
 #include "rdb_protocol/counted_term.hpp"
@@ -192,6 +193,30 @@ counted_t<const term_t> compile_term(compile_env_t *env, protob_t<const Term> t)
     unreachable();
 }
 
+counted_t<const term_t> compile_query_term(const protob_t<Query> &q) {
+    compile_env_t compile_env((var_visibility_t()));
+    // The terms die together with the root term, so we allocate them together.
+    // Compiling doesn't block, which the arena scope relies on.
+    counted_t<arena_t> arena = make_counted<arena_t>();
+    arena_scope_t arena_scope(arena.get());
+    ASSERT_NO_CORO_WAITING;
+    return compile_term(&compile_env, q.make_child(&q->query()));
+}
+
+// A cursor only reads ahead if reading it (and the global optargs it may evaluate)
+// has no side effects.
+prefetch_batches_t query_prefetch_batches(const Query &q) {
+    if (!term_is_deterministic_read(q.query())) {
+        return prefetch_batches_t::NO;
+    }
+    for (int i = 0; i < q.global_optargs_size(); ++i) {
+        if (!term_is_deterministic_read(q.global_optargs(i).val())) {
+            return prefetch_batches_t::NO;
+        }
+    }
+    return prefetch_batches_t::YES;
+}
+
 void run(protob_t<Query> q,
          rdb_context_t *ctx,
          signal_t *interruptor,
@@ -218,9 +243,7 @@ void run(protob_t<Query> q,
 
         counted_t<const term_t> root_term;
         try {
-            Term *t = q->mutable_query();
-            compile_env_t compile_env((var_visibility_t()));
-            root_term = compile_term(&compile_env, q.make_child(t));
+            root_term = compile_query_term(q);
         } catch (const exc_t &e) {
             fill_error(res, Response::COMPILE_ERROR, e.what(), e.backtrace());
             return;
@@ -278,6 +301,7 @@ void run(protob_t<Query> q,
                                          use_json,
                                          env.get_all_optargs(),
                                          profile,
+                                         query_prefetch_batches(*q),
                                          seq);
                     bool b = stream_cache->serve(token, res, interruptor);
                     r_sanity_check(b);
@@ -336,9 +360,9 @@ void run(protob_t<Query> q,
         }
 
         // NOREPLY_WAIT is just a no-op.
-        // This works because we only evaluate one Query at a time
-        // on the connection level. Once we get to the NOREPLY_WAIT Query
-        // we know that all previous Queries have completed processing.
+        // This works because the connection doesn't start a NOREPLY_WAIT
+        // Query until all previous Queries have completed processing (see
+        // `connection_queries_t` in protob.cc).
 
         // Send back a WAIT_COMPLETE response.
         res->set_type(Response::WAIT_COMPLETE);
@@ -352,6 +376,14 @@ runtime_term_t::runtime_term_t(protob_t<const Backtrace> bt)
 
 runtime_term_t::~runtime_term_t() { }
 
+void *runtime_term_t::operator new(size_t size) {
+    return arena_operator_new(size);
+}
+
+void runtime_term_t::operator delete(void *p) {
+    arena_operator_delete(p);
+}
+
 term_t::term_t(protob_t<const Term> _src)
     : runtime_term_t(get_backtrace(_src)), src(_src) { }
 term_t::~term_t() { }
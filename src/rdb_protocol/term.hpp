@@ -2,6 +2,8 @@
 #ifndef RDB_PROTOCOL_TERM_HPP_
 #define RDB_PROTOCOL_TERM_HPP_
 
+#include <string>
+
 #include "containers/counted.hpp"
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/error.hpp"
@@ -31,6 +33,10 @@ class runtime_term_t : public slow_atomic_countable_t<runtime_term_t>,
 public:
     virtual ~runtime_term_t();
 
+    // Terms compiled together come from the same arena (see `run`).
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+
     scoped_ptr_t<val_t> eval(scope_env_t *env, eval_flags_t eval_flags = NO_FLAGS) const;
 
     virtual const char *name() const = 0;
@@ -72,6 +78,9 @@ private:
 
 counted_t<const term_t> compile_term(compile_env_t *env, protob_t<const Term> t);
 
+// Compiles `q`'s query, with its terms allocated together (see `arena_t`).
+counted_t<const term_t> compile_query_term(const protob_t<Query> &q);
+
 } // namespace ql
 
 #endif // RDB_PROTOCOL_TERM_HPP_
@@ -72,33 +72,9 @@ public:
             term_recurse(t, &term_walker_t::propwalk);
         }
     }
-private:
-    // Recurses to child terms.
-    void term_recurse(Term *t, void (term_walker_t::*callback)(Term *, Term *,
-                                                                backtrace_t::frame_t)) {
-        for (int i = 0; i < t->args_size(); ++i) {
-            (this->*callback)(t->mutable_args(i), t, backtrace_t::frame_t(i));
-        }
-        for (int i = 0; i < t->optargs_size(); ++i) {
-            Term_AssocPair *ap = t->mutable_optargs(i);
-            (this->*callback)(ap->mutable_val(), t, backtrace_t::frame_t(ap->key()));
-        }
-    }
-
-    // Adds a backtrace to a term.
-    void add_bt(Term *t, Term *parent, backtrace_t::frame_t frame) {
-        r_sanity_check(t->ExtensionSize(ql2::extension::backtrace) == 0);
-        if (parent) {
-            *t->MutableExtension(ql2::extension::backtrace)
-                = parent->GetExtension(ql2::extension::backtrace);
-        } else {
-            r_sanity_check(frame.is_head());
-        }
-        *t->MutableExtension(ql2::extension::backtrace)->add_frames() = frame.toproto();
-    }
 
     // Returns true if `t` is a write or a meta op.
-    static bool term_is_write_or_meta(Term *t) {
+    static bool term_is_write_or_meta(const Term *t) {
         switch (t->type()) {
         case Term::UPDATE:
         case Term::DELETE:
@@ -271,6 +247,31 @@ private:
         }
     }
 
+private:
+    // Recurses to child terms.
+    void term_recurse(Term *t, void (term_walker_t::*callback)(Term *, Term *,
+                                                                backtrace_t::frame_t)) {
+        for (int i = 0; i < t->args_size(); ++i) {
+            (this->*callback)(t->mutable_args(i), t, backtrace_t::frame_t(i));
+        }
+        for (int i = 0; i < t->optargs_size(); ++i) {
+            Term_AssocPair *ap = t->mutable_optargs(i);
+            (this->*callback)(ap->mutable_val(), t, backtrace_t::frame_t(ap->key()));
+        }
+    }
+
+    // Adds a backtrace to a term.
+    void add_bt(Term *t, Term *parent, backtrace_t::frame_t frame) {
+        r_sanity_check(t->ExtensionSize(ql2::extension::backtrace) == 0);
+        if (parent) {
+            *t->MutableExtension(ql2::extension::backtrace)
+                = parent->GetExtension(ql2::extension::backtrace);
+        } else {
+            r_sanity_check(frame.is_head());
+        }
+        *t->MutableExtension(ql2::extension::backtrace)->add_frames() = frame.toproto();
+    }
+
     // Returns true if writes are still legal at this node.  Basically:
     // * Once writes become illegal, they are never legal again.
     // * Writes are legal at the root.
@@ -489,5 +490,26 @@ void propagate_backtrace(Term *root, const Backtrace *bt) {
     term_walker_t walker(root, bt);
 }
 
+bool term_is_deterministic_read(const Term &root) {
+    if (term_walker_t::term_is_write_or_meta(&root)
+        || root.type() == Term::JAVASCRIPT
+        || root.type() == Term::HTTP
+        || root.type() == Term::RANDOM
+        || root.type() == Term::UUID) {
+        return false;
+    }
+    for (int i = 0; i < root.args_size(); ++i) {
+        if (!term_is_deterministic_read(root.args(i))) {
+            return false;
+        }
+    }
+    for (int i = 0; i < root.optargs_size(); ++i) {
+        if (!term_is_deterministic_read(root.optargs(i).val())) {
+            return false;
+        }
+    }
+    return true;
+}
+
 
 }  // namespace ql
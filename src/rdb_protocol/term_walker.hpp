@@ -15,6 +15,11 @@ void preprocess_term(Term *root);
 // backtraces in the macroexpanded nodes).
 void propagate_backtrace(Term *root, const Backtrace *bt);
 
+// Returns true if evaluating `root` has no side effects and does the same thing each
+// time on the same data: it has no writes or meta ops, and no `r.js`, `r.http`,
+// `r.random` or `r.uuid`.
+bool term_is_deterministic_read(const Term &root);
+
 } // namespace ql
 
 #endif // RDB_PROTOCOL_TERM_WALKER_HPP_
@@ -675,7 +675,36 @@ counted_t<term_t> make_slice_term(
 
 counted_t<term_t> make_limit_term(
     compile_env_t *env, const protob_t<const Term> &term) {
-    return make_counted<limit_term_t>(env, term);
+    // If we're limiting an unindexed `order_by` to a literal number of rows, we
+    // tell it so (see `orderby_term_t`), and it keeps only those rows.
+    const Term *order_by = NULL;
+    double limit = -1;
+    if (term->args_size() == 2
+        && term->args(0).type() == Term::ORDER_BY
+        && term->args(1).type() == Term::DATUM
+        && term->args(1).datum().type() == Datum::R_NUM) {
+        order_by = &term->args(0);
+        limit = term->args(1).datum().r_num();
+        for (int i = 0; i < order_by->optargs_size(); ++i) {
+            if (order_by->optargs(i).key() == "index") {
+                order_by = NULL;
+            }
+        }
+    }
+    if (order_by == NULL || !(0 <= limit && limit <= INT32_MAX)
+        || limit != static_cast<double>(static_cast<int32_t>(limit))) {
+        return make_counted<limit_term_t>(env, term);
+    }
+
+    const Term *outer_order_by = env->limited_order_by;
+    const size_t outer_limit = env->order_by_limit;
+    env->limited_order_by = order_by;
+    env->order_by_limit = static_cast<size_t>(limit);
+    counted_t<term_t> res = make_counted<limit_term_t>(env, term);
+    // An `order_by` we're nested in might be limited too.
+    env->limited_order_by = outer_order_by;
+    env->order_by_limit = outer_limit;
+    return res;
 }
 
 counted_t<term_t> make_set_insert_term(
@@ -2,9 +2,12 @@
 #include "rdb_protocol/terms/terms.hpp"
 
 #include <string>
+#include <vector>
 
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/error.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/join.hpp"
 #include "rdb_protocol/pb_utils.hpp"
 #include "rdb_protocol/minidriver.hpp"
 
@@ -47,6 +50,46 @@ private:
     counted_t<const term_t> real;
 };
 
+// The function `inner_join` and `outer_join` call with each left row.
+r::reql_t inner_join_per_row(protob_t<const Term> in) {
+    const Term &right = in->args(1);
+    const Term &func = in->args(2);
+    auto n = pb::dummy_var_t::INNERJOIN_N;
+    auto m = pb::dummy_var_t::INNERJOIN_M;
+
+    return r::fun(n,
+                  r::expr(right).concat_map(
+                      r::fun(m,
+                          r::branch(
+                              r::expr(func)(r::var(n), r::var(m)),
+                              r::array(r::object(
+                                      r::optarg("left", n), r::optarg("right", m))),
+                              r::array()))));
+}
+
+r::reql_t outer_join_per_row(protob_t<const Term> in) {
+    const Term &right = in->args(1);
+    const Term &func = in->args(2);
+    auto n = pb::dummy_var_t::OUTERJOIN_N;
+    auto m = pb::dummy_var_t::OUTERJOIN_M;
+    auto lst = pb::dummy_var_t::OUTERJOIN_LST;
+
+    r::reql_t inner_concat_map =
+        r::expr(right).concat_map(
+            r::fun(m,
+                r::branch(
+                    r::expr(func)(n, m),
+                    r::array(r::object(r::optarg("left", n), r::optarg("right", m))),
+                    r::array())));
+
+    return r::fun(n,
+                  std::move(inner_concat_map).coerce_to("ARRAY").do_(lst,
+                      r::branch(
+                          r::expr(lst).count() > 0,
+                          lst,
+                          r::array(r::object(r::optarg("left", n))))));
+}
+
 class inner_join_term_t : public rewrite_term_t {
 public:
     inner_join_term_t(compile_env_t *env, const protob_t<const Term> &term)
@@ -56,21 +99,8 @@ public:
                              UNUSED const pb_rcheckable_t *bt_src,
                              protob_t<const Term> optargs_in) {
         const Term &left = in->args(0);
-        const Term &right = in->args(1);
-        const Term &func = in->args(2);
-        auto n = pb::dummy_var_t::INNERJOIN_N;
-        auto m = pb::dummy_var_t::INNERJOIN_M;
 
-        r::reql_t term =
-            r::expr(left).concat_map(
-                r::fun(n,
-                    r::expr(right).concat_map(
-                        r::fun(m,
-                            r::branch(
-                                r::expr(func)(r::var(n), r::var(m)),
-                                r::array(r::object(
-                                        r::optarg("left", n), r::optarg("right", m))),
-                                r::array())))));
+        r::reql_t term = r::expr(left).concat_map(inner_join_per_row(in));
 
         term.copy_optargs_from_term(*optargs_in);
         return term;
@@ -88,28 +118,8 @@ public:
                              UNUSED const pb_rcheckable_t *bt_src,
                              protob_t<const Term> optargs_in) {
         const Term &left = in->args(0);
-        const Term &right = in->args(1);
-        const Term &func = in->args(2);
-        auto n = pb::dummy_var_t::OUTERJOIN_N;
-        auto m = pb::dummy_var_t::OUTERJOIN_M;
-        auto lst = pb::dummy_var_t::OUTERJOIN_LST;
-
-        r::reql_t inner_concat_map =
-            r::expr(right).concat_map(
-                r::fun(m,
-                    r::branch(
-                        r::expr(func)(n, m),
-                        r::array(r::object(r::optarg("left", n), r::optarg("right", m))),
-                        r::array())));
 
-        r::reql_t term =
-            r::expr(left).concat_map(
-                r::fun(n,
-                    std::move(inner_concat_map).coerce_to("ARRAY").do_(lst,
-                        r::branch(
-                            r::expr(lst).count() > 0,
-                            lst,
-                            r::array(r::object(r::optarg("left", n)))))));
+        r::reql_t term = r::expr(left).concat_map(outer_join_per_row(in));
 
         term.copy_optargs_from_term(*optargs_in);
         return term;
@@ -118,16 +128,174 @@ public:
     virtual const char *name() const { return "outer_join"; }
 };
 
-class eq_join_term_t : public rewrite_term_t {
+// Gets the variables of a literal `FUNC`.
+bool func_params(const Term &func, std::vector<sym_t> *params_out) {
+    if (func.type() != Term::FUNC || func.args_size() != 2 || func.optargs_size() != 0) {
+        return false;
+    }
+    const Term &vars = func.args(0);
+    if (vars.type() == Term::DATUM) {
+        const Datum &d = vars.datum();
+        if (d.type() != Datum::R_ARRAY) {
+            return false;
+        }
+        for (int i = 0; i < d.r_array_size(); ++i) {
+            if (d.r_array(i).type() != Datum::R_NUM) {
+                return false;
+            }
+            params_out->push_back(sym_t(d.r_array(i).r_num()));
+        }
+    } else if (vars.type() == Term::MAKE_ARRAY) {
+        for (int i = 0; i < vars.args_size(); ++i) {
+            const Term &var = vars.args(i);
+            if (var.type() != Term::DATUM || var.datum().type() != Datum::R_NUM) {
+                return false;
+            }
+            params_out->push_back(sym_t(var.datum().r_num()));
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Whether `term` might refer to `var` (or to a variable we can't tell apart from
+// it).
+bool might_use_var(const Term &term, sym_t var) {
+    switch (term.type()) {
+    case Term::IMPLICIT_VAR:
+        return true;
+    case Term::VAR:
+        return term.args_size() != 1
+            || term.args(0).type() != Term::DATUM
+            || term.args(0).datum().type() != Datum::R_NUM
+            || sym_t(term.args(0).datum().r_num()).value == var.value;
+    default:
+        break;
+    }
+    for (int i = 0; i < term.args_size(); ++i) {
+        if (might_use_var(term.args(i), var)) {
+            return true;
+        }
+    }
+    for (int i = 0; i < term.optargs_size(); ++i) {
+        if (might_use_var(term.optargs(i).val(), var)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+r::reql_t key_func(sym_t var, const Term &body) {
+    std::vector<r::reql_t> vars;
+    vars.emplace_back(static_cast<double>(var.value));
+    return r::reql_t(Term::FUNC, std::move(vars), r::expr(body));
+}
+
+bool equality_join_keys(const Term &join,
+                        protob_t<Term> *left_key_out,
+                        protob_t<Term> *right_key_out) {
+    if (join.args_size() != 3) {
+        return false;
+    }
+    const Term &func = join.args(2);
+    std::vector<sym_t> params;
+    if (!func_params(func, &params) || params.size() != 2) {
+        return false;
+    }
+    const Term &body = func.args(1);
+    if (body.type() != Term::EQ || body.args_size() != 2 || body.optargs_size() != 0) {
+        return false;
+    }
+    for (int left_side = 0; left_side < 2; ++left_side) {
+        const Term &left_key = body.args(left_side);
+        const Term &right_key = body.args(1 - left_side);
+        if (left_key.type() != Term::ARGS && right_key.type() != Term::ARGS
+            && !might_use_var(left_key, params[1])
+            && !might_use_var(right_key, params[0])) {
+            *left_key_out = key_func(params[0], left_key).release_counted();
+            *right_key_out = key_func(params[1], right_key).release_counted();
+            return true;
+        }
+    }
+    return false;
+}
+
+// Runs `inner_join` and `outer_join` with an equality predicate through
+// `equi_join_datum_stream_t`, which evaluates each side's key once per row instead
+// of the predicate once per pair.  Grouped and changefeed inputs, predicates that
+// aren't deterministic, and servers with nowhere to spill the sides to, use the
+// nested loop.
+class equi_join_term_t : public grouped_seq_op_term_t {
 public:
-    eq_join_term_t(compile_env_t *env, const protob_t<const Term> &term) :
-        rewrite_term_t(env, term, argspec_t(3), rewrite) { }
+    equi_join_term_t(compile_env_t *env, const protob_t<const Term> &term,
+                     join_kind_t _kind,
+                     r::reql_t (*rewrite_per_row)(protob_t<const Term> in),
+                     protob_t<Term> _left_key_func,
+                     protob_t<Term> _right_key_func)
+        : grouped_seq_op_term_t(env, term, argspec_t(3)),
+          kind(_kind),
+          per_row_func(make_counted_term()),
+          left_key_func(std::move(_left_key_func)),
+          right_key_func(std::move(_right_key_func)) {
+        per_row_func->Swap(&rewrite_per_row(term).get());
+        propagate(per_row_func.get());
+        per_row = compile_term(env, per_row_func);
+        propagate(left_key_func.get());
+        left_key = compile_term(env, left_key_func);
+        propagate(right_key_func.get());
+        right_key = compile_term(env, right_key_func);
+    }
 private:
+    virtual scoped_ptr_t<val_t> eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
+        counted_t<datum_stream_t> stream = args->arg(env, 0)->as_seq(env->env);
+        rdb_context_t *ctx = env->env->get_rdb_ctx();
+        if (!stream->is_grouped() && !stream->is_cfeed()
+            && per_row->is_deterministic()
+            && ctx != NULL && ctx->io_backender != NULL) {
+            counted_t<datum_stream_t> right = args->arg(env, 1)->as_seq(env->env);
+            if (!right->is_grouped() && !right->is_cfeed()) {
+                return new_val(env->env, make_counted<equi_join_datum_stream_t>(
+                                   env->env, kind,
+                                   stream, left_key->eval(env)->as_func(),
+                                   right, right_key->eval(env)->as_func(),
+                                   backtrace()));
+            }
+        }
+        stream->add_transformation(
+            concatmap_wire_func_t(result_hint_t::NO_HINT,
+                                  per_row->eval(env)->as_func()),
+            backtrace());
+        return new_val(env->env, stream);
+    }
+    virtual const char *name() const {
+        return kind == join_kind_t::INNER ? "inner_join" : "outer_join";
+    }
 
-    static r::reql_t rewrite(protob_t<const Term> in,
-                             UNUSED const pb_rcheckable_t *bt_src,
-                             protob_t<const Term> optargs_in) {
-        const Term &left = in->args(0);
+    const join_kind_t kind;
+    protob_t<Term> per_row_func;
+    protob_t<Term> left_key_func;
+    protob_t<Term> right_key_func;
+    counted_t<const term_t> per_row;
+    counted_t<const term_t> left_key;
+    counted_t<const term_t> right_key;
+};
+
+// Joins on the primary key with `eq_join_datum_stream_t`, which looks up a batch of
+// left rows at a time.  Joins on a secondary index, and joins of grouped streams,
+// still use the rewritten `concat_map`, which does one `get_all` per left row.
+class eq_join_term_t : public grouped_seq_op_term_t {
+public:
+    eq_join_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : grouped_seq_op_term_t(env, term, argspec_t(3), optargspec_t({"index"})),
+          per_row_func(make_counted_term()) {
+        per_row_func->Swap(&rewrite_per_row_func(term, term).get());
+        propagate(per_row_func.get());
+        per_row = compile_term(env, per_row_func);
+    }
+private:
+    static r::reql_t rewrite_per_row_func(protob_t<const Term> in,
+                                          protob_t<const Term> optargs_in) {
         const Term &left_attr = in->args(1);
         const Term &right = in->args(2);
 
@@ -138,17 +306,37 @@ private:
             r::expr(right).get_all(
                 r::expr(left_attr)(row, r::optarg("_SHORTCUT_", GET_FIELD_SHORTCUT)));
         get_all.copy_optargs_from_term(*optargs_in);
-        return r::expr(left).concat_map(
-            r::fun(row,
-                   r::branch(
-                       r::null() == row,
-                       r::array(),
-                       std::move(get_all).default_(r::array()).map(
-                           r::fun(v, r::object(r::optarg("left", row),
-                                               r::optarg("right", v)))))));
+        return r::fun(row,
+                      r::branch(
+                          r::null() == row,
+                          r::array(),
+                          std::move(get_all).default_(r::array()).map(
+                              r::fun(v, r::object(r::optarg("left", row),
+                                                  r::optarg("right", v))))));
+    }
 
+    virtual scoped_ptr_t<val_t> eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
+        counted_t<datum_stream_t> stream = args->arg(env, 0)->as_seq(env->env);
+        if (!stream->is_grouped()) {
+            counted_t<table_t> table = args->arg(env, 2)->as_table();
+            scoped_ptr_t<val_t> index = args->optarg(env, "index");
+            if (!index || index->as_str().to_std() == table->get_pkey()) {
+                counted_t<const func_t> left_attr =
+                    args->arg(env, 1)->as_func(GET_FIELD_SHORTCUT);
+                return new_val(env->env, make_counted<eq_join_datum_stream_t>(
+                                   stream, left_attr, table));
+            }
+        }
+        stream->add_transformation(
+            concatmap_wire_func_t(result_hint_t::NO_HINT,
+                                  per_row->eval(env)->as_func()),
+            backtrace());
+        return new_val(env->env, stream);
     }
     virtual const char *name() const { return "eq_join"; }
+
+    protob_t<Term> per_row_func;
+    counted_t<const term_t> per_row;
 };
 
 class delete_term_t : public rewrite_term_t {
@@ -268,10 +456,22 @@ counted_t<term_t> make_skip_term(
 }
 counted_t<term_t> make_inner_join_term(
     compile_env_t *env, const protob_t<const Term> &term) {
+    protob_t<Term> left_key, right_key;
+    if (equality_join_keys(*term, &left_key, &right_key)) {
+        return make_counted<equi_join_term_t>(env, term, join_kind_t::INNER,
+                                              &inner_join_per_row,
+                                              left_key, right_key);
+    }
     return make_counted<inner_join_term_t>(env, term);
 }
 counted_t<term_t> make_outer_join_term(
     compile_env_t *env, const protob_t<const Term> &term) {
+    protob_t<Term> left_key, right_key;
+    if (equality_join_keys(*term, &left_key, &right_key)) {
+        return make_counted<equi_join_term_t>(env, term, join_kind_t::OUTER,
+                                              &outer_join_per_row,
+                                              left_key, right_key);
+    }
     return make_counted<outer_join_term_t>(env, term);
 }
 counted_t<term_t> make_eq_join_term(
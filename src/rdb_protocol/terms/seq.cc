@@ -1,14 +1,18 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/terms.hpp"
 
+#include <map>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "rdb_protocol/btree.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/math_utils.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
+#include "rdb_protocol/real_table.hpp"
 
 namespace ql {
 
@@ -27,16 +31,17 @@ private:
             func = args->arg(env, 1)->as_func(GET_FIELD_SHORTCUT);
         }
         if (!func.has() && !idx.has()) {
-            // TODO: make this use a table slice.
             if (uses_idx() && v->get_type().is_convertible(val_t::type_t::TABLE)) {
-                return on_idx(env->env, v->as_table(), std::move(idx));
+                return on_idx(env->env, v->as_table_slice(), std::move(idx));
             } else {
                 return v->as_seq(env->env)->run_terminal(env->env, T(backtrace()));
             }
         } else if (func.has() && !idx.has()) {
             return v->as_seq(env->env)->run_terminal(env->env, T(backtrace(), func));
         } else if (!func.has() && idx.has()) {
-            return on_idx(env->env, v->as_table(), std::move(idx));
+            // A slice from `between` on the same index works too, so
+            // `between(...).max({index: ...})` reads one key of the range.
+            return on_idx(env->env, v->as_table_slice(), std::move(idx));
         } else {
             rfail(base_exc_t::GENERIC,
                   "Cannot provide both a function and an index to %s.",
@@ -45,7 +50,7 @@ private:
     }
     virtual bool uses_idx() const = 0;
     virtual scoped_ptr_t<val_t> on_idx(
-        env_t *env, counted_t<table_t> tbl, scoped_ptr_t<val_t> idx) const = 0;
+        env_t *env, counted_t<table_slice_t> slice, scoped_ptr_t<val_t> idx) const = 0;
 };
 
 template<class T>
@@ -56,7 +61,7 @@ protected:
 private:
     virtual bool uses_idx() const { return false; }
     virtual scoped_ptr_t<val_t> on_idx(
-        env_t *, counted_t<table_t>, scoped_ptr_t<val_t>) const {
+        env_t *, counted_t<table_slice_t>, scoped_ptr_t<val_t>) const {
         rfail(base_exc_t::GENERIC, "Cannot call %s on an index.", this->name());
     }
 };
@@ -84,16 +89,14 @@ protected:
 private:
     virtual bool uses_idx() const { return true; }
     virtual scoped_ptr_t<val_t> on_idx(
-        env_t *env, counted_t<table_t> tbl, scoped_ptr_t<val_t> idx) const {
-        boost::optional<std::string> idx_str;
-        if (idx.has()) {
-            idx_str = idx->as_str().to_std();
-        }
-        counted_t<table_slice_t> slice(new table_slice_t(tbl, idx_str, sorting()));
+        env_t *env, counted_t<table_slice_t> slice, scoped_ptr_t<val_t> idx) const {
+        std::string idx_str = idx.has()
+            ? idx->as_str().to_std()
+            : slice->get_tbl()->get_pkey();
         return term_t::new_val(single_selection_t::from_slice(
             env,
             term_t::backtrace(),
-            slice,
+            slice->with_sorting(idx_str, sorting()),
             strprintf("`%s` found no entries in the specified index.",
                       this->name())));
     }
@@ -260,11 +263,234 @@ private:
     virtual const char *name() const { return "group"; }
 };
 
+// A comparison in a filter predicate between a field of the row and a value that
+// doesn't depend on the row, like `r.row('ts').lt(t)` or the `status: 'open'` in
+// `filter({status: 'open'})`.  If the field has a secondary index, `filter_term_t`
+// can read a range of the index instead of the whole table.
+struct filter_index_bound_t {
+    datum_string_t field;
+    // `EQ`, `LT`, `LE`, `GT` or `GE`, with the field on the left.
+    Term::TermType op;
+    // The value is either a literal or a term to evaluate.
+    datum_t constant;
+    counted_t<const term_t> value;
+};
+
+bool is_filter_row(const Term &t, sym_t arg) {
+    return t.type() == Term::IMPLICIT_VAR
+        || (t.type() == Term::VAR
+            && t.args_size() == 1
+            && t.args(0).type() == Term::DATUM
+            && t.args(0).datum().type() == Datum::R_NUM
+            && t.args(0).datum().r_num() == static_cast<double>(arg.value));
+}
+
+bool filter_term_uses_row(const Term &t, sym_t arg) {
+    if (is_filter_row(t, arg)) {
+        return true;
+    }
+    for (int i = 0; i < t.args_size(); ++i) {
+        if (filter_term_uses_row(t.args(i), arg)) {
+            return true;
+        }
+    }
+    for (int i = 0; i < t.optargs_size(); ++i) {
+        if (filter_term_uses_row(t.optargs(i).val(), arg)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Indexes only hold numbers, strings, bools, pseudotypes and arrays, so these are
+// the literals we look up.
+bool is_filter_index_literal(const Datum &d) {
+    return d.type() == Datum::R_NUM
+        || d.type() == Datum::R_STR
+        || d.type() == Datum::R_BOOL;
+}
+
+Term::TermType flip_comparison(Term::TermType op) {
+    switch (op) {
+    case Term::LT: return Term::GT;
+    case Term::LE: return Term::GE;
+    case Term::GT: return Term::LT;
+    case Term::GE: return Term::LE;
+    default: return op;
+    }
+}
+
+// Adds the bound for `t` if it compares a field of the row with something else.
+void collect_filter_comparison(compile_env_t *env,
+                               const protob_t<const Term> &t,
+                               sym_t arg,
+                               std::vector<filter_index_bound_t> *bounds_out) {
+    switch (t->type()) {
+    case Term::EQ: // fallthru
+    case Term::LT: // fallthru
+    case Term::LE: // fallthru
+    case Term::GT: // fallthru
+    case Term::GE:
+        break;
+    default:
+        return;
+    }
+    if (t->args_size() != 2 || t->optargs_size() != 0) {
+        return;
+    }
+    for (int field_arg = 0; field_arg < 2; ++field_arg) {
+        const Term &field = t->args(field_arg);
+        const Term &value = t->args(1 - field_arg);
+        if ((field.type() != Term::GET_FIELD && field.type() != Term::BRACKET)
+            || field.args_size() != 2 || field.optargs_size() != 0
+            || !is_filter_row(field.args(0), arg)
+            || field.args(1).type() != Term::DATUM
+            || field.args(1).datum().type() != Datum::R_STR
+            || filter_term_uses_row(value, arg)) {
+            continue;
+        }
+        filter_index_bound_t bound;
+        bound.field = datum_string_t(field.args(1).datum().r_str());
+        bound.op = field_arg == 0 ? t->type() : flip_comparison(t->type());
+        if (value.type() == Term::DATUM) {
+            if (!is_filter_index_literal(value.datum())) {
+                return;
+            }
+            bound.constant = to_datum(&value.datum(), configured_limits_t());
+        } else {
+            bound.value = compile_term(env, t.make_child(&value));
+            // We evaluate it once more to pick the range of the index.
+            if (!bound.value->is_deterministic()) {
+                return;
+            }
+        }
+        bounds_out->push_back(std::move(bound));
+        return;
+    }
+}
+
+// Adds the bounds for an object used as a filter predicate, whose fields
+// `filter_match` compares with `==` unless they're objects themselves.
+void collect_filter_object_fields(const Term &t,
+                                  std::vector<filter_index_bound_t> *bounds_out) {
+    std::vector<std::pair<std::string, const Datum *> > fields;
+    if (t.type() == Term::MAKE_OBJ) {
+        for (int i = 0; i < t.optargs_size(); ++i) {
+            fields.push_back(std::make_pair(
+                t.optargs(i).key(),
+                t.optargs(i).val().type() == Term::DATUM
+                    ? &t.optargs(i).val().datum()
+                    : NULL));
+        }
+    } else if (t.type() == Term::DATUM && t.datum().type() == Datum::R_OBJECT) {
+        for (int i = 0; i < t.datum().r_object_size(); ++i) {
+            fields.push_back(std::make_pair(t.datum().r_object(i).key(),
+                                            &t.datum().r_object(i).val()));
+        }
+    }
+    for (auto it = fields.begin(); it != fields.end(); ++it) {
+        // Pseudotypes aren't matched field by field.
+        if (it->first == datum_t::reql_type_string.to_std()) {
+            return;
+        }
+    }
+    for (auto it = fields.begin(); it != fields.end(); ++it) {
+        if (it->second != NULL && is_filter_index_literal(*it->second)) {
+            filter_index_bound_t bound;
+            bound.field = datum_string_t(it->first);
+            bound.op = Term::EQ;
+            bound.constant = to_datum(it->second, configured_limits_t());
+            bounds_out->push_back(std::move(bound));
+        }
+    }
+}
+
+// Adds the comparisons that every row passing the filter `predicate` must satisfy
+// and that an index could find.
+void collect_filter_index_bounds(compile_env_t *env,
+                                 const protob_t<const Term> &predicate,
+                                 std::vector<filter_index_bound_t> *bounds_out) {
+    if (predicate->type() != Term::FUNC) {
+        collect_filter_object_fields(*predicate, bounds_out);
+        return;
+    }
+    if (predicate->args_size() != 2) {
+        return;
+    }
+    const Term &params = predicate->args(0);
+    const Datum *param = NULL;
+    if (params.type() == Term::DATUM
+        && params.datum().type() == Datum::R_ARRAY
+        && params.datum().r_array_size() == 1) {
+        param = &params.datum().r_array(0);
+    } else if (params.type() == Term::MAKE_ARRAY
+               && params.args_size() == 1
+               && params.args(0).type() == Term::DATUM) {
+        param = &params.args(0).datum();
+    }
+    if (param == NULL || param->type() != Datum::R_NUM) {
+        return;
+    }
+    sym_t arg(param->r_num());
+
+    protob_t<const Term> body = predicate.make_child(&predicate->args(1));
+    if (body->type() == Term::MAKE_OBJ || body->type() == Term::DATUM) {
+        collect_filter_object_fields(*body, bounds_out);
+    } else if (body->type() == Term::ALL && body->optargs_size() == 0) {
+        for (int i = 0; i < body->args_size(); ++i) {
+            collect_filter_comparison(env, body.make_child(&body->args(i)), arg,
+                                      bounds_out);
+        }
+    } else {
+        collect_filter_comparison(env, body, arg, bounds_out);
+    }
+}
+
+// Maps fields to the names of the indexes on `tbl` that are ready to read and whose
+// function just gets that field, starting with the primary key.
+std::map<datum_string_t, std::string> indexes_by_field(env_t *env, table_t *tbl) {
+    std::map<datum_string_t, std::string> ret;
+    ret.insert(std::make_pair(datum_string_t(tbl->get_pkey()), tbl->get_pkey()));
+    datum_t statuses = tbl->sindex_status(env, std::set<std::string>());
+    for (size_t i = 0; i < statuses.arr_size(); ++i) {
+        datum_t status = statuses.get(i);
+        if (!status.get_field("ready").as_bool()
+            || status.get_field("outdated").as_bool()
+            || status.get_field("multi").as_bool()
+            || status.get_field("geo").as_bool()) {
+            continue;
+        }
+        const datum_string_t &blob = status.get_field("function").as_binary();
+        const size_t prefix_sz = strlen(sindex_blob_prefix);
+        if (blob.size() < prefix_sz
+            || memcmp(blob.data(), sindex_blob_prefix, prefix_sz) != 0) {
+            continue;
+        }
+        sindex_disk_info_t sindex_info;
+        try {
+            deserialize_sindex_info(
+                std::vector<char>(blob.data() + prefix_sz, blob.data() + blob.size()),
+                &sindex_info);
+        } catch (const archive_exc_t &) {
+            continue;
+        }
+        datum_string_t field;
+        if (sindex_info.mapping.compile_wire_func()->returns_field_of_arg(&field)) {
+            // If two indexes get the same field, either will do.
+            ret.insert(std::make_pair(field, status.get_field("index").as_str().to_std()));
+        }
+    }
+    return ret;
+}
+
 class filter_term_t : public grouped_seq_op_term_t {
 public:
     filter_term_t(compile_env_t *env, const protob_t<const Term> &term)
         : grouped_seq_op_term_t(env, term, argspec_t(2), optargspec_t({"default"})),
-          default_filter_term(lazy_literal_optarg(env, "default")) { }
+          default_filter_term(lazy_literal_optarg(env, "default")) {
+        collect_filter_index_bounds(env, term.make_child(&term->args(1)),
+                                    &index_bounds);
+    }
 
 private:
     virtual scoped_ptr_t<val_t> eval_impl(
@@ -278,7 +504,15 @@ private:
         }
 
         if (v0->get_type().is_convertible(val_t::type_t::SELECTION)) {
-            counted_t<selection_t> ts = v0->as_selection(env->env);
+            counted_t<selection_t> ts;
+            // With a default, rows the filter errors on can pass, even if they're
+            // not in the index.
+            if (!defval && v0->get_type().is_convertible(val_t::type_t::TABLE_SLICE)) {
+                ts = index_selection(env, v0->as_table_slice());
+            }
+            if (!ts.has()) {
+                ts = v0->as_selection(env->env);
+            }
             ts->seq->add_transformation(filter_wire_func_t(f, defval), backtrace());
             return new_val(ts);
         } else {
@@ -289,9 +523,126 @@ private:
         }
     }
 
+    // If the filter bounds a field that `slice` has an index on, returns the rows in
+    // that range of the index, which include every row that passes the filter.  The
+    // caller still applies the whole filter to them.  Otherwise returns an empty
+    // pointer.  Users can turn this off with the `index_filters` optarg.
+    counted_t<selection_t> index_selection(
+        scope_env_t *env, const counted_t<table_slice_t> &slice) const {
+        if (index_bounds.empty() || slice->get_idx()) {
+            return counted_t<selection_t>();
+        }
+        if (scoped_ptr_t<val_t> v = env->env->get_optarg(env->env, "index_filters")) {
+            if (!v->as_bool()) {
+                return counted_t<selection_t>();
+            }
+        }
+
+        table_t *tbl = slice->get_tbl().get();
+        std::map<std::pair<uuid_u, std::string>,
+                 std::map<datum_string_t, std::string> > *cache =
+            &env->env->query_cache().filter_indexes;
+        auto cached = cache->find(std::make_pair(tbl->db->id, tbl->name));
+        if (cached == cache->end()) {
+            profile::starter_t starter("Looking for an index for filter.",
+                                       env->env->trace);
+            std::map<datum_string_t, std::string> found;
+            try {
+                found = indexes_by_field(env->env, tbl);
+            } catch (const base_exc_t &) {
+                // We read the whole table like before, which reports any real
+                // problem.
+                return counted_t<selection_t>();
+            }
+            cached = cache->insert(
+                std::make_pair(std::make_pair(tbl->db->id, tbl->name), found)).first;
+        }
+        const std::map<datum_string_t, std::string> &indexes = cached->second;
+
+        for (auto it = index_bounds.begin(); it != index_bounds.end(); ++it) {
+            auto index = indexes.find(it->field);
+            if (index == indexes.end()) {
+                continue;
+            }
+            boost::optional<datum_range_t> range = field_range(env, it->field);
+            if (!range) {
+                continue;
+            }
+            profile::starter_t index_starter(
+                strprintf("Reading index `%s` for filter.", index->second.c_str()),
+                env->env->trace);
+            counted_t<table_slice_t> bounded = slice->with_bounds(index->second, *range);
+            return make_counted<selection_t>(
+                bounded->get_tbl(), bounded->as_seq(env->env, backtrace()));
+        }
+        return counted_t<selection_t>();
+    }
+
+    // Combines the bounds on `field` into a range of index keys.  Index reads skip rows
+    // whose field is missing, null or an object, which compare as less or greater
+    // than everything else of another type, so we only use ranges bounded on both
+    // sides by values of the same type.
+    boost::optional<datum_range_t> field_range(scope_env_t *env,
+                                               const datum_string_t &field) const {
+        const reql_version_t reql_version = env->env->reql_version();
+        datum_t left, right;
+        key_range_t::bound_t left_type = key_range_t::closed;
+        key_range_t::bound_t right_type = key_range_t::closed;
+        for (auto it = index_bounds.begin(); it != index_bounds.end(); ++it) {
+            if (it->field != field) {
+                continue;
+            }
+            datum_t d = it->constant;
+            if (!d.has()) {
+                try {
+                    d = it->value->eval(env)->as_datum();
+                } catch (const base_exc_t &) {
+                    // The full scan evaluates the filter on every row, which
+                    // reports the error if it matters.
+                    return boost::none;
+                }
+            }
+            if (d.get_type() != datum_t::R_NUM
+                && d.get_type() != datum_t::R_STR
+                && d.get_type() != datum_t::R_BOOL
+                && !d.is_ptype(pseudo::time_string)) {
+                return boost::none;
+            }
+            const bool lower = it->op != Term::LT && it->op != Term::LE;
+            const bool upper = it->op != Term::GT && it->op != Term::GE;
+            const key_range_t::bound_t type =
+                (it->op == Term::LT || it->op == Term::GT)
+                ? key_range_t::open
+                : key_range_t::closed;
+            if (lower && (!left.has() || d.compare_gt(reql_version, left)
+                          || (d == left && type == key_range_t::open))) {
+                left = d;
+                left_type = type;
+            }
+            if (upper && (!right.has() || d.compare_lt(reql_version, right)
+                          || (d == right && type == key_range_t::open))) {
+                right = d;
+                right_type = type;
+            }
+        }
+        if (!left.has() || !right.has()
+            || left.get_type() != right.get_type()
+            || left.is_ptype() != right.is_ptype()) {
+            return boost::none;
+        }
+        // The filter passes nothing, which it can find out without an index.
+        if (left.compare_gt(reql_version, right)
+            || (left == right && (left_type == key_range_t::open
+                                  || right_type == key_range_t::open))) {
+            return boost::none;
+        }
+        return datum_range_t(left, left_type, right, right_type);
+    }
+
     virtual const char *name() const { return "filter"; }
 
     counted_t<func_term_t> default_filter_term;
+    std::vector<filter_index_bound_t> index_bounds;
 };
 
 class reduce_term_t : public grouped_seq_op_term_t {
@@ -4,11 +4,9 @@
 #include <string>
 #include <utility>
 
-#include "errors.hpp"
-#include <boost/bind.hpp>
-
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/error.hpp"
+#include "rdb_protocol/external_sort.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/op.hpp"
@@ -51,79 +49,30 @@ class orderby_term_t : public op_term_t {
 public:
     orderby_term_t(compile_env_t *env, const protob_t<const Term> &term)
         : op_term_t(env, term, argspec_t(1, -1),
-          optargspec_t({"index"})), src_term(term) { }
-private:
-    enum order_direction_t { ASC, DESC };
-    class lt_cmp_t {
-    public:
-        typedef bool result_type;
-        explicit lt_cmp_t(
-            std::vector<std::pair<order_direction_t, counted_t<const func_t> > > _comparisons)
-            : comparisons(std::move(_comparisons)) { }
-
-        bool operator()(env_t *env,
-                        profile::sampler_t *sampler,
-                        datum_t l,
-                        datum_t r) const {
-            sampler->new_sample();
-            for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
-                datum_t lval;
-                datum_t rval;
-                try {
-                    lval = it->second->call(env, l)->as_datum();
-                } catch (const base_exc_t &e) {
-                    if (e.get_type() != base_exc_t::NON_EXISTENCE) {
-                        throw;
-                    }
-                }
-
-                try {
-                    rval = it->second->call(env, r)->as_datum();
-                } catch (const base_exc_t &e) {
-                    if (e.get_type() != base_exc_t::NON_EXISTENCE) {
-                        throw;
-                    }
-                }
-
-                if (!lval.has() && !rval.has()) {
-                    continue;
-                }
-                if (!lval.has()) {
-                    return true != (it->first == DESC);
-                }
-                if (!rval.has()) {
-                    return false != (it->first == DESC);
-                }
-                int cmp_res = lval.cmp(env->reql_version(), rval);
-                if (cmp_res == 0) {
-                    continue;
-                }
-                return (cmp_res < 0) != (it->first == DESC);
-            }
-
-            return false;
+          optargspec_t({"index"})), src_term(term) {
+        // See `make_limit_term`.
+        if (env->limited_order_by == term.get()) {
+            limit = env->order_by_limit;
         }
-
-    private:
-        const std::vector<std::pair<order_direction_t, counted_t<const func_t> > >
-            comparisons;
-    };
-
+    }
+private:
     virtual scoped_ptr_t<val_t>
     eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
-        std::vector<std::pair<order_direction_t, counted_t<const func_t> > > comparisons;
+        std::vector<std::pair<sort_direction_t, counted_t<const func_t> > > comparisons;
         for (size_t i = 1; i < args->num_args(); ++i) {
             if (get_src()->args(i).type() == Term::DESC) {
                 comparisons.push_back(
                     std::make_pair(
-                        DESC, args->arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
+                        sort_direction_t::DESC,
+                        args->arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
             } else {
                 comparisons.push_back(
                     std::make_pair(
-                        ASC, args->arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
+                        sort_direction_t::ASC,
+                        args->arg(env, i)->as_func(GET_FIELD_SHORTCUT)));
             }
         }
-        lt_cmp_t lt_cmp(comparisons);
+        sort_order_t order(std::move(comparisons));
 
         counted_t<table_slice_t> tbl_slice;
         counted_t<datum_stream_t> seq;
@@ -142,7 +91,7 @@ private:
         if (seq.has() && seq->is_exhausted()){
             /* Do nothing for empty sequence */
             if (!index.has()) {
-                rcheck(!comparisons.empty(), base_exc_t::GENERIC,
+                rcheck(!order.empty(), base_exc_t::GENERIC,
                        "Must specify something to order by.");
             }
         /* Add a sorting to the table if we're doing indexed sorting. */
@@ -164,9 +113,9 @@ private:
             r_sanity_check(sorting != sorting_t::UNORDERED);
             std::string index_str = index->as_str().to_std();
             tbl_slice = tbl_slice->with_sorting(index_str, sorting);
-            if (!comparisons.empty()) {
+            if (!order.empty()) {
                 seq = make_counted<indexed_sort_datum_stream_t>(
-                    tbl_slice->as_seq(env->env, backtrace()), lt_cmp);
+                    tbl_slice->as_seq(env->env, backtrace()), order);
             } else {
                 return new_val(tbl_slice);
             }
@@ -174,9 +123,10 @@ private:
             if (!seq.has()) {
                 seq = tbl_slice->as_seq(env->env, backtrace());
             }
-            rcheck(!comparisons.empty(), base_exc_t::GENERIC,
+            rcheck(!order.empty(), base_exc_t::GENERIC,
                    "Must specify something to order by.");
-            std::vector<datum_t> to_sort;
+            external_sorter_t sorter(env->env, std::move(order), limit);
+            size_t num_rows = 0;
             batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
             for (;;) {
                 std::vector<datum_t> data
@@ -184,15 +134,16 @@ private:
                 if (data.size() == 0) {
                     break;
                 }
-                std::move(data.begin(), data.end(), std::back_inserter(to_sort));
-                rcheck_array_size(to_sort, env->env->limits(), base_exc_t::GENERIC);
+                num_rows += data.size();
+                if (sorter.keeps_all_rows_in_memory()) {
+                    rcheck(num_rows <= env->env->limits().array_size_limit(),
+                           base_exc_t::GENERIC,
+                           strprintf("Array over size limit `%zu`.",
+                                     env->env->limits().array_size_limit()).c_str());
+                }
+                sorter.add(env->env, std::move(data));
             }
-            profile::sampler_t sampler("Sorting in-memory.", env->env->trace);
-            auto fn = boost::bind(lt_cmp, env->env, &sampler, _1, _2);
-            std::stable_sort(to_sort.begin(), to_sort.end(), fn);
-            seq = make_counted<array_datum_stream_t>(
-                datum_t(std::move(to_sort), env->env->limits()),
-                backtrace());
+            seq = sorter.finish(env->env, backtrace());
         }
         return tbl_slice.has()
             ? new_val(make_counted<selection_t>(tbl_slice->get_tbl(), seq))
@@ -203,6 +154,8 @@ private:
 
 private:
     protob_t<const Term> src_term;
+    // How many rows the `limit` right after us wants, if we know.
+    boost::optional<size_t> limit;
 };
 
 class distinct_term_t : public op_term_t {
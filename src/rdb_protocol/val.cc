@@ -6,6 +6,7 @@
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/math_utils.hpp"
 #include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
 #include "rdb_protocol/term.hpp"
 #include "stl_utils.hpp"
 #include "thread_local.hpp"
@@ -272,7 +273,9 @@ datum_t table_t::batched_insert(
                                      pkey_w);
             const ql::datum_t &keyval = (*it).get_field(pkey_w);
             keyval.print_primary(); // does error checking
-            valid_inserts.push_back(std::move(*it));
+            // The document gets serialized for the write message and then again
+            // onto disk, so we encode it once here and both just copy it.
+            valid_inserts.push_back(datum_serialize_to_buf(*it));
         } catch (const base_exc_t &e) {
             stats.add_error(e.what());
         }
@@ -365,6 +368,11 @@ datum_t table_t::get_row(env_t *env, datum_t pval) {
     return tbl->read_row(env, pval, use_outdated);
 }
 
+std::vector<datum_t> table_t::get_rows(env_t *env,
+                                       const std::vector<datum_t> &pvals) {
+    return tbl->read_rows(env, pvals, use_outdated);
+}
+
 counted_t<datum_stream_t> table_t::get_all(
         env_t *env,
         datum_t value,
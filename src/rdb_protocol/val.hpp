@@ -36,6 +36,7 @@ public:
             bool use_outdated, const protob_t<const Backtrace> &src);
     const std::string &get_pkey();
     datum_t get_row(env_t *env, datum_t pval);
+    std::vector<datum_t> get_rows(env_t *env, const std::vector<datum_t> &pvals);
     counted_t<datum_stream_t> get_all(
             env_t *env,
             datum_t value,
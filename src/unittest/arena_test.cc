@@ -0,0 +1,125 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "containers/arena.hpp"
+#include "containers/scoped.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+class arena_object_t {
+public:
+    explicit arena_object_t(int _value) : value(_value) { }
+    static void *operator new(size_t size) { return arena_operator_new(size); }
+    static void operator delete(void *p) { arena_operator_delete(p); }
+    int value;
+    char padding[37];
+};
+
+// Makes and frees the objects that come from the heap, so the current arena's next
+// objects come from its chunks.
+void use_up_heap_objects() {
+    for (size_t i = 0; i < arena_t::NUM_HEAP_OBJECTS; ++i) {
+        delete new arena_object_t(0);
+    }
+}
+
+TEST(ArenaTest, AllocateAndRelease) {
+    std::vector<arena_object_t *> objects;
+    {
+        counted_t<arena_t> arena = make_counted<arena_t>();
+        arena_scope_t arena_scope(arena.get());
+        // Enough to need several chunks.
+        for (int i = 0; i < 2000; ++i) {
+            objects.push_back(new arena_object_t(i));
+            ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(objects.back()) % 16);
+        }
+        // One reference for us and one per object that isn't from the heap.
+        ASSERT_EQ(static_cast<intptr_t>(2001 - arena_t::NUM_HEAP_OBJECTS),
+                  counted_use_count(arena.get()));
+    }
+    // The objects outlive the scope and our reference to the arena.
+    for (int i = 0; i < 2000; ++i) {
+        ASSERT_EQ(i, objects[i]->value);
+    }
+    for (auto it = objects.begin(); it != objects.end(); ++it) {
+        delete *it;
+    }
+}
+
+TEST(ArenaTest, BiggerThanAChunk) {
+    counted_t<arena_t> arena = make_counted<arena_t>();
+    // Small allocations, then one bigger than any chunk, then small ones again.
+    std::vector<char *> blocks;
+    for (size_t size = 100; size <= 200 * KILOBYTE; size *= 3) {
+        char *block = static_cast<char *>(arena->allocate(size));
+        memset(block, static_cast<int>(blocks.size()), size);
+        blocks.push_back(block);
+    }
+    blocks.push_back(static_cast<char *>(arena->allocate(100)));
+    ASSERT_EQ(static_cast<intptr_t>(blocks.size() + 1), counted_use_count(arena.get()));
+    for (size_t i = 0; i + 1 < blocks.size(); ++i) {
+        ASSERT_EQ(static_cast<char>(i), blocks[i][0]);
+    }
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        counted_release(arena.get());
+    }
+}
+
+TEST(ArenaTest, ChunksGrow) {
+    counted_t<arena_t> arena = make_counted<arena_t>();
+    arena->allocate(16);
+    ASSERT_EQ(static_cast<size_t>(KILOBYTE), arena->size_in_bytes());
+    // That doesn't fit in what's left of the first chunk, so it gets a bigger one.
+    arena->allocate(KILOBYTE);
+    ASSERT_EQ(static_cast<size_t>(3 * KILOBYTE), arena->size_in_bytes());
+    counted_release(arena.get());
+    counted_release(arena.get());
+}
+
+TEST(ArenaTest, NestedScopesAndHeap) {
+    // Without a scope, objects come from the heap.
+    scoped_ptr_t<arena_object_t> from_heap(new arena_object_t(1));
+
+    counted_t<arena_t> outer = make_counted<arena_t>();
+    counted_t<arena_t> inner = make_counted<arena_t>();
+    scoped_ptr_t<arena_object_t> from_outer;
+    scoped_ptr_t<arena_object_t> from_inner;
+    {
+        arena_scope_t outer_scope(outer.get());
+        use_up_heap_objects();
+        {
+            arena_scope_t inner_scope(inner.get());
+            use_up_heap_objects();
+            from_inner.init(new arena_object_t(2));
+        }
+        from_outer.init(new arena_object_t(3));
+    }
+    ASSERT_EQ(2, counted_use_count(outer.get()));
+    ASSERT_EQ(2, counted_use_count(inner.get()));
+    from_inner.reset();
+    ASSERT_EQ(1, counted_use_count(inner.get()));
+    ASSERT_EQ(1, from_heap->value);
+    ASSERT_EQ(3, from_outer->value);
+}
+
+TEST(ArenaTest, FirstObjectsFromHeap) {
+    counted_t<arena_t> arena = make_counted<arena_t>();
+    std::vector<scoped_ptr_t<arena_object_t> > objects;
+    {
+        arena_scope_t arena_scope(arena.get());
+        for (size_t i = 0; i < arena_t::NUM_HEAP_OBJECTS; ++i) {
+            objects.push_back(make_scoped<arena_object_t>(static_cast<int>(i)));
+        }
+        // Small queries don't get a chunk.
+        ASSERT_EQ(1, counted_use_count(arena.get()));
+        ASSERT_GT(static_cast<size_t>(KILOBYTE), arena->size_in_bytes());
+        objects.push_back(make_scoped<arena_object_t>(-1));
+    }
+    ASSERT_EQ(2, counted_use_count(arena.get()));
+    ASSERT_LT(static_cast<size_t>(KILOBYTE), arena->size_in_bytes());
+    objects.clear();
+    ASSERT_EQ(1, counted_use_count(arena.get()));
+}
+
+}  // namespace unittest
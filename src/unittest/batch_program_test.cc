@@ -0,0 +1,91 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/batch_program.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/pb_utils.hpp"
+#include "stl_utils.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+ql::sym_t batch_program_test_var(1);
+
+counted_t<const ql::func_t> make_batch_test_func(ql::r::reql_t &&body) {
+    ql::protob_t<const Term> term = std::move(body).release_counted();
+    ql::wire_func_t func(term, make_vector(batch_program_test_var),
+                         get_backtrace(term));
+    return func.compile_wire_func();
+}
+
+ql::r::reql_t batch_test_row() {
+    return ql::r::var(batch_program_test_var);
+}
+
+// Rows with a number `x` and a string `y`, some missing one or the other or with
+// the wrong types.
+std::vector<ql::datum_t> make_batch_test_rows(size_t n) {
+    std::vector<ql::datum_t> rows;
+    for (size_t i = 0; i < n; ++i) {
+        ql::datum_object_builder_t builder;
+        UNUSED bool dup;
+        if (i % 7 != 0) {
+            dup = builder.add("x", i % 11 == 0
+                                   ? ql::datum_t("ten")
+                                   : ql::datum_t(static_cast<double>(i % 10)));
+        }
+        if (i % 5 != 0) {
+            dup = builder.add("y", ql::datum_t(i % 3 == 0 ? "a" : "b"));
+        }
+        rows.push_back(std::move(builder).to_datum());
+    }
+    return rows;
+}
+
+// Whatever the program gives for a row is what calling the function gives.
+void check_batch_program(ql::env_t *env, ql::r::reql_t &&body) {
+    counted_t<const ql::func_t> f = make_batch_test_func(std::move(body));
+    scoped_ptr_t<ql::batch_program_t> program = f->compile_batch_program();
+    ASSERT_TRUE(program.has()) << f->print_source();
+    std::vector<ql::datum_t> rows = make_batch_test_rows(100);
+    std::vector<ql::datum_t> values;
+    program->eval(env, rows, &values);
+    ASSERT_EQ(rows.size(), values.size());
+    size_t evaluated = 0;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (values[i].has()) {
+            ++evaluated;
+            ASSERT_EQ(f->call(env, rows[i])->as_datum(), values[i])
+                << f->print_source() << " on " << rows[i].print();
+        }
+    }
+    ASSERT_GT(evaluated, 0u) << f->print_source();
+}
+
+TEST(BatchProgramTest, MatchesCall) {
+    cond_t interruptor;
+    ql::env_t env(&interruptor, reql_version_t::LATEST);
+    check_batch_program(&env, batch_test_row()["x"] > 5.0);
+    check_batch_program(&env, batch_test_row().bracket("y") == std::string("a"));
+    check_batch_program(&env, (batch_test_row()["x"] > 5.0)
+                              && (batch_test_row()["y"] == std::string("a")));
+    check_batch_program(&env, !(batch_test_row()["x"] <= 2.0));
+    check_batch_program(&env, (batch_test_row()["x"] + 1.0) / 2.0);
+    check_batch_program(&env, ql::r::reql_t(Term::MUL,
+                                            ql::r::reql_t(Term::SUB,
+                                                          batch_test_row()["x"], 1.0),
+                                            2.0) >= 4.0);
+    check_batch_program(&env, ql::r::expr(3.0) < batch_test_row()["x"]);
+    // Drivers send `r.row` as the implicit variable.
+    check_batch_program(&env, ql::r::reql_t(Term::IMPLICIT_VAR)["x"] > 5.0);
+
+    // The rest, like another variable, can't be compiled.
+    ASSERT_FALSE(make_batch_test_func(batch_test_row().merge(ql::r::object()))
+                 ->compile_batch_program().has());
+    ASSERT_FALSE(make_batch_test_func(batch_test_row().bracket(batch_test_row()["y"]))
+                 ->compile_batch_program().has());
+    ASSERT_FALSE(make_batch_test_func(ql::r::var(ql::sym_t(2)) == 1.0)
+                 ->compile_batch_program().has());
+}
+
+}  // namespace unittest
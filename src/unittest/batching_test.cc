@@ -0,0 +1,37 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/batching.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(BatchingTest, TunerFollowsClient) {
+    ql::batch_tuner_t tuner;
+    ASSERT_EQ(1.0, tuner.scale_factor());
+
+    // A client that comes back for 100 rows in 10ms when we read them in 1ms gets
+    // smaller batches, down to a limit.
+    for (int i = 0; i < 10; ++i) {
+        tuner.note_batch(100, 10000, 1000, 100, 10000);
+    }
+    ASSERT_EQ(1.0 / 16, tuner.scale_factor());
+
+    // One that keeps up gets bigger ones.
+    for (int i = 0; i < 10; ++i) {
+        tuner.note_batch(100, 10000, 10000, 100, 1000);
+    }
+    ASSERT_EQ(16.0, tuner.scale_factor());
+
+    // One about as fast as us keeps the size it has.
+    tuner.note_batch(100, 10000, 1000, 100, 1500);
+    ASSERT_EQ(16.0, tuner.scale_factor());
+
+    // The first batch has nothing to compare with.
+    ql::batch_tuner_t first;
+    first.note_batch(100, 10000, 1000, 0, 0);
+    ASSERT_EQ(1.0, first.scale_factor());
+    ASSERT_EQ(1u, first.batches_seen());
+    ASSERT_EQ(100u, first.rows_seen());
+    ASSERT_EQ(10000u, first.bytes_seen());
+}
+
+}  // namespace unittest
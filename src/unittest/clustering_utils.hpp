@@ -54,7 +54,8 @@ public:
             serializer(create_and_construct_serializer(&temp_file, io_backender)),
             balancer(new dummy_cache_balancer_t(GIGABYTE)),
             store(serializer.get(), balancer.get(), temp_file.name().permanent_path(), true,
-                  &get_global_perfmon_collection(), ctx, io_backender, base_path_t("."), NULL) {
+                  &get_global_perfmon_collection(), ctx, io_backender, base_path_t("."), NULL,
+                  false) {
         /* Initialize store metadata */
         cond_t non_interruptor;
         write_token_t token;
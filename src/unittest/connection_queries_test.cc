@@ -0,0 +1,269 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <functional>
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
+#include "protob/connection_queries.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// Runs every query until the test releases it.  Queries with negative tokens don't
+// get a response, like noreply queries.
+class blocking_query_handler_t : public query_handler_t {
+public:
+    blocking_query_handler_t() : num_interrupted(0) { }
+
+    bool run_query(const ql::protob_t<Query> &query,
+                   Response *response_out,
+                   client_context_t *client_ctx) {
+        started.push_back(query->token());
+        releases.push_back(make_scoped<cond_t>());
+        cond_t *release = releases.back().get();
+        try {
+            wait_interruptible(release, client_ctx->interruptor);
+        } catch (const interrupted_exc_t &) {
+            ++num_interrupted;
+            throw;
+        }
+        response_out->set_token(query->token());
+        response_out->set_type(Response::SUCCESS_ATOM);
+        return query->token() >= 0;
+    }
+
+    void unparseable_query(int64_t, Response *, const std::string &) { }
+
+    // Lets the `n`th query that was started finish.
+    void release(size_t n) {
+        releases.at(n)->pulse();
+    }
+
+    std::vector<int64_t> started;
+    std::vector<int64_t> sent;
+    int num_interrupted;
+
+private:
+    std::vector<scoped_ptr_t<cond_t> > releases;
+};
+
+// Records the responses in the handler instead of writing them to a connection.
+class recording_protocol_t {
+public:
+    static void send_response(const Response &response,
+                              query_handler_t *handler,
+                              UNUSED tcp_conn_t *conn,
+                              UNUSED signal_t *interruptor) {
+        static_cast<blocking_query_handler_t *>(handler)->sent.push_back(
+            response.token());
+    }
+};
+
+ql::protob_t<Query> make_test_query(int64_t token, Query::QueryType type) {
+    ql::protob_t<Query> query = ql::make_counted_query();
+    query->set_token(token);
+    query->set_type(type);
+    return query;
+}
+
+// A START with the `noreply` global optarg, with a negative token so that the
+// handler doesn't respond to it.
+ql::protob_t<Query> make_test_noreply_query(int64_t token) {
+    guarantee(token < 0);
+    ql::protob_t<Query> query = make_test_query(token, Query::START);
+    Query_AssocPair *optarg = query->add_global_optargs();
+    optarg->set_key("noreply");
+    optarg->mutable_val()->set_type(Term::DATUM);
+    optarg->mutable_val()->mutable_datum()->set_type(Datum::R_BOOL);
+    optarg->mutable_val()->mutable_datum()->set_r_bool(true);
+    return query;
+}
+
+// Starts a query from another coroutine, since `start_query` blocks while there's
+// no room for it.
+void start_test_query(connection_queries_t *queries,
+                      ql::protob_t<Query> query,
+                      cond_t *returned) {
+    try {
+        queries->start_query<recording_protocol_t>(query);
+    } catch (const tcp_conn_read_closed_exc_t &) {
+        // The queries were stopped.
+    }
+    returned->pulse();
+}
+
+void let_queries_run() {
+    for (int i = 0; i < 100; ++i) {
+        coro_t::yield();
+    }
+}
+
+TPTEST(ConnectionQueries, SameTokenRunsInOrder) {
+    cond_t connection_interruptor;
+    client_context_t client_ctx(NULL, ql::reject_cfeeds_t::NO,
+                                &connection_interruptor);
+    blocking_query_handler_t handler;
+    connection_queries_t queries(NULL, &handler, &client_ctx);
+
+    queries.start_query<recording_protocol_t>(make_test_query(1, Query::START));
+    queries.start_query<recording_protocol_t>(make_test_query(1, Query::CONTINUE));
+    queries.start_query<recording_protocol_t>(make_test_query(2, Query::START));
+    let_queries_run();
+
+    // The CONTINUE waits for the START, but the other token doesn't.
+    ASSERT_EQ((std::vector<int64_t>{1, 2}), handler.started);
+
+    handler.release(1);
+    let_queries_run();
+    ASSERT_EQ((std::vector<int64_t>{2}), handler.sent);
+    ASSERT_EQ((std::vector<int64_t>{1, 2}), handler.started);
+
+    handler.release(0);
+    let_queries_run();
+    ASSERT_EQ((std::vector<int64_t>{2, 1}), handler.sent);
+    ASSERT_EQ((std::vector<int64_t>{1, 2, 1}), handler.started);
+
+    handler.release(2);
+    let_queries_run();
+    ASSERT_EQ((std::vector<int64_t>{2, 1, 1}), handler.sent);
+}
+
+TPTEST(ConnectionQueries, NoreplyWaitWaitsForEarlierQueries) {
+    cond_t connection_interruptor;
+    client_context_t client_ctx(NULL, ql::reject_cfeeds_t::NO,
+                                &connection_interruptor);
+    blocking_query_handler_t handler;
+    connection_queries_t queries(NULL, &handler, &client_ctx);
+
+    queries.start_query<recording_protocol_t>(make_test_query(-1, Query::START));
+    queries.start_query<recording_protocol_t>(make_test_query(3, Query::START));
+    cond_t noreply_wait_returned;
+    coro_t::spawn_sometime(std::bind(&start_test_query, &queries,
+                                     make_test_query(4, Query::NOREPLY_WAIT),
+                                     &noreply_wait_returned));
+    let_queries_run();
+    ASSERT_FALSE(noreply_wait_returned.is_pulsed());
+
+    // The first query finishing isn't enough.
+    handler.release(0);
+    let_queries_run();
+    ASSERT_FALSE(noreply_wait_returned.is_pulsed());
+    ASSERT_TRUE(handler.sent.empty());
+
+    handler.release(1);
+    let_queries_run();
+    ASSERT_TRUE(noreply_wait_returned.is_pulsed());
+    ASSERT_EQ((std::vector<int64_t>{-1, 3, 4}), handler.started);
+
+    // Queries after the NOREPLY_WAIT wait for it in turn.
+    cond_t later_query_returned;
+    coro_t::spawn_sometime(std::bind(&start_test_query, &queries,
+                                     make_test_query(5, Query::START),
+                                     &later_query_returned));
+    let_queries_run();
+    ASSERT_FALSE(later_query_returned.is_pulsed());
+
+    handler.release(2);
+    let_queries_run();
+    ASSERT_TRUE(later_query_returned.is_pulsed());
+    ASSERT_EQ((std::vector<int64_t>{3, 4}), handler.sent);
+    ASSERT_EQ((std::vector<int64_t>{-1, 3, 4, 5}), handler.started);
+
+    handler.release(3);
+    let_queries_run();
+    ASSERT_EQ((std::vector<int64_t>{3, 4, 5}), handler.sent);
+}
+
+TPTEST(ConnectionQueries, NoreplyQueriesRunAlone) {
+    cond_t connection_interruptor;
+    client_context_t client_ctx(NULL, ql::reject_cfeeds_t::NO,
+                                &connection_interruptor);
+    blocking_query_handler_t handler;
+    connection_queries_t queries(NULL, &handler, &client_ctx);
+
+    queries.start_query<recording_protocol_t>(make_test_query(1, Query::START));
+    cond_t noreply_returned;
+    coro_t::spawn_sometime(std::bind(&start_test_query, &queries,
+                                     make_test_noreply_query(-1),
+                                     &noreply_returned));
+    let_queries_run();
+    cond_t later_query_returned;
+    coro_t::spawn_sometime(std::bind(&start_test_query, &queries,
+                                     make_test_query(2, Query::START),
+                                     &later_query_returned));
+    let_queries_run();
+
+    // The noreply query waits for the query before it...
+    ASSERT_FALSE(noreply_returned.is_pulsed());
+    ASSERT_EQ((std::vector<int64_t>{1}), handler.started);
+
+    handler.release(0);
+    let_queries_run();
+    ASSERT_TRUE(noreply_returned.is_pulsed());
+    ASSERT_EQ((std::vector<int64_t>{1, -1}), handler.started);
+
+    // ... and the query after it waits for the noreply query, so it sees the
+    // noreply query's writes.
+    ASSERT_FALSE(later_query_returned.is_pulsed());
+
+    handler.release(1);
+    let_queries_run();
+    ASSERT_TRUE(later_query_returned.is_pulsed());
+    ASSERT_EQ((std::vector<int64_t>{1, -1, 2}), handler.started);
+
+    handler.release(2);
+    let_queries_run();
+    ASSERT_EQ((std::vector<int64_t>{1, 2}), handler.sent);
+}
+
+TPTEST(ConnectionQueries, PausesAtConcurrencyCap) {
+    cond_t connection_interruptor;
+    client_context_t client_ctx(NULL, ql::reject_cfeeds_t::NO,
+                                &connection_interruptor);
+    blocking_query_handler_t handler;
+    connection_queries_t queries(NULL, &handler, &client_ctx);
+
+    for (int64_t i = 0; i < MAX_CONCURRENT_QUERIES_PER_CONNECTION; ++i) {
+        queries.start_query<recording_protocol_t>(make_test_query(i, Query::START));
+    }
+
+    // The connection loop would stop reading here.
+    const int64_t extra_token = MAX_CONCURRENT_QUERIES_PER_CONNECTION;
+    cond_t extra_query_returned;
+    coro_t::spawn_sometime(std::bind(&start_test_query, &queries,
+                                     make_test_query(extra_token, Query::START),
+                                     &extra_query_returned));
+    let_queries_run();
+    ASSERT_FALSE(extra_query_returned.is_pulsed());
+    ASSERT_EQ(static_cast<size_t>(MAX_CONCURRENT_QUERIES_PER_CONNECTION),
+              handler.started.size());
+
+    handler.release(0);
+    let_queries_run();
+    ASSERT_TRUE(extra_query_returned.is_pulsed());
+    ASSERT_EQ(extra_token, handler.started.back());
+}
+
+TPTEST(ConnectionQueries, StopDrainsRunningQueries) {
+    cond_t connection_interruptor;
+    client_context_t client_ctx(NULL, ql::reject_cfeeds_t::NO,
+                                &connection_interruptor);
+    blocking_query_handler_t handler;
+    connection_queries_t queries(NULL, &handler, &client_ctx);
+
+    queries.start_query<recording_protocol_t>(make_test_query(1, Query::START));
+    queries.start_query<recording_protocol_t>(make_test_query(2, Query::START));
+    // This one is still waiting for its token when the connection closes.
+    queries.start_query<recording_protocol_t>(make_test_query(2, Query::CONTINUE));
+    let_queries_run();
+    ASSERT_EQ(2u, handler.started.size());
+
+    queries.stop();
+    ASSERT_EQ(2, handler.num_interrupted);
+    ASSERT_EQ(2u, handler.started.size());
+    ASSERT_TRUE(handler.sent.empty());
+    ASSERT_EQ(&connection_interruptor, client_ctx.interruptor);
+}
+
+}  // namespace unittest
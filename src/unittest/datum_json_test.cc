@@ -0,0 +1,124 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "http/json.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_json.hpp"
+#include "rdb_protocol/env.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+// Parses `json` both ways.  Returns false if both consider it malformed, and
+// fails the test if they disagree.
+bool parse_json_both_ways(const std::string &json, ql::datum_t *out) {
+    ql::configured_limits_t limits;
+    bool cjson_threw = false;
+    ql::datum_t via_cjson;
+    scoped_cJSON_t cjson(cJSON_Parse(json.c_str()));
+    if (cjson.get() != NULL) {
+        try {
+            via_cjson = ql::to_datum(cjson.get(), limits);
+        } catch (const ql::base_exc_t &) {
+            cjson_threw = true;
+        }
+    }
+
+    bool direct_threw = false;
+    bool direct_ok = false;
+    try {
+        direct_ok = ql::parse_json(json.data(), json.size(), limits, out);
+    } catch (const ql::base_exc_t &) {
+        direct_threw = true;
+    }
+
+    EXPECT_EQ(cjson_threw, direct_threw) << json;
+    if (cjson_threw || direct_threw) {
+        return false;
+    }
+    EXPECT_EQ(cjson.get() != NULL, direct_ok) << json;
+    if (direct_ok && cjson.get() != NULL) {
+        EXPECT_EQ(via_cjson, *out) << json;
+        EXPECT_EQ(via_cjson.print(), out->print()) << json;
+    }
+    return direct_ok;
+}
+
+TEST(DatumJsonTest, MatchesCjson) {
+    const char *const documents[] = {
+        "null", "true", "false", "0", "-0", "1.5e3", "-0.25", "123456789012345678",
+        "0x10", "1e5x", "  [1 , 2 ,3 ]  ", "[]", "{}", "[ ]", "{ }",
+        "\"\"", "\"plain\"", "\"unterminated",
+        "\"esc\\\"aped\\\\ \\/ \\b\\f\\n\\r\\t \\q\"",
+        "\"\\u00e9 \\u20ac \\ud83d\\ude00\"",
+        "\"lone high \\ud83d here\"",
+        "\"bad second half \\ud83d\\u0041 here\"",
+        "\"a string that is longer than sixteen bytes\\\" with a quote\"",
+        "{\"id\":1,\"name\":\"Bob\",\"tags\":[\"a\",\"b\"],\"nested\":{\"x\":null}}",
+        "{\"$reql_type$\":\"TIME\",\"epoch_time\":1,\"timezone\":\"+00:00\"}",
+        "{\"$reql_type$\":\"LITERAL\",\"value\":1}",
+        "[1] trailing garbage",
+        "nulls", "truest",
+        // These are malformed.
+        "", "   ", "nul", "tru", "[1,", "[1,]", "[1 2]", "{\"a\"}", "{\"a\":}",
+        "{a:1}", "{\"a\":1,}", "-", "+1", ".5", "\"\\u0000\"", "\"\\udc00\"",
+        "\"\\u12\"",
+        // These aren't valid datums.
+        "{\"a\":1,\"a\":2}", "-1e999", "{\"$reql_type$\":\"BOGUS\"}",
+    };
+    for (size_t i = 0; i < sizeof(documents) / sizeof(char *); ++i) {
+        ql::datum_t d;
+        parse_json_both_ways(documents[i], &d);
+    }
+}
+
+TEST(DatumJsonTest, StopsAtSizeAndNul) {
+    ql::configured_limits_t limits;
+    ql::datum_t d;
+    const char str[] = "[1,2][3]";
+    ASSERT_TRUE(ql::parse_json(str + 5, 3, limits, &d));
+    ASSERT_EQ(1u, d.arr_size());
+    ASSERT_FALSE(ql::parse_json(str, 4, limits, &d));
+
+    const std::string with_nul("\"abc\0def\"", 9);
+    ASSERT_TRUE(ql::parse_json(with_nul.data(), with_nul.size(), limits, &d));
+    ASSERT_EQ(ql::datum_t("abc"), d);
+}
+
+TEST(DatumJsonTest, BigDocuments) {
+    std::vector<std::pair<std::string, std::string> > documents;
+    std::string people = "[";
+    for (int i = 0; i < 500; ++i) {
+        people += strprintf(
+            "%s{\"id\":\"%08d-5c0d-4e0e-a1ad-8c5b6a51d2ce\",\"name\":\"Person %d\","
+            "\"age\":%d,\"score\":%d.75,\"tags\":[\"a\",\"bb\",\"ccc\"],"
+            "\"address\":{\"street\":\"%d Main St\",\"zip\":\"94105\","
+            "\"geo\":[37.79,-122.39]}}", i == 0 ? "" : ",", i, i, i % 90, i, i);
+    }
+    people += "]";
+    documents.push_back(std::make_pair("objects", people));
+
+    std::string numbers = "[";
+    for (int i = 0; i < 20000; ++i) {
+        numbers += strprintf("%s%d.%d", i == 0 ? "" : ",", i * 7919, i % 1000);
+    }
+    numbers += "]";
+    documents.push_back(std::make_pair("numbers", numbers));
+
+    std::string text = "{\"body\":\"";
+    for (int i = 0; i < 2000; ++i) {
+        text += "Lorem ipsum dolor sit amet, consectetur adipiscing elit. ";
+        if (i % 10 == 0) {
+            text += "\\\"quoted\\\"\\n";
+        }
+    }
+    text += "\"}";
+    documents.push_back(std::make_pair("text", text));
+
+    for (auto it = documents.begin(); it != documents.end(); ++it) {
+        ql::datum_t d;
+        ASSERT_TRUE(parse_json_both_ways(it->second, &d)) << it->first;
+    }
+}
+
+}  // namespace unittest
@@ -0,0 +1,55 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include <inttypes.h>
+
+#include <cmath>
+
+#include "http/json.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
+
+namespace unittest {
+
+const double datum_number_test_values[] = {
+    0, -0.0, 1, -1, 9, 10, 99, 100, 127, 128, 1e15, 123456789012345.0,
+    9007199254740991.0, 9007199254740992.0, -9007199254740992.0,
+    9007199254740994.0, 1e20, 1e21, -1e300, 0.5, -0.25, 1.0 / 3, 1e-7,
+};
+
+TEST(DatumNumberTest, PrintMatchesSnprintf) {
+    for (size_t i = 0; i < sizeof(datum_number_test_values) / sizeof(double); ++i) {
+        const double d = datum_number_test_values[i];
+        std::string printed;
+        json_print_number(d, &printed);
+        ASSERT_EQ(strprintf("%.20g", d), printed);
+
+        // The key format of old indexes.
+        union {
+            double d;
+            uint64_t u;
+        } packed;
+        packed.d = d;
+        packed.u = (packed.u & (1ULL << 63)) ? ~packed.u : packed.u ^ (1ULL << 63);
+        ASSERT_EQ(strprintf("N%.*" PRIx64 "#%" PR_RECONSTRUCTABLE_DOUBLE,
+                            static_cast<int>(sizeof(double) * 2), packed.u, d),
+                  ql::datum_t(d).print_primary());
+    }
+}
+
+TEST(DatumNumberTest, DeserializeFromBuf) {
+    std::vector<ql::datum_t> numbers;
+    for (size_t i = 0; i < sizeof(datum_number_test_values) / sizeof(double); ++i) {
+        numbers.push_back(ql::datum_t(datum_number_test_values[i]));
+    }
+    ql::datum_t array = ql::datum_serialize_to_buf(
+        ql::datum_t(std::vector<ql::datum_t>(numbers), ql::configured_limits_t()));
+    ASSERT_EQ(numbers.size(), array.arr_size());
+    for (size_t i = 0; i < numbers.size(); ++i) {
+        const double d = array.get(i).as_num();
+        ASSERT_EQ(numbers[i].as_num(), d);
+        ASSERT_EQ(std::signbit(numbers[i].as_num()), std::signbit(d));
+    }
+}
+
+}  // namespace unittest
@@ -0,0 +1,109 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "containers/archive/string_stream.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_string.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
+
+namespace unittest {
+
+// Both sides of the inline size limit.
+const size_t datum_string_test_sizes[] = { 0, 1, 2, 14, 15, 16, 17, 64, 300 };
+
+std::string make_test_string(size_t size, char first) {
+    std::string str;
+    for (size_t i = 0; i < size; ++i) {
+        str.push_back(first + i % 26);
+    }
+    return str;
+}
+
+TEST(DatumStringTest, CopyMoveAndCompare) {
+    std::vector<datum_string_t> strings;
+    for (size_t i = 0; i < sizeof(datum_string_test_sizes) / sizeof(size_t); ++i) {
+        const std::string str = make_test_string(datum_string_test_sizes[i], 'a');
+        datum_string_t s(str);
+        ASSERT_EQ(str.size(), s.size());
+        ASSERT_EQ(str, s.to_std());
+        ASSERT_EQ(str.empty(), s.empty());
+
+        datum_string_t copy(s);
+        ASSERT_EQ(s, copy);
+        datum_string_t moved(std::move(copy));
+        ASSERT_EQ(s, moved);
+        // Moved-from strings are empty, not broken.
+        ASSERT_TRUE(copy.empty());
+
+        // Assign between every combination of inline and shared strings.
+        for (auto it = strings.begin(); it != strings.end(); ++it) {
+            datum_string_t assigned(*it);
+            assigned = s;
+            ASSERT_EQ(s, assigned);
+            assigned = *it;
+            ASSERT_EQ(*it, assigned);
+            assigned = std::move(moved);
+            ASSERT_EQ(s, assigned);
+            moved = assigned;
+
+            ASSERT_EQ(it->to_std() < str, *it < s);
+            ASSERT_EQ(it->to_std().compare(str) > 0, it->compare(s) > 0);
+        }
+        strings.push_back(s);
+    }
+
+    // Strings of the same content compare equal whether they're stored inline or
+    // in a buffer.
+    for (size_t i = 0; i < sizeof(datum_string_test_sizes) / sizeof(size_t); ++i) {
+        const std::string str = make_test_string(datum_string_test_sizes[i], 'k');
+        datum_string_t copied(str);
+        ql::datum_t deserialized;
+        string_stream_t stream;
+        write_message_t wm;
+        ql::datum_serialize(&wm, ql::datum_t(copied),
+                            ql::check_datum_serialization_errors_t::NO);
+        ASSERT_EQ(0, send_write_message(&stream, &wm));
+        string_read_stream_t read_stream(std::move(stream.str()), 0);
+        ASSERT_EQ(archive_result_t::SUCCESS,
+                  ql::datum_deserialize(&read_stream, &deserialized));
+        ASSERT_EQ(copied, deserialized.as_str());
+        ASSERT_EQ(str, deserialized.as_str().to_std());
+
+        ql::datum_t from_buf =
+            ql::datum_serialize_to_buf(ql::datum_t(
+                std::vector<ql::datum_t>{ql::datum_t(copied)},
+                ql::configured_limits_t())).get(0);
+        ASSERT_EQ(copied, from_buf.as_str());
+    }
+}
+
+TEST(DatumStringTest, Concat) {
+    for (size_t i = 0; i < sizeof(datum_string_test_sizes) / sizeof(size_t); ++i) {
+        for (size_t j = 0; j < sizeof(datum_string_test_sizes) / sizeof(size_t); ++j) {
+            const std::string a = make_test_string(datum_string_test_sizes[i], 'a');
+            const std::string b = make_test_string(datum_string_test_sizes[j], 'n');
+            ASSERT_EQ(a + b,
+                      concat(datum_string_t(a), datum_string_t(b)).to_std());
+        }
+    }
+}
+
+TEST(DatumStringTest, Intern) {
+    const std::string key = "a_longer_object_key";
+    datum_string_t first = intern_datum_string(key.size(), key.data());
+    datum_string_t second = intern_datum_string(key.size(), key.data());
+    ASSERT_EQ(key, first.to_std());
+    // They share a buffer.
+    ASSERT_EQ(first.data(), second.data());
+
+    const std::string other = "another_longer_key";
+    ASSERT_EQ(other, intern_datum_string(other.size(), other.data()).to_std());
+    ASSERT_EQ("id", intern_datum_string(2, "id").to_std());
+    const std::string long_key = make_test_string(200, 'a');
+    ASSERT_EQ(long_key,
+              intern_datum_string(long_key.size(), long_key.data()).to_std());
+    // Interned strings outlive the table's slot.
+    ASSERT_EQ(key, first.to_std());
+}
+
+}  // namespace unittest
@@ -4,6 +4,7 @@
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/datum_string.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
 #include "unittest/gtest.hpp"
 
 
@@ -205,4 +206,101 @@ TEST(DatumTest, OffsetScaling) {
     }
 }
 
+std::string serialize_datum_for_disk(const ql::datum_t &datum,
+                                     ql::serialization_result_t *res_out) {
+    string_stream_t stream;
+    write_message_t wm;
+    *res_out = ql::datum_serialize(&wm, datum,
+                                   ql::check_datum_serialization_errors_t::YES);
+    int write_res = send_write_message(&stream, &wm);
+    guarantee(write_res == 0);
+    return stream.str();
+}
+
+TEST(DatumTest, SerializeToBuf) {
+    ql::datum_t nested(std::vector<ql::datum_t>
+                           {ql::datum_t(1.0), ql::datum_t("two")},
+                       ql::configured_limits_t::unlimited);
+    ql::datum_t test_object(std::map<datum_string_t, ql::datum_t>
+            {std::make_pair(datum_string_t("a"), ql::datum_t::null()),
+             std::make_pair(datum_string_t("nested"), nested)});
+    ql::datum_t buf_object = ql::datum_serialize_to_buf(test_object);
+    ASSERT_TRUE(test_object.get_buf_ref() == NULL);
+    ASSERT_TRUE(buf_object.get_buf_ref() != NULL);
+    ASSERT_EQ(test_object, buf_object);
+    test_datum_serialization(buf_object);
+
+    // Writing the buffer-backed datum to disk produces exactly the same bytes.
+    ql::serialization_result_t res, buf_res;
+    std::string serialized = serialize_datum_for_disk(test_object, &res);
+    std::string buf_serialized = serialize_datum_for_disk(buf_object, &buf_res);
+    ASSERT_EQ(ql::serialization_result_t::SUCCESS, res);
+    ASSERT_EQ(ql::serialization_result_t::SUCCESS, buf_res);
+    ASSERT_EQ(serialized, buf_serialized);
+
+    // Scalars are left alone.
+    ASSERT_TRUE(ql::datum_serialize_to_buf(ql::datum_t(1.0)).get_buf_ref() == NULL);
+}
+
+TEST(DatumTest, SerializeToBufChecksArraySize) {
+    ql::datum_t big_array(std::vector<ql::datum_t>(100001, ql::datum_t::null()),
+                          ql::configured_limits_t::unlimited);
+    ql::datum_t test_object(std::map<datum_string_t, ql::datum_t>
+            {std::make_pair(datum_string_t("big"), big_array)});
+    ql::datum_t buf_object = ql::datum_serialize_to_buf(test_object);
+    ASSERT_TRUE(buf_object.get_buf_ref() != NULL);
+
+    ql::serialization_result_t res;
+    serialize_datum_for_disk(buf_object, &res);
+    ASSERT_EQ(ql::serialization_result_t::ARRAY_TOO_BIG, res);
+}
+
+ql::datum_t make_wide_test_object(size_t num_fields) {
+    std::map<datum_string_t, ql::datum_t> fields;
+    for (size_t i = 0; i < num_fields; ++i) {
+        fields[datum_string_t(strprintf("field_%03zu", i))] =
+            ql::datum_t(static_cast<double>(i));
+    }
+    return ql::datum_serialize_to_buf(ql::datum_t(std::move(fields)));
+}
+
+TEST(DatumTest, WideObjectGetField) {
+    const size_t sizes[] = { 0, 1, 2, 63, 64, 65, 300 };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        ql::datum_t object = make_wide_test_object(sizes[s]);
+        // Look everything up a few times, so that wide objects switch to their
+        // hash index half way.
+        for (int round = 0; round < 3; ++round) {
+            for (size_t i = 0; i < sizes[s]; ++i) {
+                ql::datum_t val = object.get_field(
+                    datum_string_t(strprintf("field_%03zu", i)), ql::NOTHROW);
+                ASSERT_TRUE(val.has());
+                ASSERT_EQ(static_cast<double>(i), val.as_num());
+            }
+            ASSERT_FALSE(object.get_field("field_", ql::NOTHROW).has());
+            ASSERT_FALSE(object.get_field("field_9999", ql::NOTHROW).has());
+            ASSERT_FALSE(object.get_field("", ql::NOTHROW).has());
+        }
+        // Copies of the datum share the index.
+        ql::datum_t copy = object;
+        if (sizes[s] > 0) {
+            ASSERT_TRUE(copy.get_field("field_000", ql::NOTHROW).has());
+        }
+    }
+}
+
+TEST(DatumTest, WideObjectIndexWaitsForLookups) {
+    ql::datum_t object = make_wide_test_object(300);
+    const shared_buf_ref_t<char> *buf_ref = object.get_buf_ref();
+    ASSERT_TRUE(buf_ref != NULL);
+    // Looking a field up once or twice doesn't allocate anything.
+    ASSERT_TRUE(object.get_field("field_001", ql::NOTHROW).has());
+    ASSERT_TRUE(object.get_field("field_002", ql::NOTHROW).has());
+    ASSERT_TRUE(buf_ref->get_annex() == NULL);
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_TRUE(object.get_field("field_003", ql::NOTHROW).has());
+    }
+    ASSERT_TRUE(buf_ref->get_annex() != NULL);
+}
+
 }  // namespace unittest
@@ -1,4 +1,5 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "btree/node.hpp"
 #include "math.hpp"
 #include "serializer/log/lba/disk_format.hpp"
 #include "serializer/log/log_serializer.hpp"
@@ -130,4 +131,11 @@ TEST(DiskFormatTest, LogSerializerStaticConfigT) {
     EXPECT_EQ(16u, sizeof(log_serializer_on_disk_static_config_t));
 }
 
+TEST(DiskFormatTest, BtreeStatblockT) {
+    EXPECT_EQ(0u, offsetof(btree_statblock_t, population));
+    EXPECT_EQ(8u, offsetof(btree_statblock_t, value_bytes));
+    EXPECT_EQ(16u, sizeof(btree_statblock_t));
+    EXPECT_EQ(8u, BTREE_STATBLOCK_POPULATION_ONLY_SIZE);
+}
+
 }  // namespace unittest
@@ -0,0 +1,211 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/io/disk.hpp"
+#include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/external_sort.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/pb_utils.hpp"
+#include "stl_utils.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+ql::sym_t external_sort_test_var(1);
+
+// Orders `{key, position}` rows by key only, so we can tell whether equal keys stay
+// in order.
+ql::sort_order_t make_key_order() {
+    ql::protob_t<const Term> body
+        = ql::r::var(external_sort_test_var)["key"].release_counted();
+    ql::wire_func_t func(body, make_vector(external_sort_test_var),
+                         get_backtrace(body));
+    return ql::sort_order_t(
+        {std::make_pair(ql::sort_direction_t::ASC, func.compile_wire_func())});
+}
+
+ql::datum_t make_row(int key, int position) {
+    ql::datum_object_builder_t builder;
+    UNUSED bool dup = builder.add("key", ql::datum_t(static_cast<double>(key)));
+    dup = builder.add("position", ql::datum_t(static_cast<double>(position)));
+    return std::move(builder).to_datum();
+}
+
+int row_key(const ql::datum_t &row) {
+    return static_cast<int>(row.get_field("key").as_num());
+}
+
+int row_position(const ql::datum_t &row) {
+    return static_cast<int>(row.get_field("position").as_num());
+}
+
+void run_merge_sorted_runs_test() {
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    cond_t interruptor;
+    ql::env_t env(&interruptor, reql_version_t::LATEST);
+    ql::sort_order_t order = make_key_order();
+
+    // Runs of the rows `position % num_runs == run`, each sorted, with few
+    // distinct keys.
+    const int num_runs = 4;
+    const int num_rows = 3000;
+    std::vector<std::vector<ql::keyed_row_t> > unsorted(num_runs);
+    for (int i = 0; i < num_rows; ++i) {
+        ql::keyed_row_t row;
+        row.row = make_row((i * 7919) % 10, i);
+        row.key = order.key(&env, row.row);
+        row.position = i;
+        unsorted[i % num_runs].push_back(std::move(row));
+    }
+    std::vector<scoped_ptr_t<ql::sorted_run_t> > runs;
+    for (int run = 0; run < num_runs; ++run) {
+        std::stable_sort(unsorted[run].begin(), unsorted[run].end(),
+                         [&](const ql::keyed_row_t &l, const ql::keyed_row_t &r) {
+                             return order.key_lt(&env, l.key, r.key);
+                         });
+        if (run == num_runs - 1) {
+            break;
+        }
+        const std::string path = strprintf("test_external_sort_%d", run);
+        runs.push_back(make_scoped<ql::sorted_run_t>(
+            &io_backender, manual_serializer_filepath(path, path + ".create"),
+            &get_global_perfmon_collection()));
+        for (auto it = unsorted[run].begin(); it != unsorted[run].end(); ++it) {
+            runs.back()->push(it->row);
+        }
+    }
+
+    ql::sorted_runs_merger_t merger(&order, std::move(runs),
+                                    std::move(unsorted[num_runs - 1]));
+    ASSERT_FALSE(merger.is_exhausted());
+    profile::sampler_t sampler("Merging.", NULL);
+    ql::datum_t prev;
+    int count = 0;
+    ql::datum_t d;
+    while (d = merger.next(&env, &sampler), d.has()) {
+        if (prev.has()) {
+            ASSERT_LE(row_key(prev), row_key(d));
+            if (row_key(prev) == row_key(d)) {
+                // Equal keys come out by run, then by position within the run.
+                const int prev_run = row_position(prev) % num_runs;
+                const int run = row_position(d) % num_runs;
+                ASSERT_TRUE(prev_run < run
+                            || (prev_run == run
+                                && row_position(prev) < row_position(d)));
+            }
+        }
+        prev = d;
+        ++count;
+    }
+    ASSERT_EQ(num_rows, count);
+    ASSERT_TRUE(merger.is_exhausted());
+}
+
+TEST(ExternalSortTest, MergeSortedRuns) {
+    run_in_thread_pool(&run_merge_sorted_runs_test, 2);
+}
+
+void run_top_k_test() {
+    cond_t interruptor;
+    ql::env_t env(&interruptor, reql_version_t::LATEST);
+
+    const int num_rows = 1000;
+    std::vector<ql::datum_t> rows;
+    for (int i = 0; i < num_rows; ++i) {
+        rows.push_back(make_row((i * 7919) % 37, i));
+    }
+    std::vector<ql::datum_t> expected = rows;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [](const ql::datum_t &l, const ql::datum_t &r) {
+                         return row_key(l) < row_key(r);
+                     });
+
+    const size_t limits[] = { 0, 1, 10, 999, 1000, 5000 };
+    for (size_t i = 0; i < sizeof(limits) / sizeof(limits[0]); ++i) {
+        ql::external_sorter_t sorter(&env, make_key_order(), limits[i]);
+        ASSERT_FALSE(sorter.keeps_all_rows_in_memory());
+        // In a few batches, like from a stream.
+        for (int j = 0; j < num_rows; j += 300) {
+            sorter.add(&env, std::vector<ql::datum_t>(
+                           rows.begin() + j,
+                           rows.begin() + std::min(j + 300, num_rows)));
+        }
+        ql::datum_t sorted = sorter.finish(&env, ql::make_counted_backtrace())
+            ->as_array(&env);
+        ASSERT_TRUE(sorted.has());
+        ASSERT_EQ(std::min<size_t>(limits[i], num_rows), sorted.arr_size());
+        for (size_t j = 0; j < sorted.arr_size(); ++j) {
+            ASSERT_EQ(expected[j], sorted.get(j));
+        }
+    }
+
+    // Without a limit or anywhere to spill, it's an in-memory sort.
+    ql::external_sorter_t sorter(&env, make_key_order(), boost::none);
+    ASSERT_TRUE(sorter.keeps_all_rows_in_memory());
+    sorter.add(&env, std::vector<ql::datum_t>(rows));
+    ql::datum_t sorted = sorter.finish(&env, ql::make_counted_backtrace())
+        ->as_array(&env);
+    ASSERT_EQ(ql::datum_t(std::move(expected), ql::configured_limits_t()), sorted);
+}
+
+TEST(ExternalSortTest, TopK) {
+    run_in_thread_pool(&run_top_k_test);
+}
+
+void run_spill_test() {
+    // Runs of 10 rows.
+    spilling_env_t spilling_env(10);
+    ql::env_t *env = spilling_env.get();
+
+    const int num_rows = 405;
+    std::vector<ql::datum_t> rows;
+    for (int i = 0; i < num_rows; ++i) {
+        rows.push_back(make_row((i * 7919) % 37, i));
+    }
+    std::vector<ql::datum_t> expected = rows;
+    std::stable_sort(expected.begin(), expected.end(),
+                     [](const ql::datum_t &l, const ql::datum_t &r) {
+                         return row_key(l) < row_key(r);
+                     });
+
+    ql::external_sorter_t sorter(env, make_key_order(), boost::none);
+    ASSERT_FALSE(sorter.keeps_all_rows_in_memory());
+    // What fits in memory doesn't go to disk.
+    sorter.add(env, std::vector<ql::datum_t>(rows.begin(), rows.begin() + 10));
+    ASSERT_EQ(0u, sorter.runs_on_disk());
+    sorter.add(env, std::vector<ql::datum_t>(rows.begin() + 10, rows.begin() + 11));
+    ASSERT_EQ(1u, sorter.runs_on_disk());
+    // The 16th run gets merged with the 15 before it.
+    sorter.add(env, std::vector<ql::datum_t>(rows.begin() + 11, rows.begin() + 151));
+    ASSERT_EQ(15u, sorter.runs_on_disk());
+    sorter.add(env, std::vector<ql::datum_t>(rows.begin() + 151, rows.begin() + 161));
+    ASSERT_EQ(1u, sorter.runs_on_disk());
+    // 40 runs are two runs of 16, and 8 more.
+    for (int i = 161; i < num_rows; i += 7) {
+        sorter.add(env, std::vector<ql::datum_t>(
+                       rows.begin() + i, rows.begin() + std::min(i + 7, num_rows)));
+    }
+    ASSERT_EQ(10u, sorter.runs_on_disk());
+
+    counted_t<ql::datum_stream_t> sorted
+        = sorter.finish(env, ql::make_counted_backtrace());
+    ASSERT_FALSE(sorted->is_array());
+    ql::batchspec_t batchspec = ql::batchspec_t::user(ql::batch_type_t::NORMAL, env);
+    std::vector<ql::datum_t> res;
+    for (;;) {
+        std::vector<ql::datum_t> batch = sorted->next_batch(env, batchspec);
+        if (batch.empty()) {
+            break;
+        }
+        res.insert(res.end(), batch.begin(), batch.end());
+    }
+    // Rows with equal keys keep their order through every merge.
+    ASSERT_EQ(expected, res);
+}
+
+TEST(ExternalSortTest, Spill) {
+    run_in_thread_pool(&run_spill_test);
+}
+
+}  // namespace unittest
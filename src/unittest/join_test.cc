@@ -0,0 +1,260 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/join.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/pb_utils.hpp"
+#include "stl_utils.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+ql::sym_t join_test_var(1);
+
+counted_t<const ql::func_t> make_field_func(const char *field) {
+    ql::protob_t<const Term> body
+        = ql::r::var(join_test_var)[field].release_counted();
+    ql::wire_func_t func(body, make_vector(join_test_var), get_backtrace(body));
+    return func.compile_wire_func();
+}
+
+// `{key: key, position: position}` rows, with `key` going around `num_keys`.
+std::vector<ql::datum_t> make_side_rows(int num_rows, int num_keys) {
+    std::vector<ql::datum_t> rows;
+    for (int i = 0; i < num_rows; ++i) {
+        ql::datum_object_builder_t builder;
+        UNUSED bool dup = builder.add(
+            "key", ql::datum_t(static_cast<double>(i % num_keys)));
+        dup = builder.add("position", ql::datum_t(static_cast<double>(i)));
+        rows.push_back(std::move(builder).to_datum());
+    }
+    return rows;
+}
+
+counted_t<ql::datum_stream_t> make_side(std::vector<ql::datum_t> rows) {
+    return make_counted<ql::array_datum_stream_t>(
+        ql::datum_t(std::move(rows), ql::configured_limits_t()),
+        ql::make_counted_backtrace());
+}
+
+std::vector<ql::datum_t> read_join(ql::env_t *env,
+                                   const counted_t<ql::datum_stream_t> &join) {
+    ql::batchspec_t batchspec = ql::batchspec_t::user(ql::batch_type_t::NORMAL, env);
+    std::vector<ql::datum_t> ret;
+    for (;;) {
+        std::vector<ql::datum_t> batch = join->next_batch(env, batchspec);
+        if (batch.empty()) {
+            break;
+        }
+        ret.insert(ret.end(), batch.begin(), batch.end());
+    }
+    return ret;
+}
+
+std::vector<ql::datum_t> run_join(ql::env_t *env, ql::join_kind_t kind,
+                                  int num_left, int num_right, int num_right_keys) {
+    counted_t<ql::datum_stream_t> join = make_counted<ql::equi_join_datum_stream_t>(
+        env, kind,
+        make_side(make_side_rows(num_left, num_left)), make_field_func("key"),
+        make_side(make_side_rows(num_right, num_right_keys)), make_field_func("key"),
+        ql::make_counted_backtrace());
+    return read_join(env, join);
+}
+
+// What the nested loop gets, with the rows ordered by key like a sorted join
+// returns them.
+std::vector<ql::datum_t> sorted_nested_loop_join(ql::join_kind_t kind,
+                                                 const std::vector<ql::datum_t> &left,
+                                                 const std::vector<ql::datum_t> &right) {
+    std::vector<ql::datum_t> ret;
+    for (auto l = left.begin(); l != left.end(); ++l) {
+        bool matched = false;
+        for (auto r = right.begin(); r != right.end(); ++r) {
+            if (l->get_field("key") == r->get_field("key")) {
+                ql::datum_object_builder_t pair;
+                UNUSED bool dup = pair.add("left", *l);
+                dup = pair.add("right", *r);
+                ret.push_back(std::move(pair).to_datum());
+                matched = true;
+            }
+        }
+        if (!matched && kind == ql::join_kind_t::OUTER) {
+            ql::datum_object_builder_t pair;
+            UNUSED bool dup = pair.add("left", *l);
+            ret.push_back(std::move(pair).to_datum());
+        }
+    }
+    std::stable_sort(ret.begin(), ret.end(),
+                     [](const ql::datum_t &l, const ql::datum_t &r) {
+                         return l.get_field("left").get_field("key").as_num()
+                             < r.get_field("left").get_field("key").as_num();
+                     });
+    return ret;
+}
+
+void check_sorted_join(ql::env_t *env, ql::join_kind_t kind,
+                       int num_left, int num_left_keys,
+                       int num_right, int num_right_keys) {
+    std::vector<ql::datum_t> left = make_side_rows(num_left, num_left_keys);
+    std::vector<ql::datum_t> right = make_side_rows(num_right, num_right_keys);
+    counted_t<ql::datum_stream_t> join = make_counted<ql::equi_join_datum_stream_t>(
+        env, kind,
+        make_side(left), make_field_func("key"),
+        make_side(right), make_field_func("key"),
+        ql::make_counted_backtrace());
+    ASSERT_TRUE(join->is_array());
+    ASSERT_EQ(sorted_nested_loop_join(kind, left, right), read_join(env, join));
+    // Sorting the left side doesn't change what kind of stream the join is.
+    ASSERT_TRUE(join->is_array());
+}
+
+TEST(JoinTest, InMemory) {
+    cond_t interruptor;
+    ql::env_t env(&interruptor, reql_version_t::LATEST);
+
+    // Left keys 0..9, right keys 0..3 twice each.
+    std::vector<ql::datum_t> inner = run_join(&env, ql::join_kind_t::INNER, 10, 8, 4);
+    ASSERT_EQ(8u, inner.size());
+    for (size_t i = 0; i < inner.size(); ++i) {
+        ql::datum_t left = inner[i].get_field("left");
+        ql::datum_t right = inner[i].get_field("right");
+        // Left rows come out in order, like with the nested loop.
+        ASSERT_EQ(static_cast<double>(i / 2), left.get_field("position").as_num());
+        ASSERT_EQ(left.get_field("key"), right.get_field("key"));
+    }
+
+    std::vector<ql::datum_t> outer = run_join(&env, ql::join_kind_t::OUTER, 10, 8, 4);
+    ASSERT_EQ(14u, outer.size());
+    for (size_t i = 8; i < outer.size(); ++i) {
+        ASSERT_EQ(static_cast<double>(i - 4),
+                  outer[i].get_field("left").get_field("position").as_num());
+        ASSERT_FALSE(outer[i].get_field("right", ql::NOTHROW).has());
+    }
+
+    // Nothing on the right.
+    ASSERT_EQ(0u, run_join(&env, ql::join_kind_t::INNER, 10, 0, 1).size());
+    ASSERT_EQ(10u, run_join(&env, ql::join_kind_t::OUTER, 10, 0, 1).size());
+}
+
+void run_sorted_join_test() {
+    // Past 5 rows on the right, both sides get sorted.
+    spilling_env_t spilling_env(5);
+    ql::env_t *env = spilling_env.get();
+
+    for (int i = 0; i < 2; ++i) {
+        const ql::join_kind_t kind = i == 0
+            ? ql::join_kind_t::INNER
+            : ql::join_kind_t::OUTER;
+        // Duplicate keys on both sides, with left keys past the right ones.
+        check_sorted_join(env, kind, 12, 4, 10, 3);
+        // Right keys past the left ones.
+        check_sorted_join(env, kind, 8, 2, 12, 6);
+        // Sides big enough to spill.
+        check_sorted_join(env, kind, 40, 7, 30, 5);
+        // No keys in common.
+        std::vector<ql::datum_t> left = make_side_rows(3, 3);
+        std::vector<ql::datum_t> right;
+        for (int j = 0; j < 8; ++j) {
+            ql::datum_object_builder_t builder;
+            UNUSED bool dup = builder.add("key", ql::datum_t("x"));
+            right.push_back(std::move(builder).to_datum());
+        }
+        std::vector<ql::datum_t> res = read_join(
+            env, make_counted<ql::equi_join_datum_stream_t>(
+                env, kind,
+                make_side(left), make_field_func("key"),
+                make_side(right), make_field_func("key"),
+                ql::make_counted_backtrace()));
+        ASSERT_EQ(kind == ql::join_kind_t::INNER ? 0u : 3u, res.size());
+    }
+}
+
+TEST(JoinTest, Sorted) {
+    run_in_thread_pool(&run_sorted_join_test);
+}
+
+// `inner_join([], [], function(var 1, var 2) { return body; })`
+ql::protob_t<Term> make_join_term(ql::r::reql_t &&body) {
+    std::vector<ql::r::reql_t> params;
+    params.emplace_back(1.0);
+    params.emplace_back(2.0);
+    return ql::r::reql_t(Term::INNER_JOIN, ql::r::array(), ql::r::array(),
+                         ql::r::reql_t(Term::FUNC, std::move(params), std::move(body)))
+        .release_counted();
+}
+
+ql::r::reql_t join_left_var() { return ql::r::var(ql::sym_t(1)); }
+ql::r::reql_t join_right_var() { return ql::r::var(ql::sym_t(2)); }
+
+// Whether `key` is `function(var) { return body; }`.
+bool is_key_func(const ql::protob_t<Term> &key, int64_t var, ql::r::reql_t &&body) {
+    std::vector<ql::r::reql_t> params;
+    params.emplace_back(static_cast<double>(var));
+    ql::r::reql_t expected(Term::FUNC, std::move(params), std::move(body));
+    return key->SerializeAsString() == expected.get().SerializeAsString();
+}
+
+TEST(JoinTest, EqualityPredicates) {
+    ql::protob_t<Term> left_key, right_key;
+
+    ASSERT_TRUE(ql::equality_join_keys(
+        *make_join_term(join_left_var()["a"] == join_right_var()["b"]),
+        &left_key, &right_key));
+    ASSERT_TRUE(is_key_func(left_key, 1, join_left_var()["a"]));
+    ASSERT_TRUE(is_key_func(right_key, 2, join_right_var()["b"]));
+
+    // The sides can be either way around, and the keys can be any expressions.
+    ASSERT_TRUE(ql::equality_join_keys(
+        *make_join_term(join_right_var()["b"] == (join_left_var()["a"] + 1.0)),
+        &left_key, &right_key));
+    ASSERT_TRUE(is_key_func(left_key, 1, join_left_var()["a"] + 1.0));
+    ASSERT_TRUE(is_key_func(right_key, 2, join_right_var()["b"]));
+
+    ASSERT_TRUE(ql::equality_join_keys(
+        *make_join_term(ql::r::expr(1.0) == join_right_var()["b"]),
+        &left_key, &right_key));
+    ASSERT_TRUE(is_key_func(left_key, 1, ql::r::expr(1.0)));
+}
+
+TEST(JoinTest, OtherPredicates) {
+    ql::protob_t<Term> left_key, right_key;
+
+    // Not an equality.
+    ASSERT_FALSE(ql::equality_join_keys(
+        *make_join_term(join_left_var()["a"] < join_right_var()["b"]),
+        &left_key, &right_key));
+    ASSERT_FALSE(ql::equality_join_keys(
+        *make_join_term(!(join_left_var()["a"] == join_right_var()["b"])),
+        &left_key, &right_key));
+    // Both sides of the equality use the same row.
+    ASSERT_FALSE(ql::equality_join_keys(
+        *make_join_term(join_left_var()["a"]
+                        == (join_right_var()["b"] + join_left_var()["c"])),
+        &left_key, &right_key));
+    ASSERT_FALSE(ql::equality_join_keys(
+        *make_join_term(join_left_var()["a"] == join_left_var()["b"]),
+        &left_key, &right_key));
+    // More than two things equal.
+    ASSERT_FALSE(ql::equality_join_keys(
+        *make_join_term(ql::r::reql_t(Term::EQ, join_left_var()["a"],
+                                      join_right_var()["b"], join_right_var()["c"])),
+        &left_key, &right_key));
+    // `r.row` might be either row.
+    ASSERT_FALSE(ql::equality_join_keys(
+        *make_join_term(join_left_var()["a"]
+                        == ql::r::reql_t(Term::IMPLICIT_VAR)["b"]),
+        &left_key, &right_key));
+    // Not a two-argument function.
+    std::vector<ql::r::reql_t> params;
+    params.emplace_back(1.0);
+    ASSERT_FALSE(ql::equality_join_keys(
+        *ql::r::reql_t(Term::INNER_JOIN, ql::r::array(), ql::r::array(),
+                       ql::r::reql_t(Term::FUNC, std::move(params),
+                                     join_left_var()["a"] == 1.0))
+        .release_counted(),
+        &left_key, &right_key));
+}
+
+}  // namespace unittest
@@ -0,0 +1,126 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "http/json.hpp"
+#include "protob/json_shim.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "utils.hpp"
+
+namespace unittest {
+
+const char *const json_shim_test_queries[] = {
+    "[1,[15,[[14,[\"test\"]],\"tbl\"]],{}]",
+    "[1,[56,[[15,[\"tbl\"]],{\"id\":1,\"name\":\"Bob\",\"tags\":[2,[\"a\",\"b\"]]}]],"
+    "{\"durability\":\"soft\",\"noreply\":true}]",
+    "[1,[39,[[15,[\"tbl\"]],[69,[[2,[1]],[170,[[10,[1]],\"x\"]]]]]],{}]",
+    " [ 2 , [ 1 ] , { } , \"ignored\" , [ 1 , { \"a\" : null } ] ] trailing",
+    "[1,\"esc\\\"aped\\\\ \\b\\f\\n\\r\\t \\u00e9 \\u20ac \\ud83d\\ude00 \\ud83d\"]",
+    "[1,{\"a\":1.5e3,\"b\":-0.25,\"c\":[1,2,3],\"d\":{\"e\":false}}]",
+    "[1,[2,{\"keys\":\"ignored\"}],{}]",
+    "[1,0x10]",
+    "{\"0\":1,\"1\":2}",
+    "[3]",
+    "17",
+    "\"unterminated",
+    // These aren't queries.
+    "",
+    "[1,",
+    "[1,[2,[1]],{\"a\"}]",
+    "[1,[2,[1]],[1]]",
+    "[1,[2,5]]",
+    "[\"1\"]",
+    "[1.5]",
+    "[1,\"\\u0000\"]",
+    "[1,\"\\udc00\"]",
+    "nope",
+};
+
+TEST(JsonShimTest, ParseMatchesCjson) {
+    for (size_t i = 0; i < sizeof(json_shim_test_queries) / sizeof(char *); ++i) {
+        const char *str = json_shim_test_queries[i];
+        Query direct, via_cjson;
+        bool direct_ok = json_shim::parse_json_pb(&direct, 7, str);
+        bool via_cjson_ok = json_shim::parse_json_pb_via_cjson(&via_cjson, 7, str);
+        ASSERT_EQ(via_cjson_ok, direct_ok) << str;
+        if (direct_ok) {
+            ASSERT_EQ(via_cjson.SerializeAsString(), direct.SerializeAsString()) << str;
+        }
+    }
+}
+
+const char *const json_shim_test_documents[] = {
+    "null",
+    "[true,false,0,-1,1.5,1e300,123456789012345678]",
+    "\"quote\\\" backslash\\\\ control\\u0001\\u001f tab\\t unicode\\u00e9\"",
+    "{\"id\":\"4e5f\",\"nested\":{\"a\":[1,{\"b\":[]}],\"c\":{}},\"s\":\"x\"}",
+    "{\"$reql_type$\":\"BINARY\",\"data\":\"aGVsbG8=\"}",
+};
+
+TEST(JsonShimTest, DatumWriteJsonMatchesCjson) {
+    ql::configured_limits_t limits;
+    for (size_t i = 0; i < sizeof(json_shim_test_documents) / sizeof(char *); ++i) {
+        scoped_cJSON_t json(cJSON_Parse(json_shim_test_documents[i]));
+        ASSERT_TRUE(json.get() != NULL);
+        ql::datum_t d = ql::to_datum(json.get(), limits);
+        std::string direct;
+        d.write_json(&direct);
+        ASSERT_EQ(d.as_json().PrintUnformatted(), direct);
+    }
+}
+
+TEST(JsonShimTest, WriteJsonPbPieces) {
+    Response response;
+    response.set_token(3);
+    response.set_type(Response::SUCCESS_SEQUENCE);
+    Datum *d = response.add_response();
+    d->set_type(Datum::R_JSON);
+    d->set_r_str("{\"a\":1}");
+    d = response.add_response();
+    d->set_type(Datum::R_STR);
+    d->set_r_str("line\n");
+    response.mutable_backtrace()->add_frames()->set_type(Frame::POS);
+    response.mutable_backtrace()->mutable_frames(0)->set_pos(2);
+    Frame *opt = response.mutable_backtrace()->add_frames();
+    opt->set_type(Frame::OPT);
+    opt->set_opt("index");
+
+    json_shim::json_pb_pieces_t pieces;
+    json_shim::write_json_pb(response, &pieces);
+    std::string str;
+    pieces.append_to(&str);
+    ASSERT_EQ(strprintf("{\"t\":%d,\"r\":[{\"a\":1},\"line\\n\"],\"b\":[2,\"index\"]}",
+                        Response::SUCCESS_SEQUENCE),
+              str);
+    ASSERT_EQ(str.size(), pieces.size());
+    // The datum's JSON isn't copied.
+    ASSERT_EQ(response.response(0).r_str().data(), pieces.pieces()[1].first);
+}
+
+TEST(JsonShimTest, BigQuery) {
+    std::string doc = "{\"id\":\"d0b7d5b4-5c0d-4e0e-a1ad-8c5b6a51d2ce\","
+                      "\"name\":\"Some Body\",\"age\":42,\"score\":0.75,"
+                      "\"tags\":[\"a\",\"bb\",\"ccc\"],\"address\":{\"street\":"
+                      "\"1 Main St\",\"zip\":\"94105\",\"geo\":[37.79,-122.39]}}";
+    std::string query = "[1,[56,[[15,[[14,[\"test\"]],\"people\"]],[2,[";
+    for (int i = 0; i < 100; ++i) {
+        query += (i == 0 ? "" : ",") + doc;
+    }
+    query += "]]]],{\"durability\":\"soft\"}]";
+
+    Query direct, via_cjson;
+    ASSERT_TRUE(json_shim::parse_json_pb(&direct, 1, query.c_str()));
+    ASSERT_TRUE(json_shim::parse_json_pb_via_cjson(&via_cjson, 1, query.c_str()));
+    ASSERT_EQ(via_cjson.SerializeAsString(), direct.SerializeAsString());
+
+    ql::configured_limits_t limits;
+    scoped_cJSON_t json(cJSON_Parse(("[" + query + "]").c_str()));
+    ASSERT_TRUE(json.get() != NULL);
+    ql::datum_t d = ql::to_datum(json.get(), limits);
+    std::string out;
+    d.write_json(&out);
+    ASSERT_EQ(d.as_json().PrintUnformatted(), out);
+}
+
+}  // namespace unittest
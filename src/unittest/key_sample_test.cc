@@ -0,0 +1,93 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "btree/key_sample.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+store_key_t sample_test_key(int i) {
+    return store_key_t(strprintf("%06d", i));
+}
+
+TEST(KeySampleTest, KeepsEverythingWhileSmall) {
+    key_sample_t sample;
+    for (int i = 0; i < key_sample_t::MAX_KEYS; ++i) {
+        sample.on_insert(sample_test_key(i).btree_key(), i + 1, 4000);
+    }
+    ASSERT_EQ(static_cast<size_t>(key_sample_t::MAX_KEYS), sample.num_keys());
+
+    std::vector<store_key_t> keys = sample.sorted_keys();
+    for (int i = 0; i < key_sample_t::MAX_KEYS; ++i) {
+        EXPECT_EQ(sample_test_key(i), keys[i]);
+    }
+}
+
+TEST(KeySampleTest, BoundedBySizeAndCount) {
+    key_sample_t sample;
+    for (int i = 0; i < 10000; ++i) {
+        sample.on_insert(sample_test_key(i).btree_key(), i + 1, 500);
+        ASSERT_LE(sample.size_in_bytes(), 500u);
+    }
+    EXPECT_GT(sample.num_keys(), 0u);
+
+    key_sample_t big_sample;
+    for (int i = 0; i < 10000; ++i) {
+        big_sample.on_insert(sample_test_key(i).btree_key(), i + 1, 100000);
+    }
+    EXPECT_EQ(static_cast<size_t>(key_sample_t::MAX_KEYS), big_sample.num_keys());
+}
+
+TEST(KeySampleTest, EraseAndEraseRange) {
+    key_sample_t sample;
+    for (int i = 0; i < 10; ++i) {
+        sample.on_insert(sample_test_key(i).btree_key(), i + 1, 4000);
+    }
+
+    sample.on_erase(sample_test_key(3).btree_key());
+    sample.on_erase(sample_test_key(100).btree_key());
+    ASSERT_EQ(9u, sample.num_keys());
+
+    // Erases keys 5, 6 and 7.
+    store_key_t left = sample_test_key(4);
+    store_key_t right = sample_test_key(7);
+    sample.erase_range(left.btree_key(), right.btree_key());
+    std::vector<store_key_t> keys = sample.sorted_keys();
+    ASSERT_EQ(6u, keys.size());
+    EXPECT_EQ(sample_test_key(4), keys[3]);
+    EXPECT_EQ(sample_test_key(8), keys[4]);
+
+    sample.erase_range(NULL, NULL);
+    EXPECT_EQ(0u, sample.num_keys());
+}
+
+TEST(KeySampleTest, ContainsAndDepleted) {
+    key_sample_t sample;
+    for (int i = 0; i < 100; ++i) {
+        sample.on_insert(sample_test_key(i).btree_key(), i + 1, 4000);
+    }
+    EXPECT_TRUE(key_sample_t::contains(sample.data(), sample.size_in_bytes(),
+                                       sample_test_key(42).btree_key()));
+    EXPECT_FALSE(key_sample_t::contains(sample.data(), sample.size_in_bytes(),
+                                        sample_test_key(100).btree_key()));
+    EXPECT_FALSE(sample.is_depleted(100, 4000));
+
+    // Erasing most of the keys leaves the sample too small for the population.
+    EXPECT_TRUE(sample.on_erase(sample_test_key(42).btree_key()));
+    EXPECT_FALSE(sample.on_erase(sample_test_key(42).btree_key()));
+    store_key_t right = sample_test_key(80);
+    sample.erase_range(NULL, right.btree_key());
+    EXPECT_EQ(19u, sample.num_keys());
+    EXPECT_TRUE(sample.is_depleted(100, 4000));
+    EXPECT_FALSE(sample.is_depleted(19, 4000));
+
+    // Refilling it makes it usable again.
+    for (int i = 0; i < 81; ++i) {
+        if (i != 42) {
+            sample.add(sample_test_key(i).btree_key(), 4000);
+        }
+    }
+    EXPECT_FALSE(sample.is_depleted(99, 4000));
+}
+
+}  // namespace unittest
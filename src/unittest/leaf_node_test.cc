@@ -28,6 +28,10 @@ public:
         return 256;
     }
 
+    int64_t value_bytes(const void *value) const {
+        return size(value);
+    }
+
     block_magic_t btree_leaf_magic() const {
         block_magic_t magic = { { 's', 'h', 'L', 'F' } };
         return magic;
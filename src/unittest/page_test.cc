@@ -219,6 +219,101 @@ TPTEST(PageTest, OneWriteAcqWait, 4) {
     page_cache.flush(std::move(txn));
 }
 
+TPTEST(PageTest, PeekCurrentPage, 4) {
+    mock_ser_t mock;
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    test_cache_t page_cache(mock.ser.get(), &balancer, mock.throttler.get());
+    block_id_t block_id;
+    auto txn1 = make_scoped<test_txn_t>(&page_cache);
+    {
+        current_test_acq_t acq(txn1.get(), alt_create_t::create);
+        block_id = acq.block_id();
+        test_acq_t page_acq;
+        page_acq.init(acq.current_page_for_write(), &page_cache);
+        memset(page_acq.get_buf_write(), 'x', 10);
+        // Nobody can peek at the page while it's being written.
+        ASSERT_TRUE(page_cache.peek_current_page_for_read(block_id) == NULL);
+    }
+    page_cache.flush(std::move(txn1));
+
+    const char *buf = static_cast<const char *>(
+        page_cache.peek_current_page_for_read(block_id));
+    ASSERT_TRUE(buf != NULL);
+    ASSERT_EQ('x', buf[0]);
+
+    auto txn2 = make_scoped<test_txn_t>(&page_cache);
+    {
+        current_test_acq_t acq(txn2.get(), block_id, access_t::read);
+        // Readers don't get in the way.
+        ASSERT_TRUE(page_cache.peek_current_page_for_read(block_id) != NULL);
+    }
+    page_cache.flush(std::move(txn2));
+
+    ASSERT_TRUE(page_cache.peek_current_page_for_read(block_id + 1) == NULL);
+}
+
+TPTEST(PageTest, PinnedPagesAreNotEvicted, 4) {
+    mock_ser_t mock;
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    test_cache_t page_cache(mock.ser.get(), &balancer, mock.throttler.get());
+    block_id_t pinned_id;
+    std::vector<block_id_t> unpinned_ids;
+    auto txn = make_scoped<test_txn_t>(&page_cache);
+    {
+        current_test_acq_t pinned_acq(txn.get(), alt_create_t::create);
+        pinned_id = pinned_acq.block_id();
+        ASSERT_TRUE(page_cache.evicter().pin_page(pinned_acq.current_page_for_write()));
+        ASSERT_TRUE(pinned_acq.current_page_for_write()->is_pinned());
+        test_acq_t page_acq;
+        page_acq.init(pinned_acq.current_page_for_write(), &page_cache);
+        memset(page_acq.get_buf_write(), 'p', 10);
+        for (int i = 0; i < 3; ++i) {
+            current_test_acq_t unpinned_acq(txn.get(), alt_create_t::create);
+            unpinned_ids.push_back(unpinned_acq.block_id());
+            ASSERT_FALSE(unpinned_acq.current_page_for_write()->is_pinned());
+            test_acq_t unpinned_page_acq;
+            unpinned_page_acq.init(unpinned_acq.current_page_for_write(), &page_cache);
+            memset(unpinned_page_acq.get_buf_write(), 'u', 10);
+        }
+    }
+    page_cache.flush(std::move(txn));
+    const uint64_t pinned_size = page_cache.evicter().pinned_size();
+    ASSERT_LT(0u, pinned_size);
+
+    // Once the pages are on disk, shrinking the cache to two pages evicts all but
+    // one of the unpinned pages.  The pinned page still fits under the limit for
+    // pinned pages.
+    page_cache.evicter().update_memory_limit(2 * pinned_size, 0, 0, true);
+    const char *buf = static_cast<const char *>(
+        page_cache.peek_current_page_for_read(pinned_id));
+    ASSERT_TRUE(buf != NULL);
+    ASSERT_EQ('p', buf[0]);
+    int unpinned_in_memory = 0;
+    for (block_id_t id : unpinned_ids) {
+        if (page_cache.peek_current_page_for_read(id) != NULL) {
+            ++unpinned_in_memory;
+        }
+    }
+    ASSERT_LE(unpinned_in_memory, 1);
+
+    // With no room for pinned pages, the pinned page is unpinned and evicted too,
+    // and new pages can't be pinned.
+    page_cache.evicter().update_memory_limit(0, 0, 0, true);
+    ASSERT_EQ(0u, page_cache.evicter().pinned_size());
+    ASSERT_TRUE(page_cache.peek_current_page_for_read(pinned_id) == NULL);
+
+    auto txn2 = make_scoped<test_txn_t>(&page_cache);
+    {
+        current_test_acq_t acq(txn2.get(), alt_create_t::create);
+        ASSERT_FALSE(page_cache.evicter().pin_page(acq.current_page_for_write()));
+        ASSERT_FALSE(acq.current_page_for_write()->is_pinned());
+        test_acq_t page_acq;
+        page_acq.init(acq.current_page_for_write(), &page_cache);
+        memset(page_acq.get_buf_write(), 'n', 10);
+    }
+    page_cache.flush(std::move(txn2));
+}
+
 struct ReadAfterWrite_state_t {
     block_id_t block_id;
     cond_t write_acquired;
@@ -1,6 +1,7 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "unittest/gtest.hpp"
 #include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
 
 namespace unittest {
 void test_mangle(const std::string &pkey, const std::string &skey, boost::optional<uint64_t> tag = boost::optional<uint64_t>()) {
@@ -28,4 +29,41 @@ TEST(PrintSecondary, Mangle) {
                 "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb");
 }
 
+void test_extract_value(ql::datum_t value, boost::optional<uint64_t> tag = boost::optional<uint64_t>()) {
+    store_key_t pkey(ql::datum_t("id").print_primary());
+    store_key_t key(value.print_secondary(reql_version_t::LATEST, pkey, tag));
+    ql::datum_t extracted
+        = ql::datum_t::extract_secondary_value(reql_version_t::LATEST, key);
+    ASSERT_TRUE(extracted.has()) << value.print();
+    ASSERT_EQ(value, extracted);
+    ASSERT_EQ(value.get_type_name(), extracted.get_type_name());
+}
+
+TEST(PrintSecondary, ExtractValue) {
+    test_extract_value(ql::datum_t(1.5));
+    test_extract_value(ql::datum_t(-1e300), 3);
+    test_extract_value(ql::datum_t(0.0));
+    test_extract_value(ql::datum_t(-0.0));
+    test_extract_value(ql::datum_t(""));
+    test_extract_value(ql::datum_t("open"));
+    test_extract_value(ql::datum_t(datum_string_t(3, "a\0b")));
+    test_extract_value(ql::datum_t::boolean(true));
+    test_extract_value(ql::datum_t::boolean(false));
+    test_extract_value(ql::pseudo::make_time(1400000000.25, "+00:00"));
+
+    // Truncated keys and arrays need the row.
+    ql::datum_t long_string(std::string(1000, 'a').c_str());
+    store_key_t pkey(ql::datum_t("id").print_primary());
+    ASSERT_FALSE(ql::datum_t::extract_secondary_value(
+        reql_version_t::LATEST,
+        store_key_t(long_string.print_secondary(reql_version_t::LATEST, pkey,
+                                                boost::none))).has());
+    ql::datum_t array(std::vector<ql::datum_t>{ql::datum_t(1.0)},
+                      ql::configured_limits_t());
+    ASSERT_FALSE(ql::datum_t::extract_secondary_value(
+        reql_version_t::LATEST,
+        store_key_t(array.print_secondary(reql_version_t::LATEST, pkey,
+                                          boost::none))).has());
+}
+
 }  // namespace unittest
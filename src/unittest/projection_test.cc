@@ -0,0 +1,155 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "unittest/gtest.hpp"
+
+#include "containers/archive/vector_stream.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/pb_utils.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
+#include "rdb_protocol/shards.hpp"
+#include "stl_utils.hpp"
+
+namespace unittest {
+
+ql::sym_t projection_test_var(1);
+
+ql::wire_func_t make_row_func(ql::r::reql_t &&body) {
+    ql::protob_t<const Term> term = std::move(body).release_counted();
+    return ql::wire_func_t(term, make_vector(projection_test_var), get_backtrace(term));
+}
+
+ql::r::reql_t row() {
+    return ql::r::var(projection_test_var);
+}
+
+std::set<datum_string_t> make_fields(const std::vector<std::string> &names) {
+    std::set<datum_string_t> fields;
+    fields.insert(ql::datum_t::reql_type_string);
+    for (auto it = names.begin(); it != names.end(); ++it) {
+        fields.insert(datum_string_t(*it));
+    }
+    return fields;
+}
+
+TEST(ProjectionTest, FieldsUsedByOps) {
+    std::vector<ql::transform_variant_t> transforms;
+    transforms.push_back(ql::map_wire_func_t(make_row_func(
+        row()["a"] + row().bracket("b"))));
+    auto fields = ql::fields_used_by_ops(transforms, true);
+    ASSERT_TRUE(static_cast<bool>(fields));
+    ASSERT_EQ(make_fields({"a", "b"}), *fields);
+
+    // Anything after the `map` doesn't matter.
+    transforms.push_back(ql::map_wire_func_t(make_row_func(row())));
+    ASSERT_EQ(make_fields({"a", "b"}), *ql::fields_used_by_ops(transforms, true));
+
+    transforms.clear();
+    transforms.push_back(ql::filter_wire_func_t(
+        make_row_func(row()["c"] == 1.0), boost::none));
+    // Whatever the filter lets through goes to the terminal as a whole.
+    ASSERT_FALSE(static_cast<bool>(ql::fields_used_by_ops(transforms, true)));
+    ASSERT_EQ(make_fields({"c"}), *ql::fields_used_by_ops(transforms, false));
+
+    transforms.push_back(ql::map_wire_func_t(make_row_func(
+        row().pluck("d", "e", ql::r::optarg("_NO_RECURSE_", ql::r::boolean(true))))));
+    ASSERT_EQ(make_fields({"c", "d", "e"}), *ql::fields_used_by_ops(transforms, true));
+
+    // Object bodies of `filter` look at the object's keys.
+    transforms.clear();
+    transforms.push_back(ql::filter_wire_func_t(
+        make_row_func(ql::r::object(ql::r::optarg("f", row()["g"]))), boost::none));
+    ASSERT_EQ(make_fields({"f", "g"}), *ql::fields_used_by_ops(transforms, false));
+    // ... but those of `map` don't.
+    transforms.clear();
+    transforms.push_back(ql::map_wire_func_t(
+        make_row_func(ql::r::object(ql::r::optarg("f", row()["g"])))));
+    ASSERT_EQ(make_fields({"g"}), *ql::fields_used_by_ops(transforms, true));
+
+    // These could look at any field.
+    const char *const names[] = { "merge", "non-literal field", "whole row" };
+    ql::r::reql_t bodies[] = {
+        row().merge(ql::r::object()),
+        row().bracket(row()["h"]),
+        row(),
+    };
+    for (size_t i = 0; i < sizeof(bodies) / sizeof(bodies[0]); ++i) {
+        transforms.clear();
+        transforms.push_back(ql::map_wire_func_t(make_row_func(std::move(bodies[i]))));
+        ASSERT_FALSE(static_cast<bool>(ql::fields_used_by_ops(transforms, true)))
+            << names[i];
+    }
+
+    transforms.clear();
+    transforms.push_back(ql::distinct_wire_func_t());
+    ASSERT_FALSE(static_cast<bool>(ql::fields_used_by_ops(transforms, false)));
+}
+
+// Reads from a buffer and counts how much of it it read.
+class counting_region_reader_t : public ql::datum_region_reader_t {
+public:
+    explicit counting_region_reader_t(const std::vector<char> &_data)
+        : data(_data), bytes_read(0) { }
+    void read(size_t offset, size_t size, char *out) {
+        ASSERT_LE(offset + size, data.size());
+        memcpy(out, data.data() + offset, size);
+        bytes_read += size;
+    }
+    const std::vector<char> &data;
+    size_t bytes_read;
+};
+
+std::vector<char> serialize_for_projection(const ql::datum_t &datum) {
+    write_message_t wm;
+    ql::datum_serialize(&wm, datum, ql::check_datum_serialization_errors_t::NO);
+    vector_stream_t stream;
+    int res = send_write_message(&stream, &wm);
+    EXPECT_EQ(0, res);
+    return stream.vector();
+}
+
+TEST(ProjectionTest, DeserializeProjection) {
+    ql::datum_object_builder_t builder;
+    for (int i = 0; i < 1000; ++i) {
+        ql::datum_array_builder_t value((ql::configured_limits_t()));
+        for (int j = 0; j < 10; ++j) {
+            value.add(ql::datum_t(
+                datum_string_t(strprintf("value %d of field %d", j, i))));
+        }
+        UNUSED bool dup = builder.add(datum_string_t(strprintf("field%04d", i)),
+                                      std::move(value).to_datum());
+    }
+    ql::datum_t object = std::move(builder).to_datum();
+    std::vector<char> data = serialize_for_projection(object);
+
+    std::set<datum_string_t> fields = make_fields({
+        "field0000", "field0500", "field0999", "field050", "field05000", "missing"});
+    counting_region_reader_t reader(data);
+    ql::datum_t projected;
+    ASSERT_TRUE(ql::datum_deserialize_projection(&reader, data.size(), fields,
+                                                 &projected));
+    ASSERT_EQ(3u, projected.obj_size());
+    const char *const found[] = { "field0000", "field0500", "field0999" };
+    for (size_t i = 0; i < sizeof(found) / sizeof(char *); ++i) {
+        ASSERT_EQ(object.get_field(found[i]), projected.get_field(found[i]));
+    }
+    // The offset table and a few keys, besides the three values.
+    ASSERT_LT(reader.bytes_read, data.size() / 10);
+
+    ql::datum_t empty = ql::datum_t::empty_object();
+    std::vector<char> empty_data = serialize_for_projection(empty);
+    counting_region_reader_t empty_reader(empty_data);
+    ASSERT_TRUE(ql::datum_deserialize_projection(&empty_reader, empty_data.size(),
+                                                 fields, &projected));
+    ASSERT_EQ(empty, projected);
+
+    std::vector<char> array_data = serialize_for_projection(
+        ql::datum_t(std::vector<ql::datum_t>{ql::datum_t(1.0)},
+                    ql::configured_limits_t()));
+    counting_region_reader_t array_reader(array_data);
+    ASSERT_FALSE(ql::datum_deserialize_projection(&array_reader, array_data.size(),
+                                                  fields, &projected));
+}
+
+}  // namespace unittest
@@ -4,6 +4,8 @@
 #include "arch/io/disk.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "arch/timing.hpp"
+#include "btree/get_distribution.hpp"
+#include "btree/node.hpp"
 #include "btree/operations.hpp"
 #include "buffer_cache/cache_balancer.hpp"
 #include "containers/archive/boost_types.hpp"
@@ -373,7 +375,8 @@ TPTEST(RDBBtree, SindexPostConstruct) {
             NULL,
             &io_backender,
             base_path_t("."),
-            NULL);
+            NULL,
+            false);
 
     cond_t dummy_interruptor;
 
@@ -389,6 +392,115 @@ TPTEST(RDBBtree, SindexPostConstruct) {
     check_keys_are_present(&store, sindex_name);
 }
 
+TEST(RDBBtree, SplitForPostConstruction) {
+    std::vector<store_key_t> sample;
+    for (int i = 0; i < 100; ++i) {
+        sample.push_back(store_key_t(strprintf("%03d", i)));
+    }
+
+    // The subranges cover the key space in order, without overlapping.
+    std::vector<key_range_t> subranges = split_for_post_construction(sample, 4);
+    ASSERT_EQ(4u, subranges.size());
+    ASSERT_EQ(key_range_t::universe().left, subranges.front().left);
+    ASSERT_TRUE(subranges.back().right.unbounded);
+    for (size_t i = 0; i + 1 < subranges.size(); ++i) {
+        ASSERT_FALSE(subranges[i].right.unbounded);
+        ASSERT_EQ(subranges[i].right.key, subranges[i + 1].left);
+    }
+    // Each one holds a quarter of the sample.
+    for (size_t i = 0; i < subranges.size(); ++i) {
+        size_t sampled = 0;
+        for (auto it = sample.begin(); it != sample.end(); ++it) {
+            if (subranges[i].contains_key(*it)) {
+                ++sampled;
+            }
+        }
+        ASSERT_EQ(25u, sampled);
+    }
+
+    // There are no more subranges than the sample can tell apart.
+    ASSERT_EQ(1u, split_for_post_construction(std::vector<store_key_t>(), 4).size());
+    ASSERT_EQ(2u, split_for_post_construction(
+                      std::vector<store_key_t>(10, store_key_t("a")), 4).size());
+}
+
+// Records the most leaves that post construction inserted from at once.
+void watch_post_construction_semaphore(store_t *store, cond_t *stop,
+                                       int64_t *max_leaves_out) {
+    while (!stop->is_pulsed()) {
+        *max_leaves_out = std::max(*max_leaves_out,
+                                   store->post_construction_semaphore.current());
+        coro_t::yield();
+    }
+}
+
+TPTEST(RDBBtree, SindexPostConstructSubranges, 4) {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    store_t store(
+            &serializer,
+            &balancer,
+            "unit_test_store",
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."),
+            NULL,
+            false);
+
+    cond_t dummy_interruptor;
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+
+    // Post construction splits the btree into one subrange per thread.
+    {
+        read_token_t token;
+        store.new_read_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        store.acquire_superblock_for_read(&token, &txn, &superblock,
+                                          &dummy_interruptor, false);
+        btree_statblock_t stats;
+        std::vector<store_key_t> sorted_sample;
+        ASSERT_EQ(key_sample_state_t::USABLE,
+                  get_btree_key_sample(superblock.get(), &stats, &sorted_sample));
+        ASSERT_EQ(static_cast<size_t>(get_num_db_threads()),
+                  split_for_post_construction(sorted_sample,
+                                              get_num_db_threads()).size());
+    }
+
+    sindex_name_t sindex_name = create_sindex(&store);
+
+    cond_t stop_watching;
+    int64_t max_leaves = 0;
+    coro_t::spawn_sometime(std::bind(&watch_post_construction_semaphore, &store,
+                                     &stop_watching, &max_leaves));
+
+    // The index ends up with the same entries as one built a row at a time.
+    bring_sindexes_up_to_date(&store, sindex_name);
+    check_keys_are_present(&store, sindex_name);
+
+    // The subranges share the limit on leaves being inserted from.
+    stop_watching.pulse();
+    ASSERT_GT(max_leaves, 0);
+    ASSERT_LE(max_leaves, MAX_CONCURRENT_POST_CONSTRUCTION_LEAVES);
+}
+
 TPTEST(RDBBtree, SindexEraseRange) {
     recreate_temporary_directory(base_path_t("."));
     temp_file_t temp_file;
@@ -415,7 +527,8 @@ TPTEST(RDBBtree, SindexEraseRange) {
             NULL,
             &io_backender,
             base_path_t("."),
-            NULL);
+            NULL,
+            false);
 
     cond_t dummy_interruptor;
 
@@ -464,6 +577,389 @@ TPTEST(RDBBtree, SindexEraseRange) {
     check_keys_are_NOT_present(&store, sindex_name);
 }
 
+distribution_read_response_t read_distribution(store_t *store,
+                                               bool *key_sample_depleted_out) {
+    cond_t dummy_interruptor;
+    read_token_t token;
+    store->new_read_token(&token);
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    store->acquire_superblock_for_read(&token, &txn, &superblock,
+                                       &dummy_interruptor, false);
+    distribution_read_response_t response;
+    rdb_distribution_get(2, store_key_t::min(), superblock.get(), &response,
+                         key_sample_depleted_out);
+    return response;
+}
+
+TPTEST(RDBBtree, DistributionAfterEraseRange) {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    store_t store(
+            &serializer,
+            &balancer,
+            "unit_test_store",
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."),
+            NULL,
+            false);
+
+    cond_t dummy_interruptor;
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+
+    bool depleted;
+    distribution_read_response_t before = read_distribution(&store, &depleted);
+    ASSERT_FALSE(depleted);
+    ASSERT_GT(before.key_counts.size(), 64u);
+    ASSERT_GT(before.value_bytes, 0);
+
+    // Erasing the first 90% of the keys drops their share of the sample.
+    const int first_kept = (TOTAL_KEYS_TO_INSERT * 9) / 10;
+    const store_key_t first_kept_key(
+        ql::datum_t(static_cast<double>(first_kept)).print_primary());
+    {
+        write_token_t token;
+        store.new_write_token(&token);
+
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> super_block;
+        store.acquire_superblock_for_write(repli_timestamp_t::distant_past,
+                                           1,
+                                           write_durability_t::SOFT,
+                                           &token,
+                                           &txn,
+                                           &super_block,
+                                           &dummy_interruptor);
+
+        const hash_region_t<key_range_t> test_range = hash_region_t<key_range_t>::universe();
+        rdb_protocol::range_key_tester_t tester(&test_range);
+        rdb_live_deletion_context_t deletion_context;
+        std::vector<rdb_modification_report_t> mod_reports_out;
+        rdb_erase_small_range(&tester,
+                              key_range_t(key_range_t::none, store_key_t(),
+                                          key_range_t::open, first_kept_key),
+                              super_block.get(),
+                              &deletion_context,
+                              &dummy_interruptor,
+                              &mod_reports_out);
+    }
+
+    // The depleted sample isn't used.
+    distribution_read_response_t after_erase = read_distribution(&store, &depleted);
+    ASSERT_TRUE(depleted);
+    ASSERT_FALSE(after_erase.key_counts.empty());
+    // Every row is about the same size.
+    ASSERT_LT(after_erase.value_bytes, before.value_bytes / 5);
+    ASSERT_GT(after_erase.value_bytes, 0);
+
+    // Once it's rebuilt, it describes the keys that are left.
+    store.rebuild_key_sample_in_background();
+    while (store.rebuilding_key_sample) {
+        nap(10);
+    }
+    distribution_read_response_t rebuilt = read_distribution(&store, &depleted);
+    ASSERT_FALSE(depleted);
+    ASSERT_EQ(static_cast<size_t>(TOTAL_KEYS_TO_INSERT - first_kept + 1),
+              rebuilt.key_counts.size());
+    for (auto it = rebuilt.key_counts.begin(); it != rebuilt.key_counts.end(); ++it) {
+        ASSERT_TRUE(it->first == store_key_t::min() || !(it->first < first_kept_key));
+        ASSERT_EQ(1, it->second);
+    }
+}
+
+// Counts the keys in `range` the way an unfiltered `count` does, and sets
+// `*from_stat_block_out` to whether the count came from the stat block.
+uint64_t count_keys_in_range(store_t *store, const key_range_t &range,
+                             bool use_snapshot, bool *from_stat_block_out) {
+    cond_t dummy_interruptor;
+    read_token_t token;
+    store->new_read_token(&token);
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    store->acquire_superblock_for_read(&token, &txn, &superblock,
+                                       &dummy_interruptor, use_snapshot);
+
+    rdb_context_t ctx;
+    profile::trace_t trace;
+    rget_read_response_t res;
+    {
+        ql::env_t env(&ctx, &dummy_interruptor,
+                      std::map<std::string, ql::wire_func_t>(), &trace);
+        rdb_rget_slice(
+            store->btree.get(),
+            range,
+            superblock.get(),
+            &env,
+            ql::batchspec_t::default_for(ql::batch_type_t::TERMINAL),
+            std::vector<ql::transform_variant_t>(),
+            boost::optional<ql::terminal_variant_t>(ql::count_wire_func_t()),
+            sorting_t::UNORDERED,
+            &res,
+            release_superblock_t::RELEASE);
+    }
+
+    *from_stat_block_out = false;
+    profile::event_log_t event_log = std::move(trace).extract_event_log();
+    for (auto it = event_log.begin(); it != event_log.end(); ++it) {
+        const profile::start_t *start = boost::get<profile::start_t>(&*it);
+        if (start != NULL
+            && start->description_ == "Count keys using the stat block.") {
+            *from_stat_block_out = true;
+        }
+    }
+
+    auto counts = boost::get<ql::grouped_t<uint64_t> >(&res.result);
+    guarantee(counts != NULL);
+    uint64_t count = 0;
+    for (auto it = counts->begin(ql::grouped::order_doesnt_matter_t());
+         it != counts->end(ql::grouped::order_doesnt_matter_t()); ++it) {
+        count += it->second;
+    }
+    return count;
+}
+
+TPTEST(RDBBtree, CountFromStatBlock) {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    store_t store(
+            &serializer,
+            &balancer,
+            "unit_test_store",
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."),
+            NULL,
+            false);
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+
+    const store_key_t first_key(ql::datum_t(0.0).print_primary());
+    const store_key_t middle_key(
+        ql::datum_t(static_cast<double>(TOTAL_KEYS_TO_INSERT / 2)).print_primary());
+    const store_key_t past_last_key(
+        ql::datum_t(static_cast<double>(TOTAL_KEYS_TO_INSERT)).print_primary());
+
+    // Ranges that hold every key are counted from the stat block.
+    bool from_stat_block;
+    ASSERT_EQ(static_cast<uint64_t>(TOTAL_KEYS_TO_INSERT),
+              count_keys_in_range(&store, key_range_t::universe(), false,
+                                  &from_stat_block));
+    ASSERT_TRUE(from_stat_block);
+    ASSERT_EQ(static_cast<uint64_t>(TOTAL_KEYS_TO_INSERT),
+              count_keys_in_range(&store,
+                                  key_range_t(key_range_t::closed, first_key,
+                                              key_range_t::open, past_last_key),
+                                  false, &from_stat_block));
+    ASSERT_TRUE(from_stat_block);
+
+    // Keys on either side of the range make it scan the leaves.
+    ASSERT_EQ(static_cast<uint64_t>(TOTAL_KEYS_TO_INSERT / 2),
+              count_keys_in_range(&store,
+                                  key_range_t(key_range_t::closed, first_key,
+                                              key_range_t::open, middle_key),
+                                  false, &from_stat_block));
+    ASSERT_FALSE(from_stat_block);
+    ASSERT_EQ(static_cast<uint64_t>(TOTAL_KEYS_TO_INSERT - TOTAL_KEYS_TO_INSERT / 2),
+              count_keys_in_range(&store,
+                                  key_range_t(key_range_t::closed, middle_key,
+                                              key_range_t::none, store_key_t()),
+                                  false, &from_stat_block));
+    ASSERT_FALSE(from_stat_block);
+
+    // So do snapshotted reads, since the snapshot doesn't cover the stat block.
+    ASSERT_EQ(static_cast<uint64_t>(TOTAL_KEYS_TO_INSERT),
+              count_keys_in_range(&store, key_range_t::universe(), true,
+                                  &from_stat_block));
+    ASSERT_FALSE(from_stat_block);
+}
+
+// Reads `key` the regular way, acquiring the blocks along its path.
+ql::datum_t get_row_with_locks(store_t *store, const store_key_t &key) {
+    cond_t dummy_interruptor;
+    read_token_t token;
+    store->new_read_token(&token);
+    scoped_ptr_t<txn_t> txn;
+    scoped_ptr_t<real_superblock_t> superblock;
+    store->acquire_superblock_for_read(&token, &txn, &superblock,
+                                       &dummy_interruptor, false);
+    point_read_response_t response;
+    rdb_get(key, store->btree.get(), superblock.get(), &response, NULL);
+    return response.data;
+}
+
+// Reads `key` through `store_t::read`, which tries `rdb_get_optimistically` first.
+void read_row_through_store(store_t *store, const store_key_t &key,
+                            ql::datum_t *row_out, cond_t *done) {
+#ifndef NDEBUG
+    trivial_metainfo_checker_callback_t checker_cb;
+    metainfo_checker_t checker(&checker_cb, store->get_region());
+#endif
+    cond_t dummy_interruptor;
+    read_token_t token;
+    store->new_read_token(&token);
+    read_response_t response;
+    store->read(DEBUG_ONLY(checker, )
+                read_t(point_read_t(key), profile_bool_t::DONT_PROFILE),
+                &response,
+                order_token_t::ignore,
+                &token,
+                &dummy_interruptor);
+    point_read_response_t *point_read_response
+        = boost::get<point_read_response_t>(&response.response);
+    guarantee(point_read_response != NULL);
+    *row_out = point_read_response->data;
+    done->pulse();
+}
+
+ql::datum_t parse_row(const std::string &json) {
+    ql::configured_limits_t limits;
+    return ql::to_datum(scoped_cJSON_t(cJSON_Parse(json.c_str())).get(), limits);
+}
+
+TPTEST(RDBBtree, OptimisticGetFallsBack) {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    store_t store(
+            &serializer,
+            &balancer,
+            "unit_test_store",
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."),
+            NULL,
+            false);
+
+    cond_t dummy_interruptor;
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+
+    const store_key_t key(ql::datum_t(7.0).print_primary());
+    const store_key_t missing_key(
+        ql::datum_t(static_cast<double>(TOTAL_KEYS_TO_INSERT)).print_primary());
+
+    // With nothing in the way, rows and missing rows are found without locks.
+    point_read_response_t optimistic;
+    ASSERT_TRUE(rdb_get_optimistically(key, store.btree.get(), store.cache.get(),
+                                       &optimistic));
+    ASSERT_EQ(get_row_with_locks(&store, key), optimistic.data);
+    ASSERT_TRUE(rdb_get_optimistically(missing_key, store.btree.get(),
+                                       store.cache.get(), &optimistic));
+    ASSERT_EQ(ql::datum_t::null(), optimistic.data);
+
+    // A writer in line for the superblock makes reads take the regular path, which
+    // waits for the write and then sees it.
+    const ql::datum_t new_row = parse_row("{\"id\" : 7, \"sid\" : -1}");
+    ql::datum_t row;
+    cond_t read_done;
+    {
+        write_token_t token;
+        store.new_write_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        store.acquire_superblock_for_write(
+            repli_timestamp_t::distant_past,
+            1, write_durability_t::SOFT,
+            &token, &txn, &superblock, &dummy_interruptor);
+        ASSERT_FALSE(rdb_get_optimistically(key, store.btree.get(),
+                                            store.cache.get(), &optimistic));
+
+        coro_t::spawn_sometime(std::bind(&read_row_through_store, &store, key,
+                                         &row, &read_done));
+        for (int i = 0; i < 100; ++i) {
+            coro_t::yield();
+        }
+        ASSERT_FALSE(read_done.is_pulsed());
+
+        point_write_response_t response;
+        rdb_modification_info_t mod_info;
+        rdb_live_deletion_context_t deletion_context;
+        rdb_set(key, new_row, true, store.btree.get(),
+                repli_timestamp_t::distant_past, superblock.get(),
+                &deletion_context, &response, &mod_info,
+                static_cast<profile::trace_t *>(NULL));
+    }
+    read_done.wait();
+    ASSERT_EQ(new_row, row);
+    ASSERT_EQ(get_row_with_locks(&store, key), row);
+
+    // So do documents stored outside the leaf.
+    const ql::datum_t big_row = parse_row(
+        strprintf("{\"id\" : 7, \"sid\" : \"%s\"}", std::string(1000, 'x').c_str()));
+    {
+        write_token_t token;
+        store.new_write_token(&token);
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        store.acquire_superblock_for_write(
+            repli_timestamp_t::distant_past,
+            1, write_durability_t::SOFT,
+            &token, &txn, &superblock, &dummy_interruptor);
+        point_write_response_t response;
+        rdb_modification_info_t mod_info;
+        rdb_live_deletion_context_t deletion_context;
+        rdb_set(key, big_row, true, store.btree.get(),
+                repli_timestamp_t::distant_past, superblock.get(),
+                &deletion_context, &response, &mod_info,
+                static_cast<profile::trace_t *>(NULL));
+    }
+    ASSERT_FALSE(rdb_get_optimistically(key, store.btree.get(), store.cache.get(),
+                                        &optimistic));
+    cond_t big_read_done;
+    read_row_through_store(&store, key, &row, &big_read_done);
+    ASSERT_EQ(big_row, row);
+    ASSERT_EQ(get_row_with_locks(&store, key), row);
+}
+
 TPTEST(RDBBtree, SindexInterruptionViaDrop) {
     recreate_temporary_directory(base_path_t("."));
     temp_file_t temp_file;
@@ -490,7 +986,8 @@ TPTEST(RDBBtree, SindexInterruptionViaDrop) {
             NULL,
             &io_backender,
             base_path_t("."),
-            NULL);
+            NULL,
+            false);
 
     cond_t dummy_interruptor;
 
@@ -533,7 +1030,8 @@ TPTEST(RDBBtree, SindexInterruptionViaStoreDelete) {
             NULL,
             &io_backender,
             base_path_t("."),
-            NULL));
+            NULL,
+            false));
 
     insert_rows(0, (TOTAL_KEYS_TO_INSERT * 9) / 10, store.get());
 
@@ -69,6 +69,22 @@ void mock_namespace_interface_t::read_visitor_t::operator()(const point_read_t &
     }
 }
 
+void mock_namespace_interface_t::read_visitor_t::operator()(
+        const batched_point_read_t &get) {
+    ql::configured_limits_t limits;
+    response->response = batched_point_read_response_t();
+    batched_point_read_response_t &res =
+        boost::get<batched_point_read_response_t>(response->response);
+
+    for (auto it = get.keys.begin(); it != get.keys.end(); ++it) {
+        if (data->find(*it) != data->end()) {
+            res.rows[*it] = ql::to_datum(data->at(*it)->get(), limits);
+        } else {
+            res.rows[*it] = ql::datum_t::null();
+        }
+    }
+}
+
 void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(
         const changefeed_subscribe_t &) {
     throw cannot_perform_query_exc_t("unimplemented");
@@ -80,7 +80,8 @@ void run_with_namespace_interface(
                         temp_files[i]->name().permanent_path(), do_create,
                         &get_global_perfmon_collection(), &ctx,
                         &io_backender, base_path_t("."),
-                        static_cast<outdated_index_report_t *>(NULL)));
+                        static_cast<outdated_index_report_t *>(NULL),
+                        false));
         }
 
         std::vector<scoped_ptr_t<store_view_t> > stores;
@@ -177,6 +178,58 @@ TEST(RDBProtocol, OvershardedGetSet) {
     run_in_thread_pool_with_namespace_interface(&run_get_set_test, true);
 }
 
+/* `BatchedGet` reads several keys, some of them missing, with one read */
+void run_batched_get_test(namespace_interface_t *nsi, order_source_t *osource) {
+    const int num_keys = 100;
+    for (int i = 0; i < num_keys; i += 2) {
+        write_t write(
+                point_write_t(store_key_t(strprintf("key%d", i)),
+                              ql::datum_t(static_cast<double>(i))),
+                DURABILITY_REQUIREMENT_DEFAULT,
+                profile_bool_t::PROFILE,
+                ql::configured_limits_t());
+        write_response_t response;
+
+        cond_t interruptor;
+        nsi->write(write, &response, osource->check_in("unittest::run_batched_get_test(rdb_protocol.cc-A)"), &interruptor);
+    }
+
+    for (int p = 0; p < 2; ++p) {
+        std::vector<store_key_t> keys;
+        for (int i = 0; i < num_keys; ++i) {
+            keys.push_back(store_key_t(strprintf("key%d", i)));
+        }
+        read_t read(batched_point_read_t(std::move(keys)),
+                    p == 0 ? profile_bool_t::PROFILE : profile_bool_t::DONT_PROFILE);
+        read_response_t response;
+
+        cond_t interruptor;
+        nsi->read(read, &response, osource->check_in("unittest::run_batched_get_test(rdb_protocol.cc-B)"), &interruptor);
+
+        batched_point_read_response_t *res =
+            boost::get<batched_point_read_response_t>(&response.response);
+        ASSERT_TRUE(res != NULL);
+        ASSERT_EQ(static_cast<size_t>(num_keys), res->rows.size());
+        for (int i = 0; i < num_keys; ++i) {
+            const ql::datum_t &row = res->rows[store_key_t(strprintf("key%d", i))];
+            ASSERT_TRUE(row.has());
+            if (i % 2 == 0) {
+                ASSERT_EQ(ql::datum_t(static_cast<double>(i)), row);
+            } else {
+                ASSERT_EQ(ql::datum_t::null(), row);
+            }
+        }
+    }
+}
+
+TEST(RDBProtocol, BatchedGet) {
+    run_in_thread_pool_with_namespace_interface(&run_batched_get_test, false);
+}
+
+TEST(RDBProtocol, OvershardedBatchedGet) {
+    run_in_thread_pool_with_namespace_interface(&run_batched_get_test, true);
+}
+
 std::string create_sindex(namespace_interface_t *nsi,
                           order_source_t *osource) {
     std::string id = uuid_to_str(generate_uuid());
@@ -0,0 +1,46 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/shards.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(ShardsTest, UnshardGroupedCounts) {
+    cond_t interruptor;
+    ql::env_t env(&interruptor, reql_version_t::LATEST);
+
+    // Shard `s` has a count of `s + 1` for every group `g` with `g % (s + 1) == 0`.
+    const int num_shards = 5;
+    const int num_groups = 200;
+    std::vector<ql::result_t> shard_results(num_shards);
+    std::vector<ql::result_t *> results;
+    for (int s = 0; s < num_shards; ++s) {
+        ql::grouped_t<uint64_t> counts;
+        for (int g = 0; g < num_groups; g += s + 1) {
+            counts[ql::datum_t(static_cast<double>(g))] = s + 1;
+        }
+        shard_results[s] = std::move(counts);
+        results.push_back(&shard_results[s]);
+    }
+
+    scoped_ptr_t<ql::accumulator_t> acc
+        = ql::make_terminal(ql::count_wire_func_t());
+    acc->unshard(&env, store_key_t::max(), results);
+    ql::result_t out;
+    acc->finish(&out);
+
+    ql::grouped_t<uint64_t> *counts = boost::get<ql::grouped_t<uint64_t> >(&out);
+    ASSERT_TRUE(counts != NULL);
+    ASSERT_EQ(static_cast<size_t>(num_groups), counts->size());
+    for (int g = 0; g < num_groups; ++g) {
+        uint64_t expected = 0;
+        for (int s = 0; s < num_shards; ++s) {
+            if (g % (s + 1) == 0) {
+                expected += s + 1;
+            }
+        }
+        ASSERT_EQ(expected, (*counts)[ql::datum_t(static_cast<double>(g))]);
+    }
+}
+
+}  // namespace unittest
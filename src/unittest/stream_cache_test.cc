@@ -0,0 +1,221 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/interruptor.hpp"
+#include "rdb_protocol/context.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/stream_cache.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+// Returns one row per batch, the number of the read that got it.  The read numbered
+// `fail_at` fails, and the one numbered `block_at` waits for `unblock`.
+class batch_stream_t : public ql::eager_datum_stream_t {
+public:
+    explicit batch_stream_t(int _num_batches)
+        : ql::eager_datum_stream_t(ql::make_counted_backtrace()),
+          num_batches(_num_batches), fail_at(0), block_at(0), reads(0),
+          interrupted(false) { }
+
+    bool is_exhausted() const { return reads >= num_batches; }
+    bool is_cfeed() const { return false; }
+
+    const int num_batches;
+    int fail_at;
+    int block_at;
+    cond_t unblock;
+    int reads;
+    bool interrupted;
+
+private:
+    bool is_array() { return false; }
+
+    std::vector<ql::datum_t> next_raw_batch(ql::env_t *env, const ql::batchspec_t &) {
+        const int read = ++reads;
+        if (read == block_at) {
+            try {
+                wait_interruptible(&unblock, env->interruptor);
+            } catch (const interrupted_exc_t &) {
+                interrupted = true;
+                throw;
+            }
+        }
+        if (read == fail_at) {
+            rfail_datum(ql::base_exc_t::GENERIC, "Read %d failed.", read);
+        }
+        return std::vector<ql::datum_t>{ql::datum_t(static_cast<double>(read))};
+    }
+};
+
+void insert_stream(ql::stream_cache_t *cache,
+                   int64_t token,
+                   ql::prefetch_batches_t prefetch_batches,
+                   counted_t<batch_stream_t> stream,
+                   std::map<std::string, ql::wire_func_t> optargs
+                       = std::map<std::string, ql::wire_func_t>()) {
+    cache->insert(token,
+                  ql::use_json_t::NO,
+                  std::move(optargs),
+                  profile_bool_t::DONT_PROFILE,
+                  prefetch_batches,
+                  stream);
+}
+
+// Serves a batch and checks that it's the row `row`.
+void serve_row(ql::stream_cache_t *cache, int64_t token, signal_t *interruptor,
+               double row, Response::ResponseType type) {
+    Response res;
+    ASSERT_TRUE(cache->serve(token, &res, interruptor));
+    ASSERT_EQ(type, res.type());
+    ASSERT_EQ(1, res.response_size());
+    ASSERT_EQ(row, res.response(0).r_num());
+}
+
+void serve_in_background(ql::stream_cache_t *cache, int64_t token,
+                         signal_t *interruptor, double row, cond_t *served) {
+    serve_row(cache, token, interruptor, row, Response::SUCCESS_PARTIAL);
+    served->pulse();
+}
+
+void let_prefetches_run() {
+    for (int i = 0; i < 100; ++i) {
+        coro_t::yield();
+    }
+}
+
+TPTEST(StreamCache, PrefetchesNextBatch) {
+    rdb_context_t ctx;
+    ql::stream_cache_t cache(&ctx, ql::reject_cfeeds_t::NO);
+    cond_t interruptor;
+
+    counted_t<batch_stream_t> stream = make_counted<batch_stream_t>(3);
+    insert_stream(&cache, 1, ql::prefetch_batches_t::YES, stream);
+    serve_row(&cache, 1, &interruptor, 1, Response::SUCCESS_PARTIAL);
+    let_prefetches_run();
+    ASSERT_EQ(2, stream->reads);
+
+    serve_row(&cache, 1, &interruptor, 2, Response::SUCCESS_PARTIAL);
+    let_prefetches_run();
+    ASSERT_EQ(3, stream->reads);
+
+    // We don't prefetch past the end.
+    serve_row(&cache, 1, &interruptor, 3, Response::SUCCESS_SEQUENCE);
+    ASSERT_FALSE(cache.contains(1));
+    let_prefetches_run();
+    ASSERT_EQ(3, stream->reads);
+
+    // Streams that might have side effects aren't read until the client asks.
+    counted_t<batch_stream_t> unprefetched = make_counted<batch_stream_t>(3);
+    insert_stream(&cache, 2, ql::prefetch_batches_t::NO, unprefetched);
+    serve_row(&cache, 2, &interruptor, 1, Response::SUCCESS_PARTIAL);
+    let_prefetches_run();
+    ASSERT_EQ(1, unprefetched->reads);
+    serve_row(&cache, 2, &interruptor, 2, Response::SUCCESS_PARTIAL);
+    ASSERT_EQ(2, unprefetched->reads);
+}
+
+TPTEST(StreamCache, ServeWaitsForPrefetch) {
+    rdb_context_t ctx;
+    ql::stream_cache_t cache(&ctx, ql::reject_cfeeds_t::NO);
+    cond_t interruptor;
+
+    counted_t<batch_stream_t> stream = make_counted<batch_stream_t>(3);
+    stream->block_at = 2;
+    insert_stream(&cache, 1, ql::prefetch_batches_t::YES, stream);
+    serve_row(&cache, 1, &interruptor, 1, Response::SUCCESS_PARTIAL);
+    let_prefetches_run();
+
+    cond_t served;
+    coro_t::spawn_sometime(std::bind(&serve_in_background, &cache, 1, &interruptor,
+                                     2, &served));
+    let_prefetches_run();
+    ASSERT_FALSE(served.is_pulsed());
+    ASSERT_EQ(2, stream->reads);
+
+    stream->unblock.pulse();
+    let_prefetches_run();
+    ASSERT_TRUE(served.is_pulsed());
+}
+
+TPTEST(StreamCache, ServesPrefetchError) {
+    rdb_context_t ctx;
+    ql::stream_cache_t cache(&ctx, ql::reject_cfeeds_t::NO);
+    cond_t interruptor;
+
+    counted_t<batch_stream_t> stream = make_counted<batch_stream_t>(3);
+    stream->fail_at = 2;
+    insert_stream(&cache, 1, ql::prefetch_batches_t::YES, stream);
+    serve_row(&cache, 1, &interruptor, 1, Response::SUCCESS_PARTIAL);
+    let_prefetches_run();
+    ASSERT_EQ(2, stream->reads);
+
+    // The error waits for the client to ask for the batch.
+    ASSERT_TRUE(cache.contains(1));
+    Response res;
+    ASSERT_THROW(UNUSED bool b = cache.serve(1, &res, &interruptor), ql::exc_t);
+    ASSERT_FALSE(cache.contains(1));
+}
+
+TPTEST(StreamCache, StopInterruptsPrefetch) {
+    rdb_context_t ctx;
+    ql::stream_cache_t cache(&ctx, ql::reject_cfeeds_t::NO);
+    cond_t interruptor;
+
+    counted_t<batch_stream_t> stream = make_counted<batch_stream_t>(3);
+    stream->block_at = 2;
+    insert_stream(&cache, 1, ql::prefetch_batches_t::YES, stream);
+    serve_row(&cache, 1, &interruptor, 1, Response::SUCCESS_PARTIAL);
+    let_prefetches_run();
+    ASSERT_EQ(2, stream->reads);
+
+    // This is what STOP does, and it waits for the prefetch to give up.
+    cache.erase(1);
+    ASSERT_TRUE(stream->interrupted);
+    ASSERT_FALSE(cache.contains(1));
+}
+
+// Counters are per thread, and these tests run in one.
+int64_t stream_cache_counter_value(perfmon_counter_t *counter) {
+    void *stats = counter->begin_stats();
+    counter->visit_stats(stats);
+    return std::stoll(*counter->end_stats(stats)->get_string());
+}
+
+TPTEST(StreamCache, CountsAdaptiveBatches) {
+    rdb_context_t ctx;
+    ql::stream_cache_t cache(&ctx, ql::reject_cfeeds_t::NO);
+    cond_t interruptor;
+
+    ql::protob_t<const Term> policy
+        = ql::r::expr(std::string("adaptive")).release_counted();
+    std::map<std::string, ql::wire_func_t> optargs;
+    optargs["batch_policy"] = ql::wire_func_t(
+        policy, std::vector<ql::sym_t>(), ql::get_backtrace(policy));
+    insert_stream(&cache, 1, ql::prefetch_batches_t::NO,
+                  make_counted<batch_stream_t>(3), optargs);
+    serve_row(&cache, 1, &interruptor, 1, Response::SUCCESS_PARTIAL);
+    serve_row(&cache, 1, &interruptor, 2, Response::SUCCESS_PARTIAL);
+    ASSERT_EQ(2, stream_cache_counter_value(&ctx.ql_adaptive_batches));
+
+    // Cursors with static batches don't count.
+    insert_stream(&cache, 2, ql::prefetch_batches_t::NO,
+                  make_counted<batch_stream_t>(3));
+    serve_row(&cache, 2, &interruptor, 1, Response::SUCCESS_PARTIAL);
+    ASSERT_EQ(2, stream_cache_counter_value(&ctx.ql_adaptive_batches));
+
+    serve_row(&cache, 1, &interruptor, 3, Response::SUCCESS_SEQUENCE);
+    ASSERT_EQ(3, stream_cache_counter_value(&ctx.ql_adaptive_batches));
+    // The tuner grows or shrinks the batches at most once per batch after the first.
+    ASSERT_GE(2, stream_cache_counter_value(&ctx.ql_adaptive_batches_grown)
+                 + stream_cache_counter_value(&ctx.ql_adaptive_batches_shrunk));
+}
+
+}  // namespace unittest
@@ -5,9 +5,14 @@
 
 #include <functional>
 
+#include "arch/io/disk.hpp"
 #include "arch/timing.hpp"
 #include "arch/runtime/starter.hpp"
+#include "concurrency/cond_var.hpp"
+#include "rdb_protocol/context.hpp"
 #include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "unittest/gtest.hpp"
 #include "utils.hpp"
@@ -91,6 +96,37 @@ serializer_filepath_t temp_file_t::name() const {
     return manual_serializer_filepath(filename, filename + temp_file_create_suffix);
 }
 
+spilling_env_t::spilling_env_t(int64_t array_limit) {
+    char tmpl[] = "/tmp/rdb_unittest.XXXXXX";
+    guarantee_err(mkdtemp(tmpl) != NULL, "Couldn't create a temporary directory");
+    directory = tmpl;
+
+    io_backender.init(new io_backender_t(file_direct_io_mode_t::buffered_desired));
+    ctx.init(new rdb_context_t(
+        NULL, NULL, NULL,
+        boost::shared_ptr<
+            semilattice_readwrite_view_t<auth_semilattice_metadata_t> >(),
+        &get_global_perfmon_collection(), "",
+        io_backender.get(), base_path_t(directory)));
+    interruptor.init(new cond_t);
+
+    ql::protob_t<const Term> limit
+        = ql::r::expr(static_cast<double>(array_limit)).release_counted();
+    std::map<std::string, ql::wire_func_t> optargs;
+    optargs["array_limit"]
+        = ql::wire_func_t(limit, std::vector<ql::sym_t>(), ql::get_backtrace(limit));
+    env.init(new ql::env_t(ctx.get(), interruptor.get(), optargs, NULL));
+}
+
+spilling_env_t::~spilling_env_t() {
+    env.reset();
+    interruptor.reset();
+    ctx.reset();
+    io_backender.reset();
+    // Sorts unlink their files as soon as they make them.
+    const int res = ::rmdir(directory.c_str());
+    EXPECT_EQ(0, res);
+}
 
 void let_stuff_happen() {
 #ifdef VALGRIND
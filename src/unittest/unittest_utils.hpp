@@ -11,6 +11,10 @@
 #include "rdb_protocol/protocol.hpp"
 #include "rpc/serialize_macros.hpp"
 
+class cond_t;
+class io_backender_t;
+class rdb_context_t;
+
 namespace unittest {
 
 std::string rand_string(int len);
@@ -30,6 +34,24 @@ private:
     DISABLE_COPYING(temp_file_t);
 };
 
+// A query environment whose sorts spill to a temporary directory once they have
+// more than `array_limit` rows.  It has to be made in a thread pool.
+class spilling_env_t {
+public:
+    explicit spilling_env_t(int64_t array_limit);
+    ~spilling_env_t();
+    ql::env_t *get() { return env.get(); }
+
+private:
+    std::string directory;
+    scoped_ptr_t<io_backender_t> io_backender;
+    scoped_ptr_t<rdb_context_t> ctx;
+    scoped_ptr_t<cond_t> interruptor;
+    scoped_ptr_t<ql::env_t> env;
+
+    DISABLE_COPYING(spilling_env_t);
+};
+
 void let_stuff_happen();
 
 std::set<ip_address_t> get_unittest_addresses();
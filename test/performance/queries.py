@@ -62,6 +62,14 @@ table_queries = [
         "query": "r.db('test').table(table['name']).filter(r.row['field0'].gt('5'))",
         "tag": "filter_string_5"
     },
+    {
+        "query": "r.db('test').table(table['name']).filter((r.row['int'] > 5) & (r.row['field0'] == '1')).count()",
+        "tag": "filter_int_and_string_count"
+    },
+    {
+        "query": "r.db('test').table(table['name']).map(r.row['float'] * 2 + r.row['int']).count()",
+        "tag": "map_arithmetic_count"
+    },
     {
         "query": "r.db('test').table(table['name']).limit(10).inner_join(r.db('test').table(table['name']), lambda left, right: left['id'] == right['id'])",
         "tag": "inner_join"